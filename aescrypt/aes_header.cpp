@@ -0,0 +1,273 @@
+/*
+ *  aes_header.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ReadAESHeader() function, which parses the
+ *      unencrypted header at the start of an AES Crypt file.  The header is
+ *      read using small reads that are extended only as far as needed to
+ *      cover the extensions, so that typically a single read of the first
+ *      few hundred octets of the file suffices.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <cstring>
+#include <algorithm>
+#include "aes_header.h"
+
+namespace
+{
+
+// Size in octets of the reads issued to fill the header buffer
+constexpr std::size_t Header_Read_Size = 1'024;
+
+// Largest header that will be read; extensions beyond this are ignored
+constexpr std::size_t Max_Header_Size = 65'536;
+
+// Class that reads the header of a file into a buffer as it is consumed
+class HeaderReader
+{
+    public:
+        HeaderReader() :
+            file_handle{INVALID_HANDLE_VALUE},
+            position{},
+            io_error{ERROR_SUCCESS},
+            limit_reached{}
+        {
+        }
+
+        ~HeaderReader()
+        {
+            if (file_handle != INVALID_HANDLE_VALUE)
+            {
+                ::CloseHandle(file_handle);
+            }
+        }
+
+        DWORD Open(const std::wstring &filename, std::uint64_t &file_size);
+        const std::uint8_t *Read(std::size_t count);
+        DWORD Error() const { return io_error; }
+        bool LimitReached() const { return limit_reached; }
+
+    protected:
+        HANDLE file_handle;
+        std::vector<std::uint8_t> buffer;
+        std::size_t position;
+        DWORD io_error;
+        bool limit_reached;
+};
+
+/*
+ *  HeaderReader::Open()
+ *
+ *  Description:
+ *      Open the specified file for reading.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open.
+ *
+ *      file_size [out]
+ *          The size of the file in octets.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
+ *
+ *  Comments:
+ *      The file is opened with all sharing modes so that examining the file
+ *      does not interfere with another process using it.
+ */
+DWORD HeaderReader::Open(const std::wstring &filename,
+                         std::uint64_t &file_size)
+{
+    LARGE_INTEGER size{};
+
+    file_handle = ::CreateFile(filename.c_str(),
+                               GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                   FILE_SHARE_DELETE,
+                               nullptr,
+                               OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL,
+                               nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) return ::GetLastError();
+
+    if (!::GetFileSizeEx(file_handle, &size)) return ::GetLastError();
+
+    file_size = static_cast<std::uint64_t>(size.QuadPart);
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  HeaderReader::Read()
+ *
+ *  Description:
+ *      Return the next count octets of the file, reading more of the file
+ *      into the buffer if required.
+ *
+ *  Parameters:
+ *      count [in]
+ *          The number of octets to return.
+ *
+ *  Returns:
+ *      A pointer to the requested octets, which remains valid until the
+ *      next call, or nullptr if the octets could not be read.
+ *
+ *  Comments:
+ *      A null pointer is returned at the end of the file, on a read error
+ *      (see Error()), or if the header would exceed Max_Header_Size (see
+ *      LimitReached()).
+ */
+const std::uint8_t *HeaderReader::Read(std::size_t count)
+{
+    while (buffer.size() - position < count)
+    {
+        std::size_t current = buffer.size();
+
+        if (position + count > Max_Header_Size)
+        {
+            limit_reached = true;
+            return nullptr;
+        }
+
+        // Read at least as much as required, but in units of the read size
+        std::size_t target = std::min(Max_Header_Size,
+                                      current + std::max(Header_Read_Size,
+                                                         position + count -
+                                                             current));
+        DWORD octets_read{};
+
+        buffer.resize(target);
+        if (!::ReadFile(file_handle,
+                        buffer.data() + current,
+                        static_cast<DWORD>(target - current),
+                        &octets_read,
+                        nullptr))
+        {
+            io_error = ::GetLastError();
+            buffer.resize(current);
+            return nullptr;
+        }
+        buffer.resize(current + octets_read);
+
+        // Stop if the end of the file has been reached
+        if (octets_read == 0) return nullptr;
+    }
+
+    const std::uint8_t *data = buffer.data() + position;
+    position += count;
+
+    return data;
+}
+
+} // namespace
+
+/*
+ *  ReadAESHeader()
+ *
+ *  Description:
+ *      Read the unencrypted header of an AES Crypt file, which includes the
+ *      stream version, any plaintext extensions, and the number of KDF
+ *      iterations.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the AES Crypt file to examine.
+ *
+ *      header [out]
+ *          The information read from the header.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the header was read, ERROR_INVALID_DATA if the file
+ *      is not an AES Crypt file, or else the Windows error code.
+ *
+ *  Comments:
+ *      The password is not needed, as neither the key derivation nor any
+ *      decryption is performed.  For a newer stream version than is
+ *      understood, only the version is returned.  If the extensions exceed
+ *      Max_Header_Size, those read so far are returned and the iterations
+ *      remain zero.
+ */
+DWORD ReadAESHeader(const std::wstring &filename, AESHeaderInfo &header)
+{
+    HeaderReader reader;
+    const std::uint8_t *data;
+
+    header = {};
+
+    DWORD result = reader.Open(filename, header.file_size);
+    if (result != ERROR_SUCCESS) return result;
+
+    // Report a read error in preference to reporting invalid data
+    auto read_failure = [&]() -> DWORD
+    {
+        if (reader.Error() != ERROR_SUCCESS) return reader.Error();
+        if (reader.LimitReached()) return ERROR_SUCCESS;
+        return ERROR_INVALID_DATA;
+    };
+
+    // Read the signature, version, and reserved octet
+    data = reader.Read(5);
+    if (data == nullptr) return read_failure();
+    if (std::memcmp(data, "AES", 3) != 0) return ERROR_INVALID_DATA;
+
+    header.version = data[3];
+
+    // Stream versions 0 and 1 have no extensions; newer ones are unknown
+    if ((header.version < 2) || (header.version > 3)) return ERROR_SUCCESS;
+
+    // Read the extensions, which end with one having a zero length
+    while (true)
+    {
+        data = reader.Read(2);
+        if (data == nullptr) return read_failure();
+
+        std::size_t length = (static_cast<std::size_t>(data[0]) << 8) |
+                             static_cast<std::size_t>(data[1]);
+        if (length == 0) break;
+
+        data = reader.Read(length);
+        if (data == nullptr) return read_failure();
+
+        // The identifier and value are separated by a null octet
+        const char *text = reinterpret_cast<const char *>(data);
+        const char *separator = std::find(text, text + length, '\0');
+        std::string identifier(text, separator);
+
+        // Skip extensions without an identifier, which serve as padding
+        if (identifier.empty()) continue;
+
+        std::string value;
+        if (separator != text + length)
+        {
+            value.assign(separator + 1, text + length);
+        }
+
+        header.extensions.emplace_back(std::move(identifier),
+                                       std::move(value));
+    }
+
+    // Version 3 follows the extensions with the KDF iteration count
+    if (header.version == 3)
+    {
+        data = reader.Read(4);
+        if (data == nullptr) return read_failure();
+
+        header.iterations = (static_cast<std::uint32_t>(data[0]) << 24) |
+                            (static_cast<std::uint32_t>(data[1]) << 16) |
+                            (static_cast<std::uint32_t>(data[2]) << 8) |
+                            static_cast<std::uint32_t>(data[3]);
+    }
+
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,43 @@
+/*
+ *  aes_header.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file declares the ReadAESHeader() function, which reads the
+ *      unencrypted portion of an AES Crypt file: the stream format version,
+ *      the plaintext extensions (e.g., CREATED_BY), and the number of key
+ *      derivation iterations.  No key is derived and nothing is decrypted,
+ *      so this is inexpensive enough to call while hovering over a file in
+ *      Explorer or when taking an inventory of a large number of files.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Information found in the unencrypted header of an AES Crypt file; the
+// iterations are zero for stream versions prior to 3, which did not use
+// PBKDF2, and the extensions are present only in versions 2 and later
+struct AESHeaderInfo
+{
+    std::uint8_t version;
+    std::uint32_t iterations;
+    std::vector<std::pair<std::string, std::string>> extensions;
+    std::uint64_t file_size;
+};
+
+// Read the unencrypted header of the given AES Crypt file
+DWORD ReadAESHeader(const std::wstring &filename, AESHeaderInfo &header);
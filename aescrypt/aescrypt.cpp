@@ -23,6 +23,10 @@
 #include "aescrypt.h"
 #include "worker_threads.h"
 #include "file_list.h"
+#include "batch_summary.h"
+#include "trace_provider.h"
+#include "self_test.h"
+#include "batch_host.h"
 
 // Defines the ATL-based module used by the shell extension
 class AESCryptModule : public ATL::CAtlDllModuleT<AESCryptModule>
@@ -49,6 +53,10 @@ extern "C" BOOL WINAPI DllMain(HINSTANCE hInstance,
                                DWORD dwReason,
                                LPVOID lpReserved)
 {
+    // Register the trace provider before any events may be written
+    if (dwReason == DLL_PROCESS_ATTACH) RegisterTraceProvider();
+    if (dwReason == DLL_PROCESS_DETACH) UnregisterTraceProvider();
+
     return AES_Crypt_Module.DllMain(dwReason, lpReserved);
 }
 
@@ -129,3 +137,59 @@ __declspec(dllexport) bool __cdecl AESLibraryBusy()
 {
    return Worker_Threads.IsBusy();
 }
+
+// Exported function that allows aescrypt32.exe to encrypt, decrypt, or verify
+// a list of files, returning an event that is signaled once processing
+// completes
+__declspec(dllexport) HANDLE __cdecl ProcessFilesAsync(
+                                                FileList &file_list,
+                                                BatchOperation operation,
+                                                const BatchOptions &options)
+{
+   return Worker_Threads.ProcessFilesAsync(file_list, operation, options);
+}
+
+// Exported function that allows aescrypt32.exe to encrypt, decrypt, or verify
+// a list of files using the given UTF-8 password without showing any
+// dialogs, returning an event that is signaled once the summary is complete
+__declspec(dllexport) HANDLE __cdecl ProcessFilesHeadless(
+                                                FileList &file_list,
+                                                const std::string &password,
+                                                BatchOperation operation,
+                                                const BatchOptions &options,
+                                                BatchSummary &summary)
+{
+   SecureU8String secure_password(
+       reinterpret_cast<const char8_t *>(password.data()),
+       password.size());
+
+   return Worker_Threads.ProcessFilesHeadless(file_list,
+                                              secure_password,
+                                              operation,
+                                              options,
+                                              summary);
+}
+
+// Exported function that allows aescrypt32.exe to hand a list of files to the
+// batch host, returning false if the batch host is not used or unavailable
+__declspec(dllexport) bool __cdecl ProcessFilesInHost(
+                                                FileList &file_list,
+                                                BatchOperation operation,
+                                                const BatchOptions &options)
+{
+   return UseBatchHost() && SubmitToBatchHost(file_list, operation, options);
+}
+
+// Exported function that allows aescrypt32.exe to serve as the batch host,
+// returning once the host has been idle for some time
+__declspec(dllexport) DWORD __cdecl ServeBatchHost()
+{
+   return RunBatchHost();
+}
+
+// Exported function that allows aescrypt32.exe to report the processor
+// features, self-test result, and performance of the cryptographic functions
+__declspec(dllexport) std::wstring __cdecl GetDiagnostics()
+{
+   return GetCryptoDiagnostics();
+}
@@ -0,0 +1,328 @@
+/*
+ *  aescrypt_info_tip.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the C++ class that provides the tooltip shown by
+ *      the Windows shell for .aes files.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <cstdint>
+#include <string>
+#include <cwchar>
+#include <terra/charutil/character_utilities.h>
+#include <terra/bitutil/byte_order.h>
+#include "aescrypt.h"
+#include "aescrypt_info_tip.h"
+#include "aes_header.h"
+
+namespace
+{
+
+/*
+ *  ConvertFromUTF8()
+ *
+ *  Description:
+ *      Convert a UTF-8 string read from the file header to UTF-16.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The UTF-8 string to convert.
+ *
+ *  Returns:
+ *      The converted string, or "?" if the string is not valid UTF-8.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring ConvertFromUTF8(const std::string &text)
+{
+    std::wstring unicode_text(text.size(), L'\0');
+
+    // This function assumes wchar_t is two octets in length
+    static_assert(sizeof(wchar_t) == 2);
+
+    auto [convert_success, length] = Terra::CharUtil::ConvertUTF8ToUTF16(
+        {reinterpret_cast<const std::uint8_t *>(text.data()), text.size()},
+        {reinterpret_cast<std::uint8_t *>(unicode_text.data()),
+         unicode_text.size() * sizeof(wchar_t)},
+        Terra::BitUtil::IsLittleEndian());
+
+    if (!convert_success) return L"?";
+
+    // The length is in octets, resize to two-octet characters
+    unicode_text.resize(length / 2);
+
+    return unicode_text;
+}
+
+/*
+ *  DuplicateString()
+ *
+ *  Description:
+ *      Copy a string into memory allocated with CoTaskMemAlloc(), as the
+ *      shell requires for strings returned to it.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to copy.
+ *
+ *      copy [out]
+ *          The copy of the string, which the caller must free.
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT DuplicateString(const std::wstring &text, PWSTR *copy)
+{
+    std::size_t size = (text.size() + 1) * sizeof(wchar_t);
+
+    *copy = static_cast<PWSTR>(::CoTaskMemAlloc(size));
+    if (*copy == nullptr) return E_OUTOFMEMORY;
+
+    std::wmemcpy(*copy, text.c_str(), text.size() + 1);
+
+    return S_OK;
+}
+
+} // namespace
+
+/*
+ *  AESCryptInfoTip::GetClassID()
+ *
+ *  Description:
+ *      Return the class identifier of this object.
+ *
+ *  Parameters:
+ *      pClassID [out]
+ *          The class identifier.
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::GetClassID(CLSID *pClassID)
+{
+    if (pClassID == nullptr) return E_POINTER;
+
+    *pClassID = CLSID_AESCryptInfoTipCom;
+
+    return S_OK;
+}
+
+/*
+ *  AESCryptInfoTip::IsDirty()
+ *
+ *  Description:
+ *      Indicate whether the object has changed since it was loaded.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      S_FALSE, since the file is never modified.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::IsDirty()
+{
+    return S_FALSE;
+}
+
+/*
+ *  AESCryptInfoTip::Load()
+ *
+ *  Description:
+ *      Called by the shell to identify the file for which a tip is wanted.
+ *
+ *  Parameters:
+ *      pszFileName [in]
+ *          The name of the file.
+ *
+ *      dwMode [in]
+ *          The access mode requested (ignored).
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      The file is not opened until the tip is requested.
+ */
+HRESULT AESCryptInfoTip::Load(LPCOLESTR pszFileName, DWORD dwMode)
+{
+    if (pszFileName == nullptr) return E_INVALIDARG;
+
+    filename = pszFileName;
+
+    return S_OK;
+}
+
+/*
+ *  AESCryptInfoTip::Save()
+ *
+ *  Description:
+ *      Not supported, as the file is only examined.
+ *
+ *  Parameters:
+ *      pszFileName [in]
+ *          The name of the file.
+ *
+ *      fRemember [in]
+ *          Whether the named file becomes the current file.
+ *
+ *  Returns:
+ *      E_NOTIMPL.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::Save(LPCOLESTR pszFileName, BOOL fRemember)
+{
+    return E_NOTIMPL;
+}
+
+/*
+ *  AESCryptInfoTip::SaveCompleted()
+ *
+ *  Description:
+ *      Not supported, as the file is only examined.
+ *
+ *  Parameters:
+ *      pszFileName [in]
+ *          The name of the file.
+ *
+ *  Returns:
+ *      E_NOTIMPL.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::SaveCompleted(LPCOLESTR pszFileName)
+{
+    return E_NOTIMPL;
+}
+
+/*
+ *  AESCryptInfoTip::GetCurFile()
+ *
+ *  Description:
+ *      Return the name of the file given to Load().
+ *
+ *  Parameters:
+ *      ppszFileName [out]
+ *          The name of the file, allocated with CoTaskMemAlloc().
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::GetCurFile(LPOLESTR *ppszFileName)
+{
+    if (ppszFileName == nullptr) return E_POINTER;
+
+    *ppszFileName = nullptr;
+
+    if (filename.empty()) return E_FAIL;
+
+    return DuplicateString(filename, ppszFileName);
+}
+
+/*
+ *  AESCryptInfoTip::GetInfoTip()
+ *
+ *  Description:
+ *      Produce the tip text describing the file, which is read from the
+ *      unencrypted header of the file.
+ *
+ *  Parameters:
+ *      dwFlags [in]
+ *          Flags controlling the tip (ignored).
+ *
+ *      ppwszTip [out]
+ *          The tip text, allocated with CoTaskMemAlloc().
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      This is called as the mouse hovers over a file, so only the header
+ *      is read (see ReadAESHeader()).  If the file is not a valid AES Crypt
+ *      file, failure is returned so the shell shows its default tip.
+ */
+HRESULT AESCryptInfoTip::GetInfoTip(DWORD dwFlags, PWSTR *ppwszTip)
+{
+    AESHeaderInfo header;
+
+    if (ppwszTip == nullptr) return E_POINTER;
+
+    *ppwszTip = nullptr;
+
+    if (ReadAESHeader(filename, header) != ERROR_SUCCESS) return E_FAIL;
+
+    std::wstring tip = L"AES Crypt file (stream version " +
+                       std::to_wstring(header.version) + L")";
+
+    for (const auto &[identifier, value] : header.extensions)
+    {
+        std::wstring label = (identifier == "CREATED_BY") ?
+                                 L"Created by" :
+                                 ConvertFromUTF8(identifier);
+
+        tip += L"\n" + label + L": " + ConvertFromUTF8(value);
+    }
+
+    if ((header.version == 3) && (header.iterations != 0))
+    {
+        tip += L"\nKey derivation: PBKDF2-HMAC-SHA512, " +
+               std::to_wstring(header.iterations) + L" iterations";
+    }
+    else if (header.version < 3)
+    {
+        tip += L"\nKey derivation: SHA-256, 8192 iterations";
+    }
+
+    return DuplicateString(tip, ppwszTip);
+}
+
+/*
+ *  AESCryptInfoTip::GetInfoFlags()
+ *
+ *  Description:
+ *      Return flags describing the tip.
+ *
+ *  Parameters:
+ *      pdwFlags [out]
+ *          The flags, which are always zero.
+ *
+ *  Returns:
+ *      HRESULT code indicating success or failure.
+ *
+ *  Comments:
+ *      None.
+ */
+HRESULT AESCryptInfoTip::GetInfoFlags(DWORD *pdwFlags)
+{
+    if (pdwFlags == nullptr) return E_POINTER;
+
+    *pdwFlags = 0;
+
+    return S_OK;
+}
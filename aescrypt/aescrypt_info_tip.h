@@ -0,0 +1,69 @@
+/*
+ *  aescrypt_info_tip.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This defines the C++ class that provides the tooltip (InfoTip) shown
+ *      by the Windows shell when hovering over an .aes file.  The tip gives
+ *      the stream version, the software that created the file, and the key
+ *      derivation parameters, all read from the unencrypted file header.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <shlobj.h>
+#include <string>
+#include "resource.h"
+
+// AESCryptInfoTip class declaration
+class ATL_NO_VTABLE AESCryptInfoTip :
+        public ATL::CComObjectRootEx<ATL::CComSingleThreadModel>,
+        public ATL::CComCoClass<AESCryptInfoTip, &CLSID_AESCryptInfoTipCom>,
+        public IPersistFile,
+        public IQueryInfo
+{
+    public:
+        AESCryptInfoTip() = default;
+        ~AESCryptInfoTip() = default;
+
+        // IPersistFile
+        STDMETHOD(GetClassID)(CLSID *);
+        STDMETHOD(IsDirty)();
+        STDMETHOD(Load)(LPCOLESTR, DWORD);
+        STDMETHOD(Save)(LPCOLESTR, BOOL);
+        STDMETHOD(SaveCompleted)(LPCOLESTR);
+        STDMETHOD(GetCurFile)(LPOLESTR *);
+
+        // IQueryInfo
+        STDMETHOD(GetInfoTip)(DWORD, PWSTR *);
+        STDMETHOD(GetInfoFlags)(DWORD *);
+
+        DECLARE_REGISTRY_RESOURCEID(IDR_AESCRYPTINFOTIP)
+        DECLARE_NOT_AGGREGATABLE(AESCryptInfoTip)
+
+        BEGIN_COM_MAP(AESCryptInfoTip)
+            COM_INTERFACE_ENTRY(IPersistFile)
+            COM_INTERFACE_ENTRY(IQueryInfo)
+        END_COM_MAP()
+
+        DECLARE_PROTECT_FINAL_CONSTRUCT()
+
+        HRESULT FinalConstruct() { return S_OK; }
+
+        void FinalRelease() {}
+
+    protected:
+        std::wstring filename;
+};
+
+OBJECT_ENTRY_AUTO(__uuidof(AESCryptInfoTipCom), AESCryptInfoTip)
@@ -22,11 +22,11 @@
 #include <string>
 #include <filesystem>
 #include <algorithm>
+#include <memory>
 #include <commctrl.h>
 #include "aescrypt.h"
 #include "aescrypt_shell_extension.h"
 #include "worker_threads.h"
-#include "has_aes_extension.h"
 
 // Make the global worker thread object visible in this module
 extern WorkerThreads Worker_Threads;
@@ -110,7 +110,10 @@ AESCryptShellExtension::~AESCryptShellExtension()
  *      HRESULT code indicating success or failure.
  *
  *  Comments:
- *      None.
+ *      This is called on the shell's user interface thread, so it does only
+ *      the work needed to decide whether to offer encryption or decryption.
+ *      The full list of file names is produced only if the command is
+ *      invoked, and then on a background thread.
  */
 HRESULT AESCryptShellExtension::Initialize(LPCITEMIDLIST pidlFolder,
                                            LPDATAOBJECT pDO,
@@ -122,67 +125,22 @@ HRESULT AESCryptShellExtension::Initialize(LPCITEMIDLIST pidlFolder,
     // Read the list of folders
     if (FAILED(pDO->GetData(&etc, &stg))) return E_INVALIDARG;
 
-    // Get an HDROP handle
-    HDROP hDrop = static_cast<HDROP>(GlobalLock(stg.hGlobal));
-    if (hDrop == NULL)
-    {
-        ReleaseStgMedium(&stg);
-        return E_INVALIDARG;
-    }
-
-    // Clear the file list (paranoia)
-    file_list.clear();
-
-    // Initialize the variables that indicate the type of files we have
-    aes_files = false;
-    non_aes_files = false;
-
-    // Get a count of the number of files
-    UINT file_count = DragQueryFile(hDrop, 0xFFFFFFFF, NULL, 0);
-
-    // Iterate over the list of files
-    for (UINT i = 0; i < file_count; i++)
-    {
-        std::wstring filename;
-        wchar_t filename_buffer[MAX_PATH];
-
-        // Try to retrieve a filename associated with this invocation
-        if (!DragQueryFile(hDrop, i, filename_buffer, MAX_PATH)) continue;
-
-        // Get the file name length and copy it into a std::wstring
-        size_t filename_length = _tcsnlen(filename_buffer, MAX_PATH);
-        std::copy(filename_buffer,
-                  filename_buffer + filename_length,
-                  std::back_inserter(filename));
-
-        // Determine if this is a .aes file or not
-        if (HasAESExtension(filename))
-        {
-            aes_files = true;
-
-            // Do not allow mixing of file types
-            if (non_aes_files) break;
-        }
-        else
-        {
-            non_aes_files = true;
+    // Copy the file list without examining each file
+    bool loaded = file_list.Load(stg.hGlobal);
 
-            // Do not allow mixing of file types
-            if (aes_files) break;
-        }
-
-        file_list.emplace_back(std::move(filename));
-    }
+    // Determine the type of files we have
+    file_list.Classify(aes_files, non_aes_files);
 
     // Release resources
-    GlobalUnlock(stg.hGlobal);
     ReleaseStgMedium(&stg);
 
+    if (!loaded) return E_INVALIDARG;
+
     // Do not show the menu if both a mix of .aes and non-.aes files seen
     if (aes_files && non_aes_files) return E_INVALIDARG;
 
     // If there are no files in the list, do not render a menu
-    if (file_list.empty()) return E_INVALIDARG;
+    if (file_list.Empty()) return E_INVALIDARG;
 
     return S_OK;
 }
@@ -230,7 +188,7 @@ HRESULT AESCryptShellExtension::QueryContextMenu(HMENU hMenu,
 
     // Should not happen, but do nothing if both .aes and non-.aes files seen
     // or if the file list is empty
-    if ((aes_files && non_aes_files) || file_list.empty())
+    if ((aes_files && non_aes_files) || file_list.Empty())
     {
         return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, 0);
     }
@@ -243,6 +201,11 @@ HRESULT AESCryptShellExtension::QueryContextMenu(HMENU hMenu,
                    MF_STRING | MF_BYPOSITION,
                    uidFirstCmd,
                    L"AES Decrypt");
+        InsertMenu(hMenu,
+                   uMenuIndex + 1,
+                   MF_STRING | MF_BYPOSITION,
+                   uidFirstCmd + 1,
+                   L"AES Verify");
     }
     else
     {
@@ -263,8 +226,8 @@ HRESULT AESCryptShellExtension::QueryContextMenu(HMENU hMenu,
                            NULL);
     }
 
-    // Tell the shell that we added one menu item
-    return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, 1);
+    // Tell the shell how many menu items were added
+    return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, (aes_files ? 2 : 1));
 }
 
 /*
@@ -307,8 +270,9 @@ HRESULT AESCryptShellExtension::GetCommandString(UINT idCmd,
 {
     const wchar_t *command_text;
 
-    // There is only one command, so the idCmd should always be 0
-    if (idCmd != 0)
+    // There is one command for non-.aes files (encrypt) and two for .aes
+    // files (decrypt and verify)
+    if ((idCmd != 0) && ((idCmd != 1) || !aes_files))
     {
         ATLASSERT(0);                           // should never get here
         return E_INVALIDARG;
@@ -318,7 +282,11 @@ HRESULT AESCryptShellExtension::GetCommandString(UINT idCmd,
     switch (uType)
     {
         case GCS_HELPTEXT:
-            if (aes_files)
+            if (idCmd == 1)
+            {
+                command_text = L"Verify selected AES file(s)";
+            }
+            else if (aes_files)
             {
                 command_text = L"Decrypt selected AES file(s)";
             }
@@ -338,7 +306,11 @@ HRESULT AESCryptShellExtension::GetCommandString(UINT idCmd,
             break;
 
         case GCS_VERB:
-            if (aes_files)
+            if (idCmd == 1)
+            {
+                command_text = L"AES Verify";
+            }
+            else if (aes_files)
             {
                 command_text = L"AES Decrypt";
             }
@@ -388,18 +360,35 @@ HRESULT AESCryptShellExtension::InvokeCommand(LPCMINVOKECOMMANDINFO pInfo)
     // If lpVerb really points to a string, ignore this function call
     if (HIWORD(pInfo->lpVerb) != 0) return E_INVALIDARG;
 
-    // AES Crypt inserts only one menu, so the command value should be 0
-    if (LOWORD(pInfo->lpVerb) != 0)
+    // AES Crypt inserts one menu item, or two for .aes files (decrypt and
+    // verify), so the command value should be 0 or 1
+    const WORD command = LOWORD(pInfo->lpVerb);
+    if ((command != 0) && ((command != 1) || !aes_files))
     {
         ATLASSERT(0);                           // should never get here
         return E_INVALIDARG;
     }
 
-    // The menu item was invoked, so process the list of files
-    Worker_Threads.ProcessFiles(file_list, (non_aes_files == true));
+    // Determine which operation was selected
+    BatchOperation operation = BatchOperation::Encrypt;
+    if (aes_files)
+    {
+        operation = (command == 1) ? BatchOperation::Verify :
+                                     BatchOperation::Decrypt;
+    }
+
+    // Hand the file list to the worker threads, which will produce the
+    // list of file names on a background thread
+    auto drop_file_list = std::make_shared<DropFileList>(std::move(file_list));
+    Worker_Threads.ProcessFiles(
+        [drop_file_list]() -> FileList
+        {
+            return drop_file_list->GetFileList();
+        },
+        operation);
 
     // Clear the file list
-    file_list.clear();
+    file_list.Clear();
 
     return S_OK;
 }
@@ -21,6 +21,7 @@
 #include <shlobj.h>
 #include "resource.h"
 #include "file_list.h"
+#include "drop_file_list.h"
 
 #if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
 #error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
@@ -67,7 +68,7 @@ class ATL_NO_VTABLE AESCryptShellExtension :
         HBITMAP context_bitmap;
         bool aes_files;
         bool non_aes_files;
-        FileList file_list;
+        DropFileList file_list;
 };
 
 OBJECT_ENTRY_AUTO(__uuidof(AESCryptShellExtensionCom), AESCryptShellExtension)
@@ -0,0 +1,1091 @@
+/*
+ *  archive_stream.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ArchiveBuilder and ArchiveExtractor classes,
+ *      which produce and consume a stream holding several files.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include <cwctype>
+#include <filesystem>
+#include "archive_stream.h"
+#include "text_convert.h"
+#include "globals.h"
+
+namespace
+{
+
+// Octets identifying an archive (including the format version)
+constexpr char Archive_Magic[8] = {'A', 'E', 'S', 'C', 'A', 'R', 'C', '\x01'};
+
+// Size of the magic, member count, and index length preceding the index
+constexpr std::size_t Preamble_Size = 8 + 4 + 8;
+
+// Size of the fixed portion of an index entry (preceding the name)
+constexpr std::size_t Index_Entry_Size = 8 + 8 + 8 + 2;
+
+// Largest index accepted when extracting an archive
+constexpr std::uint64_t Maximum_Index_Size = 256 * 1024 * 1024;
+
+/*
+ *  AppendInteger()
+ *
+ *  Description:
+ *      Append an unsigned integer to the buffer in little endian byte order.
+ *
+ *  Parameters:
+ *      buffer [in/out]
+ *          The buffer to which the integer is appended.
+ *
+ *      value [in]
+ *          The value to append.
+ *
+ *      octets [in]
+ *          The number of octets the value occupies.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void AppendInteger(std::vector<char> &buffer,
+                   std::uint64_t value,
+                   std::size_t octets)
+{
+    for (std::size_t i = 0; i < octets; i++)
+    {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+/*
+ *  ReadInteger()
+ *
+ *  Description:
+ *      Read an unsigned integer stored in little endian byte order.
+ *
+ *  Parameters:
+ *      data [in]
+ *          The octets holding the integer.
+ *
+ *      octets [in]
+ *          The number of octets the value occupies.
+ *
+ *  Returns:
+ *      The value read.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t ReadInteger(const char *data, std::size_t octets)
+{
+    std::uint64_t value{};
+
+    for (std::size_t i = 0; i < octets; i++)
+    {
+        value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i]))
+                 << (8 * i);
+    }
+
+    return value;
+}
+
+/*
+ *  IsValidComponent()
+ *
+ *  Description:
+ *      Determine whether the given component of a member name may be used
+ *      as a file or directory name.
+ *
+ *  Parameters:
+ *      component [in]
+ *          The name of a single file or directory.
+ *
+ *  Returns:
+ *      True if the component is acceptable, false otherwise.
+ *
+ *  Comments:
+ *      This rejects names that would refer to a location outside of the
+ *      extraction directory (e.g., ".."), that Windows would alter, or that
+ *      refer to a device (e.g., "CON" or "nul.txt").
+ */
+bool IsValidComponent(const std::wstring &component)
+{
+    if (component.empty() || (component == L".") || (component == L".."))
+    {
+        return false;
+    }
+
+    // Windows silently removes trailing periods and spaces
+    if ((component.back() == L'.') || (component.back() == L' ')) return false;
+
+    for (wchar_t c : component)
+    {
+        if ((c < 0x20) || (std::wstring_view(L"<>:\"/\\|?*").find(c) !=
+                           std::wstring_view::npos))
+        {
+            return false;
+        }
+    }
+
+    // Device names are reserved regardless of case or any extension given
+    std::wstring base = component.substr(0, component.find(L'.'));
+    while (!base.empty() && (base.back() == L' ')) base.pop_back();
+    for (wchar_t &c : base) c = static_cast<wchar_t>(std::towupper(c));
+
+    if ((base == L"CON") || (base == L"PRN") || (base == L"AUX") ||
+        (base == L"NUL") || (base == L"CONIN$") || (base == L"CONOUT$"))
+    {
+        return false;
+    }
+
+    if ((base.size() == 4) &&
+        ((base.compare(0, 3, L"COM") == 0) ||
+         (base.compare(0, 3, L"LPT") == 0)) &&
+        (std::wstring_view(L"0123456789\u00b9\u00b2\u00b3").find(base[3]) !=
+         std::wstring_view::npos))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+/*
+ *  ArchiveBuilder::ArchiveBuilder()
+ *
+ *  Description:
+ *      Constructor for the ArchiveBuilder object.
+ *
+ *  Parameters:
+ *      buffer_size [in]
+ *          The size of each read request for member files (zero selects a
+ *          size for the volume).
+ *
+ *      queue_depth [in]
+ *          The number of read requests that may be outstanding for member
+ *          files (zero selects a depth for the volume).
+ *
+ *      unbuffered [in]
+ *          True if member files should be read without using the system file
+ *          cache, where possible.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ArchiveBuilder::ArchiveBuilder(std::size_t buffer_size,
+                               std::size_t queue_depth,
+                               bool unbuffered) :
+    data_size{0},
+    index_sent{false},
+    next_member{0},
+    member_open{false},
+    member_remaining{0},
+    reader(buffer_size, queue_depth),
+    unbuffered{unbuffered},
+    buffer(Buffered_IO_Size),
+    io_error{ERROR_SUCCESS}
+{
+}
+
+/*
+ *  ArchiveBuilder::~ArchiveBuilder()
+ *
+ *  Description:
+ *      Destructor for the ArchiveBuilder object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ArchiveBuilder::~ArchiveBuilder()
+{
+    Close();
+}
+
+/*
+ *  ArchiveBuilder::AddMember()
+ *
+ *  Description:
+ *      Add a file to the archive.  All files must be added before the
+ *      archive is read.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to read.
+ *
+ *      name [in]
+ *          The name to give the file within the archive, relative to the
+ *          archive root.  Either '\' or '/' may separate directory names.
+ *
+ *      size [in]
+ *          The size of the file in octets.  Exactly this many octets of the
+ *          file will be stored in the archive.
+ *
+ *      last_write_time [in]
+ *          The last write time of the file as a FILETIME value.
+ *
+ *  Returns:
+ *      True if the file was added, false if the name is not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ArchiveBuilder::AddMember(const std::wstring &filename,
+                               const std::wstring &name,
+                               std::uint64_t size,
+                               std::uint64_t last_write_time)
+{
+    std::wstring member_name = name;
+
+    // Names within the archive always use '/' as the separator
+    std::replace(member_name.begin(), member_name.end(), L'\\', L'/');
+
+    std::string utf8_name = ConvertToUTF8(member_name);
+    if (utf8_name.empty() || (utf8_name.size() > 0xffff)) return false;
+
+    members.push_back({utf8_name, size, data_size, last_write_time});
+    filenames.push_back(filename);
+    data_size += size;
+
+    return true;
+}
+
+/*
+ *  ArchiveBuilder::GetArchiveSize()
+ *
+ *  Description:
+ *      Returns the total size of the archive in octets.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The size of the archive.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t ArchiveBuilder::GetArchiveSize() const
+{
+    std::uint64_t index_size = Preamble_Size;
+
+    for (const auto &member : members)
+    {
+        index_size += Index_Entry_Size + member.name.size();
+    }
+
+    return index_size + data_size;
+}
+
+/*
+ *  ArchiveBuilder::SetMemberCallback()
+ *
+ *  Description:
+ *      Set a function to call each time the contents of a member file have
+ *      been read completely.
+ *
+ *  Parameters:
+ *      callback [in]
+ *          The function to call.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ArchiveBuilder::SetMemberCallback(const std::function<void()> &callback)
+{
+    member_callback = callback;
+}
+
+/*
+ *  ArchiveBuilder::Close()
+ *
+ *  Description:
+ *      Close any member file being read.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ArchiveBuilder::Close()
+{
+    if (member_open)
+    {
+        reader.Close();
+        member_open = false;
+    }
+
+    setg(nullptr, nullptr, nullptr);
+}
+
+/*
+ *  ArchiveBuilder::BuildIndex()
+ *
+ *  Description:
+ *      Build the archive preamble and index from the list of members.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ArchiveBuilder::BuildIndex()
+{
+    std::uint64_t index_size{};
+
+    for (const auto &member : members)
+    {
+        index_size += Index_Entry_Size + member.name.size();
+    }
+
+    index.clear();
+    index.reserve(static_cast<std::size_t>(Preamble_Size + index_size));
+
+    index.insert(index.end(),
+                 Archive_Magic,
+                 Archive_Magic + sizeof(Archive_Magic));
+    AppendInteger(index, members.size(), 4);
+    AppendInteger(index, index_size, 8);
+
+    for (const auto &member : members)
+    {
+        AppendInteger(index, member.offset, 8);
+        AppendInteger(index, member.size, 8);
+        AppendInteger(index, member.last_write_time, 8);
+        AppendInteger(index, member.name.size(), 2);
+        index.insert(index.end(), member.name.begin(), member.name.end());
+    }
+}
+
+/*
+ *  ArchiveBuilder::OpenMember()
+ *
+ *  Description:
+ *      Open the next member file to be read.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the file was opened, false if there was an error.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ArchiveBuilder::OpenMember()
+{
+    DWORD error = reader.Open(filenames[next_member], unbuffered);
+    if (error != ERROR_SUCCESS)
+    {
+        io_error = error;
+        error_file = filenames[next_member];
+        return false;
+    }
+
+    member_open = true;
+    member_remaining = members[next_member].size;
+
+    return true;
+}
+
+/*
+ *  ArchiveBuilder::underflow()
+ *
+ *  Description:
+ *      Make the next portion of the archive available to read.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character or traits_type::eof() at the end of the archive
+ *      or on error.
+ *
+ *  Comments:
+ *      Should a member file become shorter after it was added, reading
+ *      fails with ERROR_HANDLE_EOF rather than producing an archive having
+ *      an incorrect index.
+ */
+ArchiveBuilder::int_type ArchiveBuilder::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    if (io_error != ERROR_SUCCESS) return traits_type::eof();
+
+    // The preamble and index precede the members
+    if (!index_sent)
+    {
+        BuildIndex();
+        index_sent = true;
+        setg(index.data(), index.data(), index.data() + index.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+    while (next_member < members.size())
+    {
+        if (!member_open && !OpenMember()) return traits_type::eof();
+
+        // Move to the next member once this one has been read
+        if (member_remaining == 0)
+        {
+            reader.Close();
+            member_open = false;
+            next_member++;
+            if (member_callback) member_callback();
+            continue;
+        }
+
+        std::streamsize length = reader.sgetn(
+            buffer.data(),
+            static_cast<std::streamsize>(
+                std::min<std::uint64_t>(buffer.size(), member_remaining)));
+        if (length <= 0)
+        {
+            io_error = reader.GetError();
+            if (io_error == ERROR_SUCCESS) io_error = ERROR_HANDLE_EOF;
+            error_file = filenames[next_member];
+            return traits_type::eof();
+        }
+
+        member_remaining -= static_cast<std::uint64_t>(length);
+        setg(buffer.data(), buffer.data(), buffer.data() + length);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    return traits_type::eof();
+}
+
+/*
+ *  ArchiveExtractor::ArchiveExtractor()
+ *
+ *  Description:
+ *      Constructor for the ArchiveExtractor object.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory into which files are extracted.  It will be
+ *          created if it does not exist.
+ *
+ *      buffer_size [in]
+ *          The size of each write request for member files (zero selects a
+ *          size for the volume).
+ *
+ *      queue_depth [in]
+ *          The number of write requests that may be outstanding for member
+ *          files (zero selects a depth for the volume).
+ *
+ *      unbuffered [in]
+ *          True if member files should be written without using the system
+ *          file cache, where possible.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ArchiveExtractor::ArchiveExtractor(const std::wstring &directory,
+                                   std::size_t buffer_size,
+                                   std::size_t queue_depth,
+                                   bool unbuffered) :
+    directory{directory},
+    state{State::Preamble},
+    header_needed{Preamble_Size},
+    member_count{0},
+    current_member{0},
+    member_remaining{0},
+    writer(buffer_size, queue_depth),
+    unbuffered{unbuffered},
+    io_error{ERROR_SUCCESS}
+{
+    // Remove any trailing separator from the directory name
+    while ((this->directory.size() > 1) &&
+           ((this->directory.back() == L'\\') ||
+            (this->directory.back() == L'/')))
+    {
+        this->directory.pop_back();
+    }
+}
+
+/*
+ *  ArchiveExtractor::~ArchiveExtractor()
+ *
+ *  Description:
+ *      Destructor for the ArchiveExtractor object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ArchiveExtractor::~ArchiveExtractor()
+{
+    if (writer.IsOpen()) writer.Close();
+}
+
+/*
+ *  ArchiveExtractor::Close()
+ *
+ *  Description:
+ *      Complete the extraction.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the complete archive was received and all member
+ *      files were written, or an error code otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD ArchiveExtractor::Close()
+{
+    if (writer.IsOpen())
+    {
+        DWORD error = writer.Close();
+        if (io_error == ERROR_SUCCESS) io_error = error;
+    }
+
+    // The archive is incomplete if it ended before the last member
+    if ((io_error == ERROR_SUCCESS) && (state != State::Complete))
+    {
+        io_error = ERROR_INVALID_DATA;
+    }
+
+    return io_error;
+}
+
+/*
+ *  ArchiveExtractor::RemoveExtracted()
+ *
+ *  Description:
+ *      Remove the files and directories created while extracting.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This should be called if the archive could not be decrypted, as the
+ *      contents of the files cannot be trusted.  Directories are only
+ *      removed if they are empty.
+ */
+void ArchiveExtractor::RemoveExtracted()
+{
+    if (writer.IsOpen()) writer.Close();
+
+    for (auto it = created_files.rbegin(); it != created_files.rend(); it++)
+    {
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(*it), ec);
+    }
+
+    for (auto it = created_directories.rbegin();
+         it != created_directories.rend();
+         it++)
+    {
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(*it), ec);
+    }
+
+    created_files.clear();
+    created_directories.clear();
+}
+
+/*
+ *  ArchiveExtractor::overflow()
+ *
+ *  Description:
+ *      Receive a single character of the archive.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character received or traits_type::eof() if none.
+ *
+ *  Returns:
+ *      A value other than traits_type::eof().
+ *
+ *  Comments:
+ *      None.
+ */
+ArchiveExtractor::int_type ArchiveExtractor::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    char character = traits_type::to_char_type(c);
+
+    xsputn(&character, 1);
+
+    return c;
+}
+
+/*
+ *  ArchiveExtractor::xsputn()
+ *
+ *  Description:
+ *      Receive a portion of the archive, writing any member contents to the
+ *      member file.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters received.
+ *
+ *      count [in]
+ *          The number of characters received.
+ *
+ *  Returns:
+ *      The number of characters received, which is always count.
+ *
+ *  Comments:
+ *      Once an error occurs, the remainder of the archive is accepted but
+ *      discarded.  This allows decryption to complete so that the error
+ *      can be reported, rather than a less helpful write error.
+ */
+std::streamsize ArchiveExtractor::xsputn(const char *s, std::streamsize count)
+{
+    std::streamsize consumed{};
+
+    while (consumed < count)
+    {
+        std::streamsize available = count - consumed;
+
+        switch (state)
+        {
+            case State::Preamble:
+            case State::Index:
+            {
+                // Accumulate the preamble or index
+                std::size_t length = static_cast<std::size_t>(
+                    std::min<std::uint64_t>(available,
+                                            header_needed - header.size()));
+                header.insert(header.end(),
+                              s + consumed,
+                              s + consumed + length);
+                consumed += static_cast<std::streamsize>(length);
+
+                if (header.size() < header_needed) break;
+
+                if (state == State::Preamble)
+                {
+                    if (!ParsePreamble()) break;
+                }
+                else
+                {
+                    if (!ParseIndex()) break;
+                }
+
+                break;
+            }
+
+            case State::Members:
+            {
+                std::uint64_t length =
+                    std::min<std::uint64_t>(available, member_remaining);
+
+                if (length > 0)
+                {
+                    std::streamsize written =
+                        writer.sputn(s + consumed,
+                                     static_cast<std::streamsize>(length));
+                    if (written != static_cast<std::streamsize>(length))
+                    {
+                        DWORD error = writer.GetError();
+                        Fail((error != ERROR_SUCCESS) ? error :
+                                                        ERROR_WRITE_FAULT,
+                             created_files.back());
+                        break;
+                    }
+                }
+
+                consumed += static_cast<std::streamsize>(length);
+                member_remaining -= length;
+
+                if (member_remaining == 0) FinishMember();
+
+                break;
+            }
+
+            case State::Complete:
+                // There should be nothing following the last member
+                Fail(ERROR_INVALID_DATA);
+                break;
+
+            case State::Failed:
+                // Discard the remainder of the archive
+                consumed = count;
+                break;
+        }
+    }
+
+    return count;
+}
+
+/*
+ *  ArchiveExtractor::ParsePreamble()
+ *
+ *  Description:
+ *      Parse the archive preamble once it has been received.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the preamble is valid, false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ArchiveExtractor::ParsePreamble()
+{
+    if (!std::equal(Archive_Magic,
+                    Archive_Magic + sizeof(Archive_Magic),
+                    header.begin()))
+    {
+        Fail(ERROR_BAD_FORMAT);
+        return false;
+    }
+
+    member_count = static_cast<std::uint32_t>(ReadInteger(&header[8], 4));
+    std::uint64_t index_size = ReadInteger(&header[12], 8);
+
+    if ((index_size > Maximum_Index_Size) ||
+        (index_size < static_cast<std::uint64_t>(member_count) *
+                          Index_Entry_Size))
+    {
+        Fail(ERROR_BAD_FORMAT);
+        return false;
+    }
+
+    header.clear();
+    header_needed = static_cast<std::size_t>(index_size);
+    state = State::Index;
+
+    // An empty index is complete already
+    if (header_needed == 0) return ParseIndex();
+
+    return true;
+}
+
+/*
+ *  ArchiveExtractor::ParseIndex()
+ *
+ *  Description:
+ *      Parse the archive index once it has been received.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the index is valid, false otherwise.
+ *
+ *  Comments:
+ *      The members must be listed in the order their contents appear.
+ */
+bool ArchiveExtractor::ParseIndex()
+{
+    std::size_t position{};
+    std::uint64_t expected_offset{};
+
+    members.reserve(member_count);
+
+    for (std::uint32_t i = 0; i < member_count; i++)
+    {
+        if (header.size() - position < Index_Entry_Size)
+        {
+            Fail(ERROR_BAD_FORMAT);
+            return false;
+        }
+
+        ArchiveMember member{};
+        member.offset = ReadInteger(&header[position], 8);
+        member.size = ReadInteger(&header[position + 8], 8);
+        member.last_write_time = ReadInteger(&header[position + 16], 8);
+        std::size_t name_length =
+            static_cast<std::size_t>(ReadInteger(&header[position + 24], 2));
+        position += Index_Entry_Size;
+
+        if ((header.size() - position < name_length) ||
+            (member.offset != expected_offset))
+        {
+            Fail(ERROR_BAD_FORMAT);
+            return false;
+        }
+
+        member.name.assign(header.data() + position, name_length);
+        position += name_length;
+        expected_offset += member.size;
+
+        members.push_back(std::move(member));
+    }
+
+    if (position != header.size())
+    {
+        Fail(ERROR_BAD_FORMAT);
+        return false;
+    }
+
+    header.clear();
+    header.shrink_to_fit();
+    state = State::Members;
+
+    return StartMember();
+}
+
+/*
+ *  ArchiveExtractor::StartMember()
+ *
+ *  Description:
+ *      Prepare to receive the contents of the current member, creating the
+ *      member file.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if the member file could not be created.
+ *
+ *  Comments:
+ *      Members having no contents are completed immediately.
+ */
+bool ArchiveExtractor::StartMember()
+{
+    if (current_member >= members.size())
+    {
+        state = State::Complete;
+        return true;
+    }
+
+    const ArchiveMember &member = members[current_member];
+
+    member_remaining = member.size;
+
+    std::wstring name = ConvertToUTF16(member.name);
+    std::wstring path = directory;
+    std::size_t start{};
+
+    if (name.empty())
+    {
+        Fail(ERROR_INVALID_NAME);
+        return false;
+    }
+
+    // Validate each component of the name while forming the path
+    while (start <= name.size())
+    {
+        std::size_t end = name.find(L'/', start);
+        if (end == std::wstring::npos) end = name.size();
+
+        std::wstring component = name.substr(start, end - start);
+        if (!IsValidComponent(component))
+        {
+            Fail(ERROR_INVALID_NAME, directory + L"\\" + name);
+            return false;
+        }
+
+        path += L"\\" + component;
+        start = end + 1;
+    }
+
+    if (!CreateParentDirectories(path)) return false;
+
+    // Do not overwrite existing files
+    DWORD error = writer.Open(path, unbuffered, true);
+    if (error != ERROR_SUCCESS)
+    {
+        Fail(error, path);
+        return false;
+    }
+
+    created_files.push_back(path);
+    writer.SetLastWriteTime(member.last_write_time);
+
+    if (member_remaining == 0) return FinishMember();
+
+    return true;
+}
+
+/*
+ *  ArchiveExtractor::FinishMember()
+ *
+ *  Description:
+ *      Complete the current member and prepare to receive the next.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if the member file could not be written.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ArchiveExtractor::FinishMember()
+{
+    DWORD error = writer.Close();
+    if (error != ERROR_SUCCESS)
+    {
+        Fail(error, created_files.back());
+        return false;
+    }
+
+    current_member++;
+
+    return StartMember();
+}
+
+/*
+ *  ArchiveExtractor::CreateParentDirectories()
+ *
+ *  Description:
+ *      Create any directories that do not yet exist in the path leading to
+ *      the given file, starting with the extraction directory.
+ *
+ *  Parameters:
+ *      path [in]
+ *          The path of the file to be created.
+ *
+ *  Returns:
+ *      True if successful, false if a directory could not be created.
+ *
+ *  Comments:
+ *      Directories created are recorded so that they may be removed should
+ *      extraction fail.
+ */
+bool ArchiveExtractor::CreateParentDirectories(const std::wstring &path)
+{
+    std::size_t end = path.rfind(L'\\');
+
+    for (std::size_t position = directory.size();
+         position != std::wstring::npos && position <= end;
+         position = path.find(L'\\', position + 1))
+    {
+        std::wstring parent = path.substr(0, position);
+
+        if (::CreateDirectoryW(parent.c_str(), nullptr))
+        {
+            created_directories.push_back(parent);
+            continue;
+        }
+
+        DWORD error = ::GetLastError();
+        if (error != ERROR_ALREADY_EXISTS)
+        {
+            Fail(error, parent);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ *  ArchiveExtractor::Fail()
+ *
+ *  Description:
+ *      Record an error, after which the remainder of the archive is
+ *      discarded.
+ *
+ *  Parameters:
+ *      error [in]
+ *          The error code.
+ *
+ *      filename [in]
+ *          The name of the file associated with the error, if any.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ArchiveExtractor::Fail(DWORD error, const std::wstring &filename)
+{
+    if (writer.IsOpen()) writer.Close();
+
+    if (io_error == ERROR_SUCCESS)
+    {
+        io_error = error;
+        error_file = filename;
+    }
+
+    state = State::Failed;
+}
+
+/*
+ *  HasArchiveExtension()
+ *
+ *  Description:
+ *      Returns true if the given filename ends with the archive extension.
+ *      This will perform a case insensitive comparison.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The filename to check.  This may be a complete pathname.
+ *
+ *  Returns:
+ *      True if the file ends in the archive extension and false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool HasArchiveExtension(const std::wstring &filename)
+{
+    constexpr std::size_t length =
+        sizeof(Archive_Extension) / sizeof(wchar_t) - 1;
+
+    if (filename.size() <= length) return false;
+
+    return std::equal(filename.end() - length,
+                      filename.end(),
+                      Archive_Extension,
+                      [](wchar_t a, wchar_t b)
+                      {
+                          return std::towlower(a) == std::towlower(b);
+                      });
+}
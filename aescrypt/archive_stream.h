@@ -0,0 +1,181 @@
+/*
+ *  archive_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the ArchiveBuilder and ArchiveExtractor classes.
+ *      An archive holds several files in a single stream so that they may be
+ *      encrypted together, requiring only one key derivation and one AES
+ *      Crypt header for all of the files.  The ArchiveBuilder presents the
+ *      archive as an input stream buffer, reading each member file as the
+ *      archive is consumed.  The ArchiveExtractor accepts the archive as an
+ *      output stream buffer, writing each member file as it is received.
+ *
+ *      The archive begins with an index giving the name, size, offset, and
+ *      last write time of every member, followed by the contents of each
+ *      member in the order listed.  All integers are stored in little endian
+ *      byte order:
+ *
+ *          magic           8 octets ("AESCARC" followed by version 1)
+ *          member count    4 octets
+ *          index length    8 octets
+ *          index entries   (index length octets)
+ *              offset          8 octets (relative to the first member)
+ *              size            8 octets
+ *              last write time 8 octets (FILETIME)
+ *              name length     2 octets
+ *              name            (name length octets, UTF-8, '/' separated)
+ *          member contents
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "overlapped_file.h"
+
+// Extension given to an archive before the .aes extension is appended
+constexpr wchar_t Archive_Extension[] = L".aar";
+
+// Structure describing a file held within an archive
+struct ArchiveMember
+{
+    // Name relative to the archive root (UTF-8, using '/' as separator)
+    std::string name;
+
+    // Size of the file in octets
+    std::uint64_t size;
+
+    // Offset of the file contents relative to the contents of the first file
+    std::uint64_t offset;
+
+    // Last write time of the file as a FILETIME value
+    std::uint64_t last_write_time;
+};
+
+// Stream buffer that produces an archive from a set of files
+class ArchiveBuilder : public std::streambuf
+{
+    public:
+        ArchiveBuilder(std::size_t buffer_size,
+                       std::size_t queue_depth,
+                       bool unbuffered);
+        virtual ~ArchiveBuilder();
+
+        bool AddMember(const std::wstring &filename,
+                       const std::wstring &name,
+                       std::uint64_t size,
+                       std::uint64_t last_write_time);
+        std::size_t GetMemberCount() const { return members.size(); }
+        std::uint64_t GetArchiveSize() const;
+        void SetMemberCallback(const std::function<void()> &callback);
+        void Close();
+
+        DWORD GetError() const { return io_error; }
+        const std::wstring &GetErrorFile() const { return error_file; }
+
+    protected:
+        int_type underflow() override;
+        void BuildIndex();
+        bool OpenMember();
+
+        std::vector<ArchiveMember> members;
+        std::vector<std::wstring> filenames;
+        std::uint64_t data_size;
+        std::vector<char> index;
+        bool index_sent;
+        std::size_t next_member;
+        bool member_open;
+        std::uint64_t member_remaining;
+        OverlappedFileReader reader;
+        bool unbuffered;
+        std::vector<char> buffer;
+        std::function<void()> member_callback;
+        DWORD io_error;
+        std::wstring error_file;
+};
+
+// Stream buffer that extracts the files from an archive
+class ArchiveExtractor : public std::streambuf
+{
+    public:
+        ArchiveExtractor(const std::wstring &directory,
+                         std::size_t buffer_size,
+                         std::size_t queue_depth,
+                         bool unbuffered);
+        virtual ~ArchiveExtractor();
+
+        DWORD Close();
+        void RemoveExtracted();
+
+        DWORD GetError() const { return io_error; }
+        const std::wstring &GetErrorFile() const { return error_file; }
+
+    protected:
+        // State of the extraction as the archive is received
+        enum class State
+        {
+            Preamble,
+            Index,
+            Members,
+            Complete,
+            Failed
+        };
+
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+        bool ParsePreamble();
+        bool ParseIndex();
+        bool StartMember();
+        bool FinishMember();
+        bool CreateParentDirectories(const std::wstring &path);
+        void Fail(DWORD error, const std::wstring &filename = {});
+
+        std::wstring directory;
+        State state;
+        std::vector<char> header;
+        std::size_t header_needed;
+        std::uint32_t member_count;
+        std::vector<ArchiveMember> members;
+        std::size_t current_member;
+        std::uint64_t member_remaining;
+        OverlappedFileWriter writer;
+        bool unbuffered;
+        std::vector<std::wstring> created_files;
+        std::vector<std::wstring> created_directories;
+        DWORD io_error;
+        std::wstring error_file;
+};
+
+/*
+ *  HasArchiveExtension()
+ *
+ *  Description:
+ *      Returns true if the given filename ends with the archive extension.
+ *      This will perform a case insensitive comparison.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The filename to check.  This may be a complete pathname.
+ *
+ *  Returns:
+ *      True if the file ends in the archive extension and false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool HasArchiveExtension(const std::wstring &filename);
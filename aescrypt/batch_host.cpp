@@ -0,0 +1,1020 @@
+/*
+ *  batch_host.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the batch host and the functions that hand
+ *      requests to it.  A request is sent as a four-octet length followed by
+ *      that many octets of UTF-8 text, one item per line:
+ *
+ *          operation background bandwidth_limit cpu_share sync continue
+ *          filename
+ *          ...
+ *
+ *      where the operation is "encrypt", "decrypt", or "verify".  The host
+ *      replies with a single octet that is 1 if it accepted the request.
+ *
+ *      Pipe names are global to the machine, so the name includes the
+ *      user's SID, the pipe's security descriptor grants access only to
+ *      that user, and a client sends nothing until it has verified that
+ *      the process serving the pipe runs as the same user.  A pipe created
+ *      first by another user therefore only causes requests to be processed
+ *      by the caller.
+ *      The host then prompts for the password and processes the files as
+ *      aescrypt32.exe would, with each request served on its own thread.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <sddl.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include "batch_host.h"
+#include "worker_threads.h"
+#include "settings.h"
+#include "text_convert.h"
+
+extern WorkerThreads Worker_Threads;
+
+namespace
+{
+
+// Largest request accepted by the batch host
+constexpr DWORD Max_Request_Size = 64 * 1024 * 1024;
+
+// Time a caller waits for a newly started batch host to accept requests
+constexpr std::chrono::seconds Batch_Host_Start_Time(10);
+
+// Time allowed for a request or reply to be transferred
+constexpr DWORD Pipe_Timeout = 30'000;
+
+// Interval at which the batch host checks whether it is idle
+constexpr DWORD Idle_Check_Interval = 1'000;
+
+// Name of the executable that runs the batch host
+constexpr wchar_t Host_Executable[] = L"aescrypt32.exe";
+
+// Indicates whether this process is the batch host
+std::atomic<bool> Host_Process{false};
+
+// Number of requests the batch host is serving
+std::atomic<std::size_t> Host_Requests{0};
+
+/*
+ *  GetProcessUser()
+ *
+ *  Description:
+ *      Retrieve the user as whom the given process runs.
+ *
+ *  Parameters:
+ *      process [in]
+ *          A handle to the process, opened with at least
+ *          PROCESS_QUERY_LIMITED_INFORMATION access.
+ *
+ *  Returns:
+ *      A buffer holding the TOKEN_USER structure for the process, or an
+ *      empty buffer if it could not be retrieved.
+ *
+ *  Comments:
+ *      The SID is within the returned buffer, so remains valid only as long
+ *      as the buffer.
+ */
+std::vector<std::uint8_t> GetProcessUser(HANDLE process)
+{
+    HANDLE token{};
+    DWORD length{};
+    std::vector<std::uint8_t> token_user;
+
+    if (!::OpenProcessToken(process, TOKEN_QUERY, &token)) return {};
+
+    ::GetTokenInformation(token, TokenUser, nullptr, 0, &length);
+    if (length > 0)
+    {
+        token_user.resize(length);
+        if (!::GetTokenInformation(token,
+                                   TokenUser,
+                                   token_user.data(),
+                                   length,
+                                   &length))
+        {
+            token_user.clear();
+        }
+    }
+
+    ::CloseHandle(token);
+
+    return token_user;
+}
+
+/*
+ *  GetUserSid()
+ *
+ *  Description:
+ *      Return the SID of the user within a buffer from GetProcessUser().
+ *
+ *  Parameters:
+ *      token_user [in]
+ *          The buffer returned by GetProcessUser(), which must not be empty.
+ *
+ *  Returns:
+ *      The user's SID.
+ *
+ *  Comments:
+ *      None.
+ */
+PSID GetUserSid(std::vector<std::uint8_t> &token_user)
+{
+    return reinterpret_cast<TOKEN_USER *>(token_user.data())->User.Sid;
+}
+
+/*
+ *  GetUserSidString()
+ *
+ *  Description:
+ *      Return the SID of the user running this process in string form.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The SID string, or an empty string if it could not be determined.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring GetUserSidString()
+{
+    LPWSTR sid_text{};
+    std::wstring sid_string;
+
+    std::vector<std::uint8_t> token_user =
+        GetProcessUser(::GetCurrentProcess());
+    if (token_user.empty()) return {};
+
+    if (!::ConvertSidToStringSidW(GetUserSid(token_user), &sid_text))
+    {
+        return {};
+    }
+
+    sid_string = sid_text;
+    ::LocalFree(sid_text);
+
+    return sid_string;
+}
+
+/*
+ *  GetPipeName()
+ *
+ *  Description:
+ *      Return the name of the pipe on which the batch host for the current
+ *      user and logon session accepts requests.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The name of the pipe, or an empty string if the user's SID could not
+ *      be determined.
+ *
+ *  Comments:
+ *      The host shows dialogs on the user's desktop, so each logon session
+ *      has its own host.  Pipe names are global to the machine, so the name
+ *      includes the user's SID to keep the hosts of different users apart;
+ *      this alone does not prevent another user from creating the pipe.
+ */
+std::wstring GetPipeName()
+{
+    DWORD session_id{};
+
+    std::wstring sid_string = GetUserSidString();
+    if (sid_string.empty()) return {};
+
+    ::ProcessIdToSessionId(::GetCurrentProcessId(), &session_id);
+
+    return L"\\\\.\\pipe\\Terrapane.AESCrypt.Host." + sid_string + L"." +
+           std::to_wstring(session_id);
+}
+
+/*
+ *  IsHostSameUser()
+ *
+ *  Description:
+ *      Determine whether the process serving the connected pipe runs as the
+ *      same user as this process.
+ *
+ *  Parameters:
+ *      pipe [in]
+ *          The client end of the pipe connected to the batch host.
+ *
+ *  Returns:
+ *      True if the server runs as the same user, false if it does not or
+ *      this could not be determined.
+ *
+ *  Comments:
+ *      This must be checked before anything is sent to the host, since a
+ *      pipe of the same name may have been created by another user.
+ */
+bool IsHostSameUser(HANDLE pipe)
+{
+    ULONG host_process_id{};
+
+    if (!::GetNamedPipeServerProcessId(pipe, &host_process_id)) return false;
+
+    HANDLE host_process = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION,
+                                        FALSE,
+                                        host_process_id);
+    if (host_process == NULL) return false;
+
+    std::vector<std::uint8_t> host_user = GetProcessUser(host_process);
+    ::CloseHandle(host_process);
+
+    std::vector<std::uint8_t> user = GetProcessUser(::GetCurrentProcess());
+
+    return !host_user.empty() && !user.empty() &&
+           ::EqualSid(GetUserSid(host_user), GetUserSid(user));
+}
+
+/*
+ *  OperationName()
+ *
+ *  Description:
+ *      Return the name used for the operation in a request.
+ *
+ *  Parameters:
+ *      operation [in]
+ *          The operation to perform.
+ *
+ *  Returns:
+ *      The name of the operation.
+ *
+ *  Comments:
+ *      None.
+ */
+const char *OperationName(BatchOperation operation)
+{
+    switch (operation)
+    {
+        case BatchOperation::Encrypt:
+            return "encrypt";
+
+        case BatchOperation::Verify:
+            return "verify";
+
+        default:
+            return "decrypt";
+    }
+}
+
+/*
+ *  FormatRequest()
+ *
+ *  Description:
+ *      Produce the text of a request to be sent to the batch host.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to process.
+ *
+ *      operation [in]
+ *          The operation to perform.
+ *
+ *      options [in]
+ *          Options that override the settings for this request.
+ *
+ *  Returns:
+ *      The request text, or an empty string if a filename could not be
+ *      converted to UTF-8.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string FormatRequest(const FileList &file_list,
+                          BatchOperation operation,
+                          const BatchOptions &options)
+{
+    char header[64];
+
+    std::snprintf(header,
+                  sizeof(header),
+                  "%s %u %lu %lu %u %u\n",
+                  OperationName(operation),
+                  options.background ? 1U : 0U,
+                  static_cast<unsigned long>(options.bandwidth_limit),
+                  static_cast<unsigned long>(options.cpu_share),
+                  options.sync ? 1U : 0U,
+                  options.continue_on_error ? 1U : 0U);
+
+    std::string request = header;
+
+    for (const auto &filename : file_list)
+    {
+        std::string utf8_name = ConvertToUTF8(filename);
+        if (utf8_name.empty()) return {};
+
+        request += utf8_name;
+        request += '\n';
+    }
+
+    return request;
+}
+
+/*
+ *  ParseRequest()
+ *
+ *  Description:
+ *      Parse the text of a request received by the batch host.
+ *
+ *  Parameters:
+ *      request [in]
+ *          The request text.
+ *
+ *      file_list [out]
+ *          The list of files to process.
+ *
+ *      operation [out]
+ *          The operation to perform.
+ *
+ *      options [out]
+ *          Options that override the settings for this request.
+ *
+ *  Returns:
+ *      True if the request is valid, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ParseRequest(const std::string &request,
+                  FileList &file_list,
+                  BatchOperation &operation,
+                  BatchOptions &options)
+{
+    char operation_name[16]{};
+    unsigned background{};
+    unsigned long bandwidth_limit{};
+    unsigned long cpu_share{};
+    unsigned sync{};
+    unsigned continue_on_error{};
+
+    std::size_t line_end = request.find('\n');
+    if (line_end == std::string::npos) return false;
+
+    std::string header = request.substr(0, line_end);
+    if (std::sscanf(header.c_str(),
+                    "%15s %u %lu %lu %u %u",
+                    operation_name,
+                    &background,
+                    &bandwidth_limit,
+                    &cpu_share,
+                    &sync,
+                    &continue_on_error) != 6)
+    {
+        return false;
+    }
+
+    if (std::strcmp(operation_name, "encrypt") == 0)
+    {
+        operation = BatchOperation::Encrypt;
+    }
+    else if (std::strcmp(operation_name, "decrypt") == 0)
+    {
+        operation = BatchOperation::Decrypt;
+    }
+    else if (std::strcmp(operation_name, "verify") == 0)
+    {
+        operation = BatchOperation::Verify;
+    }
+    else
+    {
+        return false;
+    }
+
+    options.background = (background != 0);
+    options.bandwidth_limit = static_cast<std::uint32_t>(bandwidth_limit);
+    options.cpu_share = static_cast<std::uint32_t>(cpu_share);
+    options.sync = (sync != 0);
+    options.continue_on_error = (continue_on_error != 0);
+
+    // Each remaining line names a file
+    for (std::size_t start = line_end + 1; start < request.size();)
+    {
+        line_end = request.find('\n', start);
+        if (line_end == std::string::npos) return false;
+
+        std::wstring filename =
+            ConvertToUTF16(request.substr(start, line_end - start));
+        if (filename.empty()) return false;
+
+        file_list.push_back(std::move(filename));
+
+        start = line_end + 1;
+    }
+
+    return !file_list.empty();
+}
+
+/*
+ *  TransferPipe()
+ *
+ *  Description:
+ *      Read or write the given number of octets on an overlapped pipe
+ *      handle, waiting no longer than Pipe_Timeout.
+ *
+ *  Parameters:
+ *      pipe [in]
+ *          The pipe handle.
+ *
+ *      write [in]
+ *          True to write the data, false to read it.
+ *
+ *      data [in/out]
+ *          The data to write or the buffer into which data is read.
+ *
+ *      length [in]
+ *          The number of octets to transfer.
+ *
+ *  Returns:
+ *      True if all octets were transferred, false if not.
+ *
+ *  Comments:
+ *      This prevents a client that stops sending or reading from holding
+ *      a host thread indefinitely, and likewise prevents an unresponsive
+ *      host from holding the client (e.g., Explorer) indefinitely.
+ */
+bool TransferPipe(HANDLE pipe, bool write, char *data, DWORD length)
+{
+    OVERLAPPED overlapped{};
+    bool result = true;
+
+    overlapped.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (overlapped.hEvent == NULL) return false;
+
+    while (result && (length > 0))
+    {
+        DWORD transferred{};
+
+        ::ResetEvent(overlapped.hEvent);
+
+        BOOL started = write ? ::WriteFile(pipe,
+                                           data,
+                                           length,
+                                           nullptr,
+                                           &overlapped) :
+                               ::ReadFile(pipe,
+                                          data,
+                                          length,
+                                          nullptr,
+                                          &overlapped);
+        if (!started && (::GetLastError() != ERROR_IO_PENDING))
+        {
+            result = false;
+            break;
+        }
+
+        if (::WaitForSingleObject(overlapped.hEvent, Pipe_Timeout) !=
+            WAIT_OBJECT_0)
+        {
+            ::CancelIo(pipe);
+            result = false;
+        }
+
+        // Wait for the (possibly cancelled) operation to complete
+        if (!::GetOverlappedResult(pipe, &overlapped, &transferred, TRUE) ||
+            (transferred == 0))
+        {
+            result = false;
+        }
+
+        data += transferred;
+        length -= transferred;
+    }
+
+    ::CloseHandle(overlapped.hEvent);
+
+    return result;
+}
+
+/*
+ *  SendRequest()
+ *
+ *  Description:
+ *      Send a request to the batch host and wait for its reply.
+ *
+ *  Parameters:
+ *      pipe [in]
+ *          The pipe connected to the batch host.
+ *
+ *      request [in]
+ *          The request text.
+ *
+ *  Returns:
+ *      True if the host accepted the request, false if not.
+ *
+ *  Comments:
+ *      The host is allowed to take the foreground so that the password
+ *      dialog is not hidden behind the window from which the request came.
+ *      The caller must first verify that the host runs as the same user.
+ *      The pipe must be opened for overlapped I/O, as each transfer is
+ *      limited to Pipe_Timeout.
+ */
+bool SendRequest(HANDLE pipe, std::string request)
+{
+    DWORD length = static_cast<DWORD>(request.size());
+    ULONG host_process_id{};
+    char reply{};
+
+    if (::GetNamedPipeServerProcessId(pipe, &host_process_id))
+    {
+        ::AllowSetForegroundWindow(host_process_id);
+    }
+
+    if (!TransferPipe(pipe, true, reinterpret_cast<char *>(&length),
+                      sizeof(length)) ||
+        !TransferPipe(pipe, true, request.data(), length) ||
+        !TransferPipe(pipe, false, &reply, 1))
+    {
+        return false;
+    }
+
+    return reply == 1;
+}
+
+/*
+ *  StartBatchHost()
+ *
+ *  Description:
+ *      Start the batch host, which is aescrypt32.exe residing in the same
+ *      directory as this library.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the process was started, false if not.
+ *
+ *  Comments:
+ *      If another caller starts a host at the same time, only one of them
+ *      is able to create the pipe and the other exits.
+ */
+bool StartBatchHost()
+{
+    HMODULE module{};
+    std::wstring path(MAX_PATH, L'\0');
+    STARTUPINFO startup_info{};
+    PROCESS_INFORMATION process_info{};
+
+    if (!::GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                                 GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                             reinterpret_cast<LPCWSTR>(&StartBatchHost),
+                             &module))
+    {
+        return false;
+    }
+
+    // Get the path of this library, growing the buffer as needed
+    while (true)
+    {
+        DWORD length = ::GetModuleFileName(module,
+                                           path.data(),
+                                           static_cast<DWORD>(path.size()));
+        if (length == 0) return false;
+        if (length < path.size())
+        {
+            path.resize(length);
+            break;
+        }
+        path.resize(path.size() * 2);
+    }
+
+    // Replace the library name with the name of the executable
+    std::size_t separator = path.find_last_of(L"\\/");
+    if (separator == std::wstring::npos) return false;
+    path.resize(separator + 1);
+    path += Host_Executable;
+
+    std::wstring command_line = L"\"" + path + L"\" /host";
+
+    startup_info.cb = sizeof(startup_info);
+
+    if (!::CreateProcess(path.c_str(),
+                         command_line.data(),
+                         nullptr,
+                         nullptr,
+                         FALSE,
+                         0,
+                         nullptr,
+                         nullptr,
+                         &startup_info,
+                         &process_info))
+    {
+        return false;
+    }
+
+    ::CloseHandle(process_info.hThread);
+    ::CloseHandle(process_info.hProcess);
+
+    return true;
+}
+
+/*
+ *  CreateHostPipe()
+ *
+ *  Description:
+ *      Create an instance of the pipe on which the batch host accepts
+ *      requests.
+ *
+ *  Parameters:
+ *      pipe_name [in]
+ *          The name of the pipe.
+ *
+ *      first_instance [in]
+ *          True if this is the first instance created by this host, which
+ *          fails if another host already owns the pipe.
+ *
+ *  Returns:
+ *      The pipe handle or INVALID_HANDLE_VALUE on error.
+ *
+ *  Comments:
+ *      The pipe is given a protected DACL granting access only to the user
+ *      running the host, so requests cannot be sent by other users.
+ */
+HANDLE CreateHostPipe(const std::wstring &pipe_name, bool first_instance)
+{
+    PSECURITY_DESCRIPTOR security_descriptor{};
+    SECURITY_ATTRIBUTES security_attributes{};
+
+    std::wstring sid_string = GetUserSidString();
+    if (sid_string.empty()) return INVALID_HANDLE_VALUE;
+
+    std::wstring sddl = L"D:P(A;;GA;;;" + sid_string + L")";
+    if (!::ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            sddl.c_str(),
+            SDDL_REVISION_1,
+            &security_descriptor,
+            nullptr))
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    security_attributes.nLength = sizeof(security_attributes);
+    security_attributes.lpSecurityDescriptor = security_descriptor;
+    security_attributes.bInheritHandle = FALSE;
+
+    HANDLE pipe = ::CreateNamedPipe(
+        pipe_name.c_str(),
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED |
+            (first_instance ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+            PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES,
+        4096,
+        4096,
+        0,
+        &security_attributes);
+
+    // Preserve the error from creating the pipe
+    DWORD error = ::GetLastError();
+    ::LocalFree(security_descriptor);
+    ::SetLastError(error);
+
+    return pipe;
+}
+
+/*
+ *  ServeClient()
+ *
+ *  Description:
+ *      Receive a request from a connected client and process it.  This runs
+ *      on a thread of its own for each client.
+ *
+ *  Parameters:
+ *      pipe [in]
+ *          The pipe connected to the client, which is closed by this
+ *          function.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The client is released as soon as the request is accepted, so it
+ *      does not wait while the password is entered or files are processed.
+ */
+void ServeClient(HANDLE pipe)
+{
+    DWORD length{};
+    std::string request;
+    FileList file_list;
+    BatchOperation operation{};
+    BatchOptions options{};
+    char reply = 0;
+
+    bool accepted =
+        TransferPipe(pipe, false, reinterpret_cast<char *>(&length),
+                     sizeof(length)) &&
+        (length > 0) && (length <= Max_Request_Size);
+
+    if (accepted)
+    {
+        try
+        {
+            request.resize(length);
+            accepted = TransferPipe(pipe, false, request.data(), length) &&
+                       ParseRequest(request, file_list, operation, options);
+        }
+        catch (...)
+        {
+            accepted = false;
+        }
+    }
+
+    // Reply and wait for the client to read the reply before disconnecting
+    if (accepted) reply = 1;
+    if (TransferPipe(pipe, true, &reply, 1)) ::FlushFileBuffers(pipe);
+    ::DisconnectNamedPipe(pipe);
+    ::CloseHandle(pipe);
+
+    if (accepted)
+    {
+        HANDLE job =
+            Worker_Threads.ProcessFilesAsync(file_list, operation, options);
+
+        if (job != NULL)
+        {
+            ::WaitForSingleObject(job, INFINITE);
+            ::CloseHandle(job);
+        }
+    }
+
+    Host_Requests--;
+}
+
+} // namespace
+
+/*
+ *  UseBatchHost()
+ *
+ *  Description:
+ *      Indicates whether requests should be handed to the batch host rather
+ *      than being processed by the calling process.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the BatchHost setting is enabled and this process is not
+ *      itself the batch host.
+ *
+ *  Comments:
+ *      None.
+ */
+bool UseBatchHost()
+{
+    return !Host_Process && LoadSettings().batch_host;
+}
+
+/*
+ *  SubmitToBatchHost()
+ *
+ *  Description:
+ *      Hand a request to the batch host for the current logon session,
+ *      starting the host if it is not running.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to process.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      options [in]
+ *          Options that override the settings for this request.
+ *
+ *  Returns:
+ *      True if the host accepted the request, false if the host could not
+ *      be reached (in which case the caller should process the request).
+ *
+ *  Comments:
+ *      This may wait for some seconds while the host starts, so it should
+ *      not be called on a thread servicing a user interface.
+ */
+bool SubmitToBatchHost(const FileList &file_list,
+                       BatchOperation operation,
+                       const BatchOptions &options)
+{
+    std::string request;
+    bool host_started = false;
+
+    try
+    {
+        request = FormatRequest(file_list, operation, options);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    if (request.empty() || (request.size() > Max_Request_Size)) return false;
+
+    std::wstring pipe_name = GetPipeName();
+    if (pipe_name.empty()) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + Batch_Host_Start_Time;
+
+    while (true)
+    {
+        HANDLE pipe = ::CreateFile(pipe_name.c_str(),
+                                   GENERIC_READ | GENERIC_WRITE,
+                                   0,
+                                   nullptr,
+                                   OPEN_EXISTING,
+                                   FILE_FLAG_OVERLAPPED |
+                                       SECURITY_SQOS_PRESENT |
+                                       SECURITY_IDENTIFICATION,
+                                   nullptr);
+        if (pipe != INVALID_HANDLE_VALUE)
+        {
+            // Send nothing to a pipe served by another user's process,
+            // which cannot then be the host for this user
+            if (!IsHostSameUser(pipe))
+            {
+                ::CloseHandle(pipe);
+                return false;
+            }
+
+            bool accepted = SendRequest(pipe, request);
+            ::CloseHandle(pipe);
+
+            // A host that is exiting may not accept the request, so try
+            // again until the deadline
+            if (accepted) return true;
+        }
+        else
+        {
+            DWORD error = ::GetLastError();
+
+            // The pipe may belong to a host run by another user
+            if (error == ERROR_ACCESS_DENIED) return false;
+
+            if (error == ERROR_PIPE_BUSY)
+            {
+                ::WaitNamedPipe(pipe_name.c_str(), Idle_Check_Interval);
+            }
+            else if (!host_started)
+            {
+                if (!StartBatchHost()) return false;
+                host_started = true;
+            }
+        }
+
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+/*
+ *  RunBatchHost()
+ *
+ *  Description:
+ *      Serve requests as the batch host for the current logon session until
+ *      no requests have been in progress for Batch_Host_Idle_Time.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS once the host has been idle, ERROR_ALREADY_EXISTS if
+ *      another host is running, or an error code if the pipe could not be
+ *      created.
+ *
+ *  Comments:
+ *      A pipe instance is always available while the host runs, as the next
+ *      instance is created before a connected instance is handed to the
+ *      thread serving the client.
+ */
+DWORD RunBatchHost()
+{
+    std::wstring pipe_name = GetPipeName();
+    OVERLAPPED overlapped{};
+    DWORD result = ERROR_SUCCESS;
+
+    Host_Process = true;
+
+    if (pipe_name.empty()) return ERROR_INVALID_SID;
+
+    HANDLE pipe = CreateHostPipe(pipe_name, true);
+    if (pipe == INVALID_HANDLE_VALUE)
+    {
+        result = ::GetLastError();
+        return (result == ERROR_ACCESS_DENIED) ? ERROR_ALREADY_EXISTS : result;
+    }
+
+    overlapped.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (overlapped.hEvent == NULL)
+    {
+        result = ::GetLastError();
+        ::CloseHandle(pipe);
+        return result;
+    }
+
+    auto idle_since = std::chrono::steady_clock::now();
+
+    while (pipe != INVALID_HANDLE_VALUE)
+    {
+        bool connected = false;
+
+        ::ResetEvent(overlapped.hEvent);
+
+        if (::ConnectNamedPipe(pipe, &overlapped))
+        {
+            connected = true;
+        }
+        else if (::GetLastError() == ERROR_PIPE_CONNECTED)
+        {
+            connected = true;
+        }
+        else if (::GetLastError() == ERROR_IO_PENDING)
+        {
+            // Wait for a client, checking periodically whether idle
+            while (::WaitForSingleObject(overlapped.hEvent,
+                                         Idle_Check_Interval) == WAIT_TIMEOUT)
+            {
+                auto now = std::chrono::steady_clock::now();
+
+                if ((Host_Requests > 0) || Worker_Threads.IsBusy())
+                {
+                    idle_since = now;
+                }
+                else if (now - idle_since >= Batch_Host_Idle_Time)
+                {
+                    ::CancelIo(pipe);
+                    break;
+                }
+            }
+
+            DWORD transferred{};
+            connected = ::GetOverlappedResult(pipe,
+                                              &overlapped,
+                                              &transferred,
+                                              TRUE) != FALSE;
+            if (!connected && (::GetLastError() == ERROR_OPERATION_ABORTED))
+            {
+                // The host has been idle long enough to exit
+                ::CloseHandle(pipe);
+                pipe = INVALID_HANDLE_VALUE;
+                break;
+            }
+        }
+
+        if (!connected)
+        {
+            ::DisconnectNamedPipe(pipe);
+            continue;
+        }
+
+        // Create the instance for the next client before serving this one
+        HANDLE client_pipe = pipe;
+        pipe = CreateHostPipe(pipe_name, false);
+        if (pipe == INVALID_HANDLE_VALUE) result = ::GetLastError();
+
+        Host_Requests++;
+        idle_since = std::chrono::steady_clock::now();
+
+        try
+        {
+            std::thread(
+                [client_pipe]()
+                {
+                    ServeClient(client_pipe);
+                }).detach();
+        }
+        catch (...)
+        {
+            ::DisconnectNamedPipe(client_pipe);
+            ::CloseHandle(client_pipe);
+            Host_Requests--;
+        }
+    }
+
+    ::CloseHandle(overlapped.hEvent);
+
+    // Wait for any requests still being served
+    while ((Host_Requests > 0) || Worker_Threads.IsBusy())
+    {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(Idle_Check_Interval));
+    }
+
+    return result;
+}
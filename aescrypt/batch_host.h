@@ -0,0 +1,50 @@
+/*
+ *  batch_host.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the functions used to hand requests to the batch
+ *      host, a long-lived aescrypt32.exe process ("aescrypt32 /host") that
+ *      processes the files selected in every Explorer window and given to
+ *      aescrypt32.exe.  A single host in each logon session means one set of
+ *      worker threads and one buffer pool serve all requests, so the
+ *      concurrency limits apply across requests and large batches do not
+ *      grow the working set of Explorer.
+ *
+ *      Requests are sent over a named pipe for the user and logon session,
+ *      which only that user may open, and are sent only once the process
+ *      serving the pipe is verified to run as the same user.
+ *      The host is started when the first request is sent and exits once
+ *      it has been idle for Batch_Host_Idle_Time.  Callers fall back to
+ *      processing the request themselves if the host cannot be reached.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <chrono>
+#include "file_list.h"
+#include "batch_summary.h"
+
+// Time the batch host remains running once no requests are in progress
+constexpr std::chrono::minutes Batch_Host_Idle_Time(5);
+
+// Indicates whether requests should be handed to the batch host
+bool UseBatchHost();
+
+// Hand the request to the batch host, starting the host if necessary
+bool SubmitToBatchHost(const FileList &file_list,
+                       BatchOperation operation,
+                       const BatchOptions &options);
+
+// Serve requests as the batch host until idle
+DWORD RunBatchHost();
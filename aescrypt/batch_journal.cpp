@@ -0,0 +1,543 @@
+/*
+ *  batch_journal.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the BatchJournal class.  Each line of a journal
+ *      is a single entry, encoded as UTF-8, having these fields separated
+ *      by tab characters (which cannot appear in a path):
+ *
+ *          state  size  last_write_time  input_path  output_path
+ *
+ *      The state is "S" once the output file has been created and "C" once
+ *      it is complete.  Later entries for an input file replace earlier
+ *      ones, and an incomplete final line (e.g., due to a crash while it
+ *      was being written) is ignored.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <shlobj.h>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include "batch_journal.h"
+#include "text_convert.h"
+
+namespace
+{
+
+// Time after which an abandoned journal is removed
+constexpr std::chrono::hours Journal_Lifetime(24 * 30);
+
+// Extension used for journal files
+constexpr wchar_t Journal_Extension[] = L".journal";
+
+/*
+ *  JournalDirectory()
+ *
+ *  Description:
+ *      Return the directory holding the journals, creating it if necessary.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The path of the directory, or an empty string if it is unavailable.
+ *
+ *  Comments:
+ *      The directory is within the user's local (i.e., non-roaming)
+ *      application data folder, as journals refer to local paths.
+ */
+std::wstring JournalDirectory()
+{
+    PWSTR local_app_data{};
+    std::wstring directory;
+
+    if (SUCCEEDED(::SHGetKnownFolderPath(FOLDERID_LocalAppData,
+                                         KF_FLAG_CREATE,
+                                         nullptr,
+                                         &local_app_data)))
+    {
+        directory =
+            std::wstring(local_app_data) + L"\\Terrapane\\AES Crypt\\Journals";
+    }
+    ::CoTaskMemFree(local_app_data);
+
+    if (directory.empty()) return {};
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(directory), ec);
+    if (ec) return {};
+
+    return directory;
+}
+
+/*
+ *  JournalName()
+ *
+ *  Description:
+ *      Produce the name of the journal for the given selection.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The files and directories selected for processing.
+ *
+ *      encrypt [in]
+ *          True if encrypting, false if decrypting.
+ *
+ *  Returns:
+ *      The journal filename.
+ *
+ *  Comments:
+ *      The name is a 64-bit FNV-1a hash over the operation and the sorted
+ *      list of names, so selecting the same items in any order refers to
+ *      the same journal.
+ */
+std::wstring JournalName(const FileList &file_list, bool encrypt)
+{
+    std::vector<std::wstring> names(file_list.begin(), file_list.end());
+    std::uint64_t hash = 0xcbf29ce484222325;
+
+    std::sort(names.begin(), names.end());
+
+    auto add = [&hash](wchar_t value)
+    {
+        hash ^= static_cast<std::uint64_t>(value);
+        hash *= 0x00000100000001b3;
+    };
+
+    add(encrypt ? L'E' : L'D');
+    for (const auto &name : names)
+    {
+        for (wchar_t c : name) add(c);
+        add(L'\0');
+    }
+
+    wchar_t buffer[17];
+    std::swprintf(buffer,
+                  sizeof(buffer) / sizeof(wchar_t),
+                  L"%016llx",
+                  static_cast<unsigned long long>(hash));
+
+    return std::wstring(buffer) + Journal_Extension;
+}
+
+/*
+ *  RemoveExpiredJournals()
+ *
+ *  Description:
+ *      Remove journals that have not been used within the journal lifetime.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory holding the journals.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A journal remains if a batch is never run again to completion, so
+ *      this keeps such journals from accumulating.
+ */
+void RemoveExpiredJournals(const std::wstring &directory)
+{
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory, ec))
+    {
+        if (entry.path().extension() != Journal_Extension) continue;
+
+        auto last_write_time = entry.last_write_time(ec);
+        if (ec) continue;
+
+        if ((now - last_write_time) > Journal_Lifetime)
+        {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+} // namespace
+
+/*
+ *  BatchJournal::BatchJournal()
+ *
+ *  Description:
+ *      Constructor for the BatchJournal object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The journal does nothing until it is opened.
+ */
+BatchJournal::BatchJournal() :
+    journal_handle{INVALID_HANDLE_VALUE}
+{
+}
+
+/*
+ *  BatchJournal::~BatchJournal()
+ *
+ *  Description:
+ *      Destructor for the BatchJournal object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The journal is retained unless the batch was reported complete.
+ */
+BatchJournal::~BatchJournal()
+{
+    Close(false);
+}
+
+/*
+ *  BatchJournal::Open()
+ *
+ *  Description:
+ *      Open the journal for the given selection, loading the entries written
+ *      by any previous run of the same batch and removing the partial output
+ *      of files that previous run did not complete.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The files and directories selected for processing.
+ *
+ *      encrypt [in]
+ *          True if encrypting, false if decrypting.
+ *
+ *  Returns:
+ *      True if the journal was opened, false if not.
+ *
+ *  Comments:
+ *      The journal is an aid to the user, so a failure to open it is not an
+ *      error; the batch is simply processed without one.  The journal is not
+ *      shared for writing, so if the same selection is being processed by
+ *      another request, only the first has a journal.
+ */
+bool BatchJournal::Open(const FileList &file_list, bool encrypt)
+{
+    std::wstring directory = JournalDirectory();
+    if (directory.empty()) return false;
+
+    RemoveExpiredJournals(directory);
+
+    journal_path = directory + L"\\" + JournalName(file_list, encrypt);
+
+    journal_handle = ::CreateFile(journal_path.c_str(),
+                                  GENERIC_READ | FILE_APPEND_DATA,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL,
+                                  nullptr);
+    if (journal_handle == INVALID_HANDLE_VALUE) return false;
+
+    LoadEntries();
+    RemovePartialOutput();
+
+    return true;
+}
+
+/*
+ *  BatchJournal::IsCompleted()
+ *
+ *  Description:
+ *      Determine whether a previous run of the batch completed the file.
+ *
+ *  Parameters:
+ *      batch_file [in]
+ *          The file to be processed.
+ *
+ *      out_file [in]
+ *          The output file it would be processed into.
+ *
+ *  Returns:
+ *      True if the previous run completed the file, the input file has the
+ *      same size and last write time, and the output still exists.
+ *
+ *  Comments:
+ *      The entries are not modified once the journal is opened, so this may
+ *      be called from any thread without locking.
+ */
+bool BatchJournal::IsCompleted(const BatchFile &batch_file,
+                               const std::wstring &out_file) const
+{
+    auto it = entries.find(batch_file.filename);
+    if (it == entries.end()) return false;
+
+    const Entry &entry = it->second;
+
+    return entry.completed &&
+           (entry.file_size == batch_file.file_size) &&
+           (entry.last_write_time == batch_file.last_write_time) &&
+           (entry.out_file == out_file) &&
+           (::GetFileAttributesW(out_file.c_str()) != INVALID_FILE_ATTRIBUTES);
+}
+
+/*
+ *  BatchJournal::Started()
+ *
+ *  Description:
+ *      Record that the output file for the given input was created.
+ *
+ *  Parameters:
+ *      batch_file [in]
+ *          The file being processed.
+ *
+ *      out_file [in]
+ *          The output file that was created.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This must only be called once the output file has been created by
+ *      this batch, as the output named by an entry that is not completed is
+ *      removed when the batch is resumed.
+ */
+void BatchJournal::Started(const BatchFile &batch_file,
+                           const std::wstring &out_file)
+{
+    Append('S', batch_file, out_file);
+}
+
+/*
+ *  BatchJournal::Completed()
+ *
+ *  Description:
+ *      Record that the output file for the given input is complete.
+ *
+ *  Parameters:
+ *      batch_file [in]
+ *          The file that was processed.
+ *
+ *      out_file [in]
+ *          The output file that was written and closed.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void BatchJournal::Completed(const BatchFile &batch_file,
+                             const std::wstring &out_file)
+{
+    Append('C', batch_file, out_file);
+}
+
+/*
+ *  BatchJournal::Close()
+ *
+ *  Description:
+ *      Close the journal.
+ *
+ *  Parameters:
+ *      batch_complete [in]
+ *          True if every file in the batch was processed successfully, in
+ *          which case the journal is no longer needed and is deleted.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void BatchJournal::Close(bool batch_complete)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (journal_handle == INVALID_HANDLE_VALUE) return;
+
+    ::CloseHandle(journal_handle);
+    journal_handle = INVALID_HANDLE_VALUE;
+
+    if (batch_complete) ::DeleteFile(journal_path.c_str());
+}
+
+/*
+ *  BatchJournal::LoadEntries()
+ *
+ *  Description:
+ *      Read the entries written by a previous run of the batch.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Lines that cannot be parsed are ignored.
+ */
+void BatchJournal::LoadEntries()
+{
+    LARGE_INTEGER file_size{};
+    std::string contents;
+    DWORD octets_read{};
+
+    if (!::GetFileSizeEx(journal_handle, &file_size) ||
+        (file_size.QuadPart == 0) || (file_size.QuadPart > 0xffffffff))
+    {
+        return;
+    }
+
+    contents.resize(static_cast<std::size_t>(file_size.QuadPart));
+    if (!::ReadFile(journal_handle,
+                    contents.data(),
+                    static_cast<DWORD>(contents.size()),
+                    &octets_read,
+                    nullptr))
+    {
+        return;
+    }
+    contents.resize(octets_read);
+
+    // Only complete lines are considered
+    std::size_t line_start = 0;
+    std::size_t line_end;
+    while ((line_end = contents.find('\n', line_start)) != std::string::npos)
+    {
+        std::string line = contents.substr(line_start, line_end - line_start);
+        std::vector<std::string> fields;
+        std::size_t field_start = 0;
+        std::size_t field_end;
+
+        line_start = line_end + 1;
+
+        while ((field_end = line.find('\t', field_start)) != std::string::npos)
+        {
+            fields.push_back(line.substr(field_start, field_end - field_start));
+            field_start = field_end + 1;
+        }
+        fields.push_back(line.substr(field_start));
+
+        if ((fields.size() != 5) || (fields[0].size() != 1) ||
+            ((fields[0][0] != 'S') && (fields[0][0] != 'C')))
+        {
+            continue;
+        }
+
+        std::wstring in_file = ConvertToUTF16(fields[3]);
+        std::wstring out_file = ConvertToUTF16(fields[4]);
+        if (in_file.empty() || out_file.empty()) continue;
+
+        entries[in_file] = {
+            std::strtoull(fields[1].c_str(), nullptr, 10),
+            std::strtoull(fields[2].c_str(), nullptr, 10),
+            out_file,
+            fields[0][0] == 'C'};
+    }
+}
+
+/*
+ *  BatchJournal::RemovePartialOutput()
+ *
+ *  Description:
+ *      Remove the output files created by a previous run of the batch that
+ *      were not completed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Normally, a file that fails is removed as the batch stops, so this
+ *      only finds files left when processing was cut short (e.g., the
+ *      session ended or the process was terminated).  Only regular files
+ *      are removed.
+ */
+void BatchJournal::RemovePartialOutput() const
+{
+    for (const auto &[in_file, entry] : entries)
+    {
+        if (entry.completed) continue;
+
+        DWORD attributes = ::GetFileAttributesW(entry.out_file.c_str());
+        if ((attributes == INVALID_FILE_ATTRIBUTES) ||
+            (attributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            continue;
+        }
+
+        ::DeleteFile(entry.out_file.c_str());
+    }
+}
+
+/*
+ *  BatchJournal::Append()
+ *
+ *  Description:
+ *      Append an entry to the journal.
+ *
+ *  Parameters:
+ *      state [in]
+ *          The state of the file ('S' or 'C').
+ *
+ *      batch_file [in]
+ *          The input file.
+ *
+ *      out_file [in]
+ *          The output file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Each entry is written with a single call, so entries written by
+ *      different threads are not interleaved.  The journal is not flushed
+ *      to disk, as the system writes cached data even if the process is
+ *      terminated.  If writing fails, the journal is closed and the batch
+ *      proceeds without it.
+ */
+void BatchJournal::Append(char state,
+                          const BatchFile &batch_file,
+                          const std::wstring &out_file)
+{
+    std::string line = std::string(1, state) + "\t" +
+                       std::to_string(batch_file.file_size) + "\t" +
+                       std::to_string(batch_file.last_write_time) + "\t" +
+                       ConvertToUTF8(batch_file.filename) + "\t" +
+                       ConvertToUTF8(out_file) + "\n";
+    DWORD octets_written{};
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (journal_handle == INVALID_HANDLE_VALUE) return;
+
+    if (!::WriteFile(journal_handle,
+                     line.data(),
+                     static_cast<DWORD>(line.size()),
+                     &octets_written,
+                     nullptr) ||
+        (octets_written != line.size()))
+    {
+        ::CloseHandle(journal_handle);
+        journal_handle = INVALID_HANDLE_VALUE;
+    }
+}
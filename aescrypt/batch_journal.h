@@ -0,0 +1,91 @@
+/*
+ *  batch_journal.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the BatchJournal class, which records the progress
+ *      of a batch so that a batch that was cancelled, failed, or was cut
+ *      short by the session ending may be resumed by processing the same
+ *      selection again.  The journal records each file as its output is
+ *      created and again once the output is complete, giving the input
+ *      file's path, size, and last write time along with the output path.
+ *      When the batch is run again, completed files whose input is unchanged
+ *      and whose output still exists are skipped, and the partial output of
+ *      any file that was being processed is removed so the file can be
+ *      processed again.  The journal is kept in the user's local application
+ *      data folder, named after the operation and the filenames selected,
+ *      and is deleted once the batch completes successfully.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include "file_list.h"
+
+// Type used to hold a file to be processed as part of a batch
+struct BatchFile
+{
+    std::wstring filename;
+    std::uint64_t file_size;
+    std::uint64_t last_write_time;
+};
+
+// Class that records the files completed by a batch
+class BatchJournal
+{
+    public:
+        BatchJournal();
+        ~BatchJournal();
+
+        // Open the journal for the given selection, loading any entries
+        // recorded by a previous run of the same batch
+        bool Open(const FileList &file_list, bool encrypt);
+
+        // Indicates whether a previous run completed this file
+        bool IsCompleted(const BatchFile &batch_file,
+                         const std::wstring &out_file) const;
+
+        // Record that the output file for this input was created
+        void Started(const BatchFile &batch_file, const std::wstring &out_file);
+
+        // Record that the output file for this input is complete
+        void Completed(const BatchFile &batch_file,
+                       const std::wstring &out_file);
+
+        // Close the journal, deleting it if the batch is complete
+        void Close(bool batch_complete);
+
+    protected:
+        struct Entry
+        {
+            std::uint64_t file_size;
+            std::uint64_t last_write_time;
+            std::wstring out_file;
+            bool completed;
+        };
+
+        void LoadEntries();
+        void RemovePartialOutput() const;
+        void Append(char state,
+                    const BatchFile &batch_file,
+                    const std::wstring &out_file);
+
+        std::mutex mutex;
+        std::wstring journal_path;
+        HANDLE journal_handle;
+        std::unordered_map<std::wstring, Entry> entries;
+};
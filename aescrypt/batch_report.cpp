@@ -0,0 +1,617 @@
+/*
+ *  batch_report.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the BatchReport class.  A JSON report is a
+ *      single object giving the software version, operation, start time,
+ *      and settings, a "files" array having one object per file, and a
+ *      "totals" object written once the batch completes.  A CSV report has
+ *      a header row followed by one "file" row per file and a final "batch"
+ *      row giving the totals, with columns that do not apply left empty.
+ *      Both are encoded as UTF-8 with CRLF line endings.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <shlobj.h>
+#include <filesystem>
+#include <atomic>
+#include <cstdio>
+#include "batch_report.h"
+#include "text_convert.h"
+#include "version.h"
+
+namespace
+{
+
+// Time after which a report is removed
+constexpr std::chrono::hours Report_Lifetime(24 * 30);
+
+// Columns of a CSV report
+constexpr char CSV_Header[] =
+    "record,file,octets_in,octets_out,kdf_us,wait_us,stream_us,close_us,"
+    "elapsed_ms,mbps,read_buffer_size,read_queue_depth,write_buffer_size,"
+    "write_queue_depth,threads,result,error_code\r\n";
+
+/*
+ *  QuoteCSV()
+ *
+ *  Description:
+ *      Quote the UTF-8 string so that it may be placed in a CSV field.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The text to quote.
+ *
+ *  Returns:
+ *      The quoted text.
+ *
+ *  Comments:
+ *      Every string is quoted, as paths commonly contain commas.
+ */
+std::string QuoteCSV(const std::string &text)
+{
+    std::string quoted_text = "\"";
+
+    for (char c : text)
+    {
+        if (c == '"') quoted_text += '"';
+        quoted_text += c;
+    }
+
+    return quoted_text + "\"";
+}
+
+/*
+ *  FormatRate()
+ *
+ *  Description:
+ *      Format the rate at which data was processed in MB/s.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets processed.
+ *
+ *      microseconds [in]
+ *          The time taken to process them.
+ *
+ *  Returns:
+ *      The rate with one decimal place, or "0.0" if no time was measured.
+ *
+ *  Comments:
+ *      As a megabyte is a million octets, the rate in MB/s is the number of
+ *      octets per microsecond.
+ */
+std::string FormatRate(std::uint64_t octets, std::uint64_t microseconds)
+{
+    char rate[32];
+
+    std::snprintf(rate,
+                  sizeof(rate),
+                  "%.1f",
+                  (microseconds > 0) ?
+                      static_cast<double>(octets) /
+                          static_cast<double>(microseconds) :
+                      0.0);
+
+    return rate;
+}
+
+/*
+ *  OperationName()
+ *
+ *  Description:
+ *      Return the name used for the operation in a report.
+ *
+ *  Parameters:
+ *      operation [in]
+ *          The operation performed.
+ *
+ *  Returns:
+ *      The name of the operation.
+ *
+ *  Comments:
+ *      None.
+ */
+const char *OperationName(BatchOperation operation)
+{
+    switch (operation)
+    {
+        case BatchOperation::Encrypt:
+            return "encrypt";
+
+        case BatchOperation::Verify:
+            return "verify";
+
+        default:
+            return "decrypt";
+    }
+}
+
+/*
+ *  ReportDirectory()
+ *
+ *  Description:
+ *      Return the directory holding the reports, creating it if necessary.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The path of the directory, or an empty string if it is unavailable.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring ReportDirectory()
+{
+    PWSTR local_app_data{};
+    std::wstring directory;
+
+    if (SUCCEEDED(::SHGetKnownFolderPath(FOLDERID_LocalAppData,
+                                         KF_FLAG_CREATE,
+                                         nullptr,
+                                         &local_app_data)))
+    {
+        directory =
+            std::wstring(local_app_data) + L"\\Terrapane\\AES Crypt\\Reports";
+    }
+    ::CoTaskMemFree(local_app_data);
+
+    if (directory.empty()) return {};
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(directory), ec);
+    if (ec) return {};
+
+    return directory;
+}
+
+/*
+ *  RemoveExpiredReports()
+ *
+ *  Description:
+ *      Remove reports that were written more than the report lifetime ago.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory holding the reports.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void RemoveExpiredReports(const std::wstring &directory)
+{
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory, ec))
+    {
+        auto extension = entry.path().extension();
+        if ((extension != L".json") && (extension != L".csv")) continue;
+
+        auto last_write_time = entry.last_write_time(ec);
+        if (ec) continue;
+
+        if ((now - last_write_time) > Report_Lifetime)
+        {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+} // namespace
+
+/*
+ *  ReportFormatFromSetting()
+ *
+ *  Description:
+ *      Return the report format selected by the BatchReport setting.
+ *
+ *  Parameters:
+ *      setting [in]
+ *          The value of the setting: 1 for JSON or 2 for CSV.
+ *
+ *  Returns:
+ *      The report format, which is None for any other value.
+ *
+ *  Comments:
+ *      None.
+ */
+ReportFormat ReportFormatFromSetting(unsigned setting)
+{
+    switch (setting)
+    {
+        case 1:
+            return ReportFormat::JSON;
+
+        case 2:
+            return ReportFormat::CSV;
+
+        default:
+            return ReportFormat::None;
+    }
+}
+
+/*
+ *  BatchReport::BatchReport()
+ *
+ *  Description:
+ *      Constructor for the BatchReport object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Nothing is written until the report is opened.
+ */
+BatchReport::BatchReport() :
+    format{ReportFormat::None},
+    report_handle{INVALID_HANDLE_VALUE},
+    threads{},
+    files_written{},
+    octets_out{}
+{
+}
+
+/*
+ *  BatchReport::~BatchReport()
+ *
+ *  Description:
+ *      Destructor for the BatchReport object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A report that was not closed is left without its totals.
+ */
+BatchReport::~BatchReport()
+{
+    if (report_handle != INVALID_HANDLE_VALUE) ::CloseHandle(report_handle);
+}
+
+/*
+ *  BatchReport::Open()
+ *
+ *  Description:
+ *      Create the report for a batch, writing the information that applies
+ *      to the batch as a whole.
+ *
+ *  Parameters:
+ *      format [in]
+ *          The format of the report, or None if no report is wanted.
+ *
+ *      operation [in]
+ *          The operation the batch performs.
+ *
+ *      settings [in]
+ *          The settings that control batch processing.
+ *
+ *  Returns:
+ *      True if the report was created, false if not.
+ *
+ *  Comments:
+ *      The report is an aid to the operator, so a failure to create or
+ *      write it is not an error; the batch simply proceeds without one.
+ *      The name gives the time the batch started (UTC), the operation, and
+ *      the process, with a count distinguishing batches that start at once.
+ */
+bool BatchReport::Open(ReportFormat format,
+                       BatchOperation operation,
+                       const Settings &settings)
+{
+    static std::atomic<unsigned> report_count{0};
+    SYSTEMTIME system_time{};
+    wchar_t report_name[96];
+    char header[512];
+
+    if (format == ReportFormat::None) return false;
+
+    std::wstring directory = ReportDirectory();
+    if (directory.empty()) return false;
+
+    RemoveExpiredReports(directory);
+
+    ::GetSystemTime(&system_time);
+    std::swprintf(report_name,
+                  sizeof(report_name) / sizeof(wchar_t),
+                  L"%04u%02u%02u-%02u%02u%02u-%hs-%lu-%u%ls",
+                  static_cast<unsigned>(system_time.wYear),
+                  static_cast<unsigned>(system_time.wMonth),
+                  static_cast<unsigned>(system_time.wDay),
+                  static_cast<unsigned>(system_time.wHour),
+                  static_cast<unsigned>(system_time.wMinute),
+                  static_cast<unsigned>(system_time.wSecond),
+                  OperationName(operation),
+                  static_cast<unsigned long>(::GetCurrentProcessId()),
+                  ++report_count,
+                  (format == ReportFormat::JSON) ? L".json" : L".csv");
+
+    report_path = directory + L"\\" + report_name;
+    report_handle = ::CreateFile(report_path.c_str(),
+                                 GENERIC_WRITE,
+                                 FILE_SHARE_READ,
+                                 nullptr,
+                                 CREATE_NEW,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 nullptr);
+    if (report_handle == INVALID_HANDLE_VALUE) return false;
+
+    this->format = format;
+    start_time = std::chrono::steady_clock::now();
+    threads = settings.batch_threads + settings.kdf_prefetch;
+    files_written = 0;
+    octets_out = 0;
+
+    if (format == ReportFormat::CSV)
+    {
+        Write(CSV_Header);
+        return report_handle != INVALID_HANDLE_VALUE;
+    }
+
+    std::snprintf(header,
+                  sizeof(header),
+                  "{\"version\":\"%s\",\"operation\":\"%s\","
+                  "\"start_time\":\"%04u-%02u-%02uT%02u:%02u:%02uZ\","
+                  "\"batch_threads\":%llu,\"kdf_prefetch\":%llu,"
+                  "\"pool_threads\":%llu,\"io_buffer_size\":%llu,"
+                  "\"io_queue_depth\":%llu,\"unbuffered_io\":%s,"
+                  "\"compression\":%u,\r\n\"files\":[",
+                  EscapeJSON(Project_Name + " " + Project_Version).c_str(),
+                  OperationName(operation),
+                  static_cast<unsigned>(system_time.wYear),
+                  static_cast<unsigned>(system_time.wMonth),
+                  static_cast<unsigned>(system_time.wDay),
+                  static_cast<unsigned>(system_time.wHour),
+                  static_cast<unsigned>(system_time.wMinute),
+                  static_cast<unsigned>(system_time.wSecond),
+                  static_cast<unsigned long long>(settings.batch_threads),
+                  static_cast<unsigned long long>(settings.kdf_prefetch),
+                  static_cast<unsigned long long>(settings.pool_threads),
+                  static_cast<unsigned long long>(settings.io_buffer_size),
+                  static_cast<unsigned long long>(settings.io_queue_depth),
+                  settings.unbuffered_io ? "true" : "false",
+                  settings.compression);
+    Write(header);
+
+    return report_handle != INVALID_HANDLE_VALUE;
+}
+
+/*
+ *  BatchReport::AddFile()
+ *
+ *  Description:
+ *      Write the record for a file processed as part of the batch.
+ *
+ *  Parameters:
+ *      file_report [in]
+ *          The measurements of the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called by any thread processing the batch.
+ */
+void BatchReport::AddFile(const FileReport &file_report)
+{
+    char numbers[384];
+    std::string record;
+
+    if (!IsOpen()) return;
+
+    std::string filename = ConvertToUTF8(file_report.filename);
+    std::string rate = FormatRate(file_report.octets_in,
+                                  file_report.stream_time);
+
+    if (format == ReportFormat::CSV)
+    {
+        std::snprintf(numbers,
+                      sizeof(numbers),
+                      "%llu,%llu,%llu,%llu,%llu,%llu,,%s,%llu,%llu,%llu,%llu,,",
+                      static_cast<unsigned long long>(file_report.octets_in),
+                      static_cast<unsigned long long>(file_report.octets_out),
+                      static_cast<unsigned long long>(
+                          file_report.key_derivation_time),
+                      static_cast<unsigned long long>(file_report.wait_time),
+                      static_cast<unsigned long long>(file_report.stream_time),
+                      static_cast<unsigned long long>(file_report.close_time),
+                      rate.c_str(),
+                      static_cast<unsigned long long>(
+                          file_report.read_buffer_size),
+                      static_cast<unsigned long long>(
+                          file_report.read_queue_depth),
+                      static_cast<unsigned long long>(
+                          file_report.write_buffer_size),
+                      static_cast<unsigned long long>(
+                          file_report.write_queue_depth));
+        record = "file," + QuoteCSV(filename) + "," + numbers +
+                 QuoteCSV(file_report.result) + "," +
+                 std::to_string(file_report.error_code) + "\r\n";
+    }
+    else
+    {
+        std::snprintf(numbers,
+                      sizeof(numbers),
+                      "\"octets_in\":%llu,\"octets_out\":%llu,"
+                      "\"kdf_us\":%llu,\"wait_us\":%llu,\"stream_us\":%llu,"
+                      "\"close_us\":%llu,\"mbps\":%s,"
+                      "\"read_buffer_size\":%llu,\"read_queue_depth\":%llu,"
+                      "\"write_buffer_size\":%llu,\"write_queue_depth\":%llu,",
+                      static_cast<unsigned long long>(file_report.octets_in),
+                      static_cast<unsigned long long>(file_report.octets_out),
+                      static_cast<unsigned long long>(
+                          file_report.key_derivation_time),
+                      static_cast<unsigned long long>(file_report.wait_time),
+                      static_cast<unsigned long long>(file_report.stream_time),
+                      static_cast<unsigned long long>(file_report.close_time),
+                      rate.c_str(),
+                      static_cast<unsigned long long>(
+                          file_report.read_buffer_size),
+                      static_cast<unsigned long long>(
+                          file_report.read_queue_depth),
+                      static_cast<unsigned long long>(
+                          file_report.write_buffer_size),
+                      static_cast<unsigned long long>(
+                          file_report.write_queue_depth));
+        record = "{\"file\":\"" + EscapeJSON(filename) + "\"," + numbers +
+                 "\"result\":\"" + EscapeJSON(file_report.result) +
+                 "\",\"error_code\":" +
+                 std::to_string(file_report.error_code) + "}";
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Records in the JSON array are separated by commas
+    if ((format == ReportFormat::JSON) && (files_written > 0))
+    {
+        record = ",\r\n" + record;
+    }
+    else if (format == ReportFormat::JSON)
+    {
+        record = "\r\n" + record;
+    }
+
+    files_written++;
+    octets_out += file_report.octets_out;
+
+    Write(record);
+}
+
+/*
+ *  BatchReport::Close()
+ *
+ *  Description:
+ *      Write the totals for the batch and close the report.
+ *
+ *  Parameters:
+ *      summary [in]
+ *          The summary of the batch.
+ *
+ *  Returns:
+ *      The path of the report, or an empty string if no report was written.
+ *
+ *  Comments:
+ *      The elapsed time is measured from when the report was opened, so it
+ *      includes the time taken to enumerate directories.
+ */
+std::wstring BatchReport::Close(const BatchSummary &summary)
+{
+    char numbers[384];
+    std::string totals;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (report_handle == INVALID_HANDLE_VALUE) return {};
+
+    auto elapsed_time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time)
+            .count());
+    std::string rate = FormatRate(summary.octets_completed, elapsed_time);
+    const char *result = summary.success ? "success" : "failure";
+
+    if (format == ReportFormat::CSV)
+    {
+        std::snprintf(numbers,
+                      sizeof(numbers),
+                      "batch,,%llu,%llu,,,,,%llu,%s,,,,,%llu,",
+                      static_cast<unsigned long long>(
+                          summary.octets_completed),
+                      static_cast<unsigned long long>(octets_out),
+                      static_cast<unsigned long long>(elapsed_time / 1000),
+                      rate.c_str(),
+                      static_cast<unsigned long long>(threads));
+        totals = std::string(numbers) + QuoteCSV(result) + ",\r\n";
+    }
+    else
+    {
+        std::snprintf(numbers,
+                      sizeof(numbers),
+                      "\r\n],\"totals\":{\"files_total\":%llu,"
+                      "\"files_completed\":%llu,\"files_skipped\":%llu,"
+                      "\"octets_total\":%llu,\"octets_completed\":%llu,"
+                      "\"octets_out\":%llu,\"elapsed_ms\":%llu,\"mbps\":%s,"
+                      "\"threads\":%llu,\"peak_memory\":%llu,",
+                      static_cast<unsigned long long>(summary.files_total),
+                      static_cast<unsigned long long>(summary.files_completed),
+                      static_cast<unsigned long long>(summary.files_skipped),
+                      static_cast<unsigned long long>(summary.octets_total),
+                      static_cast<unsigned long long>(
+                          summary.octets_completed),
+                      static_cast<unsigned long long>(octets_out),
+                      static_cast<unsigned long long>(elapsed_time / 1000),
+                      rate.c_str(),
+                      static_cast<unsigned long long>(threads),
+                      static_cast<unsigned long long>(summary.peak_memory));
+        totals = std::string(numbers) + "\"result\":\"" + result +
+                 "\",\"error\":\"" +
+                 EscapeJSON(ConvertToUTF8(summary.error_message)) +
+                 "\"}}\r\n";
+    }
+
+    Write(totals);
+
+    if (report_handle == INVALID_HANDLE_VALUE) return {};
+
+    ::CloseHandle(report_handle);
+    report_handle = INVALID_HANDLE_VALUE;
+
+    return report_path;
+}
+
+/*
+ *  BatchReport::Write()
+ *
+ *  Description:
+ *      Write text to the report.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The text to write.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The caller must hold the mutex once the report is open to other
+ *      threads.  Each record is written with a single call, and if writing
+ *      fails, the report is closed and the batch proceeds without it.
+ */
+void BatchReport::Write(const std::string &text)
+{
+    DWORD octets_written{};
+
+    if (report_handle == INVALID_HANDLE_VALUE) return;
+
+    if (!::WriteFile(report_handle,
+                     text.data(),
+                     static_cast<DWORD>(text.size()),
+                     &octets_written,
+                     nullptr) ||
+        (octets_written != text.size()))
+    {
+        ::CloseHandle(report_handle);
+        report_handle = INVALID_HANDLE_VALUE;
+    }
+}
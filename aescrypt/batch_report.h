@@ -0,0 +1,101 @@
+/*
+ *  batch_report.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the BatchReport class, which writes a report of the
+ *      performance of a batch for use by monitoring tools.  The report gives
+ *      one record per file processed, with the octets read and written, the
+ *      time spent deriving the key, waiting to stream, streaming, and
+ *      closing the output, the rate achieved, the I/O parameters used, and
+ *      the engine's result, followed by the totals for the batch and the
+ *      number of threads used.  Records are written as each file completes,
+ *      so a report is useful even if the process ends before the batch.
+ *      Reports are kept in the user's local application data folder, in
+ *      either JSON or CSV format as selected by the BatchReport setting.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "batch_summary.h"
+#include "settings.h"
+
+// Format in which batch reports are written
+enum class ReportFormat
+{
+    None,
+    JSON,
+    CSV
+};
+
+// Measurements of a single file processed as part of a batch, with times
+// given in microseconds
+struct FileReport
+{
+    std::wstring filename;
+    std::uint64_t octets_in;
+    std::uint64_t octets_out;
+    std::uint64_t key_derivation_time;
+    std::uint64_t wait_time;
+    std::uint64_t stream_time;
+    std::uint64_t close_time;
+    std::size_t read_buffer_size;
+    std::size_t read_queue_depth;
+    std::size_t write_buffer_size;
+    std::size_t write_queue_depth;
+    std::string result;
+    DWORD error_code;
+};
+
+// Return the report format selected by the BatchReport setting
+ReportFormat ReportFormatFromSetting(unsigned setting);
+
+// Class that writes the performance report for a batch
+class BatchReport
+{
+    public:
+        BatchReport();
+        ~BatchReport();
+
+        // Create the report for a batch performing the given operation
+        bool Open(ReportFormat format,
+                  BatchOperation operation,
+                  const Settings &settings);
+
+        // Indicates whether the report was opened (the format is set only
+        // once the report is open and is not changed while in use)
+        bool IsOpen() const { return format != ReportFormat::None; }
+
+        // Write the record for a file
+        void AddFile(const FileReport &file_report);
+
+        // Write the batch totals and close the report, returning its path
+        std::wstring Close(const BatchSummary &summary);
+
+    protected:
+        void Write(const std::string &text);
+
+        std::mutex mutex;
+        ReportFormat format;
+        std::wstring report_path;
+        HANDLE report_handle;
+        std::chrono::steady_clock::time_point start_time;
+        std::size_t threads;
+        std::size_t files_written;
+        std::uint64_t octets_out;
+};
@@ -0,0 +1,277 @@
+/*
+ *  buffer_pool.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the BufferPool class.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <iterator>
+#include "buffer_pool.h"
+
+/*
+ *  BufferPool::BufferPool()
+ *
+ *  Description:
+ *      Constructor for the BufferPool object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+BufferPool::BufferPool() :
+    idle_octets{},
+    limit{Buffer_Pool_Limit},
+    lock_pages{}
+{
+}
+
+/*
+ *  BufferPool::~BufferPool()
+ *
+ *  Description:
+ *      Destructor for the BufferPool object, which frees any idle buffers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      All buffers must have been returned to the pool.
+ */
+BufferPool::~BufferPool()
+{
+    Trim();
+}
+
+/*
+ *  BufferPool::Configure()
+ *
+ *  Description:
+ *      Set the number of octets of idle buffers the pool may retain and
+ *      whether newly allocated buffers are locked into physical memory.
+ *
+ *  Parameters:
+ *      limit [in]
+ *          The maximum number of octets of idle buffers to retain.  Zero
+ *          disables pooling, with buffers freed as they are returned.
+ *
+ *      lock_pages [in]
+ *          True if buffers should be locked into memory with VirtualLock()
+ *          so their contents are never written to the page file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Idle buffers in excess of a reduced limit are freed immediately.
+ */
+void BufferPool::Configure(std::size_t limit, bool lock_pages)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->limit = limit;
+    this->lock_pages = lock_pages;
+
+    // Free idle buffers, largest first, until within the limit
+    while ((idle_octets > limit) && !idle_buffers.empty())
+    {
+        auto it = std::prev(idle_buffers.end());
+
+        FreeBuffer(it->second.back(), it->first);
+        idle_octets -= it->first;
+        it->second.pop_back();
+        if (it->second.empty()) idle_buffers.erase(it);
+    }
+}
+
+/*
+ *  BufferPool::Acquire()
+ *
+ *  Description:
+ *      Take a buffer of the given size from the pool, allocating one if
+ *      there is no idle buffer of that size.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The size of the buffer in octets.
+ *
+ *  Returns:
+ *      A page-aligned buffer whose contents are zero, or nullptr if the
+ *      buffer could not be allocated (with the error available from
+ *      GetLastError()).
+ *
+ *  Comments:
+ *      As buffers are page aligned, they are suitable for unbuffered I/O
+ *      and never share a cache line with other data.  Failure to lock the
+ *      pages (e.g., because the working set limit is reached) is ignored.
+ */
+char *BufferPool::Acquire(std::size_t size)
+{
+    bool lock_buffer;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = idle_buffers.find(size);
+        if (it != idle_buffers.end())
+        {
+            char *buffer = it->second.back();
+
+            idle_octets -= size;
+            it->second.pop_back();
+            if (it->second.empty()) idle_buffers.erase(it);
+
+            return buffer;
+        }
+
+        lock_buffer = lock_pages;
+    }
+
+    // Memory returned by VirtualAlloc() is zero-filled
+    char *buffer = static_cast<char *>(::VirtualAlloc(nullptr,
+                                                      size,
+                                                      MEM_RESERVE | MEM_COMMIT,
+                                                      PAGE_READWRITE));
+    if ((buffer != nullptr) && lock_buffer) ::VirtualLock(buffer, size);
+
+    return buffer;
+}
+
+/*
+ *  BufferPool::Release()
+ *
+ *  Description:
+ *      Erase the contents of a buffer and return it to the pool, or free
+ *      it if the pool is already holding as much as it may.
+ *
+ *  Parameters:
+ *      buffer [in]
+ *          The buffer being returned, which must have come from Acquire().
+ *
+ *      size [in]
+ *          The size of the buffer as given to Acquire().
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The buffer is erased before the lock is taken, so threads returning
+ *      buffers do not wait on one another.
+ */
+void BufferPool::Release(char *buffer, std::size_t size)
+{
+    if (buffer == nullptr) return;
+
+    ::SecureZeroMemory(buffer, size);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (idle_octets + size <= limit)
+        {
+            idle_buffers[size].push_back(buffer);
+            idle_octets += size;
+            return;
+        }
+    }
+
+    FreeBuffer(buffer, size);
+}
+
+/*
+ *  BufferPool::Trim()
+ *
+ *  Description:
+ *      Free all idle buffers held by the pool.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This is called once all requests are complete so memory is not held
+ *      while AES Crypt is idle.
+ */
+void BufferPool::Trim()
+{
+    std::map<std::size_t, std::vector<char *>> buffers;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        buffers.swap(idle_buffers);
+        idle_octets = 0;
+    }
+
+    for (auto &[size, list] : buffers)
+    {
+        for (char *buffer : list) FreeBuffer(buffer, size);
+    }
+}
+
+/*
+ *  BufferPool::FreeBuffer()
+ *
+ *  Description:
+ *      Release a buffer's memory to the system.
+ *
+ *  Parameters:
+ *      buffer [in]
+ *          The buffer to free, whose contents have already been erased.
+ *
+ *      size [in]
+ *          The size of the buffer.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Unlocking a buffer that was not locked fails harmlessly.
+ */
+void BufferPool::FreeBuffer(char *buffer, std::size_t size)
+{
+    ::VirtualUnlock(buffer, size);
+    ::VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+/*
+ *  GetBufferPool()
+ *
+ *  Description:
+ *      Return the buffer pool shared by all file I/O in the process.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      A reference to the buffer pool.
+ *
+ *  Comments:
+ *      The pool is created on first use.
+ */
+BufferPool &GetBufferPool()
+{
+    static BufferPool buffer_pool;
+
+    return buffer_pool;
+}
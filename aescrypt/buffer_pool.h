@@ -0,0 +1,66 @@
+/*
+ *  buffer_pool.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the BufferPool class, which holds the page-aligned
+ *      buffers used for file I/O so that they may be reused from one file
+ *      to the next rather than being allocated, wiped, and freed for every
+ *      file.  Buffers are erased as they are returned, so a buffer taken
+ *      from the pool never holds data from a previous file.  The pool
+ *      retains no more than a configured number of octets and is emptied
+ *      when processing becomes idle, limiting the memory held by the DLL
+ *      while loaded into Explorer.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <cstddef>
+
+// Default number of octets of idle buffers the pool may retain
+constexpr std::size_t Buffer_Pool_Limit = 16'777'216;
+
+// Class holding a pool of reusable I/O buffers
+class BufferPool
+{
+    public:
+        BufferPool();
+        ~BufferPool();
+
+        // Set the number of idle octets retained and whether to lock pages
+        void Configure(std::size_t limit, bool lock_pages);
+
+        // Take a wiped buffer of the given size from the pool
+        char *Acquire(std::size_t size);
+
+        // Wipe a buffer and return it to the pool
+        void Release(char *buffer, std::size_t size);
+
+        // Free all idle buffers
+        void Trim();
+
+    protected:
+        void FreeBuffer(char *buffer, std::size_t size);
+
+        std::mutex mutex;
+        std::map<std::size_t, std::vector<char *>> idle_buffers;
+        std::size_t idle_octets;
+        std::size_t limit;
+        bool lock_pages;
+};
+
+// Return the pool shared by all file I/O in the process
+BufferPool &GetBufferPool();
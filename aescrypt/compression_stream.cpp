@@ -0,0 +1,691 @@
+/*
+ *  compression_stream.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the CompressingStreamBuffer and
+ *      DecompressingStreamBuffer classes.  The Windows Compression API is
+ *      used in raw mode, as the frame header already records the lengths
+ *      needed to reverse compression.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include <cstring>
+#include "compression_stream.h"
+
+namespace
+{
+
+// Length of the frame header preceding each block
+constexpr std::size_t Frame_Header_Size = 8;
+
+// Bit set in the stored length if the block is not compressed
+constexpr std::uint32_t Stored_Raw = 0x80000000;
+
+/*
+ *  GetAlgorithmIdentifier()
+ *
+ *  Description:
+ *      Return the Windows Compression API identifier for the algorithm.
+ *
+ *  Parameters:
+ *      algorithm [in]
+ *          The compression algorithm.
+ *
+ *  Returns:
+ *      The algorithm identifier or COMPRESS_ALGORITHM_INVALID if there is
+ *      no such algorithm.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD GetAlgorithmIdentifier(CompressionAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case CompressionAlgorithm::XPress:
+            return COMPRESS_ALGORITHM_XPRESS;
+
+        case CompressionAlgorithm::XPressHuffman:
+            return COMPRESS_ALGORITHM_XPRESS_HUFF;
+
+        case CompressionAlgorithm::MSZip:
+            return COMPRESS_ALGORITHM_MSZIP;
+
+        case CompressionAlgorithm::LZMS:
+            return COMPRESS_ALGORITHM_LZMS;
+
+        default:
+            return COMPRESS_ALGORITHM_INVALID;
+    }
+}
+
+/*
+ *  PutUint32()
+ *
+ *  Description:
+ *      Write a 32-bit value in network byte order.
+ *
+ *  Parameters:
+ *      p [out]
+ *          The location to which the value is written.
+ *
+ *      value [in]
+ *          The value to write.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void PutUint32(char *p, std::uint32_t value)
+{
+    p[0] = static_cast<char>((value >> 24) & 0xff);
+    p[1] = static_cast<char>((value >> 16) & 0xff);
+    p[2] = static_cast<char>((value >> 8) & 0xff);
+    p[3] = static_cast<char>(value & 0xff);
+}
+
+/*
+ *  GetUint32()
+ *
+ *  Description:
+ *      Read a 32-bit value stored in network byte order.
+ *
+ *  Parameters:
+ *      p [in]
+ *          The location from which the value is read.
+ *
+ *  Returns:
+ *      The value read.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint32_t GetUint32(const char *p)
+{
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(p[0]))
+                << 24) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(p[1]))
+                << 16) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(p[2]))
+                << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(p[3]));
+}
+
+} // namespace
+
+/*
+ *  CompressionFromSetting()
+ *
+ *  Description:
+ *      Map the value of the Compression setting to a compression algorithm.
+ *
+ *  Parameters:
+ *      setting [in]
+ *          The setting value, where 0 disables compression and 1 through 4
+ *          select algorithms from the fastest to the most compact.
+ *
+ *  Returns:
+ *      The compression algorithm.
+ *
+ *  Comments:
+ *      Values above 4 select the most compact algorithm.
+ */
+CompressionAlgorithm CompressionFromSetting(unsigned setting)
+{
+    switch (setting)
+    {
+        case 0:
+            return CompressionAlgorithm::None;
+
+        case 1:
+            return CompressionAlgorithm::XPress;
+
+        case 2:
+            return CompressionAlgorithm::XPressHuffman;
+
+        case 3:
+            return CompressionAlgorithm::MSZip;
+
+        default:
+            return CompressionAlgorithm::LZMS;
+    }
+}
+
+/*
+ *  CompressionName()
+ *
+ *  Description:
+ *      Return the name recorded in the COMPRESSION header extension for the
+ *      given algorithm.
+ *
+ *  Parameters:
+ *      algorithm [in]
+ *          The compression algorithm.
+ *
+ *  Returns:
+ *      The name of the algorithm, or an empty string for None.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string CompressionName(CompressionAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case CompressionAlgorithm::XPress:
+            return "xpress";
+
+        case CompressionAlgorithm::XPressHuffman:
+            return "xpress-huff";
+
+        case CompressionAlgorithm::MSZip:
+            return "mszip";
+
+        case CompressionAlgorithm::LZMS:
+            return "lzms";
+
+        default:
+            return {};
+    }
+}
+
+/*
+ *  CompressionFromName()
+ *
+ *  Description:
+ *      Return the algorithm named in a COMPRESSION header extension.
+ *
+ *  Parameters:
+ *      name [in]
+ *          The name of the algorithm.
+ *
+ *  Returns:
+ *      The compression algorithm, or None if the name is not recognized.
+ *
+ *  Comments:
+ *      None.
+ */
+CompressionAlgorithm CompressionFromName(const std::string &name)
+{
+    for (auto algorithm : {CompressionAlgorithm::XPress,
+                           CompressionAlgorithm::XPressHuffman,
+                           CompressionAlgorithm::MSZip,
+                           CompressionAlgorithm::LZMS})
+    {
+        if (name == CompressionName(algorithm)) return algorithm;
+    }
+
+    return CompressionAlgorithm::None;
+}
+
+/*
+ *  CompressingStreamBuffer::CompressingStreamBuffer()
+ *
+ *  Description:
+ *      Constructor for the CompressingStreamBuffer object.
+ *
+ *  Parameters:
+ *      source [in]
+ *          The stream buffer from which uncompressed data is read.
+ *
+ *      algorithm [in]
+ *          The compression algorithm to use.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Open() must be called before any data is read.
+ */
+CompressingStreamBuffer::CompressingStreamBuffer(
+                                            std::streambuf *source,
+                                            CompressionAlgorithm algorithm) :
+    source{source},
+    algorithm{algorithm},
+    compressor{nullptr},
+    position{0}
+{
+}
+
+/*
+ *  CompressingStreamBuffer::~CompressingStreamBuffer()
+ *
+ *  Description:
+ *      Destructor for the CompressingStreamBuffer object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+CompressingStreamBuffer::~CompressingStreamBuffer()
+{
+    if (compressor != nullptr) CloseCompressor(compressor);
+}
+
+/*
+ *  CompressingStreamBuffer::Open()
+ *
+ *  Description:
+ *      Create the compressor and allocate the block buffers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if successful or an error code if the compressor could
+ *      not be created.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD CompressingStreamBuffer::Open()
+{
+    if (compressor != nullptr) return ERROR_SUCCESS;
+
+    if (!CreateCompressor(GetAlgorithmIdentifier(algorithm) | COMPRESS_RAW,
+                          nullptr,
+                          &compressor))
+    {
+        compressor = nullptr;
+        return ::GetLastError();
+    }
+
+    try
+    {
+        input.resize(Compression_Block_Size);
+        output.resize(Frame_Header_Size + Compression_Block_Size);
+    }
+    catch (...)
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  CompressingStreamBuffer::underflow()
+ *
+ *  Description:
+ *      Called when the get area is exhausted to read the next block from the
+ *      source, compress it, and make the resulting frame the get area.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character or traits_type::eof() at the end of the data or
+ *      on error.
+ *
+ *  Comments:
+ *      A block that cannot be compressed or that would not be made smaller
+ *      is stored as-is.
+ */
+CompressingStreamBuffer::int_type CompressingStreamBuffer::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    if (compressor == nullptr) return traits_type::eof();
+
+    // Fill the block, as the source may return fewer octets than requested
+    std::size_t length = 0;
+    while (length < input.size())
+    {
+        std::streamsize read =
+            source->sgetn(input.data() + length,
+                          static_cast<std::streamsize>(input.size() - length));
+        if (read <= 0) break;
+        length += static_cast<std::size_t>(read);
+    }
+
+    if (length == 0) return traits_type::eof();
+
+    position += length;
+
+    SIZE_T compressed_length = 0;
+    std::uint32_t stored_length;
+
+    if (Compress(compressor,
+                 input.data(),
+                 length,
+                 output.data() + Frame_Header_Size,
+                 length - 1,
+                 &compressed_length) &&
+        (compressed_length < length))
+    {
+        stored_length = static_cast<std::uint32_t>(compressed_length);
+    }
+    else
+    {
+        std::memcpy(output.data() + Frame_Header_Size, input.data(), length);
+        compressed_length = length;
+        stored_length = static_cast<std::uint32_t>(length) | Stored_Raw;
+    }
+
+    PutUint32(output.data(), static_cast<std::uint32_t>(length));
+    PutUint32(output.data() + 4, stored_length);
+
+    setg(output.data(),
+         output.data(),
+         output.data() + Frame_Header_Size + compressed_length);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  DecompressingStreamBuffer::DecompressingStreamBuffer()
+ *
+ *  Description:
+ *      Constructor for the DecompressingStreamBuffer object.
+ *
+ *  Parameters:
+ *      target [in]
+ *          The stream buffer to which decompressed data is written.
+ *
+ *      algorithm [in]
+ *          The compression algorithm used to compress the data.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Open() must be called before any data is written.
+ */
+DecompressingStreamBuffer::DecompressingStreamBuffer(
+                                            std::streambuf *target,
+                                            CompressionAlgorithm algorithm) :
+    target{target},
+    algorithm{algorithm},
+    decompressor{nullptr},
+    frame_filled{0},
+    frame_length{Frame_Header_Size},
+    error{ERROR_SUCCESS}
+{
+}
+
+/*
+ *  DecompressingStreamBuffer::~DecompressingStreamBuffer()
+ *
+ *  Description:
+ *      Destructor for the DecompressingStreamBuffer object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+DecompressingStreamBuffer::~DecompressingStreamBuffer()
+{
+    if (decompressor != nullptr) CloseDecompressor(decompressor);
+}
+
+/*
+ *  DecompressingStreamBuffer::Open()
+ *
+ *  Description:
+ *      Create the decompressor and allocate the block buffers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if successful or an error code if the decompressor
+ *      could not be created.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD DecompressingStreamBuffer::Open()
+{
+    if (decompressor != nullptr) return ERROR_SUCCESS;
+
+    if (!CreateDecompressor(GetAlgorithmIdentifier(algorithm) | COMPRESS_RAW,
+                            nullptr,
+                            &decompressor))
+    {
+        decompressor = nullptr;
+        error = ::GetLastError();
+        return error;
+    }
+
+    try
+    {
+        frame.resize(Frame_Header_Size + Compression_Block_Size);
+        output.resize(Compression_Block_Size);
+    }
+    catch (...)
+    {
+        error = ERROR_NOT_ENOUGH_MEMORY;
+        return error;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  DecompressingStreamBuffer::Finish()
+ *
+ *  Description:
+ *      Verify that the data ended on a frame boundary and flush the target
+ *      stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if all data was decompressed and written, or an error
+ *      code if the data was not valid or could not be written.
+ *
+ *  Comments:
+ *      No data may be written once this is called.
+ */
+DWORD DecompressingStreamBuffer::Finish()
+{
+    if ((error == ERROR_SUCCESS) && (frame_filled > 0))
+    {
+        error = ERROR_INVALID_DATA;
+    }
+
+    if ((error == ERROR_SUCCESS) && (target->pubsync() == -1))
+    {
+        error = ERROR_WRITE_FAULT;
+    }
+
+    return error;
+}
+
+/*
+ *  DecompressingStreamBuffer::ProcessFrame()
+ *
+ *  Description:
+ *      Decompress the complete frame held in the frame buffer and write the
+ *      result to the target stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if the frame was not valid or the data
+ *      could not be written.
+ *
+ *  Comments:
+ *      None.
+ */
+bool DecompressingStreamBuffer::ProcessFrame()
+{
+    std::size_t original_length = GetUint32(frame.data());
+    std::uint32_t stored_length = GetUint32(frame.data() + 4);
+    const char *data = frame.data() + Frame_Header_Size;
+
+    if ((stored_length & Stored_Raw) == 0)
+    {
+        SIZE_T decompressed_length = 0;
+
+        if (!Decompress(decompressor,
+                        data,
+                        stored_length,
+                        output.data(),
+                        original_length,
+                        &decompressed_length) ||
+            (decompressed_length != original_length))
+        {
+            error = ERROR_INVALID_DATA;
+            return false;
+        }
+
+        data = output.data();
+    }
+
+    if (target->sputn(data, static_cast<std::streamsize>(original_length)) !=
+        static_cast<std::streamsize>(original_length))
+    {
+        error = ERROR_WRITE_FAULT;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  DecompressingStreamBuffer::overflow()
+ *
+ *  Description:
+ *      Called to write a character, as this stream buffer has no put area.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to write or traits_type::eof() if none.
+ *
+ *  Returns:
+ *      A value other than traits_type::eof() on success, or
+ *      traits_type::eof() on error.
+ *
+ *  Comments:
+ *      None.
+ */
+DecompressingStreamBuffer::int_type DecompressingStreamBuffer::overflow(
+                                                                int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    char octet = traits_type::to_char_type(c);
+
+    return (xsputn(&octet, 1) == 1) ? c : traits_type::eof();
+}
+
+/*
+ *  DecompressingStreamBuffer::xsputn()
+ *
+ *  Description:
+ *      Assemble the data written into frames, decompressing and writing
+ *      each frame once it is complete.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters to write.
+ *
+ *      count [in]
+ *          The number of characters to write.
+ *
+ *  Returns:
+ *      The number of characters written, which is less than count if the
+ *      data was not valid or could not be written.
+ *
+ *  Comments:
+ *      The lengths in a frame header are checked before the frame is
+ *      assembled, so corrupt data cannot cause a block larger than
+ *      Compression_Block_Size to be accepted.
+ */
+std::streamsize DecompressingStreamBuffer::xsputn(const char *s,
+                                                  std::streamsize count)
+{
+    std::streamsize written = 0;
+
+    while ((written < count) && (error == ERROR_SUCCESS))
+    {
+        std::size_t length =
+            std::min(frame_length - frame_filled,
+                     static_cast<std::size_t>(count - written));
+        std::memcpy(frame.data() + frame_filled, s + written, length);
+        frame_filled += length;
+        written += static_cast<std::streamsize>(length);
+
+        if (frame_filled < frame_length) break;
+
+        // Once the header is complete, determine the length of the frame
+        if (frame_length == Frame_Header_Size)
+        {
+            std::size_t original_length = GetUint32(frame.data());
+            std::uint32_t stored_length = GetUint32(frame.data() + 4);
+            std::size_t data_length = stored_length & ~Stored_Raw;
+
+            if ((original_length == 0) ||
+                (original_length > Compression_Block_Size) ||
+                (data_length == 0) ||
+                (data_length > Compression_Block_Size) ||
+                (((stored_length & Stored_Raw) != 0) &&
+                 (data_length != original_length)))
+            {
+                error = ERROR_INVALID_DATA;
+                break;
+            }
+
+            frame_length = Frame_Header_Size + data_length;
+            continue;
+        }
+
+        if (!ProcessFrame()) break;
+
+        frame_filled = 0;
+        frame_length = Frame_Header_Size;
+    }
+
+    return (error == ERROR_SUCCESS) ? written : 0;
+}
+
+/*
+ *  DecompressingStreamBuffer::sync()
+ *
+ *  Description:
+ *      Called when the stream is flushed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      0 on success or -1 if an error has occurred.
+ *
+ *  Comments:
+ *      A partial frame cannot be written until it is complete, so this only
+ *      reports the error state; the target stream buffer is flushed by
+ *      Finish().
+ */
+int DecompressingStreamBuffer::sync()
+{
+    return (error == ERROR_SUCCESS) ? 0 : -1;
+}
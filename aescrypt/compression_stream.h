@@ -0,0 +1,116 @@
+/*
+ *  compression_stream.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines stream buffer classes that compress a file's
+ *      contents before encryption and decompress them after decryption
+ *      using the Windows Compression API.  Data is compressed in blocks,
+ *      each preceded by a frame header giving the block's original length
+ *      and stored length (both as 32-bit big endian values), with the high
+ *      bit of the stored length set if the block is stored uncompressed
+ *      because it did not compress.  A file whose contents were compressed
+ *      carries a header extension naming the algorithm, so decryption can
+ *      detect and reverse compression transparently.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <compressapi.h>
+#include <streambuf>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "secure_containers.h"
+
+// Size of the blocks into which data is divided for compression
+constexpr std::size_t Compression_Block_Size = 1'048'576;
+
+// Identifier of the header extension naming the compression algorithm
+constexpr char Compression_Extension[] = "COMPRESSION";
+
+// Compression algorithms, ordered from fastest to most compact
+enum class CompressionAlgorithm
+{
+    None,
+    XPress,
+    XPressHuffman,
+    MSZip,
+    LZMS
+};
+
+// Map a setting value (0..4) to a compression algorithm
+CompressionAlgorithm CompressionFromSetting(unsigned setting);
+
+// Return the name recorded in the header extension for the algorithm
+std::string CompressionName(CompressionAlgorithm algorithm);
+
+// Return the algorithm having the given name (None if not recognized)
+CompressionAlgorithm CompressionFromName(const std::string &name);
+
+// Input stream buffer that compresses the data read from another
+class CompressingStreamBuffer : public std::streambuf
+{
+    public:
+        CompressingStreamBuffer(std::streambuf *source,
+                                CompressionAlgorithm algorithm);
+        virtual ~CompressingStreamBuffer();
+
+        // Create the compressor
+        DWORD Open();
+
+        // Number of octets read (and compressed) from the source so far
+        std::uint64_t GetPosition() const { return position; }
+
+    protected:
+        int_type underflow() override;
+
+        std::streambuf *source;
+        CompressionAlgorithm algorithm;
+        COMPRESSOR_HANDLE compressor;
+        SecureVector<char> input;
+        SecureVector<char> output;
+        std::uint64_t position;
+};
+
+// Output stream buffer that decompresses data before writing it to another
+class DecompressingStreamBuffer : public std::streambuf
+{
+    public:
+        DecompressingStreamBuffer(std::streambuf *target,
+                                  CompressionAlgorithm algorithm);
+        virtual ~DecompressingStreamBuffer();
+
+        // Create the decompressor
+        DWORD Open();
+
+        // Check that the data ended on a block boundary and flush the target,
+        // returning an error if the data was not valid or could not be written
+        DWORD Finish();
+
+    protected:
+        bool ProcessFrame();
+
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+        int sync() override;
+
+        std::streambuf *target;
+        CompressionAlgorithm algorithm;
+        DECOMPRESSOR_HANDLE decompressor;
+        SecureVector<char> frame;
+        std::size_t frame_filled;
+        std::size_t frame_length;
+        SecureVector<char> output;
+        DWORD error;
+};
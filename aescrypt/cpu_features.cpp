@@ -0,0 +1,137 @@
+/*
+ *  cpu_features.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the functions that detect the processor
+ *      features used to accelerate AES and SHA.
+ *
+ *  Portability Issues:
+ *      Supports x86 and x64 processors only.
+ */
+
+#include "pch.h"
+#include <intrin.h>
+#include "cpu_features.h"
+
+namespace
+{
+
+/*
+ *  DetectCPUFeatures()
+ *
+ *  Description:
+ *      Query the processor using the CPUID instruction to determine which
+ *      features are present.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The detected features.
+ *
+ *  Comments:
+ *      The AVX-based features are reported only if the operating system
+ *      saves the extended register state (as indicated by XGETBV), since
+ *      the instructions are otherwise unusable.
+ */
+CPUFeatures DetectCPUFeatures()
+{
+    CPUFeatures features{};
+    int registers[4]{};
+
+    // Determine the highest standard function supported
+    __cpuid(registers, 0);
+    int max_function = registers[0];
+    if (max_function < 1) return features;
+
+    // Function 1 reports AES-NI, PCLMULQDQ, OSXSAVE, and AVX in ECX
+    __cpuid(registers, 1);
+    const unsigned ecx = static_cast<unsigned>(registers[2]);
+
+    features.aes_ni = (ecx & (1U << 25)) != 0;
+    features.pclmulqdq = (ecx & (1U << 1)) != 0;
+
+    // AVX requires that the OS saves the XMM and YMM registers
+    if ((ecx & (1U << 27)) && (ecx & (1U << 28)))
+    {
+        features.avx = (_xgetbv(0) & 0x06) == 0x06;
+    }
+
+    if (max_function < 7) return features;
+
+    // Function 7 reports AVX2 and SHA in EBX and VAES and VPCLMULQDQ in ECX
+    __cpuidex(registers, 7, 0);
+    const unsigned ebx7 = static_cast<unsigned>(registers[1]);
+    const unsigned ecx7 = static_cast<unsigned>(registers[2]);
+
+    features.sha_ni = (ebx7 & (1U << 29)) != 0;
+    features.avx2 = features.avx && ((ebx7 & (1U << 5)) != 0);
+    features.vaes = features.avx && ((ecx7 & (1U << 9)) != 0);
+    features.vpclmulqdq = features.avx && ((ecx7 & (1U << 10)) != 0);
+
+    return features;
+}
+
+} // namespace
+
+/*
+ *  GetCPUFeatures()
+ *
+ *  Description:
+ *      Return the features of the processor relevant to cryptography.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The processor features.
+ *
+ *  Comments:
+ *      The processor is queried on the first call only.
+ */
+const CPUFeatures &GetCPUFeatures()
+{
+    static const CPUFeatures features = DetectCPUFeatures();
+
+    return features;
+}
+
+/*
+ *  DescribeCPUFeatures()
+ *
+ *  Description:
+ *      Produce text listing which of the processor features are available,
+ *      one per line.
+ *
+ *  Parameters:
+ *      features [in]
+ *          The processor features to describe.
+ *
+ *  Returns:
+ *      The description of the features.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring DescribeCPUFeatures(const CPUFeatures &features)
+{
+    auto line = [](const wchar_t *name, bool present) -> std::wstring
+    {
+        return std::wstring(name) + (present ? L": yes\n" : L": no\n");
+    };
+
+    return line(L"AES-NI", features.aes_ni) +
+           line(L"PCLMULQDQ", features.pclmulqdq) +
+           line(L"AVX", features.avx) +
+           line(L"AVX2", features.avx2) +
+           line(L"VAES", features.vaes) +
+           line(L"VPCLMULQDQ", features.vpclmulqdq) +
+           line(L"SHA-NI", features.sha_ni);
+}
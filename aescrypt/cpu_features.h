@@ -0,0 +1,41 @@
+/*
+ *  cpu_features.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file declares the GetCPUFeatures() function, which reports the
+ *      processor instructions that accelerate AES and SHA and that are
+ *      usable on this machine (i.e., supported by both the processor and
+ *      the operating system).
+ *
+ *  Portability Issues:
+ *      Supports x86 and x64 processors only.
+ */
+
+#pragma once
+
+#include <string>
+
+// Processor instructions relevant to the cryptographic functions
+struct CPUFeatures
+{
+    bool aes_ni;                                // AES New Instructions
+    bool pclmulqdq;                             // Carry-less multiply
+    bool avx;                                   // Advanced Vector Extensions
+    bool avx2;                                  // AVX2
+    bool vaes;                                  // Vector AES (AVX2/AVX-512)
+    bool vpclmulqdq;                            // Vector carry-less multiply
+    bool sha_ni;                                // SHA extensions
+};
+
+// Return the processor features, which are detected only once
+const CPUFeatures &GetCPUFeatures();
+
+// Return a description of the processor features for diagnostics
+std::wstring DescribeCPUFeatures(const CPUFeatures &features);
@@ -0,0 +1,226 @@
+/*
+ *  drop_file_list.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the DropFileList class, which holds a copy of the
+ *      list of files provided by the Windows shell in CF_HDROP format.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <shlobj.h>
+#include <cwchar>
+#include "drop_file_list.h"
+#include "has_aes_extension.h"
+
+/*
+ *  DropFileList::Load()
+ *
+ *  Description:
+ *      Copy the list of files from the given CF_HDROP global memory object.
+ *      The list of files is copied as a single block, as the global memory
+ *      object is released once the shell extension is initialized.
+ *
+ *  Parameters:
+ *      global [in]
+ *          The global memory object holding a DROPFILES structure.
+ *
+ *  Returns:
+ *      True if the file list was copied, false if the object is invalid.
+ *
+ *  Comments:
+ *      DragQueryFile() is not used, since retrieving each file by index
+ *      requires scanning all of the names that precede it.
+ */
+bool DropFileList::Load(HGLOBAL global)
+{
+    bool result = false;
+
+    names.clear();
+
+    SIZE_T global_size = ::GlobalSize(global);
+
+    const DROPFILES *drop_files =
+        static_cast<const DROPFILES *>(::GlobalLock(global));
+    if (drop_files == nullptr) return false;
+
+    // Ensure the file list lies within the memory object
+    if ((global_size > sizeof(DROPFILES)) &&
+        (drop_files->pFiles >= sizeof(DROPFILES)) &&
+        (drop_files->pFiles < global_size))
+    {
+        const char *list =
+            reinterpret_cast<const char *>(drop_files) + drop_files->pFiles;
+        std::size_t list_size = global_size - drop_files->pFiles;
+
+        if (drop_files->fWide)
+        {
+            const wchar_t *wide_list = reinterpret_cast<const wchar_t *>(list);
+            names.assign(wide_list, wide_list + list_size / sizeof(wchar_t));
+        }
+        else
+        {
+            // Convert names provided in the system code page
+            int length = ::MultiByteToWideChar(CP_ACP,
+                                               0,
+                                               list,
+                                               static_cast<int>(list_size),
+                                               nullptr,
+                                               0);
+            if (length > 0)
+            {
+                names.resize(length);
+                ::MultiByteToWideChar(CP_ACP,
+                                      0,
+                                      list,
+                                      static_cast<int>(list_size),
+                                      names.data(),
+                                      length);
+            }
+        }
+
+        // The list ends with an empty name, but the memory object may be
+        // larger than the list and not properly terminated
+        names.push_back(L'\0');
+        names.push_back(L'\0');
+
+        result = true;
+    }
+
+    ::GlobalUnlock(global);
+
+    return result;
+}
+
+/*
+ *  DropFileList::Clear()
+ *
+ *  Description:
+ *      Release the list of files.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void DropFileList::Clear()
+{
+    names.clear();
+    names.shrink_to_fit();
+}
+
+/*
+ *  DropFileList::Empty()
+ *
+ *  Description:
+ *      Indicates whether there are no files in the list.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the list is empty, false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool DropFileList::Empty() const
+{
+    return names.empty() || (names.front() == L'\0');
+}
+
+/*
+ *  DropFileList::Classify()
+ *
+ *  Description:
+ *      Determine whether the list contains files having a .aes extension,
+ *      files that do not, or both.
+ *
+ *  Parameters:
+ *      aes_files [out]
+ *          Set to true if any file has a .aes extension.
+ *
+ *      non_aes_files [out]
+ *          Set to true if any file does not have a .aes extension.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This only examines the extension of each name, without allocating
+ *      memory or accessing the file system, and stops as soon as both kinds
+ *      of file are seen.  Directories are selected for encryption, which
+ *      is the case unless the directory name itself ends in .aes.
+ */
+void DropFileList::Classify(bool &aes_files, bool &non_aes_files) const
+{
+    aes_files = false;
+    non_aes_files = false;
+
+    if (Empty()) return;
+
+    for (const wchar_t *name = names.data(); *name != L'\0';)
+    {
+        std::size_t length = std::wcslen(name);
+
+        if (HasAESExtension(name, length))
+        {
+            aes_files = true;
+        }
+        else
+        {
+            non_aes_files = true;
+        }
+
+        // There is no need to look further once both kinds are seen
+        if (aes_files && non_aes_files) break;
+
+        name += length + 1;
+    }
+}
+
+/*
+ *  DropFileList::GetFileList()
+ *
+ *  Description:
+ *      Produce the list of files.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The list of files.
+ *
+ *  Comments:
+ *      None.
+ */
+FileList DropFileList::GetFileList() const
+{
+    FileList file_list;
+
+    if (Empty()) return file_list;
+
+    for (const wchar_t *name = names.data(); *name != L'\0';)
+    {
+        std::size_t length = std::wcslen(name);
+
+        file_list.emplace_back(name, length);
+
+        name += length + 1;
+    }
+
+    return file_list;
+}
@@ -0,0 +1,50 @@
+/*
+ *  drop_file_list.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the DropFileList class, which holds a copy of the
+ *      list of files provided by the Windows shell in CF_HDROP format.  The
+ *      names are kept in the packed form provided by the shell so that a
+ *      large selection can be examined without creating a string for each
+ *      file, deferring that work until the files are to be processed.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include "file_list.h"
+
+// Class holding a list of files in CF_HDROP format
+class DropFileList
+{
+    public:
+        // Copy the file list from the CF_HDROP global memory object
+        bool Load(HGLOBAL global);
+
+        // Release the file list
+        void Clear();
+
+        // Indicates whether there are no files in the list
+        bool Empty() const;
+
+        // Determine whether there are .aes and/or non-.aes files in the list
+        void Classify(bool &aes_files, bool &non_aes_files) const;
+
+        // Produce the list of files
+        FileList GetFileList() const;
+
+    protected:
+        // Sequence of null-terminated names, ending with an empty name
+        std::vector<wchar_t> names;
+};
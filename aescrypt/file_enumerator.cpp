@@ -0,0 +1,153 @@
+/*
+ *  file_enumerator.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements a function to recursively enumerate the files
+ *      within a directory.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <vector>
+#include "file_enumerator.h"
+
+/*
+ *  EnumerateDirectory()
+ *
+ *  Description:
+ *      Recursively enumerate the files within the given directory, calling
+ *      the file handler for each file found.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory to enumerate.
+ *
+ *      file_handler [in]
+ *          The function to call for each file found.  It is given the full
+ *          path of the file, its size in octets, and its last write time as
+ *          a FILETIME value.
+ *
+ *      failed_directory [out]
+ *          The directory that could not be read if an error is returned.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if all files were enumerated, ERROR_CANCELLED if the
+ *      file handler stopped enumeration, or the Windows error code that
+ *      resulted from attempting to read a directory.
+ *
+ *  Comments:
+ *      Directories are walked using an explicit stack rather than recursion
+ *      so that deep directory trees cannot exhaust the thread's stack.  The
+ *      files in a directory are reported before its subdirectories are
+ *      entered.
+ */
+DWORD EnumerateDirectory(const std::wstring &directory,
+                         const FileHandler &file_handler,
+                         std::wstring &failed_directory)
+{
+    std::vector<std::wstring> pending_directories;
+
+    pending_directories.push_back(directory);
+
+    while (!pending_directories.empty())
+    {
+        WIN32_FIND_DATAW find_data{};
+
+        std::wstring current_directory = std::move(pending_directories.back());
+        pending_directories.pop_back();
+
+        // Ensure the directory name ends with a separator
+        if (!current_directory.empty() &&
+            (current_directory.back() != L'\\') &&
+            (current_directory.back() != L'/'))
+        {
+            current_directory += L'\\';
+        }
+
+        // The basic information level and large fetch flag avoid retrieving
+        // short names and reduce the number of calls into the file system
+        HANDLE find_handle =
+            ::FindFirstFileExW((current_directory + L"*").c_str(),
+                               FindExInfoBasic,
+                               &find_data,
+                               FindExSearchNameMatch,
+                               nullptr,
+                               FIND_FIRST_EX_LARGE_FETCH);
+        if (find_handle == INVALID_HANDLE_VALUE)
+        {
+            DWORD error = ::GetLastError();
+
+            // An empty root directory has no entries at all
+            if (error == ERROR_FILE_NOT_FOUND) continue;
+
+            failed_directory = current_directory;
+            return error;
+        }
+
+        // Subdirectories found in this directory
+        std::vector<std::wstring> subdirectories;
+
+        do
+        {
+            std::wstring name = find_data.cFileName;
+
+            if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                // Skip the current and parent directory entries
+                if ((name == L".") || (name == L"..")) continue;
+
+                // Do not follow junctions or symbolic links
+                if (find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                {
+                    continue;
+                }
+
+                subdirectories.push_back(current_directory + name);
+
+                continue;
+            }
+
+            std::uint64_t file_size =
+                (static_cast<std::uint64_t>(find_data.nFileSizeHigh) << 32) |
+                find_data.nFileSizeLow;
+            std::uint64_t last_write_time =
+                (static_cast<std::uint64_t>(
+                     find_data.ftLastWriteTime.dwHighDateTime) << 32) |
+                find_data.ftLastWriteTime.dwLowDateTime;
+
+            if (!file_handler(current_directory + name,
+                              file_size,
+                              last_write_time))
+            {
+                ::FindClose(find_handle);
+                return ERROR_CANCELLED;
+            }
+        } while (::FindNextFileW(find_handle, &find_data));
+
+        DWORD error = ::GetLastError();
+
+        ::FindClose(find_handle);
+
+        if (error != ERROR_NO_MORE_FILES)
+        {
+            failed_directory = current_directory;
+            return error;
+        }
+
+        // Place subdirectories on the stack so the first found is walked next
+        pending_directories.insert(pending_directories.end(),
+                                   subdirectories.rbegin(),
+                                   subdirectories.rend());
+    }
+
+    return ERROR_SUCCESS;
+}
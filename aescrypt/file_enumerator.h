@@ -0,0 +1,64 @@
+/*
+ *  file_enumerator.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines a function to recursively enumerate the files
+ *      within a directory.  Files are handed to the caller as they are
+ *      found, so processing of the first files may begin while the rest of
+ *      the directory tree is still being walked.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+// Function called for each file found (returns false to stop enumerating)
+using FileHandler = std::function<bool(const std::wstring &filename,
+                                       std::uint64_t file_size,
+                                       std::uint64_t last_write_time)>;
+
+/*
+ *  EnumerateDirectory()
+ *
+ *  Description:
+ *      Recursively enumerate the files within the given directory, calling
+ *      the file handler for each file found.
+ *
+ *  Parameters:
+ *      directory [in]
+ *          The directory to enumerate.
+ *
+ *      file_handler [in]
+ *          The function to call for each file found.  It is given the full
+ *          path of the file, its size in octets, and its last write time as
+ *          a FILETIME value.
+ *
+ *      failed_directory [out]
+ *          The directory that could not be read if an error is returned.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if all files were enumerated, ERROR_CANCELLED if the
+ *      file handler stopped enumeration, or the Windows error code that
+ *      resulted from attempting to read a directory.
+ *
+ *  Comments:
+ *      Directories that are reparse points (e.g., junctions and symbolic
+ *      links) are not followed, as they may refer to a directory already
+ *      being enumerated.
+ */
+DWORD EnumerateDirectory(const std::wstring &directory,
+                         const FileHandler &file_handler,
+                         std::wstring &failed_directory);
@@ -0,0 +1,244 @@
+/*
+ *  gated_stream_buffer.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the GatedStreamBuffer class, a stream buffer that
+ *      forwards to another stream buffer once a gate function allows it.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include "pch.h"
+#include "gated_stream_buffer.h"
+
+/*
+ *  GatedStreamBuffer::GatedStreamBuffer()
+ *
+ *  Description:
+ *      Constructor for the GatedStreamBuffer object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer to which reads and writes are forwarded.
+ *
+ *      gate [in]
+ *          The function to call before the first character is transferred.
+ *          It returns true to allow the transfer or false to refuse it.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+GatedStreamBuffer::GatedStreamBuffer(std::streambuf *stream_buffer,
+                                     const std::function<bool()> &gate) :
+    stream_buffer{stream_buffer},
+    gate{gate},
+    gate_state{GateState::Closed}
+{
+}
+
+/*
+ *  GatedStreamBuffer::PassGate()
+ *
+ *  Description:
+ *      Call the gate function if it has not already been called.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if data may be transferred, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool GatedStreamBuffer::PassGate()
+{
+    if (gate_state == GateState::Closed)
+    {
+        gate_state = (!gate || gate()) ? GateState::Opened : GateState::Denied;
+    }
+
+    return gate_state == GateState::Opened;
+}
+
+/*
+ *  GatedStreamBuffer::underflow()
+ *
+ *  Description:
+ *      Return the next character from the underlying stream buffer without
+ *      consuming it.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character or traits_type::eof().
+ *
+ *  Comments:
+ *      None.
+ */
+GatedStreamBuffer::int_type GatedStreamBuffer::underflow()
+{
+    if (!PassGate()) return traits_type::eof();
+
+    return stream_buffer->sgetc();
+}
+
+/*
+ *  GatedStreamBuffer::uflow()
+ *
+ *  Description:
+ *      Return and consume the next character from the underlying stream
+ *      buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character or traits_type::eof().
+ *
+ *  Comments:
+ *      None.
+ */
+GatedStreamBuffer::int_type GatedStreamBuffer::uflow()
+{
+    if (!PassGate()) return traits_type::eof();
+
+    return stream_buffer->sbumpc();
+}
+
+/*
+ *  GatedStreamBuffer::xsgetn()
+ *
+ *  Description:
+ *      Read characters from the underlying stream buffer.
+ *
+ *  Parameters:
+ *      s [out]
+ *          The buffer into which characters are read.
+ *
+ *      count [in]
+ *          The number of characters to read.
+ *
+ *  Returns:
+ *      The number of characters read.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize GatedStreamBuffer::xsgetn(char *s, std::streamsize count)
+{
+    if (!PassGate()) return 0;
+
+    return stream_buffer->sgetn(s, count);
+}
+
+/*
+ *  GatedStreamBuffer::showmanyc()
+ *
+ *  Description:
+ *      Return the number of characters known to be available to read.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of characters available, 0 if unknown, or -1 if none.
+ *
+ *  Comments:
+ *      This does not pass the gate, as no data is transferred.
+ */
+std::streamsize GatedStreamBuffer::showmanyc()
+{
+    if (gate_state == GateState::Denied) return -1;
+
+    return stream_buffer->in_avail();
+}
+
+/*
+ *  GatedStreamBuffer::overflow()
+ *
+ *  Description:
+ *      Write a character to the underlying stream buffer.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to write or traits_type::eof() if none.
+ *
+ *  Returns:
+ *      A value other than traits_type::eof() on success, or
+ *      traits_type::eof() on error.
+ *
+ *  Comments:
+ *      None.
+ */
+GatedStreamBuffer::int_type GatedStreamBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    if (!PassGate()) return traits_type::eof();
+
+    return stream_buffer->sputc(traits_type::to_char_type(c));
+}
+
+/*
+ *  GatedStreamBuffer::xsputn()
+ *
+ *  Description:
+ *      Write characters to the underlying stream buffer.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters to write.
+ *
+ *      count [in]
+ *          The number of characters to write.
+ *
+ *  Returns:
+ *      The number of characters written.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize GatedStreamBuffer::xsputn(const char *s, std::streamsize count)
+{
+    if (!PassGate()) return 0;
+
+    return stream_buffer->sputn(s, count);
+}
+
+/*
+ *  GatedStreamBuffer::sync()
+ *
+ *  Description:
+ *      Flush the underlying stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      0 on success or -1 on error.
+ *
+ *  Comments:
+ *      This does not pass the gate, as no data is transferred.
+ */
+int GatedStreamBuffer::sync()
+{
+    if (gate_state == GateState::Denied) return -1;
+
+    return stream_buffer->pubsync();
+}
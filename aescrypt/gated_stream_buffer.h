@@ -0,0 +1,66 @@
+/*
+ *  gated_stream_buffer.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the GatedStreamBuffer class, a stream buffer that
+ *      forwards all reads and writes to another stream buffer, but calls a
+ *      "gate" function before the first character is transferred.  The gate
+ *      may block until the caller is allowed to proceed or refuse passage,
+ *      in which case the stream behaves as if an error occurred.
+ *
+ *      This is used to allow the AES Crypt Engine to perform key derivation
+ *      for a file while holding back the streaming of the file's contents
+ *      until other files finish streaming.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <streambuf>
+#include <functional>
+
+// Stream buffer that waits on a gate before the first character transfer
+class GatedStreamBuffer : public std::streambuf
+{
+    public:
+        GatedStreamBuffer(std::streambuf *stream_buffer,
+                          const std::function<bool()> &gate);
+        virtual ~GatedStreamBuffer() = default;
+
+        // Indicates whether the gate was passed (i.e., data was transferred)
+        bool WasOpened() const { return gate_state == GateState::Opened; }
+
+        // Indicates whether the gate refused passage
+        bool WasDenied() const { return gate_state == GateState::Denied; }
+
+    protected:
+        enum class GateState
+        {
+            Closed,
+            Opened,
+            Denied
+        };
+
+        bool PassGate();
+
+        int_type underflow() override;
+        int_type uflow() override;
+        std::streamsize xsgetn(char *s, std::streamsize count) override;
+        std::streamsize showmanyc() override;
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+        int sync() override;
+
+        std::streambuf *stream_buffer;
+        std::function<bool()> gate;
+        GateState gate_state;
+};
@@ -23,5 +23,8 @@
 // Number of KDF iterations to perform when deriving key from password
 constexpr std::uint32_t KDF_Iterations = 300'000;
 
-// Size in octets of buffer for file I/O
+// Default size in octets of buffer for file I/O
 constexpr std::size_t Buffered_IO_Size = 131'072;
+
+// Default number of file I/O buffers that may have I/O outstanding
+constexpr std::size_t IO_Queue_Depth = 4;
@@ -18,7 +18,6 @@
 
 #pragma once
 
-#include <filesystem>
 #include "has_aes_extension.h"
 
 /*
@@ -41,27 +40,49 @@
  */
 bool HasAESExtension(const std::wstring &filename)
 {
-    try
-    {
-        // Get the file extension from the filename
-        auto extension = std::filesystem::path(filename).extension().wstring();
+    return HasAESExtension(filename.data(), filename.length());
+}
+
+/*
+ *  HasAESExtension()
+ *
+ *  Description:
+ *      Returns true if the given filename ends with .aes or not.  This will
+ *      perform a case insensitive comparison.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The filename to check for a .aes extension.  This may be a complete
+ *          pathname and need not be null terminated.
+ *
+ *      length [in]
+ *          The length of the filename in characters.
+ *
+ *  Returns:
+ *      True if the file ends in .aes and false otherwise.
+ *
+ *  Comments:
+ *      A name consisting only of ".aes" (e.g., "C:\.aes") has no extension,
+ *      consistent with how std::filesystem::path treats such names.
+ */
+bool HasAESExtension(const wchar_t *filename, std::size_t length)
+{
+    // There must be at least one character preceding the extension
+    if (length < 5) return false;
 
-        // If the extension is not exactly 4 characters (.aes), return false
-        if (extension.length() != 4) return false;
+    const wchar_t *extension = filename + length - 4;
 
-        // Compare each of the last 4 characters looking for .aes
-        if ((extension[0] == L'.') &&
-            ((extension[1] == L'a') || (extension[1] == L'A')) &&
-            ((extension[2] == L'e') || (extension[2] == L'E')) &&
-            ((extension[3] == L's') || (extension[3] == L'S')))
-        {
-            return true;
-        }
-    }
-    catch (...)
+    // The extension must not be the entire final path component
+    if ((extension[-1] == L'\\') ||
+        (extension[-1] == L'/') ||
+        (extension[-1] == L':'))
     {
-        // Nothing to do; failure assumes false
+        return false;
     }
 
-    return false;
+    // Compare each of the last 4 characters looking for .aes
+    return (extension[0] == L'.') &&
+           ((extension[1] == L'a') || (extension[1] == L'A')) &&
+           ((extension[2] == L'e') || (extension[2] == L'E')) &&
+           ((extension[3] == L's') || (extension[3] == L'S'));
 }
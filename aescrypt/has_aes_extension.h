@@ -19,6 +19,7 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
 
 /*
  *  HasAESExtension()
@@ -39,3 +40,27 @@
  *      None.
  */
 bool HasAESExtension(const std::wstring &filename);
+
+/*
+ *  HasAESExtension()
+ *
+ *  Description:
+ *      Returns true if the given filename ends with .aes or not.  This will
+ *      perform a case insensitive comparison.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The filename to check for a .aes extension.  This may be a complete
+ *          pathname and need not be null terminated.
+ *
+ *      length [in]
+ *          The length of the filename in characters.
+ *
+ *  Returns:
+ *      True if the file ends in .aes and false otherwise.
+ *
+ *  Comments:
+ *      This does not allocate memory, so it is suitable for checking a
+ *      large number of names quickly.
+ */
+bool HasAESExtension(const wchar_t *filename, std::size_t length);
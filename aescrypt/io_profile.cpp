@@ -0,0 +1,270 @@
+/*
+ *  io_profile.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the function that selects the I/O buffer size
+ *      and queue depth to use for files on a given volume.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <winioctl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include "io_profile.h"
+#include "settings.h"
+#include "globals.h"
+
+namespace
+{
+
+// Transfer size for network volumes, where latency dominates
+constexpr std::size_t Remote_IO_Size = 1024 * 1024;
+
+// Transfer size for local storage that incurs a seek penalty
+constexpr std::size_t Rotational_IO_Size = 512 * 1024;
+
+// Limits on the transfer size (including any registry override)
+constexpr std::size_t Minimum_IO_Size = 64 * 1024;
+constexpr std::size_t Maximum_IO_Size = 16 * 1024 * 1024;
+
+// Profiles cached by volume serial number
+std::mutex Profile_Mutex;
+std::map<DWORD, IOProfile> Profile_Cache;
+
+/*
+ *  IsRemoteFile()
+ *
+ *  Description:
+ *      Determine whether the given file is accessed via a network protocol.
+ *
+ *  Parameters:
+ *      file_handle [in]
+ *          A handle to the open file.
+ *
+ *  Returns:
+ *      True if the file is on a remote volume, false otherwise.
+ *
+ *  Comments:
+ *      Remote protocol information is only available for remote files.
+ */
+bool IsRemoteFile(HANDLE file_handle)
+{
+    FILE_REMOTE_PROTOCOL_INFO protocol_info{};
+
+    return ::GetFileInformationByHandleEx(file_handle,
+                                          FileRemoteProtocolInfo,
+                                          &protocol_info,
+                                          sizeof(protocol_info)) != FALSE;
+}
+
+/*
+ *  IncursSeekPenalty()
+ *
+ *  Description:
+ *      Determine whether the storage device holding the given file incurs
+ *      a seek penalty (i.e., is a rotational disk).
+ *
+ *  Parameters:
+ *      file_handle [in]
+ *          A handle to the open file.
+ *
+ *  Returns:
+ *      True if the device is known to incur a seek penalty, false if it
+ *      does not or if this could not be determined.
+ *
+ *  Comments:
+ *      The volume is opened without any access rights, which is sufficient
+ *      to query device properties and does not require elevation.
+ */
+bool IncursSeekPenalty(HANDLE file_handle)
+{
+    std::wstring path(MAX_PATH, L'\0');
+
+    // Get the path of the file in the form \\?\Volume{GUID}\...
+    DWORD length = ::GetFinalPathNameByHandle(file_handle,
+                                              path.data(),
+                                              static_cast<DWORD>(path.size()),
+                                              VOLUME_NAME_GUID);
+    if (length >= path.size())
+    {
+        path.resize(length + 1);
+        length = ::GetFinalPathNameByHandle(file_handle,
+                                            path.data(),
+                                            static_cast<DWORD>(path.size()),
+                                            VOLUME_NAME_GUID);
+    }
+    if ((length == 0) || (length >= path.size())) return false;
+    path.resize(length);
+
+    // Isolate the volume name (without a trailing backslash)
+    auto separator = path.find(L'\\', 4);
+    if (separator == std::wstring::npos) return false;
+    path.resize(separator);
+
+    HANDLE volume_handle = ::CreateFile(path.c_str(),
+                                        0,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        nullptr,
+                                        OPEN_EXISTING,
+                                        0,
+                                        nullptr);
+    if (volume_handle == INVALID_HANDLE_VALUE) return false;
+
+    STORAGE_PROPERTY_QUERY query{};
+    DEVICE_SEEK_PENALTY_DESCRIPTOR descriptor{};
+    DWORD returned{};
+
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+
+    BOOL result = ::DeviceIoControl(volume_handle,
+                                    IOCTL_STORAGE_QUERY_PROPERTY,
+                                    &query,
+                                    sizeof(query),
+                                    &descriptor,
+                                    sizeof(descriptor),
+                                    &returned,
+                                    nullptr);
+
+    ::CloseHandle(volume_handle);
+
+    if (!result || (returned < sizeof(descriptor))) return false;
+
+    return descriptor.IncursSeekPenalty != FALSE;
+}
+
+/*
+ *  SelectIOProfile()
+ *
+ *  Description:
+ *      Select the I/O profile for the volume holding the given file based
+ *      on the characteristics of the volume and storage device.
+ *
+ *  Parameters:
+ *      file_handle [in]
+ *          A handle to the open file.
+ *
+ *  Returns:
+ *      The I/O profile for the volume.
+ *
+ *  Comments:
+ *      None.
+ */
+IOProfile SelectIOProfile(HANDLE file_handle)
+{
+    IOProfile profile{Buffered_IO_Size, IO_Queue_Depth};
+    FILE_STORAGE_INFO storage_info{};
+
+    if (IsRemoteFile(file_handle))
+    {
+        profile.buffer_size = Remote_IO_Size;
+    }
+    else if (IncursSeekPenalty(file_handle))
+    {
+        profile.buffer_size = Rotational_IO_Size;
+    }
+
+    // Ensure the transfer size is a multiple of the sector size that
+    // provides the best performance
+    if (::GetFileInformationByHandleEx(file_handle,
+                                       FileStorageInfo,
+                                       &storage_info,
+                                       sizeof(storage_info)))
+    {
+        std::size_t sector_size =
+            storage_info.PhysicalBytesPerSectorForPerformance;
+        if ((sector_size > 0) && ((profile.buffer_size % sector_size) != 0))
+        {
+            profile.buffer_size =
+                ((profile.buffer_size / sector_size) + 1) * sector_size;
+        }
+    }
+
+    return profile;
+}
+
+} // namespace
+
+/*
+ *  GetIOProfile()
+ *
+ *  Description:
+ *      Determine the I/O profile to use for the volume on which the given
+ *      file resides.  The profile is selected based on whether the volume
+ *      is remote, whether the storage device incurs a seek penalty, and the
+ *      volume's sector size.  The result is cached per volume.
+ *
+ *  Parameters:
+ *      file_handle [in]
+ *          A handle to an open file on the volume.
+ *
+ *  Returns:
+ *      The I/O profile for the volume.
+ *
+ *  Comments:
+ *      The profile for a volume may be overridden by creating the registry
+ *      key "IOProfiles\XXXXXXXX" under the AES Crypt settings key, where
+ *      XXXXXXXX is the volume serial number in hexadecimal, and setting the
+ *      DWORD values "BufferSize" (in KiB) and/or "QueueDepth".
+ */
+IOProfile GetIOProfile(HANDLE file_handle)
+{
+    DWORD serial_number{};
+
+    // Without a volume serial number, the profile cannot be cached
+    if (!::GetVolumeInformationByHandleW(file_handle,
+                                         nullptr,
+                                         0,
+                                         &serial_number,
+                                         nullptr,
+                                         nullptr,
+                                         nullptr,
+                                         0))
+    {
+        return SelectIOProfile(file_handle);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(Profile_Mutex);
+
+        auto it = Profile_Cache.find(serial_number);
+        if (it != Profile_Cache.end()) return it->second;
+    }
+
+    IOProfile profile = SelectIOProfile(file_handle);
+
+    // Apply any override configured for this volume
+    wchar_t subkey[32];
+    std::swprintf(subkey,
+                  sizeof(subkey) / sizeof(wchar_t),
+                  L"IOProfiles\\%08X",
+                  static_cast<unsigned>(serial_number));
+    DWORD buffer_size = ReadSetting(L"BufferSize", 0, subkey);
+    DWORD queue_depth = ReadSetting(L"QueueDepth", 0, subkey);
+    if (buffer_size > 0)
+    {
+        profile.buffer_size =
+            std::clamp(static_cast<std::size_t>(buffer_size) * 1024,
+                       Minimum_IO_Size,
+                       Maximum_IO_Size);
+    }
+    if (queue_depth > 0) profile.queue_depth = queue_depth;
+
+    std::lock_guard<std::mutex> lock(Profile_Mutex);
+    Profile_Cache[serial_number] = profile;
+
+    return profile;
+}
@@ -0,0 +1,58 @@
+/*
+ *  io_profile.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the IOProfile structure and a function to select
+ *      the I/O buffer size and queue depth to use for files on a given
+ *      volume.  Network volumes benefit from large transfers, while local
+ *      solid state storage performs well with smaller transfers.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+
+// Structure holding the I/O parameters to use for a volume
+struct IOProfile
+{
+    // Size of each I/O request in octets
+    std::size_t buffer_size;
+
+    // Number of I/O requests to keep outstanding per file
+    std::size_t queue_depth;
+};
+
+/*
+ *  GetIOProfile()
+ *
+ *  Description:
+ *      Determine the I/O profile to use for the volume on which the given
+ *      file resides.  The profile is selected based on whether the volume
+ *      is remote, whether the storage device incurs a seek penalty, and the
+ *      volume's sector size.  The result is cached per volume.
+ *
+ *  Parameters:
+ *      file_handle [in]
+ *          A handle to an open file on the volume.
+ *
+ *  Returns:
+ *      The I/O profile for the volume.
+ *
+ *  Comments:
+ *      The profile for a volume may be overridden by creating the registry
+ *      key "IOProfiles\XXXXXXXX" under the AES Crypt settings key, where
+ *      XXXXXXXX is the volume serial number in hexadecimal, and setting the
+ *      DWORD values "BufferSize" (in KiB) and/or "QueueDepth".
+ */
+IOProfile GetIOProfile(HANDLE file_handle);
@@ -0,0 +1,459 @@
+/*
+ *  mapped_file_reader.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the MappedFileReader class, a stream buffer that
+ *      reads a file through a sliding window mapped into memory.  Data is
+ *      copied directly from the mapped view into the caller's buffer.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include "mapped_file_reader.h"
+
+namespace
+{
+
+/*
+ *  CopyMappedMemory()
+ *
+ *  Description:
+ *      Copy memory from a mapped view of a file.  If the underlying read
+ *      from the file fails (e.g., a device error or the file was truncated
+ *      by another process), the resulting in-page exception is caught and
+ *      returned as an error rather than terminating the process.
+ *
+ *  Parameters:
+ *      destination [out]
+ *          The buffer into which to copy the data.
+ *
+ *      source [in]
+ *          The location within the mapped view from which to copy data.
+ *
+ *      length [in]
+ *          The number of octets to copy.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the data was copied, else ERROR_READ_FAULT.
+ *
+ *  Comments:
+ *      This function must not contain objects requiring unwinding, since
+ *      it uses structured exception handling.
+ */
+DWORD CopyMappedMemory(char *destination,
+                       const char *source,
+                       std::size_t length)
+{
+    __try
+    {
+        std::memcpy(destination, source, length);
+    }
+    __except ((GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR) ?
+                  EXCEPTION_EXECUTE_HANDLER :
+                  EXCEPTION_CONTINUE_SEARCH)
+    {
+        return ERROR_READ_FAULT;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+} // namespace
+
+/*
+ *  MappedFileReader::MappedFileReader()
+ *
+ *  Description:
+ *      Constructor for the MappedFileReader object.
+ *
+ *  Parameters:
+ *      window_size [in]
+ *          The size of the file window to map into memory at one time.
+ *          This is rounded to a multiple of the allocation granularity.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+MappedFileReader::MappedFileReader(std::size_t window_size) :
+    file_handle{INVALID_HANDLE_VALUE},
+    mapping_handle{nullptr},
+    window_size{window_size},
+    file_size{0},
+    position{0},
+    view_offset{0},
+    view_length{0},
+    view{nullptr},
+    peek_buffer{0},
+    io_error{ERROR_SUCCESS}
+{
+}
+
+/*
+ *  MappedFileReader::~MappedFileReader()
+ *
+ *  Description:
+ *      Destructor for the MappedFileReader object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+MappedFileReader::~MappedFileReader()
+{
+    Close();
+}
+
+/*
+ *  MappedFileReader::Open()
+ *
+ *  Description:
+ *      Open the specified file for reading and create a file mapping
+ *      object from which views will be mapped.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD MappedFileReader::Open(const std::wstring &filename)
+{
+    SYSTEM_INFO system_info{};
+    LARGE_INTEGER size{};
+
+    // Views must start on a multiple of the allocation granularity
+    ::GetSystemInfo(&system_info);
+    std::size_t granularity = system_info.dwAllocationGranularity;
+    if (granularity == 0) granularity = 65'536;
+    window_size =
+        std::max(granularity, window_size - (window_size % granularity));
+
+    file_handle = ::CreateFile(filename.c_str(),
+                               GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE,
+                               nullptr,
+                               OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL |
+                                   FILE_FLAG_SEQUENTIAL_SCAN,
+                               nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) return ::GetLastError();
+
+    if (!::GetFileSizeEx(file_handle, &size))
+    {
+        DWORD error = ::GetLastError();
+        Close();
+        return error;
+    }
+
+    file_size = static_cast<std::uint64_t>(size.QuadPart);
+    position = 0;
+    io_error = ERROR_SUCCESS;
+    setg(nullptr, nullptr, nullptr);
+
+    // An empty file cannot be mapped, but there is nothing to read anyway
+    if (file_size == 0) return ERROR_SUCCESS;
+
+    mapping_handle = ::CreateFileMapping(file_handle,
+                                         nullptr,
+                                         PAGE_READONLY,
+                                         0,
+                                         0,
+                                         nullptr);
+    if (mapping_handle == nullptr)
+    {
+        DWORD error = ::GetLastError();
+        Close();
+        return error;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  MappedFileReader::Close()
+ *
+ *  Description:
+ *      Unmap any mapped view and close the file.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void MappedFileReader::Close()
+{
+    UnmapWindow();
+
+    if (mapping_handle != nullptr)
+    {
+        ::CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+
+    if (file_handle != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(file_handle);
+        file_handle = INVALID_HANDLE_VALUE;
+    }
+
+    setg(nullptr, nullptr, nullptr);
+}
+
+/*
+ *  MappedFileReader::MapWindow()
+ *
+ *  Description:
+ *      Ensure the mapped view contains the current read position, mapping
+ *      the next window of the file if it does not.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the current position is within the mapped view, false if
+ *      the view could not be mapped.
+ *
+ *  Comments:
+ *      The memory manager is asked to read in the whole window at once,
+ *      so the read proceeds while data is being consumed from the window.
+ */
+bool MappedFileReader::MapWindow()
+{
+    if ((view != nullptr) && (position >= view_offset) &&
+        (position < view_offset + view_length))
+    {
+        return true;
+    }
+
+    UnmapWindow();
+
+    std::uint64_t offset = position - (position % window_size);
+    std::size_t length = static_cast<std::size_t>(
+        std::min(static_cast<std::uint64_t>(window_size), file_size - offset));
+
+    view = static_cast<const char *>(
+        ::MapViewOfFile(mapping_handle,
+                        FILE_MAP_READ,
+                        static_cast<DWORD>(offset >> 32),
+                        static_cast<DWORD>(offset & 0xffffffff),
+                        length));
+    if (view == nullptr)
+    {
+        io_error = ::GetLastError();
+        return false;
+    }
+
+    view_offset = offset;
+    view_length = length;
+
+    // Start reading the window in; failure here is not an error
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<char *>(view), view_length};
+    ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+
+    return true;
+}
+
+/*
+ *  MappedFileReader::UnmapWindow()
+ *
+ *  Description:
+ *      Unmap the currently mapped view, if any.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void MappedFileReader::UnmapWindow()
+{
+    if (view != nullptr)
+    {
+        ::UnmapViewOfFile(view);
+        view = nullptr;
+    }
+
+    view_offset = 0;
+    view_length = 0;
+}
+
+/*
+ *  MappedFileReader::underflow()
+ *
+ *  Description:
+ *      Called when a single character is requested and the get area is
+ *      empty.  The character is copied into a one-octet get area.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character in the stream or traits_type::eof() at the end
+ *      of the file or on error.
+ *
+ *  Comments:
+ *      The mapped view itself is never exposed as the get area, since all
+ *      access to the view must be protected against in-page errors.
+ */
+MappedFileReader::int_type MappedFileReader::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    if ((position >= file_size) || !MapWindow()) return traits_type::eof();
+
+    DWORD error = CopyMappedMemory(&peek_buffer,
+                                   view + (position - view_offset),
+                                   1);
+    if (error != ERROR_SUCCESS)
+    {
+        io_error = error;
+        return traits_type::eof();
+    }
+
+    position++;
+    setg(&peek_buffer, &peek_buffer, &peek_buffer + 1);
+
+    return traits_type::to_int_type(peek_buffer);
+}
+
+/*
+ *  MappedFileReader::xsgetn()
+ *
+ *  Description:
+ *      Read the requested number of characters, copying directly from the
+ *      mapped view into the caller's buffer.
+ *
+ *  Parameters:
+ *      s [out]
+ *          The buffer into which characters are read.
+ *
+ *      count [in]
+ *          The number of characters to read.
+ *
+ *  Returns:
+ *      The number of characters read, which is less than the number
+ *      requested only at the end of the file or on error.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize MappedFileReader::xsgetn(char *s, std::streamsize count)
+{
+    std::streamsize total = 0;
+
+    // Deliver any character already placed in the get area
+    while ((total < count) && (gptr() < egptr()))
+    {
+        s[total++] = *gptr();
+        gbump(1);
+    }
+
+    while ((total < count) && (position < file_size))
+    {
+        if (!MapWindow()) break;
+
+        std::size_t view_position =
+            static_cast<std::size_t>(position - view_offset);
+        std::size_t length =
+            std::min(view_length - view_position,
+                     static_cast<std::size_t>(count - total));
+
+        DWORD error = CopyMappedMemory(s + total, view + view_position, length);
+        if (error != ERROR_SUCCESS)
+        {
+            io_error = error;
+            break;
+        }
+
+        total += static_cast<std::streamsize>(length);
+        position += length;
+    }
+
+    return total;
+}
+
+/*
+ *  MappedFileReader::showmanyc()
+ *
+ *  Description:
+ *      Return the number of characters remaining in the file.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of characters remaining or -1 at the end of the file.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize MappedFileReader::showmanyc()
+{
+    if (position >= file_size) return -1;
+
+    return static_cast<std::streamsize>(file_size - position);
+}
+
+/*
+ *  IsLocalFixedVolume()
+ *
+ *  Description:
+ *      Determine whether the given file resides on a local fixed volume
+ *      (i.e., not a network share or removable media).
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to check.
+ *
+ *  Returns:
+ *      True if the file is on a local fixed volume, false otherwise or if
+ *      the volume type cannot be determined.
+ *
+ *  Comments:
+ *      None.
+ */
+bool IsLocalFixedVolume(const std::wstring &filename)
+{
+    std::wstring volume_path(filename.size() + MAX_PATH, L'\0');
+
+    if (!::GetVolumePathName(filename.c_str(),
+                             volume_path.data(),
+                             static_cast<DWORD>(volume_path.size())))
+    {
+        return false;
+    }
+    volume_path.resize(std::wcslen(volume_path.c_str()));
+
+    return ::GetDriveType(volume_path.c_str()) == DRIVE_FIXED;
+}
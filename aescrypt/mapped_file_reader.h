@@ -0,0 +1,83 @@
+/*
+ *  mapped_file_reader.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the MappedFileReader class, a stream buffer that
+ *      reads a file through a window mapped into memory with MapViewOfFile().
+ *      The window slides forward through the file as data is consumed,
+ *      avoiding the copy from the system cache into an I/O buffer.  This is
+ *      intended for large files on local volumes.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <streambuf>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Size of the file window mapped into memory at one time
+constexpr std::size_t Mapped_Window_Size = 64 * 1024 * 1024;
+
+// Stream buffer that reads a file via a sliding memory-mapped window
+class MappedFileReader : public std::streambuf
+{
+    public:
+        MappedFileReader(std::size_t window_size = Mapped_Window_Size);
+        virtual ~MappedFileReader();
+
+        DWORD Open(const std::wstring &filename);
+        void Close();
+
+        bool IsOpen() const { return file_handle != INVALID_HANDLE_VALUE; }
+        DWORD GetError() const { return io_error; }
+
+    protected:
+        int_type underflow() override;
+        std::streamsize xsgetn(char *s, std::streamsize count) override;
+        std::streamsize showmanyc() override;
+        bool MapWindow();
+        void UnmapWindow();
+
+        HANDLE file_handle;
+        HANDLE mapping_handle;
+        std::size_t window_size;
+        std::uint64_t file_size;
+        std::uint64_t position;
+        std::uint64_t view_offset;
+        std::size_t view_length;
+        const char *view;
+        char peek_buffer;
+        DWORD io_error;
+};
+
+/*
+ *  IsLocalFixedVolume()
+ *
+ *  Description:
+ *      Determine whether the given file resides on a local fixed volume
+ *      (i.e., not a network share or removable media).
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to check.
+ *
+ *  Returns:
+ *      True if the file is on a local fixed volume, false otherwise or if
+ *      the volume type cannot be determined.
+ *
+ *  Comments:
+ *      None.
+ */
+bool IsLocalFixedVolume(const std::wstring &filename);
@@ -0,0 +1,257 @@
+/*
+ *  memory_budget.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the MemoryBudget class.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include "memory_budget.h"
+#include "trace_provider.h"
+
+namespace
+{
+
+/*
+ *  TraceUsage()
+ *
+ *  Description:
+ *      Write a trace event giving the current and peak memory usage.
+ *
+ *  Parameters:
+ *      event_name [in]
+ *          The name of the change, which must be a string constant.
+ *
+ *      usage [in]
+ *          The number of octets reserved following the change.
+ *
+ *      peak [in]
+ *          The peak number of octets reserved.
+ *
+ *      limit [in]
+ *          The limit in octets (zero if there is no limit).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void TraceUsage(const char *event_name,
+                std::uint64_t usage,
+                std::uint64_t peak,
+                std::uint64_t limit)
+{
+    TraceLoggingWrite(AES_Crypt_Trace_Provider,
+                      "MemoryBudget",
+                      TraceLoggingString(event_name, "Change"),
+                      TraceLoggingUInt64(usage, "Usage"),
+                      TraceLoggingUInt64(peak, "Peak"),
+                      TraceLoggingUInt64(limit, "Limit"));
+}
+
+} // namespace
+
+/*
+ *  MemoryBudget::MemoryBudget()
+ *
+ *  Description:
+ *      Constructor for the MemoryBudget object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      No limit is imposed until Configure() is called.
+ */
+MemoryBudget::MemoryBudget() :
+    limit{},
+    usage{},
+    peak{}
+{
+}
+
+/*
+ *  MemoryBudget::Configure()
+ *
+ *  Description:
+ *      Set the number of octets that may be reserved by all streams.
+ *
+ *  Parameters:
+ *      limit [in]
+ *          The limit in octets, or zero to impose no limit.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Memory already reserved is unaffected by a lower limit, but no
+ *      further streams are admitted until usage falls below it.
+ */
+void MemoryBudget::Configure(std::uint64_t limit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->limit = limit;
+}
+
+/*
+ *  MemoryBudget::Reserve()
+ *
+ *  Description:
+ *      Reserve memory for a stream if it fits within the limit.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets the stream will use.
+ *
+ *      required [in]
+ *          True if the memory is reserved even if it exceeds the limit.
+ *          This allows a batch having no streams to make progress.
+ *
+ *  Returns:
+ *      True if the memory was reserved, false if it does not fit.
+ *
+ *  Comments:
+ *      None.
+ */
+bool MemoryBudget::Reserve(std::uint64_t octets, bool required)
+{
+    std::uint64_t current_usage;
+    std::uint64_t current_peak;
+    std::uint64_t current_limit;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!required && (limit > 0) && (usage + octets > limit))
+        {
+            return false;
+        }
+
+        usage += octets;
+        peak = std::max(peak, usage);
+        current_usage = usage;
+        current_peak = peak;
+        current_limit = limit;
+    }
+
+    TraceUsage("Reserved", current_usage, current_peak, current_limit);
+
+    return true;
+}
+
+/*
+ *  MemoryBudget::Release()
+ *
+ *  Description:
+ *      Release memory previously reserved by calling Reserve().
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets reserved.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void MemoryBudget::Release(std::uint64_t octets)
+{
+    std::uint64_t current_usage;
+    std::uint64_t current_peak;
+    std::uint64_t current_limit;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        usage -= std::min(usage, octets);
+        current_usage = usage;
+        current_peak = peak;
+        current_limit = limit;
+    }
+
+    TraceUsage("Released", current_usage, current_peak, current_limit);
+}
+
+/*
+ *  MemoryBudget::GetUsage()
+ *
+ *  Description:
+ *      Return the number of octets currently reserved.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of octets reserved.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t MemoryBudget::GetUsage()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return usage;
+}
+
+/*
+ *  MemoryBudget::GetPeak()
+ *
+ *  Description:
+ *      Return the largest number of octets reserved at once since the
+ *      process started.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The peak number of octets reserved.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t MemoryBudget::GetPeak()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return peak;
+}
+
+/*
+ *  GetMemoryBudget()
+ *
+ *  Description:
+ *      Return the memory budget shared by all batches in the process.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      A reference to the memory budget.
+ *
+ *  Comments:
+ *      The budget is created on first use.
+ */
+MemoryBudget &GetMemoryBudget()
+{
+    static MemoryBudget memory_budget;
+
+    return memory_budget;
+}
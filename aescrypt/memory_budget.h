@@ -0,0 +1,61 @@
+/*
+ *  memory_budget.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the MemoryBudget class, which accounts for the
+ *      memory used by the files being streamed by all batches in the
+ *      process.  Before a file begins to stream, the memory it will use
+ *      (its I/O buffers, pipeline ring, compression buffers, and the
+ *      engine's working memory) is reserved against the budget; a file
+ *      that does not fit waits until other files complete, so that a busy
+ *      system processes fewer files at once rather than paging.  The
+ *      current and peak usage are written as trace events.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <cstdint>
+
+// Estimate of the memory used by the AES Crypt Engine for each stream
+constexpr std::uint64_t Engine_Stream_Memory = 262'144;
+
+// Class accounting for the memory used by streaming files
+class MemoryBudget
+{
+    public:
+        MemoryBudget();
+        ~MemoryBudget() = default;
+
+        // Set the limit in octets (zero imposes no limit)
+        void Configure(std::uint64_t limit);
+
+        // Reserve memory for a stream, even beyond the limit if required
+        bool Reserve(std::uint64_t octets, bool required);
+
+        // Release memory reserved for a stream
+        void Release(std::uint64_t octets);
+
+        // Octets currently reserved and the most ever reserved at once
+        std::uint64_t GetUsage();
+        std::uint64_t GetPeak();
+
+    protected:
+        std::mutex mutex;
+        std::uint64_t limit;
+        std::uint64_t usage;
+        std::uint64_t peak;
+};
+
+// Return the memory budget shared by all batches in the process
+MemoryBudget &GetMemoryBudget();
@@ -0,0 +1,1051 @@
+/*
+ *  overlapped_file.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements stream buffer classes that read and write files
+ *      using overlapped Win32 I/O.  Reads are issued ahead of the position
+ *      being consumed and writes are issued behind the position being
+ *      produced so that disk I/O overlaps the cryptographic work.  When
+ *      requested and supported by the volume, the file is opened with
+ *      FILE_FLAG_NO_BUFFERING so that data moves directly between the
+ *      device and the buffers, bypassing the system file cache.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <cstring>
+#include "overlapped_file.h"
+#include "io_profile.h"
+#include "buffer_pool.h"
+#include "globals.h"
+
+/*
+ *  OverlappedStreamBuffer::OverlappedStreamBuffer()
+ *
+ *  Description:
+ *      Constructor for the OverlappedStreamBuffer object.
+ *
+ *  Parameters:
+ *      buffer_size [in]
+ *          The size of each buffer in the ring.  This should be a multiple
+ *          of the system page size so that unbuffered I/O may be used.  If
+ *          zero, the size is selected based on the file's volume.
+ *
+ *      queue_depth [in]
+ *          The number of buffers in the ring (i.e., the number of I/O
+ *          operations that may be outstanding at once).  If zero, the
+ *          depth is selected based on the file's volume.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedStreamBuffer::OverlappedStreamBuffer(std::size_t buffer_size,
+                                               std::size_t queue_depth) :
+    file_handle{INVALID_HANDLE_VALUE},
+    requested_buffer_size{buffer_size},
+    requested_queue_depth{queue_depth},
+    buffer_size{0},
+    queue_depth{0},
+    current_slot{0},
+    next_offset{0},
+    disk_file{false},
+    unbuffered_io{false},
+    sector_size{0},
+    io_error{ERROR_SUCCESS}
+{
+}
+
+/*
+ *  OverlappedStreamBuffer::~OverlappedStreamBuffer()
+ *
+ *  Description:
+ *      Destructor for the OverlappedStreamBuffer object.  Any outstanding
+ *      I/O is cancelled and the file is closed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedStreamBuffer::~OverlappedStreamBuffer()
+{
+    CancelPending();
+    CloseFileHandle();
+    FreeSlots();
+}
+
+/*
+ *  OverlappedStreamBuffer::OpenHandle()
+ *
+ *  Description:
+ *      Open the specified file for overlapped I/O and allocate the ring of
+ *      buffers used to perform I/O.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open.
+ *
+ *      desired_access [in]
+ *          The access requested (GENERIC_READ or GENERIC_WRITE).
+ *
+ *      share_mode [in]
+ *          The sharing mode to pass to CreateFile().
+ *
+ *      creation_disposition [in]
+ *          The creation disposition to pass to CreateFile().
+ *
+ *      flags [in]
+ *          Additional flags to pass to CreateFile().
+ *
+ *      unbuffered [in]
+ *          True if the file should be opened with FILE_FLAG_NO_BUFFERING.
+ *          Unbuffered I/O is used only if the file is a disk file and the
+ *          sector size of the volume is compatible with the buffer size.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD OverlappedStreamBuffer::OpenHandle(const std::wstring &filename,
+                                         DWORD desired_access,
+                                         DWORD share_mode,
+                                         DWORD creation_disposition,
+                                         DWORD flags,
+                                         bool unbuffered)
+{
+    DWORD open_flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | flags;
+
+    // Open the file, first trying unbuffered I/O if requested
+    if (unbuffered)
+    {
+        file_handle = ::CreateFile(filename.c_str(),
+                                   desired_access,
+                                   share_mode,
+                                   nullptr,
+                                   creation_disposition,
+                                   open_flags | FILE_FLAG_NO_BUFFERING,
+                                   nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) return ::GetLastError();
+
+        // Determine the buffer size, which unbuffered I/O must align with
+        ApplyIOProfile();
+
+        // Unbuffered I/O requires the buffer size to be sector aligned
+        FILE_STORAGE_INFO storage_info{};
+        if ((::GetFileType(file_handle) == FILE_TYPE_DISK) &&
+            ::GetFileInformationByHandleEx(file_handle,
+                                           FileStorageInfo,
+                                           &storage_info,
+                                           sizeof(storage_info)) &&
+            (storage_info.LogicalBytesPerSector > 0) &&
+            ((buffer_size % storage_info.LogicalBytesPerSector) == 0))
+        {
+            unbuffered_io = true;
+            sector_size = storage_info.LogicalBytesPerSector;
+        }
+        else
+        {
+            // Re-open the file below without FILE_FLAG_NO_BUFFERING
+            ::CloseHandle(file_handle);
+            file_handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        file_handle = ::CreateFile(filename.c_str(),
+                                   desired_access,
+                                   share_mode,
+                                   nullptr,
+                                   creation_disposition,
+                                   open_flags,
+                                   nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) return ::GetLastError();
+
+        ApplyIOProfile();
+    }
+
+    // Only disk files support multiple outstanding I/O requests at offsets
+    disk_file = (::GetFileType(file_handle) == FILE_TYPE_DISK);
+    if (!disk_file) queue_depth = 1;
+
+    // Allocate the buffers used for I/O
+    DWORD error = AllocateSlots();
+    if (error != ERROR_SUCCESS)
+    {
+        FreeSlots();
+        CloseFileHandle();
+        return error;
+    }
+
+    current_slot = 0;
+    next_offset = 0;
+    io_error = ERROR_SUCCESS;
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  OverlappedStreamBuffer::ApplyIOProfile()
+ *
+ *  Description:
+ *      Determine the buffer size and queue depth to use for the open file.
+ *      Values given to the constructor are used as specified, while those
+ *      given as zero are taken from the I/O profile of the file's volume.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void OverlappedStreamBuffer::ApplyIOProfile()
+{
+    IOProfile profile{Buffered_IO_Size, 1};
+
+    // Only disk files have a volume from which to select a profile
+    if (((requested_buffer_size == 0) || (requested_queue_depth == 0)) &&
+        (::GetFileType(file_handle) == FILE_TYPE_DISK))
+    {
+        profile = GetIOProfile(file_handle);
+    }
+
+    buffer_size = (requested_buffer_size > 0) ? requested_buffer_size :
+                                                profile.buffer_size;
+    queue_depth = (requested_queue_depth > 0) ? requested_queue_depth :
+                                                profile.queue_depth;
+}
+
+/*
+ *  OverlappedStreamBuffer::AllocateSlots()
+ *
+ *  Description:
+ *      Allocate the ring of buffers and the events used to signal I/O
+ *      completion.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the buffers were allocated, else the Windows
+ *      error code.
+ *
+ *  Comments:
+ *      Buffers are taken from the buffer pool, which provides page-aligned
+ *      buffers as is required for unbuffered I/O.
+ */
+DWORD OverlappedStreamBuffer::AllocateSlots()
+{
+    slots.resize(queue_depth);
+
+    for (auto &slot : slots)
+    {
+        slot = IOSlot{};
+        slot.buffer = GetBufferPool().Acquire(buffer_size);
+        if (slot.buffer == nullptr) return ::GetLastError();
+
+        slot.overlapped.hEvent =
+            ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (slot.overlapped.hEvent == nullptr) return ::GetLastError();
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  OverlappedStreamBuffer::FreeSlots()
+ *
+ *  Description:
+ *      Return the ring of buffers to the buffer pool, which erases their
+ *      contents since they may have held plaintext.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      There must be no outstanding I/O when this function is called.
+ */
+void OverlappedStreamBuffer::FreeSlots()
+{
+    for (auto &slot : slots)
+    {
+        if (slot.buffer != nullptr)
+        {
+            GetBufferPool().Release(slot.buffer, buffer_size);
+            slot.buffer = nullptr;
+        }
+        if (slot.overlapped.hEvent != nullptr)
+        {
+            ::CloseHandle(slot.overlapped.hEvent);
+            slot.overlapped.hEvent = nullptr;
+        }
+    }
+
+    slots.clear();
+}
+
+/*
+ *  OverlappedStreamBuffer::WaitSlot()
+ *
+ *  Description:
+ *      Wait for the I/O operation associated with the given slot, if any,
+ *      to complete.
+ *
+ *  Parameters:
+ *      slot [in/out]
+ *          The slot for which to wait.  On return, the octets and error
+ *          members reflect the result of the I/O operation.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the operation succeeded, else the Windows error
+ *      code.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD OverlappedStreamBuffer::WaitSlot(IOSlot &slot)
+{
+    DWORD octets{};
+
+    if (!slot.pending) return slot.error;
+
+    if (::GetOverlappedResult(file_handle, &slot.overlapped, &octets, TRUE))
+    {
+        slot.octets = octets;
+        slot.error = ERROR_SUCCESS;
+    }
+    else
+    {
+        slot.octets = 0;
+        slot.error = ::GetLastError();
+    }
+
+    slot.pending = false;
+
+    return slot.error;
+}
+
+/*
+ *  OverlappedStreamBuffer::WaitAllSlots()
+ *
+ *  Description:
+ *      Wait for all outstanding I/O operations to complete, recording the
+ *      first error encountered.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void OverlappedStreamBuffer::WaitAllSlots()
+{
+    for (auto &slot : slots)
+    {
+        DWORD error = WaitSlot(slot);
+        if ((error != ERROR_SUCCESS) && (error != ERROR_HANDLE_EOF) &&
+            (io_error == ERROR_SUCCESS))
+        {
+            io_error = error;
+        }
+    }
+}
+
+/*
+ *  OverlappedStreamBuffer::CancelPending()
+ *
+ *  Description:
+ *      Cancel any outstanding I/O operations and wait for them to finish
+ *      so that the buffers may be safely released.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void OverlappedStreamBuffer::CancelPending()
+{
+    if (!IsOpen()) return;
+
+    for (auto &slot : slots)
+    {
+        if (!slot.pending) continue;
+        ::CancelIoEx(file_handle, &slot.overlapped);
+        WaitSlot(slot);
+    }
+}
+
+/*
+ *  OverlappedStreamBuffer::CloseFileHandle()
+ *
+ *  Description:
+ *      Close the file handle.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the handle was closed or was not open, else the
+ *      Windows error code.
+ *
+ *  Comments:
+ *      There must be no outstanding I/O when this function is called.
+ */
+DWORD OverlappedStreamBuffer::CloseFileHandle()
+{
+    DWORD error = ERROR_SUCCESS;
+
+    if (!IsOpen()) return error;
+
+    if (!::CloseHandle(file_handle)) error = ::GetLastError();
+    file_handle = INVALID_HANDLE_VALUE;
+
+    return error;
+}
+
+/*
+ *  OverlappedStreamBuffer::SetOffset()
+ *
+ *  Description:
+ *      Set the file offset in the given OVERLAPPED structure.
+ *
+ *  Parameters:
+ *      overlapped [out]
+ *          The OVERLAPPED structure to update.
+ *
+ *      offset [in]
+ *          The file offset at which the I/O operation should occur.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void OverlappedStreamBuffer::SetOffset(OVERLAPPED &overlapped,
+                                       std::uint64_t offset)
+{
+    overlapped.Offset = static_cast<DWORD>(offset & 0xffffffff);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+}
+
+/*
+ *  OverlappedFileReader::OverlappedFileReader()
+ *
+ *  Description:
+ *      Constructor for the OverlappedFileReader object.
+ *
+ *  Parameters:
+ *      buffer_size [in]
+ *          The size of each read request.
+ *
+ *      queue_depth [in]
+ *          The number of read requests to keep outstanding.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedFileReader::OverlappedFileReader(std::size_t buffer_size,
+                                           std::size_t queue_depth) :
+    OverlappedStreamBuffer(buffer_size, queue_depth),
+    slot_consumed{false},
+    end_of_file{false}
+{
+}
+
+/*
+ *  OverlappedFileReader::~OverlappedFileReader()
+ *
+ *  Description:
+ *      Destructor for the OverlappedFileReader object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedFileReader::~OverlappedFileReader()
+{
+    Close();
+}
+
+/*
+ *  OverlappedFileReader::Open()
+ *
+ *  Description:
+ *      Open the specified file for reading and issue the initial read
+ *      requests to fill the ring of buffers.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open.
+ *
+ *      unbuffered [in]
+ *          True if the file should be read bypassing the system file cache.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD OverlappedFileReader::Open(const std::wstring &filename, bool unbuffered)
+{
+    DWORD error = OpenHandle(filename,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN,
+                             unbuffered);
+    if (error != ERROR_SUCCESS) return error;
+
+    slot_consumed = false;
+    end_of_file = false;
+    setg(nullptr, nullptr, nullptr);
+
+    // Read ahead into every buffer in the ring
+    for (auto &slot : slots) IssueRead(slot);
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  OverlappedFileReader::Close()
+ *
+ *  Description:
+ *      Cancel any outstanding reads, close the file, and release the
+ *      buffers.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void OverlappedFileReader::Close()
+{
+    CancelPending();
+    CloseFileHandle();
+    FreeSlots();
+    setg(nullptr, nullptr, nullptr);
+}
+
+/*
+ *  OverlappedFileReader::IssueRead()
+ *
+ *  Description:
+ *      Issue an overlapped read of the next block of the file into the
+ *      given slot.
+ *
+ *  Parameters:
+ *      slot [in/out]
+ *          The slot into which data should be read.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Errors are recorded in the slot and reported when the slot's data
+ *      is consumed.
+ */
+void OverlappedFileReader::IssueRead(IOSlot &slot)
+{
+    slot.octets = 0;
+    slot.pending = false;
+
+    // Do not read beyond a short read, which indicates the end of file
+    if (end_of_file)
+    {
+        slot.error = ERROR_HANDLE_EOF;
+        return;
+    }
+
+    SetOffset(slot.overlapped, next_offset);
+
+    if (!::ReadFile(file_handle,
+                    slot.buffer,
+                    static_cast<DWORD>(buffer_size),
+                    nullptr,
+                    &slot.overlapped))
+    {
+        DWORD error = ::GetLastError();
+        if (error != ERROR_IO_PENDING)
+        {
+            slot.error = error;
+            return;
+        }
+    }
+
+    slot.error = ERROR_SUCCESS;
+    slot.pending = true;
+    next_offset += buffer_size;
+}
+
+/*
+ *  OverlappedFileReader::underflow()
+ *
+ *  Description:
+ *      Called when the data in the get area is exhausted.  This will
+ *      re-issue a read into the consumed buffer and then make the next
+ *      buffer in the ring the get area once its read has completed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The next character in the stream or traits_type::eof() at the end
+ *      of the file or on error.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedFileReader::int_type OverlappedFileReader::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    if (!IsOpen() || slots.empty()) return traits_type::eof();
+
+    // Refill the buffer just consumed and move to the next one
+    if (slot_consumed)
+    {
+        IssueRead(slots[current_slot]);
+        current_slot = (current_slot + 1) % slots.size();
+    }
+
+    IOSlot &slot = slots[current_slot];
+    DWORD error = WaitSlot(slot);
+    slot_consumed = true;
+
+    if ((error == ERROR_HANDLE_EOF) ||
+        ((error == ERROR_SUCCESS) && (slot.octets == 0)))
+    {
+        end_of_file = true;
+        setg(nullptr, nullptr, nullptr);
+        return traits_type::eof();
+    }
+
+    if (error != ERROR_SUCCESS)
+    {
+        io_error = error;
+        setg(nullptr, nullptr, nullptr);
+        return traits_type::eof();
+    }
+
+    // A short read from a disk file means the end of the file was reached
+    if (disk_file && (slot.octets < buffer_size)) end_of_file = true;
+
+    setg(slot.buffer, slot.buffer, slot.buffer + slot.octets);
+
+    return traits_type::to_int_type(*gptr());
+}
+
+/*
+ *  OverlappedFileWriter::OverlappedFileWriter()
+ *
+ *  Description:
+ *      Constructor for the OverlappedFileWriter object.
+ *
+ *  Parameters:
+ *      buffer_size [in]
+ *          The size of each write request.
+ *
+ *      queue_depth [in]
+ *          The number of write requests that may be outstanding.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedFileWriter::OverlappedFileWriter(std::size_t buffer_size,
+                                           std::size_t queue_depth) :
+    OverlappedStreamBuffer(buffer_size, queue_depth),
+    octets_written{0},
+    padded_write{false},
+    last_write_time{0}
+{
+}
+
+/*
+ *  OverlappedFileWriter::~OverlappedFileWriter()
+ *
+ *  Description:
+ *      Destructor for the OverlappedFileWriter object.  If the file is
+ *      still open, any buffered data is written and the file is closed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Callers should call Close() explicitly in order to learn whether
+ *      all data was written successfully.
+ */
+OverlappedFileWriter::~OverlappedFileWriter()
+{
+    Close();
+}
+
+/*
+ *  OverlappedFileWriter::Open()
+ *
+ *  Description:
+ *      Create (or truncate) the specified file for writing.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to open.
+ *
+ *      unbuffered [in]
+ *          True if the file should be written bypassing the system file
+ *          cache.
+ *
+ *      create_new [in]
+ *          True if the file must not already exist, in which case an
+ *          existing file is left untouched and ERROR_FILE_EXISTS returned.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD OverlappedFileWriter::Open(const std::wstring &filename,
+                                 bool unbuffered,
+                                 bool create_new)
+{
+    DWORD error = OpenHandle(filename,
+                             GENERIC_WRITE,
+                             FILE_SHARE_READ,
+                             create_new ? CREATE_NEW : CREATE_ALWAYS,
+                             0,
+                             unbuffered);
+    if (error != ERROR_SUCCESS) return error;
+
+    octets_written = 0;
+    padded_write = false;
+    last_write_time = 0;
+    setp(slots[0].buffer, slots[0].buffer + buffer_size);
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  OverlappedFileWriter::Close()
+ *
+ *  Description:
+ *      Write any buffered data, wait for all writes to complete, and close
+ *      the file.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if all data was written and the file was closed, else
+ *      the Windows error code for the first error encountered.
+ *
+ *  Comments:
+ *      When using unbuffered I/O, the final write is padded to a multiple
+ *      of the sector size, so the file is then truncated to its true size.
+ */
+DWORD OverlappedFileWriter::Close()
+{
+    if (!IsOpen()) return io_error;
+
+    if (io_error == ERROR_SUCCESS) SubmitCurrentSlot();
+    WaitAllSlots();
+
+    // Trim the file to the octets written if the final write was padded
+    if ((io_error == ERROR_SUCCESS) && padded_write)
+    {
+        FILE_END_OF_FILE_INFO end_of_file{};
+        end_of_file.EndOfFile.QuadPart =
+            static_cast<LONGLONG>(octets_written);
+        if (!::SetFileInformationByHandle(file_handle,
+                                          FileEndOfFileInfo,
+                                          &end_of_file,
+                                          sizeof(end_of_file)) &&
+            (io_error == ERROR_SUCCESS))
+        {
+            io_error = ::GetLastError();
+        }
+    }
+
+    // Apply the last write time if one was given
+    if ((io_error == ERROR_SUCCESS) && (last_write_time != 0))
+    {
+        FILETIME file_time{};
+        file_time.dwLowDateTime = static_cast<DWORD>(last_write_time);
+        file_time.dwHighDateTime = static_cast<DWORD>(last_write_time >> 32);
+        if (!::SetFileTime(file_handle, nullptr, nullptr, &file_time))
+        {
+            io_error = ::GetLastError();
+        }
+    }
+
+    DWORD error = CloseFileHandle();
+    if (io_error == ERROR_SUCCESS) io_error = error;
+
+    FreeSlots();
+    setp(nullptr, nullptr);
+
+    return io_error;
+}
+
+/*
+ *  OverlappedFileWriter::Preallocate()
+ *
+ *  Description:
+ *      Reserve space on the volume for the expected size of the file so
+ *      that it is allocated contiguously where possible, rather than being
+ *      extended as each write completes.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The expected size of the file in octets.  This need not be
+ *          exact, as any allocation beyond the end of the file is released
+ *          when the file is closed.
+ *
+ *  Returns:
+ *      ERROR_SUCCESS if space was reserved, else the Windows error code.
+ *
+ *  Comments:
+ *      This must be called after Open() and before anything is written.
+ *      Failure is not an error for the caller, as the file will simply be
+ *      extended as it is written.
+ */
+DWORD OverlappedFileWriter::Preallocate(std::uint64_t size)
+{
+    if (!IsOpen()) return ERROR_INVALID_HANDLE;
+    if ((next_offset != 0) || (pptr() != pbase()) || !disk_file)
+    {
+        return ERROR_INVALID_FUNCTION;
+    }
+
+    // Only reserve the space, leaving the end of the file where it is; the
+    // file is not extended with SetFileValidData(), as that would expose
+    // whatever the disk previously held beyond the data written to anyone
+    // able to read the file, and leave it in the file if the process ended
+    // before the file was trimmed
+    FILE_ALLOCATION_INFO allocation{};
+    allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    if (!::SetFileInformationByHandle(file_handle,
+                                      FileAllocationInfo,
+                                      &allocation,
+                                      sizeof(allocation)))
+    {
+        return ::GetLastError();
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/*
+ *  OverlappedFileWriter::IssueWrite()
+ *
+ *  Description:
+ *      Issue an overlapped write of the given slot's buffer at the next
+ *      offset in the file.
+ *
+ *  Parameters:
+ *      slot [in/out]
+ *          The slot containing the data to write.
+ *
+ *      length [in]
+ *          The number of octets to write from the slot's buffer.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Errors are recorded in the slot and reported when the slot is
+ *      next reused or when the file is closed.
+ */
+void OverlappedFileWriter::IssueWrite(IOSlot &slot, std::size_t length)
+{
+    slot.octets = 0;
+    slot.pending = false;
+
+    SetOffset(slot.overlapped, next_offset);
+
+    if (!::WriteFile(file_handle,
+                     slot.buffer,
+                     static_cast<DWORD>(length),
+                     nullptr,
+                     &slot.overlapped))
+    {
+        DWORD error = ::GetLastError();
+        if (error != ERROR_IO_PENDING)
+        {
+            slot.error = error;
+            return;
+        }
+    }
+
+    slot.error = ERROR_SUCCESS;
+    slot.pending = true;
+    next_offset += length;
+}
+
+/*
+ *  OverlappedFileWriter::SubmitCurrentSlot()
+ *
+ *  Description:
+ *      Write the data in the put area and make the next buffer in the ring
+ *      the put area once any earlier write from it has completed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if an I/O error occurred.
+ *
+ *  Comments:
+ *      When using unbuffered I/O, a partially filled buffer is padded with
+ *      zeros to a multiple of the sector size.  This happens only for the
+ *      final write, as the put area is otherwise always full.
+ */
+bool OverlappedFileWriter::SubmitCurrentSlot()
+{
+    std::size_t length = static_cast<std::size_t>(pptr() - pbase());
+
+    if (io_error != ERROR_SUCCESS) return false;
+
+    if (length > 0)
+    {
+        std::size_t write_length = length;
+
+        if (unbuffered_io && ((length % sector_size) != 0))
+        {
+            write_length = ((length / sector_size) + 1) * sector_size;
+            std::memset(pbase() + length, 0, write_length - length);
+            padded_write = true;
+        }
+
+        IssueWrite(slots[current_slot], write_length);
+        octets_written += length;
+
+        current_slot = (current_slot + 1) % slots.size();
+    }
+
+    // Ensure the write previously issued from the next buffer completed
+    DWORD error = WaitSlot(slots[current_slot]);
+    if (error != ERROR_SUCCESS)
+    {
+        io_error = error;
+        setp(nullptr, nullptr);
+        return false;
+    }
+
+    setp(slots[current_slot].buffer,
+         slots[current_slot].buffer + buffer_size);
+
+    return true;
+}
+
+/*
+ *  OverlappedFileWriter::overflow()
+ *
+ *  Description:
+ *      Called when the put area is full.  The buffer is written to the file
+ *      and the next buffer in the ring becomes the put area.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to store after the put area is written, or
+ *          traits_type::eof() if there is none.
+ *
+ *  Returns:
+ *      A value other than traits_type::eof() on success, or
+ *      traits_type::eof() on error.
+ *
+ *  Comments:
+ *      None.
+ */
+OverlappedFileWriter::int_type OverlappedFileWriter::overflow(int_type c)
+{
+    if (!IsOpen() || slots.empty()) return traits_type::eof();
+
+    if (!SubmitCurrentSlot()) return traits_type::eof();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+/*
+ *  OverlappedFileWriter::sync()
+ *
+ *  Description:
+ *      Called when the stream is flushed.  Buffered data is written and
+ *      this function waits for all outstanding writes to complete.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      0 on success or -1 on error.
+ *
+ *  Comments:
+ *      When using unbuffered I/O, writes must be a multiple of the sector
+ *      size, so any partially filled buffer is retained until the next
+ *      overflow or until the file is closed.
+ */
+int OverlappedFileWriter::sync()
+{
+    if (!IsOpen()) return -1;
+
+    if (!unbuffered_io && !SubmitCurrentSlot()) return -1;
+
+    WaitAllSlots();
+
+    return (io_error == ERROR_SUCCESS) ? 0 : -1;
+}
@@ -0,0 +1,144 @@
+/*
+ *  overlapped_file.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines stream buffer classes that read and write files
+ *      using overlapped Win32 I/O.  Each object maintains a ring of
+ *      page-aligned buffers so that reading ahead (or writing behind) the
+ *      data being processed happens while the AES Crypt Engine is busy
+ *      encrypting or decrypting the current buffer.  Since the classes are
+ *      derived from std::streambuf, they may be used with std::istream and
+ *      std::ostream objects consumed by the AES Crypt Engine.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Base class for the overlapped file reader and writer
+class OverlappedStreamBuffer : public std::streambuf
+{
+    public:
+        OverlappedStreamBuffer(std::size_t buffer_size,
+                               std::size_t queue_depth);
+        virtual ~OverlappedStreamBuffer();
+
+        bool IsOpen() const { return file_handle != INVALID_HANDLE_VALUE; }
+        DWORD GetError() const { return io_error; }
+
+        // Number of octets of I/O buffers allocated while the file is open
+        std::size_t GetBufferOctets() const
+        {
+            return slots.size() * buffer_size;
+        }
+
+        // I/O parameters selected for the file when it was opened
+        std::size_t GetBufferSize() const { return buffer_size; }
+        std::size_t GetQueueDepth() const { return queue_depth; }
+
+    protected:
+        // Structure holding the state of a single buffer in the ring
+        struct IOSlot
+        {
+            char *buffer;
+            OVERLAPPED overlapped;
+            bool pending;
+            DWORD octets;
+            DWORD error;
+        };
+
+        DWORD OpenHandle(const std::wstring &filename,
+                         DWORD desired_access,
+                         DWORD share_mode,
+                         DWORD creation_disposition,
+                         DWORD flags,
+                         bool unbuffered);
+        void ApplyIOProfile();
+        DWORD AllocateSlots();
+        void FreeSlots();
+        DWORD WaitSlot(IOSlot &slot);
+        void WaitAllSlots();
+        void CancelPending();
+        DWORD CloseFileHandle();
+        static void SetOffset(OVERLAPPED &overlapped, std::uint64_t offset);
+
+        HANDLE file_handle;
+        std::size_t requested_buffer_size;
+        std::size_t requested_queue_depth;
+        std::size_t buffer_size;
+        std::size_t queue_depth;
+        std::vector<IOSlot> slots;
+        std::size_t current_slot;
+        std::uint64_t next_offset;
+        bool disk_file;
+        bool unbuffered_io;
+        std::size_t sector_size;
+        DWORD io_error;
+};
+
+// Stream buffer that reads a file using overlapped I/O
+class OverlappedFileReader : public OverlappedStreamBuffer
+{
+    public:
+        OverlappedFileReader(std::size_t buffer_size,
+                             std::size_t queue_depth);
+        virtual ~OverlappedFileReader();
+
+        DWORD Open(const std::wstring &filename, bool unbuffered);
+        void Close();
+
+    protected:
+        int_type underflow() override;
+        void IssueRead(IOSlot &slot);
+
+        bool slot_consumed;
+        bool end_of_file;
+};
+
+// Stream buffer that writes a file using overlapped I/O
+class OverlappedFileWriter : public OverlappedStreamBuffer
+{
+    public:
+        OverlappedFileWriter(std::size_t buffer_size,
+                             std::size_t queue_depth);
+        virtual ~OverlappedFileWriter();
+
+        DWORD Open(const std::wstring &filename,
+                   bool unbuffered,
+                   bool create_new = false);
+        DWORD Close();
+
+        // Reserve space for the expected size of the file before writing
+        DWORD Preallocate(std::uint64_t size);
+
+        // Set the last write time (as a FILETIME value) to apply on close
+        void SetLastWriteTime(std::uint64_t time) { last_write_time = time; }
+
+        // Number of octets written to the file (complete once closed)
+        std::uint64_t GetOctetsWritten() const { return octets_written; }
+
+    protected:
+        int_type overflow(int_type c) override;
+        int sync() override;
+        bool SubmitCurrentSlot();
+        void IssueWrite(IOSlot &slot, std::size_t length);
+
+        std::uint64_t octets_written;
+        bool padded_write;
+        std::uint64_t last_write_time;
+};
@@ -0,0 +1,434 @@
+/*
+ *  pipelined_stream_buffer.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the PipelinedStreamBuffer class.  The producing
+ *      thread fills the slot at the head of the ring and advances the head,
+ *      while the writing thread writes the slot at the tail and advances the
+ *      tail.  Each index is only modified by one thread, and a thread waits
+ *      on the other's index (via std::atomic::wait()) only when the ring is
+ *      full or empty.  A slot having a length of zero marks the end of the
+ *      data.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include <cstring>
+#include "pipelined_stream_buffer.h"
+#include "buffer_pool.h"
+#include "throttle.h"
+
+/*
+ *  PipelinedStreamBuffer::PipelinedStreamBuffer()
+ *
+ *  Description:
+ *      Constructor for the PipelinedStreamBuffer object.
+ *
+ *  Parameters:
+ *      stream_buffer [in]
+ *          The stream buffer to which data is written by the writing thread.
+ *
+ *      buffer_size [in]
+ *          The size of each buffer in the ring.
+ *
+ *      depth [in]
+ *          The number of buffers in the ring.
+ *
+ *      background_mode [in]
+ *          A function called by the writing thread before writing each
+ *          buffer, returning true if the thread should be in background
+ *          mode, or an empty function to leave the thread's mode unchanged.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Start() must be called before any data is written.
+ */
+PipelinedStreamBuffer::PipelinedStreamBuffer(
+                            std::streambuf *stream_buffer,
+                            std::size_t buffer_size,
+                            std::size_t depth,
+                            const std::function<bool()> &background_mode) :
+    stream_buffer{stream_buffer},
+    buffer_size{buffer_size},
+    slots(std::max<std::size_t>(depth, 2), Slot{}),
+    head{0},
+    tail{0},
+    failed{false},
+    slot_acquired{false},
+    background_mode{background_mode}
+{
+}
+
+/*
+ *  PipelinedStreamBuffer::~PipelinedStreamBuffer()
+ *
+ *  Description:
+ *      Destructor for the PipelinedStreamBuffer object.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      If Finish() was not called, any remaining data is written before the
+ *      writing thread is stopped.
+ */
+PipelinedStreamBuffer::~PipelinedStreamBuffer()
+{
+    if (writer_thread.joinable()) Finish();
+
+    FreeSlots();
+}
+
+/*
+ *  PipelinedStreamBuffer::Start()
+ *
+ *  Description:
+ *      Take the buffers for the ring from the buffer pool and start the
+ *      writing thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the pipeline was started, false if the buffers could not be
+ *      allocated or the thread could not be created.
+ *
+ *  Comments:
+ *      If this fails, the caller should write to the stream buffer directly.
+ */
+bool PipelinedStreamBuffer::Start()
+{
+    for (auto &slot : slots)
+    {
+        slot.buffer = GetBufferPool().Acquire(buffer_size);
+        if (slot.buffer == nullptr)
+        {
+            FreeSlots();
+            return false;
+        }
+    }
+
+    try
+    {
+        writer_thread = std::thread(
+            [this]()
+            {
+                WriteSlots();
+            });
+    }
+    catch (...)
+    {
+        FreeSlots();
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  PipelinedStreamBuffer::Finish()
+ *
+ *  Description:
+ *      Hand any partially filled buffer to the writing thread, wait for it
+ *      to write all data, and flush the underlying stream buffer.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if all data was written and flushed, false if there was an
+ *      error writing to the underlying stream buffer.
+ *
+ *  Comments:
+ *      No data may be written once this is called.
+ */
+bool PipelinedStreamBuffer::Finish()
+{
+    if (!writer_thread.joinable()) return !failed;
+
+    sync();
+
+    // Mark the end of the data, which the writing thread always consumes
+    AcquireSlot();
+    SubmitSlot(0);
+
+    writer_thread.join();
+    FreeSlots();
+
+    if (!failed && (stream_buffer->pubsync() == -1)) failed = true;
+
+    return !failed;
+}
+
+/*
+ *  PipelinedStreamBuffer::AcquireSlot()
+ *
+ *  Description:
+ *      Make the slot at the head of the ring the put area, waiting for the
+ *      writing thread to release it if the ring is full.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the slot may be filled, false if a write error occurred.
+ *
+ *  Comments:
+ *      The slot is acquired even if a write error occurred, so that the end
+ *      of the data can still be marked.  Only the producing thread calls
+ *      this function.
+ */
+bool PipelinedStreamBuffer::AcquireSlot()
+{
+    if (slot_acquired) return !failed;
+
+    std::size_t current_head = head.load(std::memory_order_relaxed);
+
+    // Wait while all slots hold data yet to be written
+    while (true)
+    {
+        std::size_t current_tail = tail.load(std::memory_order_acquire);
+        if (current_head - current_tail < slots.size()) break;
+        tail.wait(current_tail, std::memory_order_acquire);
+    }
+
+    Slot &slot = slots[current_head % slots.size()];
+    setp(slot.buffer, slot.buffer + buffer_size);
+    slot_acquired = true;
+
+    return !failed;
+}
+
+/*
+ *  PipelinedStreamBuffer::SubmitSlot()
+ *
+ *  Description:
+ *      Hand the slot at the head of the ring to the writing thread.
+ *
+ *  Parameters:
+ *      length [in]
+ *          The number of octets in the slot, or zero to mark the end of the
+ *          data.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Only the producing thread calls this function.
+ */
+void PipelinedStreamBuffer::SubmitSlot(std::size_t length)
+{
+    std::size_t current_head = head.load(std::memory_order_relaxed);
+
+    slots[current_head % slots.size()].length = length;
+
+    // Publish the slot contents along with the new head
+    head.store(current_head + 1, std::memory_order_release);
+    head.notify_one();
+
+    setp(nullptr, nullptr);
+    slot_acquired = false;
+}
+
+/*
+ *  PipelinedStreamBuffer::WriteSlots()
+ *
+ *  Description:
+ *      Write each slot handed over by the producing thread to the underlying
+ *      stream buffer until the end of the data is reached.  This function
+ *      runs on the writing thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Once a write fails, the remaining slots are released without being
+ *      written so that the producing thread never waits indefinitely.  The
+ *      background mode is checked before each slot is written, since the
+ *      user may enter or leave background mode at any time.
+ */
+void PipelinedStreamBuffer::WriteSlots()
+{
+    std::size_t current_tail = tail.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        // Wait for the producing thread to submit a slot
+        std::size_t current_head = head.load(std::memory_order_acquire);
+        while (current_head == current_tail)
+        {
+            head.wait(current_head, std::memory_order_acquire);
+            current_head = head.load(std::memory_order_acquire);
+        }
+
+        const Slot &slot = slots[current_tail % slots.size()];
+        std::size_t length = slot.length;
+
+        // Issue the writes at the priority of the producing thread
+        if (background_mode) SetThreadBackgroundMode(background_mode());
+
+        if ((length > 0) && !failed &&
+            (stream_buffer->sputn(slot.buffer,
+                                  static_cast<std::streamsize>(length)) !=
+             static_cast<std::streamsize>(length)))
+        {
+            failed = true;
+        }
+
+        // Release the slot to the producing thread
+        tail.store(++current_tail, std::memory_order_release);
+        tail.notify_one();
+
+        if (length == 0) break;
+    }
+}
+
+/*
+ *  PipelinedStreamBuffer::FreeSlots()
+ *
+ *  Description:
+ *      Return the buffers of the ring to the buffer pool.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The writing thread must not be running.
+ */
+void PipelinedStreamBuffer::FreeSlots()
+{
+    for (auto &slot : slots)
+    {
+        GetBufferPool().Release(slot.buffer, buffer_size);
+        slot.buffer = nullptr;
+    }
+
+    setp(nullptr, nullptr);
+    slot_acquired = false;
+}
+
+/*
+ *  PipelinedStreamBuffer::overflow()
+ *
+ *  Description:
+ *      Called when the put area is full (or absent) to write a character.
+ *
+ *  Parameters:
+ *      c [in]
+ *          The character to write or traits_type::eof() if none.
+ *
+ *  Returns:
+ *      A value other than traits_type::eof() on success, or
+ *      traits_type::eof() on error.
+ *
+ *  Comments:
+ *      None.
+ */
+PipelinedStreamBuffer::int_type PipelinedStreamBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    if (slot_acquired && (pptr() == epptr())) SubmitSlot(buffer_size);
+
+    if (!AcquireSlot()) return traits_type::eof();
+
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+
+    return c;
+}
+
+/*
+ *  PipelinedStreamBuffer::xsputn()
+ *
+ *  Description:
+ *      Write characters to the ring, handing each buffer to the writing
+ *      thread as it fills.
+ *
+ *  Parameters:
+ *      s [in]
+ *          The characters to write.
+ *
+ *      count [in]
+ *          The number of characters to write.
+ *
+ *  Returns:
+ *      The number of characters written, which is less than count if a
+ *      write error occurred.
+ *
+ *  Comments:
+ *      None.
+ */
+std::streamsize PipelinedStreamBuffer::xsputn(const char *s,
+                                              std::streamsize count)
+{
+    std::streamsize written = 0;
+
+    while (written < count)
+    {
+        if (slot_acquired && (pptr() == epptr())) SubmitSlot(buffer_size);
+
+        if (!AcquireSlot()) break;
+
+        std::size_t length =
+            std::min(static_cast<std::size_t>(epptr() - pptr()),
+                     static_cast<std::size_t>(count - written));
+        std::memcpy(pptr(), s + written, length);
+        pbump(static_cast<int>(length));
+        written += static_cast<std::streamsize>(length);
+    }
+
+    return written;
+}
+
+/*
+ *  PipelinedStreamBuffer::sync()
+ *
+ *  Description:
+ *      Called when the stream is flushed to hand any partially filled
+ *      buffer to the writing thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      0 on success or -1 if a write error has occurred.
+ *
+ *  Comments:
+ *      This does not wait for the data to be written, as that would stall
+ *      the pipeline each time the stream is flushed; the underlying stream
+ *      buffer is flushed by Finish().
+ */
+int PipelinedStreamBuffer::sync()
+{
+    if (slot_acquired && (pptr() > pbase()))
+    {
+        SubmitSlot(static_cast<std::size_t>(pptr() - pbase()));
+    }
+
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,85 @@
+/*
+ *  pipelined_stream_buffer.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the PipelinedStreamBuffer class, an output stream
+ *      buffer that hands the data written to it to a dedicated thread,
+ *      which writes it to another stream buffer.  Data passes between the
+ *      two threads through a single-producer, single-consumer ring of
+ *      buffers taken from the buffer pool, coordinated using atomic indices
+ *      only, so the thread producing the data (e.g., the AES Crypt Engine
+ *      encrypting a file) does not stop to copy data into I/O buffers or to
+ *      wait on writes unless the ring is full.  The writing thread may be
+ *      placed in background mode, as directed by the caller, so that its
+ *      writes are issued at the same priority as the producing thread's.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <streambuf>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+// Size of each buffer in the ring
+constexpr std::size_t Pipeline_Buffer_Size = 1'048'576;
+
+// Number of buffers in the ring
+constexpr std::size_t Pipeline_Depth = 8;
+
+// Stream buffer that writes to another stream buffer on a separate thread
+class PipelinedStreamBuffer : public std::streambuf
+{
+    public:
+        PipelinedStreamBuffer(
+                    std::streambuf *stream_buffer,
+                    std::size_t buffer_size = Pipeline_Buffer_Size,
+                    std::size_t depth = Pipeline_Depth,
+                    const std::function<bool()> &background_mode = {});
+        virtual ~PipelinedStreamBuffer();
+
+        // Allocate the ring and start the writing thread
+        bool Start();
+
+        // Write any remaining data and stop the writing thread, returning
+        // true if all data was written and flushed
+        bool Finish();
+
+    protected:
+        struct Slot
+        {
+            char *buffer;
+            std::size_t length;
+        };
+
+        bool AcquireSlot();
+        void SubmitSlot(std::size_t length);
+        void WriteSlots();
+        void FreeSlots();
+
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+        int sync() override;
+
+        std::streambuf *stream_buffer;
+        std::size_t buffer_size;
+        std::vector<Slot> slots;
+        std::atomic<std::size_t> head;
+        std::atomic<std::size_t> tail;
+        std::atomic<bool> failed;
+        bool slot_acquired;
+        std::function<bool()> background_mode;
+        std::thread writer_thread;
+};
@@ -19,7 +19,144 @@
 #include "pch.h"
 #include <Windows.h>
 #include <VersionHelpers.h>
+#include <string>
+#include <algorithm>
+#include <cstdio>
 #include "progress_dialog.h"
+#include "batch_summary.h"
+
+namespace
+{
+
+// Identifier of the timer used to sample the progress of the batch
+constexpr UINT_PTR Progress_Timer_ID = 1;
+
+// Structure holding a sample of the progress of a batch of files
+struct BatchStatus
+{
+    std::uint64_t completed_bytes;
+    std::uint64_t total_bytes;
+    std::size_t files_completed;
+    std::size_t files_total;
+};
+
+// Time to wait before showing the throughput, so that it is meaningful
+constexpr std::chrono::seconds Throughput_Settle_Time(2);
+
+/*
+ *  FormatDuration()
+ *
+ *  Description:
+ *      Format a time duration for display to the user.
+ *
+ *  Parameters:
+ *      seconds [in]
+ *          The duration in seconds.
+ *
+ *  Returns:
+ *      The duration as a string (e.g., "3 min 05 sec").
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring FormatDuration(std::uint64_t seconds)
+{
+    wchar_t text[64];
+
+    if (seconds < 60)
+    {
+        std::swprintf(text,
+                      sizeof(text) / sizeof(wchar_t),
+                      L"%u sec",
+                      static_cast<unsigned>(seconds));
+    }
+    else if (seconds < 3600)
+    {
+        std::swprintf(text,
+                      sizeof(text) / sizeof(wchar_t),
+                      L"%u min %02u sec",
+                      static_cast<unsigned>(seconds / 60),
+                      static_cast<unsigned>(seconds % 60));
+    }
+    else
+    {
+        std::swprintf(text,
+                      sizeof(text) / sizeof(wchar_t),
+                      L"%llu hr %02u min",
+                      static_cast<unsigned long long>(seconds / 3600),
+                      static_cast<unsigned>((seconds % 3600) / 60));
+    }
+
+    return text;
+}
+
+/*
+ *  FormatBatchStatus()
+ *
+ *  Description:
+ *      Format the batch status line shown below the progress meter.
+ *
+ *  Parameters:
+ *      status [in]
+ *          The current batch status.
+ *
+ *      elapsed [in]
+ *          The time elapsed since processing started.
+ *
+ *  Returns:
+ *      The status as a string (e.g., "3 of 10 files, 85.3 MB/s, about
+ *      2 min 10 sec remaining").
+ *
+ *  Comments:
+ *      The throughput and time remaining are omitted until processing has
+ *      run long enough for the figures to be meaningful.
+ */
+std::wstring FormatBatchStatus(const BatchStatus &status,
+                               std::chrono::steady_clock::duration elapsed)
+{
+    wchar_t text[64];
+
+    std::swprintf(text,
+                  sizeof(text) / sizeof(wchar_t),
+                  L"%zu of %zu files",
+                  status.files_completed,
+                  status.files_total);
+
+    std::wstring status_text = text;
+
+    // Throughput is only meaningful once there is some history
+    if ((elapsed < Throughput_Settle_Time) || (status.completed_bytes == 0))
+    {
+        return status_text;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double rate = static_cast<double>(status.completed_bytes) / seconds;
+
+    // A MB is 1,000,000 octets, as with BandwidthLimit and /mbps
+    std::swprintf(text,
+                  sizeof(text) / sizeof(wchar_t),
+                  L", %.1f MB/s",
+                  rate / 1'000'000.0);
+    status_text += text;
+
+    // Estimate the time remaining from the average throughput
+    if (status.total_bytes > status.completed_bytes)
+    {
+        double remaining_seconds =
+            static_cast<double>(status.total_bytes - status.completed_bytes) /
+            rate;
+
+        status_text += L", about ";
+        status_text +=
+            FormatDuration(static_cast<std::uint64_t>(remaining_seconds + 0.5));
+        status_text += L" remaining";
+    }
+
+    return status_text;
+}
+
+} // namespace
 
 /*
  *  ProgressDialog::ProgressDialog()
@@ -45,9 +182,16 @@ ProgressDialog::ProgressDialog(std::function<void()> notify_cancel,
                                bool hide_on_cancel) :
     ATL::CAxDialogImpl<ProgressDialog>(),
     cancel_pressed{false},
+    background_mode{false},
     hIcon{},
     notify_cancel{notify_cancel},
-    hide_on_cancel{hide_on_cancel}
+    hide_on_cancel{hide_on_cancel},
+    total_bytes{0},
+    completed_bytes{0},
+    total_files{0},
+    completed_files{0},
+    meter_position{0},
+    start_time{std::chrono::steady_clock::now()}
 {
     // Load the icon to show on the system menu
     hIcon =
@@ -94,9 +238,8 @@ ProgressDialog::~ProgressDialog()
  *          Word parameter, but not used by this function.
  *
  *      lParam [in]
- *          This parameters will hold a non-zero value if encrypting files and
- *          zero value if not encrypting files.  This dictates what text is
- *          rendered while the program is working.
+ *          This parameter holds the BatchOperation being performed, which
+ *          dictates what text is rendered while the program is working.
  *
  *      bHandled [out]
  *          This is set to true if this function handles the message.
@@ -118,8 +261,8 @@ LRESULT ProgressDialog::OnInitDialog(UINT uMsg,
     CAxDialogImpl<ProgressDialog>::OnInitDialog(uMsg, wParam, lParam, bHandled);
     bHandled = TRUE;
 
-    // Are we encrypting?
-    bool encrypting = (lParam != 0) ? true : false;
+    // What operation is being performed?
+    auto operation = static_cast<BatchOperation>(lParam);
 
     // If the lock icon is available, show it
     if (hIcon != NULL) SetIcon(hIcon);
@@ -127,14 +270,31 @@ LRESULT ProgressDialog::OnInitDialog(UINT uMsg,
     // Position the dialog
     CenterWindow(GetForegroundWindow());
 
-    // Set the encrpypting / decrypting message
-    if (encrypting)
-    {
-        SetDlgItemText(IDC_ENCRYPTINGMSG, L"Encrypting...");
-    }
-    else
+    // Reflect whether the batch is running in background mode
+    CheckDlgButton(IDC_BACKGROUND,
+                   background_mode.load() ? BST_CHECKED : BST_UNCHECKED);
+
+    // Throughput is measured from the time the dialog is shown
+    start_time = std::chrono::steady_clock::now();
+
+    // Start the timer used to sample the progress of the batch
+    SetTimer(Progress_Timer_ID,
+             static_cast<UINT>(Progress_Update_Interval.count()));
+
+    // Set the encrypting / decrypting / verifying message
+    switch (operation)
     {
-        SetDlgItemText(IDC_ENCRYPTINGMSG, L"Decrypting...");
+        case BatchOperation::Encrypt:
+            SetDlgItemText(IDC_ENCRYPTINGMSG, L"Encrypting...");
+            break;
+
+        case BatchOperation::Verify:
+            SetDlgItemText(IDC_ENCRYPTINGMSG, L"Verifying...");
+            break;
+
+        default:
+            SetDlgItemText(IDC_ENCRYPTINGMSG, L"Decrypting...");
+            break;
     }
 
     // If older than Windows XP (major OS version less than 5), then set the
@@ -242,6 +402,82 @@ LRESULT ProgressDialog::OnEndSession(UINT uMsg,
     return 0;
 }
 
+/*
+ *  ProgressDialog::OnTimer()
+ *
+ *  Description:
+ *      Called periodically to sample the progress of the batch and update
+ *      the progress meter and the status line showing the number of files
+ *      processed, throughput, and estimated time remaining.
+ *
+ *  Parameters:
+ *      uMsg [in]
+ *          The associated Windows message. This should be WM_TIMER.
+ *
+ *      wParam [in]
+ *          The identifier of the timer.
+ *
+ *      lParam [in]
+ *          Long parameter, but not used by this function.
+ *
+ *      bHandled [out]
+ *          This is set to true if this function handles the message.
+ *
+ *  Returns:
+ *      Returns zero to indicate success.
+ *
+ *  Comments:
+ *      Worker threads only update atomic counters as they process files,
+ *      so sampling them here keeps all synchronization with this thread off
+ *      the encryption and decryption path.
+ */
+LRESULT ProgressDialog::OnTimer(UINT uMsg,
+                                WPARAM wParam,
+                                LPARAM lParam,
+                                BOOL &bHandled)
+{
+    // Ignore timers not created by this object
+    if (wParam != Progress_Timer_ID)
+    {
+        bHandled = FALSE;
+        return 0;
+    }
+
+    // Indicate that the message was handled
+    bHandled = TRUE;
+
+    // Sample the progress of the batch
+    BatchStatus status{completed_bytes.load(std::memory_order_relaxed),
+                       total_bytes.load(std::memory_order_relaxed),
+                       completed_files.load(std::memory_order_relaxed),
+                       total_files.load(std::memory_order_relaxed)};
+
+    // Move the progress meter (range of 0..100) if the total size is known
+    if (status.total_bytes > 0)
+    {
+        int position = static_cast<int>(
+            100 * std::min(status.completed_bytes, status.total_bytes) /
+            status.total_bytes);
+
+        if (position > meter_position)
+        {
+            meter_position = position;
+            SendDlgItemMessage(IDC_PROGRESSBAR,
+                               PBM_SETPOS,
+                               static_cast<WPARAM>(position),
+                               0);
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+
+    std::wstring status_text = FormatBatchStatus(status, elapsed);
+
+    SetDlgItemText(IDC_BATCHSTATUS, status_text.c_str());
+
+    return 0;
+}
+
 /*
  *  ProgressDialog::OnClickedCancel()
  *
@@ -288,6 +524,46 @@ LRESULT ProgressDialog::OnClickedCancel(WORD wNotifyCode,
     return 0;
 }
 
+/*
+ *  ProgressDialog::OnClickedBackground()
+ *
+ *  Description:
+ *      Actions to take when the user toggles the background mode checkbox.
+ *
+ *  Parameters:
+ *      wNotifyCode [in]
+ *          The notification code.
+ *
+ *      wID [in]
+ *          The identifier of the menu item, control, or accelerator.  Here,
+ *          it is the checkbox identifier.
+ *
+ *      hWndCtl [in]
+ *          A handle to a window control.
+ *
+ *      bHandled [out]
+ *          Set to true if this message is handled and false if not.
+ *
+ *  Returns:
+ *      Zero indicates success, non-zero indicates failure.
+ *
+ *  Comments:
+ *      Threads processing files pick up the change as they next report
+ *      progress.
+ */
+LRESULT ProgressDialog::OnClickedBackground(WORD wNotifyCode,
+                                            WORD wID,
+                                            HWND hWndCtl,
+                                            BOOL &bHandled)
+{
+    // Indicate that the message was handled
+    bHandled = TRUE;
+
+    background_mode.store(IsDlgButtonChecked(IDC_BACKGROUND) == BST_CHECKED);
+
+    return 0;
+}
+
 /*
  *  ProgressDialog::WasCancelPressed()
  *
@@ -308,3 +584,175 @@ bool ProgressDialog::WasCancelPressed()
 {
     return cancel_pressed.load();
 }
+
+/*
+ *  ProgressDialog::SetBackgroundMode()
+ *
+ *  Description:
+ *      Set whether the batch is processed in background mode.
+ *
+ *  Parameters:
+ *      background [in]
+ *          True if the batch should be processed in background mode.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This should be called before the dialog is created so that the
+ *      checkbox shows the initial mode.
+ */
+void ProgressDialog::SetBackgroundMode(bool background)
+{
+    background_mode.store(background);
+}
+
+/*
+ *  ProgressDialog::IsBackgroundMode()
+ *
+ *  Description:
+ *      Returns a boolean indicating whether the batch is being processed in
+ *      background mode, which the user may change at any time.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if in background mode, false if not.
+ *
+ *  Comments:
+ *      This may be called from any thread.
+ */
+bool ProgressDialog::IsBackgroundMode()
+{
+    return background_mode.load();
+}
+
+/*
+ *  ProgressDialog::AddBatchSize()
+ *
+ *  Description:
+ *      Add to the size of the batch of files being processed.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The total size in octets of the files being added to the batch.
+ *
+ *      files [in]
+ *          The number of files being added to the batch.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called from any thread.  The batch may grow while it is
+ *      being processed (e.g., as directories are enumerated).
+ */
+void ProgressDialog::AddBatchSize(std::uint64_t octets, std::size_t files)
+{
+    total_bytes.fetch_add(octets, std::memory_order_relaxed);
+    total_files.fetch_add(files, std::memory_order_relaxed);
+}
+
+/*
+ *  ProgressDialog::AddBatchProgress()
+ *
+ *  Description:
+ *      Add to the number of octets of the batch that have been processed.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets processed since the last call.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called from any thread and neither locks nor waits on
+ *      the thread servicing the dialog, so it may be called frequently.
+ */
+void ProgressDialog::AddBatchProgress(std::uint64_t octets)
+{
+    completed_bytes.fetch_add(octets, std::memory_order_relaxed);
+}
+
+/*
+ *  ProgressDialog::FileCompleted()
+ *
+ *  Description:
+ *      Indicate that processing of a file in the batch has completed.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called from any thread.
+ */
+void ProgressDialog::FileCompleted()
+{
+    completed_files.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ *  ProgressDialog::SetFileName()
+ *
+ *  Description:
+ *      Show the name of the file being processed.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This does nothing if the dialog window was not created, which is the
+ *      case when processing files without user interaction.
+ */
+void ProgressDialog::SetFileName(const std::wstring &filename)
+{
+    if (!IsWindow()) return;
+
+    SetDlgItemText(IDC_FILENAME, filename.c_str());
+}
+
+/*
+ *  ProgressDialog::GetBatchTotals()
+ *
+ *  Description:
+ *      Get the number of octets and files in the batch and the number of
+ *      each that have been processed.
+ *
+ *  Parameters:
+ *      octets_completed [out]
+ *          The number of octets processed.
+ *
+ *      octets_total [out]
+ *          The number of octets in the batch.
+ *
+ *      files_completed [out]
+ *          The number of files processed successfully.
+ *
+ *      files_total [out]
+ *          The number of files in the batch.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called from any thread.
+ */
+void ProgressDialog::GetBatchTotals(std::uint64_t &octets_completed,
+                                    std::uint64_t &octets_total,
+                                    std::size_t &files_completed,
+                                    std::size_t &files_total) const
+{
+    octets_completed = completed_bytes.load(std::memory_order_relaxed);
+    octets_total = total_bytes.load(std::memory_order_relaxed);
+    files_completed = completed_files.load(std::memory_order_relaxed);
+    files_total = total_files.load(std::memory_order_relaxed);
+}
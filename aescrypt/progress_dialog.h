@@ -20,10 +20,17 @@
 
 #include <Windows.h>
 #include <functional>
+#include <string>
 #include <atlhost.h>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include "resource.h"
 
+// Interval at which the dialog samples the progress of the batch
+constexpr std::chrono::milliseconds Progress_Update_Interval(250);
+
 class ProgressDialog : public ATL::CAxDialogImpl<ProgressDialog>
 {
     public:
@@ -37,7 +44,9 @@ class ProgressDialog : public ATL::CAxDialogImpl<ProgressDialog>
             MESSAGE_HANDLER(WM_INITDIALOG, OnInitDialog)
             MESSAGE_HANDLER(WM_QUERYENDSESSION, OnQueryEndSession)
             MESSAGE_HANDLER(WM_ENDSESSION, OnEndSession)
+            MESSAGE_HANDLER(WM_TIMER, OnTimer)
             COMMAND_HANDLER(IDCANCEL, BN_CLICKED, OnClickedCancel)
+            COMMAND_HANDLER(IDC_BACKGROUND, BN_CLICKED, OnClickedBackground)
             CHAIN_MSG_MAP(CAxDialogImpl<ProgressDialog>)
         END_MSG_MAP()
 
@@ -56,16 +65,50 @@ class ProgressDialog : public ATL::CAxDialogImpl<ProgressDialog>
                              LPARAM lParam,
                              BOOL &bHandled);
 
+        LRESULT OnTimer(UINT uMsg,
+                        WPARAM wParam,
+                        LPARAM lParam,
+                        BOOL &bHandled);
+
         LRESULT OnClickedCancel(WORD wNotifyCode,
                                 WORD wID,
                                 HWND hWndCtl,
                                 BOOL &bHandled);
 
+        LRESULT OnClickedBackground(WORD wNotifyCode,
+                                    WORD wID,
+                                    HWND hWndCtl,
+                                    BOOL &bHandled);
+
         bool WasCancelPressed();
 
+        void SetBackgroundMode(bool background);
+
+        bool IsBackgroundMode();
+
+        void AddBatchSize(std::uint64_t octets, std::size_t files);
+
+        void AddBatchProgress(std::uint64_t octets);
+
+        void FileCompleted();
+
+        void SetFileName(const std::wstring &filename);
+
+        void GetBatchTotals(std::uint64_t &octets_completed,
+                            std::uint64_t &octets_total,
+                            std::size_t &files_completed,
+                            std::size_t &files_total) const;
+
     protected:
         std::atomic<bool> cancel_pressed;
+        std::atomic<bool> background_mode;
         HICON hIcon;
         std::function<void()> notify_cancel;
         bool hide_on_cancel;
+        std::atomic<std::uint64_t> total_bytes;
+        std::atomic<std::uint64_t> completed_bytes;
+        std::atomic<std::size_t> total_files;
+        std::atomic<std::size_t> completed_files;
+        int meter_position;
+        std::chrono::steady_clock::time_point start_time;
 };
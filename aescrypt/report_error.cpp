@@ -9,7 +9,8 @@
  *      Paul E. Jones <paulej@packetizer.com>
  *
  *  Description:
- *      This file implements functions for reporting errors to the user.
+ *      This file implements functions for reporting errors to the user and
+ *      for formatting the text of those errors.
  *
  *  Portability Issues:
  *      None.
@@ -21,34 +22,29 @@
 #include "report_error.h"
 
 /*
- *  ReportError()
+ *  FormatError()
  *
  *  Description:
- *      This function will report an error to the user by displaying a
- *      message box.  The message to render is provided as the first parameter.
- *      The second parameter contains either ERROR_SUCCESS or some error
- *      code from GetLastError().  If an error code is provided, the message
- *      will be formatted for user consumption.
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter.  The second parameter
+ *      contains either ERROR_SUCCESS or some error code from GetLastError().
+ *      If an error code is provided, the message will be formatted for user
+ *      consumption.
  *
  *  Parameters:
- *      window_title [in]
- *          The text of the title in the message box.
- *
  *      message [in]
- *         The message to show the user (encoded as UTF-8).
+ *         The message describing the error (encoded as UTF-8).
  *
  *      reason [in]
  *         The reason for the error (generally, the value from GetLastError()).
  *
  *  Returns:
- *      Nothing.
+ *      The text describing the error.
  *
  *  Comments:
  *      None.
  */
-void ReportError(const std::wstring &window_title,
-                 const std::string &message,
-                 DWORD reason)
+std::wstring FormatError(const std::string &message, DWORD reason)
 {
     std::wstring unicode_message(message.size(), L'\0');
 
@@ -74,25 +70,21 @@ void ReportError(const std::wstring &window_title,
         unicode_message = L"Error occurred, as did a UTF-8 conversion error";
     }
 
-    ReportError(window_title, unicode_message, reason);
+    return FormatError(unicode_message, reason);
 }
 
 /*
- *  ReportError()
+ *  FormatError()
  *
  *  Description:
- *      This function will report an error to the user by displaying a
- *      message box.  The message to render is provided as the first parameter.
- *      The second parameter contains either ERROR_SUCCESS or some error
- *      code from GetLastError().  If an error code is provided, the message
- *      will be formatted for user consumption.
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter, followed by a UTF-8
+ *      string to append to the message.  If an error code is provided, the
+ *      message will be formatted for user consumption.
  *
  *  Parameters:
- *      window_title [in]
- *          The text of the title in the message box.
- *
  *      message [in]
- *         The message to show the user.
+ *         The message describing the error.
  *
  *      error_string [in]
  *          A UTF-8 error string that will be appended to the above message.
@@ -101,15 +93,14 @@ void ReportError(const std::wstring &window_title,
  *         The reason for the error (generally, the value from GetLastError()).
  *
  *  Returns:
- *      Nothing.
+ *      The text describing the error.
  *
  *  Comments:
  *      None.
  */
-void ReportError(const std::wstring &window_title,
-                 const std::wstring &message,
-                 const std::string &error_string,
-                 DWORD reason)
+std::wstring FormatError(const std::wstring &message,
+                         const std::string &error_string,
+                         DWORD reason)
 {
     std::wstring unicode_error(error_string.size(), L'\0');
 
@@ -137,38 +128,33 @@ void ReportError(const std::wstring &window_title,
 
     std::wstring error_text = message + L": " + unicode_error;
 
-    ReportError(window_title, error_text, reason);
+    return FormatError(error_text, reason);
 }
 
 /*
- *  ReportError()
+ *  FormatError()
  *
  *  Description:
- *      This function will report an error to the user by displaying a
- *      message box.  The message to render is provided as the first parameter.
- *      The second parameter contains either ERROR_SUCCESS or some error
- *      code from GetLastError().  If an error code is provided, the message
- *      will be formatted for user consumption.
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter.  The second parameter
+ *      contains either ERROR_SUCCESS or some error code from GetLastError().
+ *      If an error code is provided, the message will be formatted for user
+ *      consumption.
  *
  *  Parameters:
- *      window_title [in]
- *          The text of the title in the message box.
- *
  *      message [in]
- *         The message to show the user.
+ *         The message describing the error.
  *
  *      reason [in]
  *         The reason for the error (generally, the value from GetLastError()).
  *
  *  Returns:
- *      Nothing.
+ *      The text describing the error.
  *
  *  Comments:
  *      None.
  */
-void ReportError(const std::wstring &window_title,
-                 const std::wstring &message,
-                 DWORD reason)
+std::wstring FormatError(const std::wstring &message, DWORD reason)
 {
     // Copy the message to report (which may be revised below)
     std::wstring reported_message = message;
@@ -196,5 +182,117 @@ void ReportError(const std::wstring &window_title,
         }
     }
 
-    ::MessageBox(NULL, reported_message.c_str(), window_title.c_str(), MB_OK);
+    return reported_message;
+}
+
+/*
+ *  ReportError()
+ *
+ *  Description:
+ *      This function will report an error to the user by displaying a
+ *      message box.  The message to render is provided as the first parameter.
+ *      The second parameter contains either ERROR_SUCCESS or some error
+ *      code from GetLastError().  If an error code is provided, the message
+ *      will be formatted for user consumption.
+ *
+ *  Parameters:
+ *      window_title [in]
+ *          The text of the title in the message box.
+ *
+ *      message [in]
+ *         The message to show the user (encoded as UTF-8).
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ReportError(const std::wstring &window_title,
+                 const std::string &message,
+                 DWORD reason)
+{
+    ::MessageBox(NULL,
+                 FormatError(message, reason).c_str(),
+                 window_title.c_str(),
+                 MB_OK);
+}
+
+/*
+ *  ReportError()
+ *
+ *  Description:
+ *      This function will report an error to the user by displaying a
+ *      message box.  The message to render is provided as the first parameter.
+ *      The second parameter contains either ERROR_SUCCESS or some error
+ *      code from GetLastError().  If an error code is provided, the message
+ *      will be formatted for user consumption.
+ *
+ *  Parameters:
+ *      window_title [in]
+ *          The text of the title in the message box.
+ *
+ *      message [in]
+ *         The message to show the user.
+ *
+ *      error_string [in]
+ *          A UTF-8 error string that will be appended to the above message.
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ReportError(const std::wstring &window_title,
+                 const std::wstring &message,
+                 const std::string &error_string,
+                 DWORD reason)
+{
+    ::MessageBox(NULL,
+                 FormatError(message, error_string, reason).c_str(),
+                 window_title.c_str(),
+                 MB_OK);
+}
+
+/*
+ *  ReportError()
+ *
+ *  Description:
+ *      This function will report an error to the user by displaying a
+ *      message box.  The message to render is provided as the first parameter.
+ *      The second parameter contains either ERROR_SUCCESS or some error
+ *      code from GetLastError().  If an error code is provided, the message
+ *      will be formatted for user consumption.
+ *
+ *  Parameters:
+ *      window_title [in]
+ *          The text of the title in the message box.
+ *
+ *      message [in]
+ *         The message to show the user.
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ReportError(const std::wstring &window_title,
+                 const std::wstring &message,
+                 DWORD reason)
+{
+    ::MessageBox(NULL,
+                 FormatError(message, reason).c_str(),
+                 window_title.c_str(),
+                 MB_OK);
 }
@@ -9,7 +9,8 @@
  *      Paul E. Jones <paulej@packetizer.com>
  *
  *  Description:
- *      This file defines functions for reporting errors to the user.
+ *      This file defines functions for reporting errors to the user and for
+ *      formatting the text of those errors.
  *
  *  Portability Issues:
  *      None.
@@ -20,6 +21,87 @@
 #include <Windows.h>
 #include <string>
 
+/*
+ *  FormatError()
+ *
+ *  Description:
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter.  The second parameter
+ *      contains either ERROR_SUCCESS or some error code from GetLastError().
+ *      If an error code is provided, the message will be formatted for user
+ *      consumption.
+ *
+ *  Parameters:
+ *      message [in]
+ *         The message describing the error (encoded as UTF-8).
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      The text describing the error.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring FormatError(const std::string &message,
+                         DWORD reason = ERROR_SUCCESS);
+
+/*
+ *  FormatError()
+ *
+ *  Description:
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter, followed by a UTF-8
+ *      string to append to the message.  If an error code is provided, the
+ *      message will be formatted for user consumption.
+ *
+ *  Parameters:
+ *      message [in]
+ *         The message describing the error.
+ *
+ *      error_string [in]
+ *          A UTF-8 error string that will be appended to the above message.
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      The text describing the error.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring FormatError(const std::wstring &message,
+                         const std::string &error_string,
+                         DWORD reason = ERROR_SUCCESS);
+
+/*
+ *  FormatError()
+ *
+ *  Description:
+ *      This function will produce the text used to report an error.  The
+ *      message is provided as the first parameter.  The second parameter
+ *      contains either ERROR_SUCCESS or some error code from GetLastError().
+ *      If an error code is provided, the message will be formatted for user
+ *      consumption.
+ *
+ *  Parameters:
+ *      message [in]
+ *         The message describing the error.
+ *
+ *      reason [in]
+ *         The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      The text describing the error.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring FormatError(const std::wstring &message,
+                         DWORD reason = ERROR_SUCCESS);
+
 /*
  *  ReportError()
  *
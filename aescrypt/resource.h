@@ -7,6 +7,7 @@
 #define IDR_AESCRYPTSHELLEXTENSION      102
 #define IDD_PASSWDDIALOG                103
 #define IDD_PROGRESSDIALOG              104
+#define IDR_AESCRYPTINFOTIP             105
 #define IDB_CTXBITMAP                   201
 #define IDC_PASSWD                      202
 #define IDC_PASSWDCONFIRM               203
@@ -17,6 +18,8 @@
 #define IDC_PROGRESSBAR                 207
 #define IDC_ENCRYPTINGMSG               208
 #define IDC_FILENAME                    209
+#define IDC_BATCHSTATUS                 210
+#define IDC_BACKGROUND                  211
 
 // Next default values for new objects
 //
@@ -24,7 +27,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        207
 #define _APS_NEXT_COMMAND_VALUE         32768
-#define _APS_NEXT_CONTROL_VALUE         210
-#define _APS_NEXT_SYMED_VALUE           105
+#define _APS_NEXT_CONTROL_VALUE         212
+#define _APS_NEXT_SYMED_VALUE           106
 #endif
 #endif
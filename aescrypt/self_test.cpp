@@ -0,0 +1,405 @@
+/*
+ *  self_test.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the self-test of the cryptographic functions
+ *      and the diagnostic report.  The self-test encrypts a test pattern
+ *      and checks that it decrypts to the same data, that a wrong password
+ *      and an altered stream are both detected, and that two encryptions of
+ *      the same data differ.  Together, these exercise AES, HMAC-SHA-256,
+ *      PBKDF2-HMAC-SHA-512, and the random number generator through the
+ *      same engine interfaces used to process files.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#include "pch.h"
+#include <sstream>
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <cstdint>
+#include <cstddef>
+#include <terra/aescrypt/engine/encryptor.h>
+#include <terra/aescrypt/engine/decryptor.h>
+#include "self_test.h"
+#include "cpu_features.h"
+#include "trace_provider.h"
+#include "globals.h"
+
+namespace
+{
+
+// Number of KDF iterations used when testing, kept small for speed
+constexpr std::uint32_t Self_Test_Iterations = 1'000;
+
+// Size of the self-test pattern, which is deliberately not a multiple of
+// the AES block size so that padding is exercised
+constexpr std::size_t Self_Test_Size = 4'099;
+
+// Size of the data encrypted and decrypted to measure throughput
+constexpr std::size_t Throughput_Test_Size = 16'777'216;
+
+// Password used when testing
+const std::u8string Self_Test_Password = u8"AES Crypt self-test";
+
+/*
+ *  TestPattern()
+ *
+ *  Description:
+ *      Produce the data that is encrypted by the tests.
+ *
+ *  Parameters:
+ *      size [in]
+ *          The number of octets to produce.
+ *
+ *  Returns:
+ *      The test pattern.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string TestPattern(std::size_t size)
+{
+    std::string pattern(size, '\0');
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        pattern[i] = static_cast<char>((i * 31 + 7) & 0xff);
+    }
+
+    return pattern;
+}
+
+/*
+ *  Encrypt()
+ *
+ *  Description:
+ *      Encrypt the given data in memory.
+ *
+ *  Parameters:
+ *      plaintext [in]
+ *          The data to encrypt.
+ *
+ *      iterations [in]
+ *          The number of KDF iterations to perform.
+ *
+ *      ciphertext [out]
+ *          The resulting AES Crypt stream.
+ *
+ *  Returns:
+ *      True if encryption was successful.
+ *
+ *  Comments:
+ *      None.
+ */
+bool Encrypt(const std::string &plaintext,
+             std::uint32_t iterations,
+             std::string &ciphertext)
+{
+    Terra::AESCrypt::Engine::Encryptor encryptor;
+    std::istringstream istream(plaintext);
+    std::ostringstream ostream;
+
+    if (encryptor.Encrypt(Self_Test_Password, iterations, istream, ostream) !=
+        Terra::AESCrypt::Engine::EncryptResult::Success)
+    {
+        return false;
+    }
+
+    ciphertext = ostream.str();
+
+    return true;
+}
+
+/*
+ *  Decrypt()
+ *
+ *  Description:
+ *      Decrypt the given AES Crypt stream in memory.
+ *
+ *  Parameters:
+ *      password [in]
+ *          The password to use.
+ *
+ *      ciphertext [in]
+ *          The AES Crypt stream to decrypt.
+ *
+ *      plaintext [out]
+ *          The decrypted data.
+ *
+ *  Returns:
+ *      The result of decryption.
+ *
+ *  Comments:
+ *      None.
+ */
+Terra::AESCrypt::Engine::DecryptResult Decrypt(const std::u8string &password,
+                                               const std::string &ciphertext,
+                                               std::string &plaintext)
+{
+    Terra::AESCrypt::Engine::Decryptor decryptor;
+    std::istringstream istream(ciphertext);
+    std::ostringstream ostream;
+
+    auto result = decryptor.Decrypt(password, istream, ostream);
+
+    plaintext = ostream.str();
+
+    return result;
+}
+
+/*
+ *  PerformSelfTest()
+ *
+ *  Description:
+ *      Perform the tests of the cryptographic functions.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      An empty string if all tests pass, else a description of the first
+ *      test that failed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring PerformSelfTest()
+{
+    const std::string pattern = TestPattern(Self_Test_Size);
+    std::string ciphertext;
+    std::string second_ciphertext;
+    std::string plaintext;
+
+    if (!Encrypt(pattern, Self_Test_Iterations, ciphertext) ||
+        !Encrypt(pattern, Self_Test_Iterations, second_ciphertext))
+    {
+        return L"Encryption failed";
+    }
+
+    // The random IV and session key must make each encryption unique
+    if (ciphertext == second_ciphertext)
+    {
+        return L"Encryption produced identical output twice";
+    }
+
+    if ((Decrypt(Self_Test_Password, ciphertext, plaintext) !=
+         Terra::AESCrypt::Engine::DecryptResult::Success) ||
+        (plaintext != pattern))
+    {
+        return L"Decryption did not reproduce the original data";
+    }
+
+    if (Decrypt(u8"AES Crypt self-test?", ciphertext, plaintext) ==
+        Terra::AESCrypt::Engine::DecryptResult::Success)
+    {
+        return L"Decryption with the wrong password was not detected";
+    }
+
+    // Alter the last octet of the ciphertext preceding the final HMAC
+    if (ciphertext.size() < 33) return L"Encryption output is too short";
+    ciphertext[ciphertext.size() - 33] ^= 0x01;
+
+    if (Decrypt(Self_Test_Password, ciphertext, plaintext) ==
+        Terra::AESCrypt::Engine::DecryptResult::Success)
+    {
+        return L"Alteration of the encrypted data was not detected";
+    }
+
+    return {};
+}
+
+/*
+ *  MeasureRate()
+ *
+ *  Description:
+ *      Express the rate at which data was processed in MB/s.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets processed.
+ *
+ *      elapsed [in]
+ *          The time taken to process them.
+ *
+ *  Returns:
+ *      The rate as text.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring MeasureRate(std::size_t octets,
+                         std::chrono::steady_clock::duration elapsed)
+{
+    auto microseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+            .count();
+    if (microseconds <= 0) microseconds = 1;
+
+    return std::to_wstring(static_cast<std::uint64_t>(octets) /
+                           static_cast<std::uint64_t>(microseconds)) +
+           L" MB/s";
+}
+
+} // namespace
+
+/*
+ *  RunSelfTest()
+ *
+ *  Description:
+ *      Test the cryptographic functions, which is done the first time this
+ *      function is called.  Subsequent calls return the same result.
+ *
+ *  Parameters:
+ *      failure [out]
+ *          Text describing the failure if the self-test failed.
+ *
+ *  Returns:
+ *      True if the self-test passed, false otherwise.
+ *
+ *  Comments:
+ *      This is called before the first request is processed, so no file is
+ *      encrypted or decrypted unless the self-test passes.  The result and
+ *      the processor features are also written as a trace event.
+ */
+bool RunSelfTest(std::wstring &failure)
+{
+    static std::once_flag self_test_flag;
+    static std::wstring self_test_failure;
+
+    std::call_once(
+        self_test_flag,
+        []()
+        {
+            auto start_time = std::chrono::steady_clock::now();
+
+            try
+            {
+                self_test_failure = PerformSelfTest();
+            }
+            catch (const std::exception &)
+            {
+                self_test_failure = L"Exception during the self-test";
+            }
+            catch (...)
+            {
+                self_test_failure = L"Exception during the self-test";
+            }
+
+            std::uint64_t duration = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start_time)
+                    .count());
+            const CPUFeatures &features = GetCPUFeatures();
+
+            TraceLoggingWrite(AES_Crypt_Trace_Provider,
+                              "SelfTest",
+                              TraceLoggingBool(self_test_failure.empty(),
+                                               "Passed"),
+                              TraceLoggingWideString(self_test_failure.c_str(),
+                                                     "Failure"),
+                              TraceLoggingUInt64(duration,
+                                                 "DurationMicroseconds"),
+                              TraceLoggingBool(features.aes_ni, "AESNI"),
+                              TraceLoggingBool(features.vaes, "VAES"),
+                              TraceLoggingBool(features.avx2, "AVX2"),
+                              TraceLoggingBool(features.sha_ni, "SHANI"));
+        });
+
+    if (self_test_failure.empty()) return true;
+
+    failure = L"The cryptographic self-test failed: " + self_test_failure;
+
+    return false;
+}
+
+/*
+ *  GetCryptoDiagnostics()
+ *
+ *  Description:
+ *      Produce a report giving the processor features that accelerate AES
+ *      and SHA, the result of the self-test, and the measured performance
+ *      of key derivation, encryption, and decryption.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The report as text, one item per line.
+ *
+ *  Comments:
+ *      The cryptographic libraries select their implementations internally,
+ *      so the measured throughput is what shows whether the processor's
+ *      AES and SHA instructions are being put to use.  Producing the report
+ *      takes around a second, most of which is the key derivation.
+ */
+std::wstring GetCryptoDiagnostics()
+{
+    std::wstring report = L"Processor features:\n" +
+                          DescribeCPUFeatures(GetCPUFeatures());
+    std::wstring failure;
+    std::string ciphertext;
+    std::string plaintext;
+
+    if (!RunSelfTest(failure))
+    {
+        return report + failure + L"\n";
+    }
+
+    report += L"Self-test: passed\n";
+
+    try
+    {
+        const std::string pattern = TestPattern(Throughput_Test_Size);
+
+        // Measure the KDF using an empty input
+        auto start_time = std::chrono::steady_clock::now();
+        if (!Encrypt({}, KDF_Iterations, ciphertext))
+        {
+            return report + L"Key derivation failed\n";
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        report +=
+            L"Key derivation (" + std::to_wstring(KDF_Iterations) +
+            L" iterations): " +
+            std::to_wstring(
+                std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+                    .count()) +
+            L" ms\n";
+
+        // Measure encryption and decryption, using few KDF iterations
+        start_time = std::chrono::steady_clock::now();
+        if (!Encrypt(pattern, Self_Test_Iterations, ciphertext))
+        {
+            return report + L"Encryption failed\n";
+        }
+        elapsed = std::chrono::steady_clock::now() - start_time;
+        report += L"Encryption: " + MeasureRate(pattern.size(), elapsed) +
+                  L"\n";
+
+        start_time = std::chrono::steady_clock::now();
+        if (Decrypt(Self_Test_Password, ciphertext, plaintext) !=
+            Terra::AESCrypt::Engine::DecryptResult::Success)
+        {
+            return report + L"Decryption failed\n";
+        }
+        elapsed = std::chrono::steady_clock::now() - start_time;
+        report += L"Decryption: " + MeasureRate(pattern.size(), elapsed) +
+                  L"\n";
+    }
+    catch (const std::exception &)
+    {
+        report += L"Exception measuring performance\n";
+    }
+
+    return report;
+}
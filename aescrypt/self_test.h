@@ -0,0 +1,29 @@
+/*
+ *  self_test.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file declares the functions that test the cryptographic
+ *      functions before any files are processed and that produce the
+ *      diagnostic report of the processor features and the performance of
+ *      the cryptographic functions on this machine.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <string>
+
+// Test the cryptographic functions, which is done only once per process
+bool RunSelfTest(std::wstring &failure);
+
+// Produce a report of the processor features, self-test, and performance
+std::wstring GetCryptoDiagnostics();
@@ -0,0 +1,235 @@
+/*
+ *  settings.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements a function to load the AES Crypt settings from
+ *      the Windows registry.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <thread>
+#include <string>
+#include "settings.h"
+#include "buffer_pool.h"
+
+namespace
+{
+
+/*
+ *  ReadRegistryDWORD()
+ *
+ *  Description:
+ *      Read a DWORD value from the given registry key under the given
+ *      registry root key.
+ *
+ *  Parameters:
+ *      root_key [in]
+ *          The registry root key (e.g., HKEY_CURRENT_USER).
+ *
+ *      key_name [in]
+ *          The name of the registry key holding the value.
+ *
+ *      name [in]
+ *          The name of the registry value to read.
+ *
+ *      value [out]
+ *          The value read from the registry.  This is unchanged if the
+ *          value could not be read.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ReadRegistryDWORD(HKEY root_key,
+                       const std::wstring &key_name,
+                       const wchar_t *name,
+                       DWORD &value)
+{
+    ATL::CRegKey reg;
+    DWORD registry_value{};
+
+    if (reg.Open(root_key, key_name.c_str(), KEY_READ) != ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    if (reg.QueryDWORDValue(name, registry_value) == ERROR_SUCCESS)
+    {
+        value = registry_value;
+    }
+}
+
+} // namespace
+
+/*
+ *  ReadSetting()
+ *
+ *  Description:
+ *      Read a DWORD setting, first from HKEY_LOCAL_MACHINE and then from
+ *      HKEY_CURRENT_USER so that the user's value takes precedence.
+ *
+ *  Parameters:
+ *      name [in]
+ *          The name of the registry value to read.
+ *
+ *      default_value [in]
+ *          The value to return if the setting is not found.
+ *
+ *      subkey [in]
+ *          The name of a key under the AES Crypt settings key holding the
+ *          value, or an empty string if the value is held directly in the
+ *          AES Crypt settings key.
+ *
+ *  Returns:
+ *      The value of the setting.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD ReadSetting(const wchar_t *name,
+                  DWORD default_value,
+                  const std::wstring &subkey)
+{
+    std::wstring key_name = Settings_Registry_Key;
+    DWORD value = default_value;
+
+    if (!subkey.empty()) key_name += L"\\" + subkey;
+
+    ReadRegistryDWORD(HKEY_LOCAL_MACHINE, key_name, name, value);
+    ReadRegistryDWORD(HKEY_CURRENT_USER, key_name, name, value);
+
+    return value;
+}
+
+/*
+ *  LoadSettings()
+ *
+ *  Description:
+ *      This function will load the AES Crypt settings from the registry.
+ *      Values are first read from HKEY_LOCAL_MACHINE and then from
+ *      HKEY_CURRENT_USER, allowing a user to override system-wide values.
+ *      Any value not found in the registry is assigned a default value.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The settings to use when processing files.
+ *
+ *  Comments:
+ *      None.
+ */
+Settings LoadSettings()
+{
+    Settings settings{};
+
+    // Number of files to process at once (zero means one per logical core)
+    settings.batch_threads = ReadSetting(L"BatchThreads", 0);
+    if (settings.batch_threads == 0)
+    {
+        settings.batch_threads = std::thread::hardware_concurrency();
+    }
+    if (settings.batch_threads == 0) settings.batch_threads = 1;
+
+    // Number of files to begin key derivation for ahead of streaming
+    settings.kdf_prefetch = ReadSetting(L"KDFPrefetch", 1);
+
+    // Threads shared by all requests (zero allows a full batch per core)
+    settings.pool_threads = ReadSetting(L"PoolThreads", 0);
+    if (settings.pool_threads == 0)
+    {
+        settings.pool_threads = settings.batch_threads + settings.kdf_prefetch;
+    }
+
+    // Whether to bypass the system file cache when reading and writing
+    settings.unbuffered_io = ReadSetting(L"UnbufferedIO", 0) != 0;
+
+    // Number of I/O requests to keep outstanding for each file
+    settings.io_queue_depth = ReadSetting(L"IOQueueDepth", 0);
+
+    // Size in KiB of each I/O request
+    settings.io_buffer_size =
+        static_cast<std::size_t>(ReadSetting(L"IOBufferSize", 0)) * 1024;
+
+    // Size in MiB at or above which local files are read via memory mapping
+    settings.mapped_io_threshold =
+        static_cast<std::uint64_t>(ReadSetting(L"MappedIOThreshold", 64)) *
+        1024 * 1024;
+
+    // Size in MiB at or above which encrypted output is written by a
+    // separate thread
+    settings.pipeline_threshold =
+        static_cast<std::uint64_t>(ReadSetting(L"PipelineThreshold", 64)) *
+        1024 * 1024;
+
+    // Compression algorithm to apply to files before encrypting them
+    settings.compression = ReadSetting(L"Compression", 0);
+
+    // Whether to encrypt several files into a single archive
+    settings.archive_mode = ReadSetting(L"ArchiveMode", 0) != 0;
+
+    // Whether to encrypt only new or changed files
+    settings.sync_mode = ReadSetting(L"SyncMode", 0) != 0;
+
+    // Whether to continue processing files after a file fails
+    settings.continue_on_error = ReadSetting(L"ContinueOnError", 0) != 0;
+
+    // Whether to close output files on a pool thread
+    settings.background_close = ReadSetting(L"BackgroundClose", 1) != 0;
+
+    // Whether to reserve space for output files before writing
+    settings.preallocate_output = ReadSetting(L"PreallocateOutput", 1) != 0;
+
+    // Size in MiB of the idle I/O buffers retained for reuse
+    settings.buffer_pool_size =
+        static_cast<std::size_t>(ReadSetting(
+            L"BufferPoolSize",
+            static_cast<DWORD>(Buffer_Pool_Limit / (1024 * 1024)))) *
+        1024 * 1024;
+
+    // Whether to lock I/O buffers into physical memory
+    settings.lock_buffers = ReadSetting(L"LockBuffers", 0) != 0;
+
+    // Size in MiB of the memory that streaming files may use in total and
+    // within each batch
+    settings.memory_budget =
+        static_cast<std::uint64_t>(ReadSetting(L"MemoryBudget", 0)) *
+        1024 * 1024;
+    settings.job_memory_budget =
+        static_cast<std::uint64_t>(ReadSetting(L"JobMemoryBudget", 0)) *
+        1024 * 1024;
+
+    // Whether to keep a journal allowing an incomplete batch to be resumed
+    settings.batch_journal = ReadSetting(L"BatchJournal", 1) != 0;
+
+    // Format of the performance report written for each batch, if any
+    settings.batch_report = ReadSetting(L"BatchReport", 0);
+
+    // Whether to hand requests to the batch host
+    settings.batch_host = ReadSetting(L"BatchHost", 1) != 0;
+
+    // Whether to process files in background mode
+    settings.background_mode = ReadSetting(L"BackgroundMode", 0) != 0;
+
+    // Rate limit in MB/s applied in background mode
+    settings.bandwidth_limit =
+        static_cast<std::uint64_t>(ReadSetting(L"BandwidthLimit", 0)) *
+        1'000'000;
+
+    // Processor share in percent applied in background mode
+    settings.cpu_share = ReadSetting(L"CPUShare", 0);
+
+    return settings;
+}
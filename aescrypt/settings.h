@@ -0,0 +1,167 @@
+/*
+ *  settings.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the Settings structure, which holds the values that
+ *      control how AES Crypt processes files, and a function to load those
+ *      values from the Windows registry.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Registry key (under HKLM and HKCU) where AES Crypt settings are stored
+constexpr wchar_t Settings_Registry_Key[] = L"Software\\Terrapane\\AES Crypt";
+
+// Structure holding the configurable AES Crypt settings
+struct Settings
+{
+    // Number of files to process concurrently in a batch
+    std::size_t batch_threads;
+
+    // Number of additional files for which key derivation may proceed while
+    // the maximum number of files are streaming
+    std::size_t kdf_prefetch;
+
+    // Maximum number of threads shared by all requests
+    std::size_t pool_threads;
+
+    // Use unbuffered I/O (bypassing the system file cache) when possible
+    bool unbuffered_io;
+
+    // Number of file I/O buffers that may have I/O outstanding per file
+    // (zero selects a queue depth for the volume)
+    std::size_t io_queue_depth;
+
+    // Size of each file I/O request (zero selects a size for the volume)
+    std::size_t io_buffer_size;
+
+    // Minimum size of a file on a local volume to read via memory mapping
+    // (zero disables memory-mapped reading)
+    std::uint64_t mapped_io_threshold;
+
+    // Minimum size of a file whose encrypted output is written on a separate
+    // thread (zero disables pipelined writing)
+    std::uint64_t pipeline_threshold;
+
+    // Compress files before encrypting them (zero disables compression and
+    // values 1 through 4 select algorithms from fastest to most compact)
+    unsigned compression;
+
+    // Encrypt a selection of several files or directories into a single
+    // archive rather than encrypting each file separately
+    bool archive_mode;
+
+    // Encrypt only files that are new or have changed since their existing
+    // encrypted output was produced, replacing the outdated output
+    bool sync_mode;
+
+    // Continue with the remaining files when a file cannot be processed,
+    // listing the files that failed once the batch is complete
+    bool continue_on_error;
+
+    // Close each output file on a pool thread so that the next file may be
+    // processed while buffered data is written (e.g., to a network share)
+    bool background_close;
+
+    // Reserve space for each new output file before writing it
+    bool preallocate_output;
+
+    // Number of octets of idle I/O buffers kept for reuse between files
+    std::size_t buffer_pool_size;
+
+    // Lock I/O buffers into memory so they are never paged to disk
+    bool lock_buffers;
+
+    // Number of octets of memory that may be used by the files streaming in
+    // all batches and in each batch (zero imposes no limit)
+    std::uint64_t memory_budget;
+    std::uint64_t job_memory_budget;
+
+    // Record the files completed by each batch so that a batch that does
+    // not complete can be resumed by processing the same selection again
+    bool batch_journal;
+
+    // Write a performance report for each batch (zero disables the report,
+    // 1 selects JSON, and 2 selects CSV)
+    unsigned batch_report;
+
+    // Hand requests from Explorer and aescrypt32.exe to a single process
+    // for the logon session rather than processing them in each process
+    bool batch_host;
+
+    // Process files with low CPU and I/O priority, subject to the limits
+    // below (this may also be changed from the progress dialog)
+    bool background_mode;
+
+    // Maximum rate in octets per second at which data is processed in
+    // background mode (zero means no limit)
+    std::uint64_t bandwidth_limit;
+
+    // Percentage of a processor each thread may use in background mode
+    // (zero means no limit)
+    unsigned cpu_share;
+};
+
+/*
+ *  LoadSettings()
+ *
+ *  Description:
+ *      This function will load the AES Crypt settings from the registry.
+ *      Values are first read from HKEY_LOCAL_MACHINE and then from
+ *      HKEY_CURRENT_USER, allowing a user to override system-wide values.
+ *      Any value not found in the registry is assigned a default value.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The settings to use when processing files.
+ *
+ *  Comments:
+ *      None.
+ */
+Settings LoadSettings();
+
+/*
+ *  ReadSetting()
+ *
+ *  Description:
+ *      Read a DWORD setting, first from HKEY_LOCAL_MACHINE and then from
+ *      HKEY_CURRENT_USER so that the user's value takes precedence.
+ *
+ *  Parameters:
+ *      name [in]
+ *          The name of the registry value to read.
+ *
+ *      default_value [in]
+ *          The value to return if the setting is not found.
+ *
+ *      subkey [in]
+ *          The name of a key under the AES Crypt settings key holding the
+ *          value, or an empty string if the value is held directly in the
+ *          AES Crypt settings key.
+ *
+ *  Returns:
+ *      The value of the setting.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD ReadSetting(const wchar_t *name,
+                  DWORD default_value,
+                  const std::wstring &subkey = {});
@@ -0,0 +1,164 @@
+/*
+ *  text_convert.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements functions to convert text between UTF-16 and
+ *      UTF-8 and to escape UTF-8 text for use in JSON.
+ *
+ *  Portability Issues:
+ *      It is assumed that wchar_t is a two-octet value.  A static assertion
+ *      exists to highlight this fact should that not be the case on a
+ *      target system.
+ */
+
+#include <span>
+#include <cstdint>
+#include <cstdio>
+#include <terra/charutil/character_utilities.h>
+#include <terra/bitutil/byte_order.h>
+#include "text_convert.h"
+
+/*
+ *  ConvertToUTF8()
+ *
+ *  Description:
+ *      Convert the UTF-16 string to UTF-8.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The UTF-8 string, or an empty string if conversion failed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string ConvertToUTF8(const std::wstring &text)
+{
+    // This function assumes a wchar_t holds a UTF-16 value
+    static_assert(sizeof(wchar_t) == 2);
+
+    std::string utf8_text(text.size() * 3, '\0');
+
+    auto [convert_success, length] = Terra::CharUtil::ConvertUTF16ToUTF8(
+        std::span<const std::uint8_t>(
+            reinterpret_cast<const std::uint8_t *>(text.data()),
+            text.size() * sizeof(wchar_t)),
+        std::span<std::uint8_t>(
+            reinterpret_cast<std::uint8_t *>(utf8_text.data()),
+            utf8_text.size()),
+        Terra::BitUtil::IsLittleEndian());
+
+    if (!convert_success) return {};
+
+    utf8_text.resize(length);
+
+    return utf8_text;
+}
+
+/*
+ *  ConvertToUTF16()
+ *
+ *  Description:
+ *      Convert the UTF-8 string to UTF-16.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The UTF-16 string, or an empty string if conversion failed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring ConvertToUTF16(const std::string &text)
+{
+    // This function assumes a wchar_t holds a UTF-16 value
+    static_assert(sizeof(wchar_t) == 2);
+
+    std::wstring utf16_text(text.size(), L'\0');
+
+    auto [convert_success, length] = Terra::CharUtil::ConvertUTF8ToUTF16(
+        {reinterpret_cast<const std::uint8_t *>(text.data()), text.size()},
+        {reinterpret_cast<std::uint8_t *>(utf16_text.data()),
+         utf16_text.size() * sizeof(wchar_t)},
+        Terra::BitUtil::IsLittleEndian());
+
+    if (!convert_success) return {};
+
+    // The length is in octets, resize to two-octet characters
+    utf16_text.resize(length / 2);
+
+    return utf16_text;
+}
+
+/*
+ *  EscapeJSON()
+ *
+ *  Description:
+ *      Escape the UTF-8 string so that it may be placed in a JSON string.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The text to escape.
+ *
+ *  Returns:
+ *      The escaped text.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string EscapeJSON(const std::string &text)
+{
+    std::string escaped_text;
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '"':
+                escaped_text += "\\\"";
+                break;
+
+            case '\\':
+                escaped_text += "\\\\";
+                break;
+
+            case '\n':
+                escaped_text += "\\n";
+                break;
+
+            case '\r':
+                escaped_text += "\\r";
+                break;
+
+            case '\t':
+                escaped_text += "\\t";
+                break;
+
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped_text += code;
+                }
+                else
+                {
+                    escaped_text += c;
+                }
+                break;
+        }
+    }
+
+    return escaped_text;
+}
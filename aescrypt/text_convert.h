@@ -0,0 +1,31 @@
+/*
+ *  text_convert.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines functions to convert text between UTF-16 and UTF-8
+ *      (e.g., to write file names to journals, reports, pipes, and archives)
+ *      and to escape UTF-8 text for use in JSON.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <string>
+
+// Convert the UTF-16 string to UTF-8, returning an empty string on failure
+std::string ConvertToUTF8(const std::wstring &text);
+
+// Convert the UTF-8 string to UTF-16, returning an empty string on failure
+std::wstring ConvertToUTF16(const std::string &text);
+
+// Escape the UTF-8 string so that it may be placed within a JSON string
+std::string EscapeJSON(const std::string &text);
@@ -0,0 +1,338 @@
+/*
+ *  thread_pool.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the ThreadPool class, a persistent pool of worker
+ *      threads that execute jobs taken from a shared queue.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <thread>
+#include <algorithm>
+#include "thread_pool.h"
+
+namespace
+{
+
+/*
+ *  PoolThreadEntry()
+ *
+ *  Description:
+ *      This is the entry point for threads created by the ThreadPool.  The
+ *      thread holds a reference to this module while it runs so that the
+ *      module cannot be unloaded while the thread is executing code within
+ *      it, releasing the reference only as the thread exits.
+ *
+ *  Parameters:
+ *      lpParameter [in]
+ *          A pointer to the ThreadPool object.
+ *
+ *  Returns:
+ *      Always returns 0.
+ *
+ *  Comments:
+ *      None.
+ */
+DWORD WINAPI PoolThreadEntry(LPVOID lpParameter)
+{
+    HMODULE module{};
+
+    ThreadPool *thread_pool = reinterpret_cast<ThreadPool *>(lpParameter);
+
+    // Take a reference to this module for the life of the thread
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                      reinterpret_cast<LPCWSTR>(thread_pool),
+                      &module);
+
+    thread_pool->WorkerLoop();
+
+    if (module != nullptr) FreeLibraryAndExitThread(module, 0);
+
+    return 0;
+}
+
+} // namespace
+
+/*
+ *  ThreadPool::ThreadPool()
+ *
+ *  Description:
+ *      Constructor for the ThreadPool object.  No threads are created until
+ *      jobs are submitted.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+ThreadPool::ThreadPool() :
+    last_job_id{0},
+    thread_limit{0},
+    thread_count{0},
+    idle_threads{0},
+    active_jobs{0},
+    shutdown{false}
+{
+    SetThreadLimit(0);
+}
+
+/*
+ *  ThreadPool::~ThreadPool()
+ *
+ *  Description:
+ *      Destructor for the ThreadPool object.  Idle threads are told to exit.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Since each pool thread holds a reference to the module, the module
+ *      (and therefore this object) is only destroyed once all pool threads
+ *      have exited or when the process is terminating, so there are no
+ *      threads for which to wait.
+ */
+ThreadPool::~ThreadPool()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    shutdown = true;
+    cv.notify_all();
+}
+
+/*
+ *  ThreadPool::SetThreadLimit()
+ *
+ *  Description:
+ *      Set the maximum number of threads in the pool.
+ *
+ *  Parameters:
+ *      limit [in]
+ *          The maximum number of threads.  If zero, the limit is the number
+ *          of logical processors.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Lowering the limit does not terminate threads already running, but
+ *      no new threads are created until the count falls below the limit.
+ */
+void ThreadPool::SetThreadLimit(std::size_t limit)
+{
+    if (limit == 0) limit = std::thread::hardware_concurrency();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    thread_limit = std::max(limit, std::size_t(1));
+}
+
+/*
+ *  ThreadPool::Submit()
+ *
+ *  Description:
+ *      Place a job on the queue to be executed by a pool thread, creating
+ *      a new thread if no thread is idle and the thread limit allows.
+ *
+ *  Parameters:
+ *      job [in]
+ *          The function to execute.
+ *
+ *  Returns:
+ *      The identifier of the submitted job, or zero if there are no threads
+ *      to execute it and no thread could be created.
+ *
+ *  Comments:
+ *      Jobs must handle their own exceptions.
+ */
+ThreadPool::JobID ThreadPool::Submit(std::function<void()> job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    JobID job_id = ++last_job_id;
+
+    jobs.emplace_back(job_id, std::move(job));
+
+    // Create a thread if there are more jobs than idle threads
+    if ((idle_threads < jobs.size()) && (thread_count < thread_limit))
+    {
+        CreateWorker();
+    }
+
+    // If there are no threads at all, the job can never run
+    if (thread_count == 0)
+    {
+        jobs.pop_back();
+        return 0;
+    }
+
+    cv.notify_one();
+
+    return job_id;
+}
+
+/*
+ *  ThreadPool::Revoke()
+ *
+ *  Description:
+ *      Remove a job from the queue if a thread has not yet started to
+ *      execute it.
+ *
+ *  Parameters:
+ *      job_id [in]
+ *          The identifier of the job to remove.
+ *
+ *  Returns:
+ *      True if the job was removed and will not be executed, false if the
+ *      job has already started (or finished).
+ *
+ *  Comments:
+ *      None.
+ */
+bool ThreadPool::Revoke(JobID job_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = std::find_if(jobs.begin(),
+                           jobs.end(),
+                           [job_id](const auto &job)
+                           {
+                               return job.first == job_id;
+                           });
+    if (it == jobs.end()) return false;
+
+    jobs.erase(it);
+
+    return true;
+}
+
+/*
+ *  ThreadPool::IsBusy()
+ *
+ *  Description:
+ *      Returns true if there are jobs waiting in the queue or running.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if there are queued or running jobs, false otherwise.
+ *
+ *  Comments:
+ *      Idle threads do not make the pool busy.  They hold a reference to
+ *      the module, so it will not be unloaded until they have exited.
+ */
+bool ThreadPool::IsBusy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return !jobs.empty() || (active_jobs > 0);
+}
+
+/*
+ *  ThreadPool::CreateWorker()
+ *
+ *  Description:
+ *      Create a new pool thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if the thread was created, false otherwise.
+ *
+ *  Comments:
+ *      The mutex must be locked when calling this function.
+ */
+bool ThreadPool::CreateWorker()
+{
+    HANDLE thread_handle =
+        CreateThread(NULL, 0, ::PoolThreadEntry, this, 0, NULL);
+
+    if (thread_handle == NULL) return false;
+
+    // The thread is never joined, so the handle is not needed
+    CloseHandle(thread_handle);
+
+    thread_count++;
+
+    return true;
+}
+
+/*
+ *  ThreadPool::WorkerLoop()
+ *
+ *  Description:
+ *      This function is executed by each pool thread.  It will execute jobs
+ *      from the queue until the pool is destroyed or no job arrives within
+ *      the idle timeout period.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void ThreadPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        // Wait for a job to arrive
+        idle_threads++;
+        bool have_job = cv.wait_for(lock,
+                                    Pool_Idle_Timeout,
+                                    [&]() -> bool
+                                    {
+                                        return shutdown || !jobs.empty();
+                                    });
+        idle_threads--;
+
+        // Exit if idle for too long or if the pool is being destroyed
+        if (!have_job || shutdown) break;
+
+        auto job = std::move(jobs.front().second);
+        jobs.pop_front();
+        active_jobs++;
+
+        lock.unlock();
+
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+            // Jobs are expected to handle their own exceptions
+        }
+
+        // Release anything captured by the job before taking the lock
+        job = nullptr;
+
+        lock.lock();
+
+        active_jobs--;
+    }
+
+    thread_count--;
+}
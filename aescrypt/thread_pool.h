@@ -0,0 +1,74 @@
+/*
+ *  thread_pool.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the ThreadPool class, a persistent pool of worker
+ *      threads that execute jobs taken from a shared queue.  All requests to
+ *      encrypt or decrypt files share the same pool, which limits the total
+ *      number of threads competing for the processor.  Idle threads exit
+ *      after a period of inactivity.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <utility>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Time an idle pool thread waits for a job before exiting
+constexpr std::chrono::seconds Pool_Idle_Timeout(30);
+
+// Class implementing a pool of threads fed by a job queue
+class ThreadPool
+{
+    public:
+        // Identifier for a submitted job (zero is never a valid identifier)
+        using JobID = std::uint64_t;
+
+        ThreadPool();
+        ~ThreadPool();
+
+        // Set the maximum number of threads (zero means one per core)
+        void SetThreadLimit(std::size_t limit);
+
+        // Submit a job, returning its identifier or zero on failure
+        JobID Submit(std::function<void()> job);
+
+        // Remove a job from the queue if it has not yet started
+        bool Revoke(JobID job_id);
+
+        // Indicates whether jobs are queued or running
+        bool IsBusy();
+
+        // This should only be called by threads created by this class
+        void WorkerLoop();
+
+    protected:
+        bool CreateWorker();
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::pair<JobID, std::function<void()>>> jobs;
+        JobID last_job_id;
+        std::size_t thread_limit;
+        std::size_t thread_count;
+        std::size_t idle_threads;
+        std::size_t active_jobs;
+        bool shutdown;
+};
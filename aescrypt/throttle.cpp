@@ -0,0 +1,277 @@
+/*
+ *  throttle.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file implements the Throttle class and the function that
+ *      places threads into background processing mode.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <algorithm>
+#include "throttle.h"
+
+namespace
+{
+
+/*
+ *  ThreadCPUTime()
+ *
+ *  Description:
+ *      Return the processor time consumed by the calling thread.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The kernel and user time of the thread in 100 ns units, or zero if
+ *      it cannot be determined.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t ThreadCPUTime()
+{
+    FILETIME creation_time;
+    FILETIME exit_time;
+    FILETIME kernel_time;
+    FILETIME user_time;
+
+    if (!::GetThreadTimes(::GetCurrentThread(),
+                          &creation_time,
+                          &exit_time,
+                          &kernel_time,
+                          &user_time))
+    {
+        return 0;
+    }
+
+    auto to_integer = [](const FILETIME &time) -> std::uint64_t
+    {
+        return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+               time.dwLowDateTime;
+    };
+
+    return to_integer(kernel_time) + to_integer(user_time);
+}
+
+} // namespace
+
+/*
+ *  Throttle::StreamState::StreamState()
+ *
+ *  Description:
+ *      Constructor for the StreamState object, which records the processor
+ *      time the calling thread had consumed when the stream started.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Since the time is recorded before the key is derived, the processor
+ *      time spent on key derivation also counts toward the thread's share.
+ */
+Throttle::StreamState::StreamState() :
+    position{},
+    cpu_time{ThreadCPUTime()}
+{
+}
+
+/*
+ *  Throttle::Throttle()
+ *
+ *  Description:
+ *      Constructor for the Throttle object, which initially imposes no
+ *      limits.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+Throttle::Throttle() :
+    rate{},
+    cpu_share{},
+    tokens{},
+    last_refill{std::chrono::steady_clock::now()}
+{
+}
+
+/*
+ *  Throttle::Configure()
+ *
+ *  Description:
+ *      Set the limits imposed on the batch.
+ *
+ *  Parameters:
+ *      octets_per_second [in]
+ *          The maximum rate at which the batch may process data, or zero
+ *          for no limit.
+ *
+ *      cpu_share [in]
+ *          The percentage of a processor each thread may use, with zero or
+ *          values of 100 or more imposing no limit.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This may be called while the batch is being processed.  The token
+ *      bucket starts empty so that the limit applies from the outset.
+ */
+void Throttle::Configure(std::uint64_t octets_per_second, unsigned cpu_share)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    rate = octets_per_second;
+    this->cpu_share = (cpu_share < 100) ? cpu_share : 0;
+    tokens = 0.0;
+    last_refill = std::chrono::steady_clock::now();
+}
+
+/*
+ *  Throttle::IsLimited()
+ *
+ *  Description:
+ *      Indicates whether a rate or processor share limit is in effect.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if a limit is in effect, false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool Throttle::IsLimited() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return (rate > 0) || (cpu_share > 0);
+}
+
+/*
+ *  Throttle::Pace()
+ *
+ *  Description:
+ *      Account for the data processed and processor time consumed since
+ *      the previous call for the stream, returning how long the thread
+ *      should pause to remain within the limits.
+ *
+ *  Parameters:
+ *      state [in/out]
+ *          The state of the stream being processed on the calling thread.
+ *
+ *      position [in]
+ *          The number of octets of the stream processed so far.
+ *
+ *  Returns:
+ *      The time for which the thread should pause (possibly zero).
+ *
+ *  Comments:
+ *      The token bucket allows a burst of up to one second of data.  Any
+ *      thread taking more than is available is asked to wait until the
+ *      deficit is repaid, so the combined rate of all threads sharing the
+ *      throttle converges to the limit.  For the processor share, a thread
+ *      that used T of processor time pauses for T * (100 - share) / share.
+ */
+std::chrono::microseconds Throttle::Pace(StreamState &state,
+                                         std::uint64_t position)
+{
+    std::chrono::microseconds delay{};
+    unsigned share;
+
+    std::uint64_t octets =
+        (position > state.position) ? position - state.position : 0;
+    state.position = std::max(position, state.position);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (rate > 0)
+        {
+            auto now = std::chrono::steady_clock::now();
+            double elapsed =
+                std::chrono::duration<double>(now - last_refill).count();
+
+            last_refill = now;
+            tokens = std::min(tokens + elapsed * static_cast<double>(rate),
+                              static_cast<double>(rate));
+            tokens -= static_cast<double>(octets);
+
+            if (tokens < 0.0)
+            {
+                delay = std::chrono::microseconds(static_cast<std::int64_t>(
+                    -tokens * 1'000'000.0 / static_cast<double>(rate)));
+            }
+        }
+
+        share = cpu_share;
+    }
+
+    if (share > 0)
+    {
+        std::uint64_t cpu_time = ThreadCPUTime();
+        std::uint64_t consumed =
+            (cpu_time > state.cpu_time) ? cpu_time - state.cpu_time : 0;
+
+        state.cpu_time = cpu_time;
+
+        // Convert from 100 ns units to microseconds
+        delay += std::chrono::microseconds(
+            static_cast<std::int64_t>(consumed * (100 - share) / share / 10));
+    }
+
+    return delay;
+}
+
+/*
+ *  SetThreadBackgroundMode()
+ *
+ *  Description:
+ *      Place the calling thread into or out of background processing mode,
+ *      which lowers its CPU scheduling, I/O, and memory priorities.
+ *
+ *  Parameters:
+ *      background [in]
+ *          True to enter background mode, false to leave it.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The mode is tracked per thread so that redundant calls do nothing;
+ *      Windows fails a request to enter background mode when the thread is
+ *      already in it.  Threads from the thread pool must leave background
+ *      mode before being used for other work.
+ */
+void SetThreadBackgroundMode(bool background)
+{
+    thread_local bool in_background = false;
+
+    if (background == in_background) return;
+
+    if (::SetThreadPriority(::GetCurrentThread(),
+                            background ? THREAD_MODE_BACKGROUND_BEGIN :
+                                         THREAD_MODE_BACKGROUND_END))
+    {
+        in_background = background;
+    }
+}
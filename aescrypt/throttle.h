@@ -0,0 +1,71 @@
+/*
+ *  throttle.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the Throttle class, which limits the rate at which
+ *      a batch of files is processed so that a large batch may run without
+ *      degrading interactive use of the machine.  The rate of data across
+ *      all threads of the batch is limited using a token bucket, and the
+ *      share of a processor used by each thread is limited by pausing the
+ *      thread in proportion to the processor time it consumed.  Also
+ *      declared is SetThreadBackgroundMode(), which places the calling
+ *      thread into or out of background processing mode (i.e., low CPU,
+ *      I/O, and memory priority).
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Class that paces the processing of a batch of files
+class Throttle
+{
+    public:
+        // Per-stream state used to pace the processor share of a thread,
+        // which must be created on the thread processing the stream
+        struct StreamState
+        {
+            StreamState();
+
+            std::uint64_t position;
+            std::uint64_t cpu_time;
+        };
+
+        Throttle();
+        ~Throttle() = default;
+
+        // Set the rate limit (octets/second) and processor share (percent)
+        void Configure(std::uint64_t octets_per_second, unsigned cpu_share);
+
+        // Indicates whether any limit is in effect
+        bool IsLimited() const;
+
+        // Account for progress within a stream, returning the time the
+        // thread should pause
+        std::chrono::microseconds Pace(StreamState &state,
+                                       std::uint64_t position);
+
+    protected:
+        mutable std::mutex mutex;
+        std::uint64_t rate;
+        unsigned cpu_share;
+        double tokens;
+        std::chrono::steady_clock::time_point last_refill;
+};
+
+// Enter (true) or leave (false) background mode for the calling thread
+void SetThreadBackgroundMode(bool background);
@@ -0,0 +1,338 @@
+/*
+ *  trace_provider.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the TraceLogging (ETW) provider and implements the
+ *      TraceActivity and StreamTrace classes.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <evntrace.h>
+#include "trace_provider.h"
+
+// The provider GUID is derived from the name "Terrapane.AESCrypt" as per
+// the ETW convention, allowing sessions to enable the provider by name
+TRACELOGGING_DEFINE_PROVIDER(AES_Crypt_Trace_Provider,
+                             "Terrapane.AESCrypt",
+                             (0xb940d3fa,
+                              0x4235,
+                              0x53e0,
+                              0x9e, 0x7b, 0x50, 0x61, 0xa2, 0xad, 0xdb, 0xc0));
+
+/*
+ *  RegisterTraceProvider()
+ *
+ *  Description:
+ *      Register the trace provider so that events may be written.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      A failure to register is ignored, as events are simply not written.
+ */
+void RegisterTraceProvider()
+{
+    TraceLoggingRegister(AES_Crypt_Trace_Provider);
+}
+
+/*
+ *  UnregisterTraceProvider()
+ *
+ *  Description:
+ *      Unregister the trace provider.  This must be called before the DLL
+ *      is unloaded.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void UnregisterTraceProvider()
+{
+    TraceLoggingUnregister(AES_Crypt_Trace_Provider);
+}
+
+/*
+ *  TraceActivity::TraceActivity()
+ *
+ *  Description:
+ *      Constructor for the TraceActivity object, which writes the event
+ *      marking the start of the phase if tracing is enabled.
+ *
+ *  Parameters:
+ *      phase [in]
+ *          The name of the phase, which must be a string constant.
+ *
+ *      filename [in]
+ *          The name of the file being processed.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Nothing is recorded (nor the filename copied) if no trace session
+ *      has enabled the provider.
+ */
+TraceActivity::TraceActivity(const char *phase,
+                             const std::wstring &filename) :
+    enabled{TraceLoggingProviderEnabled(AES_Crypt_Trace_Provider, 0, 0)},
+    phase{phase},
+    activity_id{},
+    start_time{},
+    octets{},
+    result{ERROR_SUCCESS}
+{
+    if (!enabled) return;
+
+    this->filename = filename;
+
+    EventActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, &activity_id);
+    ::QueryPerformanceCounter(&start_time);
+
+    TraceLoggingWriteActivity(AES_Crypt_Trace_Provider,
+                              "PhaseStart",
+                              &activity_id,
+                              nullptr,
+                              TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                              TraceLoggingString(phase, "Phase"),
+                              TraceLoggingWideString(this->filename.c_str(),
+                                                     "File"));
+}
+
+/*
+ *  TraceActivity::~TraceActivity()
+ *
+ *  Description:
+ *      Destructor for the TraceActivity object, which ensures the event
+ *      marking the end of the phase is written.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+TraceActivity::~TraceActivity()
+{
+    Stop();
+}
+
+/*
+ *  TraceActivity::Stop()
+ *
+ *  Description:
+ *      Write the event marking the end of the phase, giving its duration,
+ *      the number of octets processed, and the result.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Only the first call has any effect, allowing the phase to end before
+ *      the object leaves scope.
+ */
+void TraceActivity::Stop()
+{
+    LARGE_INTEGER stop_time;
+    LARGE_INTEGER frequency;
+
+    if (!enabled) return;
+
+    enabled = false;
+
+    ::QueryPerformanceCounter(&stop_time);
+    ::QueryPerformanceFrequency(&frequency);
+
+    std::uint64_t duration =
+        static_cast<std::uint64_t>(stop_time.QuadPart - start_time.QuadPart) *
+        1'000'000 / static_cast<std::uint64_t>(frequency.QuadPart);
+
+    TraceLoggingWriteActivity(AES_Crypt_Trace_Provider,
+                              "PhaseStop",
+                              &activity_id,
+                              nullptr,
+                              TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                              TraceLoggingString(phase, "Phase"),
+                              TraceLoggingWideString(filename.c_str(), "File"),
+                              TraceLoggingUInt64(duration,
+                                                 "DurationMicroseconds"),
+                              TraceLoggingUInt64(octets, "Octets"),
+                              TraceLoggingUInt32(result, "Result"));
+}
+
+/*
+ *  StreamTrace::StreamTrace()
+ *
+ *  Description:
+ *      Constructor for the StreamTrace object.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file being processed.  This must remain valid
+ *          for the life of this object.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+StreamTrace::StreamTrace(const std::wstring &filename) :
+    filename{filename},
+    key_derivation_time{},
+    wait_time{},
+    stream_time{}
+{
+}
+
+/*
+ *  StreamTrace::Start()
+ *
+ *  Description:
+ *      Called just before the engine is given the stream, which will
+ *      first derive the key.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void StreamTrace::Start()
+{
+    phase_start = std::chrono::steady_clock::now();
+    key_derivation.emplace("KeyDerivation", filename);
+}
+
+/*
+ *  StreamTrace::KeyDerived()
+ *
+ *  Description:
+ *      Called when the engine first transfers the stream contents, which
+ *      happens once the key is derived and before waiting for permission
+ *      to stream.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void StreamTrace::KeyDerived()
+{
+    key_derivation_time = EndPhase();
+    key_derivation.reset();
+    waiting.emplace("StreamWait", filename);
+}
+
+/*
+ *  StreamTrace::Streaming()
+ *
+ *  Description:
+ *      Called when the wait for permission to stream completes.
+ *
+ *  Parameters:
+ *      allowed [in]
+ *          True if streaming was permitted.
+ *
+ *  Returns:
+ *      The value of allowed, so the result of the wait may be passed
+ *      through.
+ *
+ *  Comments:
+ *      None.
+ */
+bool StreamTrace::Streaming(bool allowed)
+{
+    wait_time = EndPhase();
+    waiting.reset();
+    if (allowed) streaming.emplace("Stream", filename);
+
+    return allowed;
+}
+
+/*
+ *  StreamTrace::Stop()
+ *
+ *  Description:
+ *      Called when the engine has finished with the stream.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets in the stream.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Any phase still in progress (e.g., key derivation for an empty or
+ *      unreadable stream) ends here.
+ */
+void StreamTrace::Stop(std::uint64_t octets)
+{
+    if (key_derivation) key_derivation_time = EndPhase();
+    if (waiting) wait_time = EndPhase();
+    if (streaming) stream_time = EndPhase();
+
+    key_derivation.reset();
+    waiting.reset();
+    if (streaming) streaming->SetOctets(octets);
+    streaming.reset();
+}
+
+/*
+ *  StreamTrace::EndPhase()
+ *
+ *  Description:
+ *      End the current phase, with the next phase (if any) starting now.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The number of microseconds spent in the phase that ended.
+ *
+ *  Comments:
+ *      None.
+ */
+std::uint64_t StreamTrace::EndPhase()
+{
+    auto now = std::chrono::steady_clock::now();
+    auto duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                              phase_start);
+
+    phase_start = now;
+
+    return static_cast<std::uint64_t>(duration.count());
+}
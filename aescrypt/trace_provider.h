@@ -0,0 +1,103 @@
+/*
+ *  trace_provider.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file declares the TraceLogging (ETW) provider used to record
+ *      where time is spent while processing files and defines the
+ *      TraceActivity class, which records the start and stop of a single
+ *      phase of processing (e.g., opening a file or deriving the key).
+ *
+ *      The provider is named "Terrapane.AESCrypt", so a trace may be
+ *      captured with a WPR profile or with a command like:
+ *
+ *          tracelog -start aescrypt -f aescrypt.etl -guid *Terrapane.AESCrypt
+ *
+ *      Each phase produces a PhaseStart and PhaseStop event sharing an
+ *      activity ID, with the stop event carrying the duration in
+ *      microseconds, the number of octets processed, and a result code.
+ *      When no trace session is listening, an activity costs only a check
+ *      of whether the provider is enabled.
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#pragma once
+
+#include <Windows.h>
+#include <TraceLoggingProvider.h>
+#include <string>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+// Provider through which all trace events are written
+TRACELOGGING_DECLARE_PROVIDER(AES_Crypt_Trace_Provider);
+
+// Register and unregister the trace provider (called by DllMain)
+void RegisterTraceProvider();
+void UnregisterTraceProvider();
+
+// Records the start and stop of a phase of processing a file
+class TraceActivity
+{
+    public:
+        TraceActivity(const char *phase, const std::wstring &filename);
+        ~TraceActivity();
+
+        void SetOctets(std::uint64_t count) { octets = count; }
+        void SetResult(DWORD code) { result = code; }
+        void Stop();
+
+    protected:
+        bool enabled;
+        const char *phase;
+        std::wstring filename;
+        GUID activity_id;
+        LARGE_INTEGER start_time;
+        std::uint64_t octets;
+        DWORD result;
+};
+
+// Records the phases of the engine processing a stream: key derivation,
+// waiting for permission to stream, and streaming the contents; the time
+// spent in each phase is retained (whether or not tracing is enabled) for
+// the batch report
+class StreamTrace
+{
+    public:
+        StreamTrace(const std::wstring &filename);
+        ~StreamTrace() = default;
+
+        void Start();
+        void KeyDerived();
+        bool Streaming(bool allowed);
+        void Stop(std::uint64_t octets);
+
+        // Microseconds spent in each phase
+        std::uint64_t GetKeyDerivationTime() const
+        {
+            return key_derivation_time;
+        }
+        std::uint64_t GetWaitTime() const { return wait_time; }
+        std::uint64_t GetStreamTime() const { return stream_time; }
+
+    protected:
+        std::uint64_t EndPhase();
+
+        const std::wstring &filename;
+        std::optional<TraceActivity> key_derivation;
+        std::optional<TraceActivity> waiting;
+        std::optional<TraceActivity> streaming;
+        std::chrono::steady_clock::time_point phase_start;
+        std::uint64_t key_derivation_time;
+        std::uint64_t wait_time;
+        std::uint64_t stream_time;
+};
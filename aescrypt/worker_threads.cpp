@@ -18,11 +18,16 @@
 
 #include "pch.h"
 #include <filesystem>
-#include <fstream>
+#include <sstream>
 #include <thread>
 #include <limits>
 #include <chrono>
 #include <stdexcept>
+#include <algorithm>
+#include <list>
+#include <set>
+#include <cwctype>
+#include <functional>
 #include <terra/aescrypt/engine/encryptor.h>
 #include <terra/aescrypt/engine/decryptor.h>
 #include <terra/aescrypt_lm/aescrypt_lm.h>
@@ -34,60 +39,476 @@
 #include "progress_dialog.h"
 #include "password_convert.h"
 #include "has_aes_extension.h"
+#include "overlapped_file.h"
+#include "mapped_file_reader.h"
+#include "gated_stream_buffer.h"
+#include "pipelined_stream_buffer.h"
+#include "compression_stream.h"
+#include "aes_header.h"
+#include "file_enumerator.h"
+#include "archive_stream.h"
+#include "trace_provider.h"
+#include "self_test.h"
+#include "buffer_pool.h"
+#include "memory_budget.h"
+#include "throttle.h"
+#include "batch_host.h"
+#include "settings.h"
 #include "version.h"
 
-// Minimum frequency with which to update the progress meter
-constexpr std::chrono::milliseconds Progress_Update_Minimum(250);
+// Number of octets processed between progress updates from the engine
+constexpr std::size_t Progress_Interval = 256 * 1024;
 
-// Minimum progress meter update interval
-constexpr std::size_t Minimal_Interval = 16 * 100;
+// Maximum number of failed files listed for the user
+constexpr std::size_t Failures_Shown = 10;
+
+// Extension appended to the name of a file while it is being decrypted, or
+// while an encrypted file is being replaced in sync mode
+constexpr wchar_t Partial_Extension[] = L".partial";
+
+// Header extensions recording the size and last write time of the file from
+// which an encrypted file was produced in sync mode
+constexpr char Source_Size_Extension[] = "SOURCE_SIZE";
+constexpr char Source_Time_Extension[] = "SOURCE_TIME";
+
+// Interval at which a file waiting for memory checks the process budget
+constexpr std::chrono::milliseconds Memory_Budget_Interval(100);
 
 namespace
 {
 
 std::wstring Application_Name = L"AES Crypt";
 
+// Registers a function to cancel a stream for the duration of its scope
+class CancelRegistration
+{
+    public:
+        /*
+         *  CancelRegistration()
+         *
+         *  Description:
+         *      Add the cancel function to the batch so that it is called
+         *      if the user cancels processing.
+         *
+         *  Parameters:
+         *      batch [in]
+         *          The batch context shared by all threads processing files.
+         *
+         *      cancel [in]
+         *          The function to call to cancel processing of a stream.
+         *
+         *  Returns:
+         *      Nothing.
+         *
+         *  Comments:
+         *      None.
+         */
+        CancelRegistration(BatchContext &batch,
+                           const std::function<void()> &cancel) :
+            batch{batch}
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            handler = batch.cancel_handlers.insert(batch.cancel_handlers.end(),
+                                                   cancel);
+        }
+
+        /*
+         *  ~CancelRegistration()
+         *
+         *  Description:
+         *      Remove the cancel function from the batch.
+         *
+         *  Parameters:
+         *      None.
+         *
+         *  Returns:
+         *      Nothing.
+         *
+         *  Comments:
+         *      None.
+         */
+        ~CancelRegistration()
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.cancel_handlers.erase(handler);
+        }
+
+    protected:
+        BatchContext &batch;
+        std::list<std::function<void()>>::iterator handler;
+};
+
 /*
- *  ThreadEntry()
+ *  OpenInputFile()
  *
  *  Description:
- *      This is a C function call used as the initial starting point when
- *      a new thread is created.  It receives a pointer to the WorkerThreads
- *      object and then calls the ThreadEntry() function so that it can then
- *      get the data needed to continue file processing.
+ *      Open the input file for a batch file.  Large files on local fixed
+ *      volumes are read through a memory-mapped window, while other files
+ *      (including those on network shares or devices) are read using
+ *      overlapped I/O.
  *
  *  Parameters:
- *      lpParameter [in]
- *          A pointer to a WorkerThreads object.
+ *      settings [in]
+ *          The settings that control how files are read.
+ *
+ *      batch_file [in]
+ *          The file to open.
+ *
+ *      reader [in]
+ *          The overlapped file reader to use for the stream path.
+ *
+ *      mapped_reader [in]
+ *          The memory-mapped file reader to use for the mapped path.
+ *
+ *      input_buffer [out]
+ *          The stream buffer from which the file should be read.
  *
  *  Returns:
- *      Always returns 0.
+ *      ERROR_SUCCESS if the file was opened, else the Windows error code.
  *
  *  Comments:
  *      None.
  */
-DWORD WINAPI ThreadEntry(LPVOID lpParameter)
+DWORD OpenInputFile(const Settings &settings,
+                    const BatchFile &batch_file,
+                    OverlappedFileReader &reader,
+                    MappedFileReader &mapped_reader,
+                    std::streambuf *&input_buffer)
 {
-    try
+    if ((settings.mapped_io_threshold > 0) &&
+        (batch_file.file_size >= settings.mapped_io_threshold) &&
+        IsLocalFixedVolume(batch_file.filename))
+    {
+        input_buffer = &mapped_reader;
+        return mapped_reader.Open(batch_file.filename);
+    }
+
+    input_buffer = &reader;
+    return reader.Open(batch_file.filename, settings.unbuffered_io);
+}
+
+// Stream buffer that discards everything written to it
+class DiscardStreamBuffer : public std::streambuf
+{
+    protected:
+        int_type overflow(int_type c) override
+        {
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize count) override
+        {
+            return count;
+        }
+};
+
+/*
+ *  GetHeaderExtensions()
+ *
+ *  Description:
+ *      Returns the extensions to insert into the header of encrypted files.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      The list of extensions.
+ *
+ *  Comments:
+ *      None.
+ */
+ExtensionList GetHeaderExtensions()
+{
+    return
     {
-        WorkerThreads *aes_crypt_worker_threads =
-            reinterpret_cast<WorkerThreads *>(lpParameter);
+        {"CREATED_BY", std::string(Project_Name) + " " + Project_Version}
+    };
+}
+
+/*
+ *  EncryptedSize()
+ *
+ *  Description:
+ *      Returns the expected size of an AES Crypt stream produced by
+ *      encrypting the given number of octets.
+ *
+ *  Parameters:
+ *      input_size [in]
+ *          The number of octets to be encrypted.
+ *
+ *      extensions [in]
+ *          The extensions to be inserted into the header.
+ *
+ *  Returns:
+ *      The expected size of the encrypted stream.
+ *
+ *  Comments:
+ *      This is used only to preallocate the output file, so it need not be
+ *      exact; the file is trimmed to the octets written when closed.
+ */
+std::uint64_t EncryptedSize(std::uint64_t input_size,
+                            const ExtensionList &extensions)
+{
+    // Signature, version, and reserved octet (5), extensions terminator
+    // (2), KDF iterations (4), IV (16), encrypted IV and key (48), HMAC of
+    // the encrypted IV and key (32), and HMAC of the ciphertext (32)
+    std::uint64_t size = 5 + 2 + 4 + 16 + 48 + 32 + 32;
 
-        aes_crypt_worker_threads->ThreadEntry();
+    // Each extension has a length, identifier, separator, and value
+    for (const auto &[identifier, value] : extensions)
+    {
+        size += 2 + identifier.size() + 1 + value.size();
     }
-    catch (const std::exception &e)
+
+    // The ciphertext is padded to a whole number of blocks, always adding
+    // at least one octet
+    return size + (input_size / 16 + 1) * 16;
+}
+
+/*
+ *  EstimatedWriterMemory()
+ *
+ *  Description:
+ *      Estimate the memory used by the I/O buffers of a file writer created
+ *      with the given settings, for when the writer is not yet open.
+ *
+ *  Parameters:
+ *      settings [in]
+ *          The settings that control batch processing.
+ *
+ *  Returns:
+ *      The estimated number of octets.
+ *
+ *  Comments:
+ *      Where the settings select I/O parameters for the volume, the
+ *      defaults are assumed, so this may understate the memory used when
+ *      writing to a network share.
+ */
+std::uint64_t EstimatedWriterMemory(const Settings &settings)
+{
+    std::uint64_t buffer_size = (settings.io_buffer_size > 0) ?
+                                    settings.io_buffer_size :
+                                    Buffered_IO_Size;
+    std::uint64_t queue_depth = (settings.io_queue_depth > 0) ?
+                                    settings.io_queue_depth :
+                                    IO_Queue_Depth;
+
+    return buffer_size * queue_depth;
+}
+
+/*
+ *  GetFileCompression()
+ *
+ *  Description:
+ *      Determine whether the contents of the given AES Crypt file were
+ *      compressed before being encrypted.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the AES Crypt file.
+ *
+ *      compression [out]
+ *          The compression algorithm named in the file's COMPRESSION header
+ *          extension, or None if the contents were not compressed.
+ *
+ *  Returns:
+ *      True if the contents were not compressed or were compressed using a
+ *      supported algorithm, false if the algorithm is not supported.
+ *
+ *  Comments:
+ *      A header that cannot be read is treated as having no extensions, as
+ *      the engine will report the problem when decrypting the file.
+ */
+bool GetFileCompression(const std::wstring &filename,
+                        CompressionAlgorithm &compression)
+{
+    AESHeaderInfo header{};
+
+    compression = CompressionAlgorithm::None;
+
+    if (ReadAESHeader(filename, header) != ERROR_SUCCESS) return true;
+
+    for (const auto &[identifier, value] : header.extensions)
     {
-        ::ReportError(Application_Name + L" Error",
-                      L"Unhandled exception in worker thread: ",
-                      e.what());
+        if (identifier != Compression_Extension) continue;
+
+        compression = CompressionFromName(value);
+
+        return compression != CompressionAlgorithm::None;
     }
-    catch (...)
+
+    return true;
+}
+
+/*
+ *  IsOutputCurrent()
+ *
+ *  Description:
+ *      Determine whether the given AES Crypt file was produced from the
+ *      current contents of the given input file in sync mode.
+ *
+ *  Parameters:
+ *      batch_file [in]
+ *          The input file, with its size and last write time.
+ *
+ *      out_file [in]
+ *          The name of the existing AES Crypt file.
+ *
+ *  Returns:
+ *      True if the output file's header records the input file's current
+ *      size and last write time, false if not or the header is unreadable.
+ *
+ *  Comments:
+ *      An output file not produced in sync mode is never current, so it is
+ *      replaced the first time the input file is encrypted in sync mode.
+ */
+bool IsOutputCurrent(const BatchFile &batch_file, const std::wstring &out_file)
+{
+    AESHeaderInfo header{};
+    bool size_matches{};
+    bool time_matches{};
+
+    if (ReadAESHeader(out_file, header) != ERROR_SUCCESS) return false;
+
+    for (const auto &[identifier, value] : header.extensions)
+    {
+        if (identifier == Source_Size_Extension)
+        {
+            size_matches = (value == std::to_string(batch_file.file_size));
+        }
+        else if (identifier == Source_Time_Extension)
+        {
+            time_matches =
+                (value == std::to_string(batch_file.last_write_time));
+        }
+    }
+
+    return size_matches && time_matches;
+}
+
+/*
+ *  StreamReport()
+ *
+ *  Description:
+ *      Produce the batch report record for a file once the engine has
+ *      finished with its stream.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file processed.
+ *
+ *      octets_in [in]
+ *          The number of octets in the file.
+ *
+ *      stream_trace [in]
+ *          The trace of the stream, giving the time spent in each phase.
+ *
+ *      reader [in]
+ *          The reader used for the file, which must still be open, or
+ *          nullptr if the file is not read by an OverlappedFileReader.
+ *
+ *      writer [in]
+ *          The writer used for the output, which must still be open, or
+ *          nullptr if there is no output file.
+ *
+ *      result_text [in]
+ *          The engine's result as text.
+ *
+ *  Returns:
+ *      The record, to which the caller adds the octets written, the time
+ *      taken to close the output, and any error code.
+ *
+ *  Comments:
+ *      A file read by mapping it into memory shows no read I/O parameters.
+ */
+FileReport StreamReport(const std::wstring &filename,
+                        std::uint64_t octets_in,
+                        const StreamTrace &stream_trace,
+                        const OverlappedFileReader *reader,
+                        const OverlappedFileWriter *writer,
+                        const std::string &result_text)
+{
+    FileReport file_report{};
+
+    file_report.filename = filename;
+    file_report.octets_in = octets_in;
+    file_report.key_derivation_time = stream_trace.GetKeyDerivationTime();
+    file_report.wait_time = stream_trace.GetWaitTime();
+    file_report.stream_time = stream_trace.GetStreamTime();
+    file_report.result = result_text;
+
+    if ((reader != nullptr) && reader->IsOpen())
+    {
+        file_report.read_buffer_size = reader->GetBufferSize();
+        file_report.read_queue_depth = reader->GetQueueDepth();
+    }
+
+    if ((writer != nullptr) && writer->IsOpen())
+    {
+        file_report.write_buffer_size = writer->GetBufferSize();
+        file_report.write_queue_depth = writer->GetQueueDepth();
+    }
+
+    return file_report;
+}
+
+// Name of the file being processed by the calling thread, if any, so that
+// an error may be recorded against the file when continuing on error
+thread_local const std::wstring *current_batch_file = nullptr;
+
+// Class that names the file being processed by the calling thread for as
+// long as the object exists
+class BatchFileScope
+{
+    public:
+        BatchFileScope(const std::wstring &filename) :
+            previous_file{current_batch_file}
+        {
+            current_batch_file = &filename;
+        }
+
+        ~BatchFileScope() { current_batch_file = previous_file; }
+
+    protected:
+        const std::wstring *previous_file;
+};
+
+/*
+ *  ListFailedFiles()
+ *
+ *  Description:
+ *      Produce the list of failed files shown to the user, giving each
+ *      file's name and the reason it failed.
+ *
+ *  Parameters:
+ *      failed_files [in]
+ *          The files that failed.
+ *
+ *  Returns:
+ *      The text listing the files, with each preceded by a newline.
+ *
+ *  Comments:
+ *      Only as many failures as will reasonably fit on the screen are
+ *      listed, followed by the number not shown.
+ */
+std::wstring ListFailedFiles(const std::vector<FileFailure> &failed_files)
+{
+    std::wstring text;
+
+    for (std::size_t i = 0; i < failed_files.size(); i++)
     {
-        ::ReportError(Application_Name + L" Error",
-                      L"Unhandled exception in worker thread");
+        if (i == Failures_Shown)
+        {
+            text += L"\n(and " + std::to_wstring(failed_files.size() - i) +
+                    L" more)";
+            break;
+        }
+
+        text += L"\n" + failed_files[i].filename + L"\n    " +
+                failed_files[i].reason;
     }
 
-    return 0;
+    return text;
 }
 
 } // namespace
@@ -107,7 +528,7 @@ DWORD WINAPI ThreadEntry(LPVOID lpParameter)
  *  Comments:
  *      None.
  */
-WorkerThreads::WorkerThreads() : thread_count{0}
+WorkerThreads::WorkerThreads() : active_requests{0}
 {
     // Load the application name
     HMODULE hModule{};
@@ -135,8 +556,6 @@ WorkerThreads::WorkerThreads() : thread_count{0}
     }
 
     application_error = application_name + L" Error";
-
-    InitializeCriticalSection(&critical_section);
 }
 
 /*
@@ -156,72 +575,39 @@ WorkerThreads::WorkerThreads() : thread_count{0}
  */
 WorkerThreads::~WorkerThreads()
 {
-    // Wait for any active threads to complete
-    // NOTE: This block of code should never have to wait, since the IsBusy()
-    //       call should be made and the object should not be destroyed.
-    while (true)
-    {
-        EnterCriticalSection(&critical_section);
-        if (thread_count == 0)
-        {
-            LeaveCriticalSection(&critical_section);
-            break;
-        }
-        LeaveCriticalSection(&critical_section);
-        Sleep(200);
-    }
-
-    // Close any completed thread handles
-    CloseThreadHandles();
-
-    // Destroy the critical section object
-    DeleteCriticalSection(&critical_section);
+    // NOTE: Threads in the pool hold a reference to this module, so this
+    //       object is not destroyed while any of them are running.
 }
 
 /*
  *  WorkerThreads::IsBusy()
  *
  *  Description:
- *      Returns true if there are active threads.  This doesn't mean that the
- *      threads have fully exited, but it is indicative that any running thread
- *      is nearing completion (and it would be safe to wait for that thread).
+ *      Returns true if there are requests waiting to be processed or being
+ *      processed.  Idle threads in the pool do not make this object busy.
  *
  *  Parameters:
  *      None.
  *
  *  Returns:
- *      True if there are actively working threads, false otherwise.
+ *      True if there are requests queued or in progress, false otherwise.
  *
  *  Comments:
  *      None.
  */
 bool WorkerThreads::IsBusy()
 {
-    bool busy = false;
-
-    // Close any completed thread handles
-    CloseThreadHandles();
-
-    // Enter the critical section
-    EnterCriticalSection(&critical_section);
-
-    // If there are active threads, indicate busy
-    if (thread_count > 0) busy = true;
-
-    LeaveCriticalSection(&critical_section);
-
-    return busy;
+    return thread_pool.IsBusy();
 }
 
 /*
  *  WorkerThreads::ProcessFiles()
  *
  *  Description:
- *      This function is called once the user selects the shell extension
- *      menu option or by the aescrypt32.exe (usually when a user double-clicks
- *      on a file having a .aes extension).  This will prompt the user for a
- *      a password and then invoke a thread to handle the encryption or
- *      decryption process.
+ *      This function is called by the aescrypt32.exe (usually when a user
+ *      double-clicks on a file having a .aes extension).  This will prompt the
+ *      user for a password and then queue the request to be processed by the
+ *      thread pool.
  *
  *  Parameters:
  *      file_list [in]
@@ -238,936 +624,3509 @@ bool WorkerThreads::IsBusy()
  */
 void WorkerThreads::ProcessFiles(const FileList &file_list, bool encrypt)
 {
-    PasswdDialog password_dialog(application_name);
-
-    // Prompt the user for a password
-    if (password_dialog.DoModal(::GetActiveWindow(), (encrypt ? 1 : 0)) == IDOK)
-    {
-        // Convert the password to UTF-8 as required by the AES Crypt Engine
-        SecureU8String password =
-            PasswordConvertUTF8(password_dialog.GetPassword(),
-                                Terra::BitUtil::IsLittleEndian());
-
-        // Ensure the password converted properly
-        if (password.empty())
-        {
-            ::ReportError(application_error,
-                          L"Password could not be converted to UTF-8");
-            return;
-        }
-
-        // Verify user license rights
-        if (!Terra::ACLM::ValidateACLM())
-        {
-            ::ReportError(application_name,
-                          L"A valid license is required to use AES Crypt. You "
-                          L"may obtain a license by visiting "
-                          L"https://www.aescrypt.com/.");
-            return;
-        }
-
-        StartThread(file_list, password, encrypt);
-    }
+    // Make a copy of the file list, as the request is processed after
+    // this function returns
+    ProcessFiles([file_list]() -> FileList { return file_list; },
+                 encrypt ? BatchOperation::Encrypt : BatchOperation::Decrypt);
 }
 
 /*
- *  WorkerThreads::CloseThreadHandles()
+ *  WorkerThreads::ProcessFiles()
  *
  *  Description:
- *      This function will wait on any threads that are finished to ensure
- *      thread are completely finished and handles are closed.
+ *      This function is called once the user selects the shell extension
+ *      menu option.  This will prompt the user for a password and then queue
+ *      the request to be processed by the thread pool.  The list of files
+ *      is produced by the thread processing the request, so that a large
+ *      selection does not delay the thread that calls this function.
  *
  *  Parameters:
- *      None.
+ *      file_list_source [in]
+ *          The function that will produce the list of files to encrypt or
+ *          decrypt.  It is called on a pool thread.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      completion [in]
+ *          The completion to signal once the request has been processed, if
+ *          the caller awaits completion.
  *
  *  Returns:
- *      Nothing.
+ *      True if the request was queued, false if the user cancelled or the
+ *      request could not be queued.
  *
  *  Comments:
- *      This function will enter the critical section, so ensure it is not
- *      entered before calling this routine.
+ *      A request whose completion is not awaited is handed to the batch
+ *      host, if enabled, in which case the host prompts for the password.
  */
-void WorkerThreads::CloseThreadHandles()
+bool WorkerThreads::ProcessFiles(
+                    const FileListSource &file_list_source,
+                    BatchOperation operation,
+                    const std::shared_ptr<RequestCompletion> &completion)
 {
-    // Enter the critical section
-    EnterCriticalSection(&critical_section);
+    PasswdDialog password_dialog(application_name);
+    bool encrypt = (operation == BatchOperation::Encrypt);
 
-    // Close the handles of any terminated threads
-    while (!terminated_threads.empty())
+    if (!completion && UseBatchHost())
     {
-        // Pull the thread handle from the front
-        auto thread_handle = terminated_threads.front();
-        terminated_threads.pop_front();
+        return QueueHostRequest(file_list_source, operation);
+    }
 
-        // Leave the critical section
-        LeaveCriticalSection(&critical_section);
+    // Prompt the user for a password
+    if (password_dialog.DoModal(::GetActiveWindow(), (encrypt ? 1 : 0)) != IDOK)
+    {
+        return false;
+    }
 
-        // Wait for the thread to exit (should be already)
-        WaitForSingleObject(thread_handle, INFINITE);
+    // Convert the password to UTF-8 as required by the AES Crypt Engine
+    SecureU8String password =
+        PasswordConvertUTF8(password_dialog.GetPassword(),
+                            Terra::BitUtil::IsLittleEndian());
 
-        // Close the thread handle
-        CloseHandle(thread_handle);
+    // Ensure the password converted properly
+    if (password.empty())
+    {
+        ::ReportError(application_error,
+                      L"Password could not be converted to UTF-8");
+        return false;
+    }
 
-        // Re-enter the critical section
-        EnterCriticalSection(&critical_section);
+    // Verify user license rights
+    if (!Terra::ACLM::ValidateACLM())
+    {
+        ::ReportError(application_name,
+                      L"A valid license is required to use AES Crypt. You "
+                      L"may obtain a license by visiting "
+                      L"https://www.aescrypt.com/.");
+        return false;
     }
 
-    // Leave the critical section
-    LeaveCriticalSection(&critical_section);
+    return QueueRequest(file_list_source, password, operation, completion);
 }
 
- /*
-  *  WorkerThreads::StartThread()
-  *
-  *  Description:
-  *      This function is called after the user provides a password to start
-  *      a new thread to process the file list.
-  *
-  *  Parameters:
-  *      file_list [in]
-  *         The list of files to encrypt or decrypt.
-  *
-  *      password [in]
-  *         The password to use for encrypting or decrypting.
-  *
-  *      encrypt [in]
-  *         True if encrypting, false if decrypting.
-  *
-  *  Returns:
-  *      Nothing.
-  *
-  *  Comments:
-  *      None.
-  */
-void WorkerThreads::StartThread(const FileList &file_list,
-                                const SecureU8String &password,
-                                bool encrypt)
+/*
+ *  WorkerThreads::ProcessFilesAsync()
+ *
+ *  Description:
+ *      This function is called by the aescrypt32.exe to process a list of
+ *      files as ProcessFiles() does, returning an event that is signaled
+ *      once the request has been processed.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to encrypt or decrypt.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      options [in]
+ *          Options that override the settings for this request.
+ *
+ *  Returns:
+ *      A handle to a manual-reset event that is signaled once processing
+ *      completes, or nullptr if the user cancelled or the request could not
+ *      be queued.  The caller must close the handle.
+ *
+ *  Comments:
+ *      This allows the caller to wait for the request to complete rather
+ *      than polling IsBusy().
+ */
+HANDLE WorkerThreads::ProcessFilesAsync(const FileList &file_list,
+                                        BatchOperation operation,
+                                        const BatchOptions &options)
 {
-    DWORD thread_id;
-
-    // Enter the critical section so that the thread will be held up until
-    // the worker_data
-    EnterCriticalSection(&critical_section);
+    HANDLE caller_event{};
 
-    // Create the thread
-    HANDLE thread_handle =
-        CreateThread(NULL, 0, ::ThreadEntry, this, 0, &thread_id);
-
-    // Did we succeed to create the thread?
-    if (thread_handle != NULL)
+    auto completion = CreateCompletion(false, nullptr, caller_event);
+    if (!completion)
     {
-        // Make a copy of the file list and password, as those will be invalid
-        // upon return from this function and as another thread processes
-        // this data in the background
-        requests.emplace_back(file_list,
-                              password,
-                              encrypt,
-                              thread_id,
-                              thread_handle);
-
-        // Increase the internal thread counter
-        thread_count++;
-
-        // Let the thread in
-        LeaveCriticalSection(&critical_section);
+        ::ReportError(application_error,
+                      L"Unable to create the completion event",
+                      ::GetLastError());
+        return nullptr;
     }
-    else
-    {
-        // Leave the critical section
-        LeaveCriticalSection(&critical_section);
+    completion->options = options;
 
-        ::ReportError(application_error, L"Thread creation failed");
+    if (!ProcessFiles([file_list]() -> FileList { return file_list; },
+                      operation,
+                      completion))
+    {
+        CompleteRequest(*completion);
+        ::CloseHandle(caller_event);
+        return nullptr;
     }
+
+    return caller_event;
 }
 
 /*
- *  WorkerThreads::ThreadEntry()
+ *  WorkerThreads::ProcessFilesHeadless()
  *
  *  Description:
- *      This is the entry point where the worker thread calls to actually
- *      begin processing files.  It will get the information it needs from
- *      the member variables and then begin processing.
+ *      This function will queue a request to encrypt or decrypt the list of
+ *      files using the given password without prompting the user or showing
+ *      any dialogs.  Errors are reported via the summary rather than by
+ *      displaying a message box.
  *
  *  Parameters:
- *      None.
+ *      file_list [in]
+ *          The list of files to encrypt or decrypt.
+ *
+ *      password [in]
+ *          The password to use for encrypting or decrypting.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      options [in]
+ *          Options that override the settings for this request.
+ *
+ *      summary [out]
+ *          The summary of the request, which is complete once the returned
+ *          event is signaled.  This must remain valid until then.
  *
  *  Returns:
- *      Nothing.
+ *      A handle to a manual-reset event that is signaled once processing
+ *      completes, or nullptr if the request could not be queued (in which
+ *      case the summary describes the reason).  The caller must close the
+ *      handle.
  *
  *  Comments:
  *      None.
  */
-void WorkerThreads::ThreadEntry()
+HANDLE WorkerThreads::ProcessFilesHeadless(const FileList &file_list,
+                                           const SecureU8String &password,
+                                           BatchOperation operation,
+                                           const BatchOptions &options,
+                                           BatchSummary &summary)
 {
-    // Close any completed thread handles
-    CloseThreadHandles();
-
-    // Determine the thread ID of this thread
-    DWORD thread_id = GetCurrentThreadId();
+    HANDLE caller_event{};
 
-    // Try to enter the critical section
-    EnterCriticalSection(&critical_section);
+    summary = {};
 
-    // Locate the data to be processed
-    auto it = std::find_if(requests.begin(),
-                           requests.end(),
-                           [thread_id](const RequestData &request)
-                           {
-                               return request.thread_id == thread_id;
-                           });
-
-    // If unable to find the thread ID, report the problem
-    if (it == requests.end())
+    if (password.empty())
     {
-        // Leave the critical section while reporting the issue
-        LeaveCriticalSection(&critical_section);
+        summary.error_message = L"A password is required";
+        return nullptr;
+    }
 
-        ::ReportError(application_error, L"Thread rendezvous failed");
-
-        // Reduce the thread count and return
-        EnterCriticalSection(&critical_section);
-        thread_count--;
-        LeaveCriticalSection(&critical_section);
-        return;
+    // Verify user license rights
+    if (!Terra::ACLM::ValidateACLM())
+    {
+        summary.error_message = L"A valid license is required to use AES "
+                                L"Crypt. You may obtain a license by "
+                                L"visiting https://www.aescrypt.com/.";
+        return nullptr;
     }
 
-    // Move the data from the deque to the local variable
-    RequestData request = std::move(*it);
-
-    // Remove this element from the deque
-    requests.erase(it);
-
-    // Leave the critical section since necessary data is now local
-    LeaveCriticalSection(&critical_section);
-
-    try
+    auto completion = CreateCompletion(true, &summary, caller_event);
+    if (!completion)
     {
-        // Encrypt or decrypt files based on the request
-        if (request.encrypt)
-        {
-            EncryptFiles(request.file_list, request.password);
-        }
-        else
-        {
-            DecryptFiles(request.file_list, request.password);
-        }
+        summary.error_message =
+            FormatError(L"Unable to create the completion event",
+                        ::GetLastError());
+        return nullptr;
     }
-    catch (const std::exception &e)
+    completion->options = options;
+
+    if (!QueueRequest([file_list]() -> FileList { return file_list; },
+                      password,
+                      operation,
+                      completion))
     {
-        ::ReportError(application_error,
-                      L"Unhandled exception processing file(s): ",
-                      e.what());
+        CompleteRequest(*completion);
+        ::CloseHandle(caller_event);
+        return nullptr;
     }
-    catch (...)
+
+    return caller_event;
+}
+
+/*
+ *  WorkerThreads::CreateCompletion()
+ *
+ *  Description:
+ *      Create the completion for a request whose completion is awaited by
+ *      the caller.
+ *
+ *  Parameters:
+ *      headless [in]
+ *          True if the request is to be processed without showing dialogs.
+ *
+ *      summary [in]
+ *          The summary to fill in when the request completes (may be
+ *          nullptr).
+ *
+ *      caller_event [out]
+ *          A handle to the completion event for the caller to wait on.
+ *
+ *  Returns:
+ *      The completion or nullptr if the event could not be created.
+ *
+ *  Comments:
+ *      The caller receives its own handle to the event so that it may close
+ *      that handle at any time without affecting the request.
+ */
+std::shared_ptr<RequestCompletion> WorkerThreads::CreateCompletion(
+                                                    bool headless,
+                                                    BatchSummary *summary,
+                                                    HANDLE &caller_event)
+{
+    HANDLE event = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (event == NULL) return {};
+
+    if (!::DuplicateHandle(::GetCurrentProcess(),
+                           event,
+                           ::GetCurrentProcess(),
+                           &caller_event,
+                           0,
+                           FALSE,
+                           DUPLICATE_SAME_ACCESS))
     {
-        ::ReportError(application_error,
-                      L"Unhandled exception processing file(s)");
+        ::CloseHandle(event);
+        return {};
     }
 
-    // Once done, decrement the thread count, clean up memory, etc.
-    EnterCriticalSection(&critical_section);
-    thread_count--;
-    terminated_threads.push_back(request.thread_handle);
-    LeaveCriticalSection(&critical_section);
+    return std::make_shared<RequestCompletion>(
+        RequestCompletion{event, headless, summary});
 }
 
 /*
- *  WorkerThreads::EncryptFiles()
+ *  WorkerThreads::CompleteRequest()
  *
  *  Description:
- *      This function will iterate over the list of files and encrypt each one
- *      given the provided password.
+ *      Signal that the request has been processed.
  *
  *  Parameters:
- *      file_list [in]
- *          The list of files to encrypt.
- *
- *      password [in]
- *          The password to use for encryption.
+ *      completion [in]
+ *          The completion of the request.
  *
  *  Returns:
  *      Nothing.
  *
  *  Comments:
- *      None.
+ *      The summary must not be accessed after calling this function, as the
+ *      caller may release it once the event is signaled.
  */
-void WorkerThreads::EncryptFiles(const FileList &file_list,
-                                 const SecureU8String &password)
+void WorkerThreads::CompleteRequest(RequestCompletion &completion)
 {
-    std::condition_variable cv;
-    std::mutex mutex;
+    if (completion.event == NULL) return;
 
-    // Secure buffer for file I/O
-    SecureVector<char> read_buffer(Buffered_IO_Size, 0);
-    SecureVector<char> write_buffer(Buffered_IO_Size, 0);
+    ::SetEvent(completion.event);
+    ::CloseHandle(completion.event);
 
-    // If the file list is empty, just return
-    if (file_list.empty()) return;
+    completion.event = NULL;
+    completion.summary = nullptr;
+}
 
-    // Create a progress dialog that will notify the waiting thread
-    ProgressDialog progress_dialog(
-        [&]()
+/*
+ *  WorkerThreads::QueueRequest()
+ *
+ *  Description:
+ *      This function is called after the user provides a password to queue
+ *      the request to process the file list.  The request will be processed
+ *      by a thread in the thread pool.
+ *
+ *  Parameters:
+ *      file_list_source [in]
+ *          The function that will produce the list of files to encrypt or
+ *          decrypt.
+ *
+ *      password [in]
+ *          The password to use for encrypting or decrypting.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      completion [in]
+ *          The completion to signal once the request has been processed, if
+ *          the caller awaits completion.
+ *
+ *  Returns:
+ *      True if the request was queued, false otherwise.
+ *
+ *  Comments:
+ *      None.
+ */
+bool WorkerThreads::QueueRequest(
+                        const FileListSource &file_list_source,
+                        const SecureU8String &password,
+                        BatchOperation operation,
+                        const std::shared_ptr<RequestCompletion> &completion)
+{
+    // Apply the current thread limit to the pool
+    thread_pool.SetThreadLimit(LoadSettings().pool_threads);
+
+    // Make a copy of the file list source and password, as those will be
+    // invalid upon return from this function and as another thread
+    // processes this data in the background
+    auto job_id = thread_pool.Submit(
+        [this, file_list_source, password, operation, completion]()
         {
-            std::lock_guard<std::mutex> lock(mutex);
-            cv.notify_all();
+            ProcessRequest(file_list_source, password, operation, completion);
         });
 
-    // Define the extensions to insert into the header
-    const std::vector<std::pair<std::string, std::string>> extensions =
+    if (job_id == 0)
     {
-        {"CREATED_BY", std::string(Project_Name) + " " + Project_Version}
-    };
+        ReportRequestError(completion.get(), L"Thread creation failed");
+        return false;
+    }
 
-    // Create an event used to indicate the progress dialog is ready
-    HANDLE event_handle = CreateEvent(NULL, TRUE, FALSE, NULL);
+    return true;
+}
 
-    // Create a thread to service the windows message loop for the dialog
-    std::thread progress_thread(
-        [&]()
+/*
+ *  WorkerThreads::QueueHostRequest()
+ *
+ *  Description:
+ *      This function queues a request to be handed to the batch host.  The
+ *      list of files is produced and sent to the host by a pool thread, as
+ *      the host may take some time to start.
+ *
+ *  Parameters:
+ *      file_list_source [in]
+ *          The function that will produce the list of files to encrypt or
+ *          decrypt.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *  Returns:
+ *      True if the request was queued, false otherwise.
+ *
+ *  Comments:
+ *      If the host cannot be reached, the request is processed by this
+ *      process instead, prompting for the password on the pool thread.
+ */
+bool WorkerThreads::QueueHostRequest(const FileListSource &file_list_source,
+                                     BatchOperation operation)
+{
+    // Apply the current thread limit to the pool
+    thread_pool.SetThreadLimit(LoadSettings().pool_threads);
+
+    auto job_id = thread_pool.Submit(
+        [this, file_list_source, operation]()
         {
             try
             {
-                // Non-zero LPARAM displays "Encrypting"
-                progress_dialog.Create(GetDesktopWindow(), LPARAM(1));
-                progress_dialog.ShowWindow(SW_SHOWNORMAL);
+                FileList file_list = file_list_source();
+                if (file_list.empty()) return;
 
-                // Signal that the progress dialog is ready
-                SetEvent(event_handle);
+                if (SubmitToBatchHost(file_list, operation, {})) return;
 
-                // Process messages
-                WindowsMessageLoop();
-
-                // Destroy the progress window
-                progress_dialog.DestroyWindow();
+                // Process the request here, as the host is unavailable
+                HANDLE job = ProcessFilesAsync(file_list, operation);
+                if (job != NULL) ::CloseHandle(job);
             }
             catch (const std::exception &e)
             {
-                ::ReportError(application_error,
-                              L"Unexpected error in progress dialog thread",
-                              e.what());
+                ReportRequestError(
+                    nullptr,
+                    FormatError(L"Unhandled exception processing file(s)",
+                                e.what()));
             }
             catch (...)
             {
-                ::ReportError(application_error,
-                              L"Unexpected error in progress dialog thread");
+                ReportRequestError(nullptr,
+                                   L"Unhandled exception processing file(s)");
             }
         });
 
-    // Wait for the progress window to open
-    WaitForSingleObject(event_handle, INFINITE);
-    CloseHandle(event_handle);
-
-    // Iterate over the list of files
-    for (const auto &in_file : file_list)
+    if (job_id == 0)
     {
-        std::size_t file_size{};
-        std::ifstream ifs;
-        std::ofstream ofs;
-        bool remove_on_fail{};
+        ReportRequestError(nullptr, L"Thread creation failed");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  WorkerThreads::ProcessRequest()
+ *
+ *  Description:
+ *      This function is executed by a pool thread to process a request to
+ *      encrypt or decrypt a list of files.
+ *
+ *  Parameters:
+ *      file_list_source [in]
+ *          The function that will produce the list of files to encrypt or
+ *          decrypt.
+ *
+ *      password [in]
+ *          The password to use for encrypting or decrypting.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      completion [in]
+ *          The completion to signal once the request has been processed, if
+ *          the caller awaits completion.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The self-test of the cryptographic functions is performed before the
+ *      first request is processed.
+ */
+void WorkerThreads::ProcessRequest(
+                        const FileListSource &file_list_source,
+                        const SecureU8String &password,
+                        BatchOperation operation,
+                        const std::shared_ptr<RequestCompletion> &completion)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    std::wstring self_test_failure;
 
-        // Reset the progress bar (default range is 0..100)
-        progress_dialog.SendDlgItemMessage(IDC_PROGRESSBAR, PBM_SETPOS, 0, 0);
+    active_requests++;
 
-        // Display the file name
-        progress_dialog.SetDlgItemText(IDC_FILENAME, in_file.c_str());
+    try
+    {
+        // Produce the list of files to process
+        FileList file_list = file_list_source();
 
-        try
-        {
-            // Attempt to get the file size
-            file_size =
-                std::filesystem::file_size(std::filesystem::path(in_file));
-        }
-        catch (...)
+        // Encrypt, decrypt, or verify files based on the request, provided
+        // the cryptographic functions pass the self-test (run once)
+        if (!RunSelfTest(self_test_failure))
         {
-            // Nothing we can do, nor is this critical
+            ReportRequestError(completion.get(), self_test_failure);
         }
-
-        try
+        else if (operation == BatchOperation::Encrypt)
         {
-            // Open the input file for reading
-            ifs.open(std::filesystem::path(in_file),
-                     std::ios::in | std::ios::binary);
+            EncryptFiles(file_list, password, completion.get());
         }
-        catch (...)
+        else
         {
-            // Nothing we can do, but an error will be presented below
+            DecryptFiles(file_list,
+                         password,
+                         operation == BatchOperation::Verify,
+                         completion.get());
         }
+    }
+    catch (const std::exception &e)
+    {
+        ReportRequestError(
+            completion.get(),
+            FormatError(L"Unhandled exception processing file(s)",
+                        e.what()));
+    }
+    catch (...)
+    {
+        ReportRequestError(completion.get(),
+                           L"Unhandled exception processing file(s)");
+    }
 
-        if (!ifs.good() || !ifs.is_open())
+    // Free the pooled I/O buffers once no requests remain
+    if (--active_requests == 0) GetBufferPool().Trim();
+
+    if (completion)
+    {
+        // Record the time taken to process the request
+        if (completion->summary != nullptr)
         {
-            DWORD error_code = ERROR_SUCCESS;
-            if (!ifs.good()) error_code = GetLastError();
+            completion->summary->elapsed_time = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start_time)
+                    .count());
+        }
 
-            // Report an error opening the file
-            std::wstring message = L"Unable to open the input file " + in_file;
-            ::ReportError(application_error, message, error_code);
+        CompleteRequest(*completion);
+    }
+}
 
-            break;
+/*
+ *  WorkerThreads::ReportRequestError()
+ *
+ *  Description:
+ *      This function will report an error that occurred while processing a
+ *      request.  For requests processed without user interaction, the error
+ *      is recorded in the summary rather than shown to the user.
+ *
+ *  Parameters:
+ *      completion [in]
+ *          The completion of the request, if the caller awaits completion.
+ *
+ *      error_text [in]
+ *          The text describing the error.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Only the first error is recorded in the summary.
+ */
+void WorkerThreads::ReportRequestError(const RequestCompletion *completion,
+                                       const std::wstring &error_text) const
+{
+    if ((completion != nullptr) && completion->headless)
+    {
+        if ((completion->summary != nullptr) &&
+            completion->summary->error_message.empty())
+        {
+            completion->summary->success = false;
+            completion->summary->error_message = error_text;
         }
+        return;
+    }
 
-        // Set the buffer to use for reading
-        ifs.rdbuf()->pubsetbuf(read_buffer.data(), read_buffer.size());
+    ::ReportError(application_error, error_text);
+}
 
-        // Define the output filename
-        std::wstring out_file = in_file + L".aes";
+/*
+ *  WorkerThreads::EncryptFiles()
+ *
+ *  Description:
+ *      This function will encrypt each file in the list of files using the
+ *      provided password.  Files are processed as a batch, with several
+ *      files being encrypted concurrently.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to encrypt.
+ *
+ *      password [in]
+ *          The password to use for encryption.
+ *
+ *      completion [in]
+ *          The completion of the request, if the caller awaits completion.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void WorkerThreads::EncryptFiles(const FileList &file_list,
+                                 const SecureU8String &password,
+                                 const RequestCompletion *completion)
+{
+    // If the file list is empty, just return
+    if (file_list.empty()) return;
 
-        try
-        {
-            // Get the file status of the output file
-            std::filesystem::file_status file_status =
-                std::filesystem::status(std::filesystem::path(out_file));
+    // Encrypt the files
+    RunBatch(file_list, password, BatchOperation::Encrypt, completion);
+}
 
-            // If the output file does not exist, attempt to remove later
-            // (Do not remove by default so as to not attempt to remove things
-            // like character special devices.)
-            if (!std::filesystem::exists(file_status)) remove_on_fail = true;
+/*
+ *  WorkerThreads::DecryptFiles()
+ *
+ *  Description:
+ *      This function will decrypt each file in the list of files using the
+ *      provided password.  Files are processed as a batch, with several
+ *      files being decrypted concurrently.  When only verifying, the
+ *      decrypted contents are discarded rather than written, so that the
+ *      password and integrity of each file are checked without writing
+ *      anything.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to decrypt.
+ *
+ *      password [in]
+ *          The password to use for decryption.
+ *
+ *      verify_only [in]
+ *          True if the files are only to be verified.
+ *
+ *      completion [in]
+ *          The completion of the request, if the caller awaits completion.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void WorkerThreads::DecryptFiles(const FileList &file_list,
+                                 const SecureU8String &password,
+                                 bool verify_only,
+                                 const RequestCompletion *completion)
+{
+    // If the file list is empty, just return
+    if (file_list.empty()) return;
 
-            // Does a regular file having this output file name exist?
-            if (std::filesystem::is_regular_file(file_status))
-            {
-                // Report an error opening the file
-                ::ReportError(application_error,
-                              std::wstring(L"Output file already exists: ") +
-                                  out_file);
-                break;
-            }
-        }
-        catch (const std::exception &e)
-        {
-            ::ReportError(application_error,
-                          std::wstring(L"Unexpected error processing ") +
-                              in_file,
-                          e.what());
-            break;
-        }
-        catch (...)
+    // Ensure all files end in .aes (directories are enumerated later to
+    // find the files that do)
+    for (const auto &in_file : file_list)
+    {
+        if (!HasAESExtension(in_file) &&
+            !std::filesystem::is_directory(std::filesystem::path(in_file)))
         {
-            // Report an error opening the file
-            ::ReportError(application_error,
-                          std::wstring(L"Unexpected error processing ") +
-                              in_file);
-            break;
+            ReportRequestError(completion,
+                               L"File to decrypt does not end in .aes: " +
+                                   in_file);
+            return;
         }
+    }
 
-        try
-        {
-            // Open the output file for writing
-            ofs.open(std::filesystem::path(out_file),
-                     std::ios::out | std::ios::binary);
-        }
-        catch (...)
-        {
-            // Nothing we can do, but an error will be presented below
-        }
-        if (!ofs.good() || !ofs.is_open())
+    // Decrypt or verify the files
+    RunBatch(file_list,
+             password,
+             verify_only ? BatchOperation::Verify : BatchOperation::Decrypt,
+             completion);
+}
+
+/*
+ *  WorkerThreads::RunBatch()
+ *
+ *  Description:
+ *      This function will encrypt, decrypt, or verify the list of files as a
+ *      batch, showing the progress dialog while the batch is processed unless
+ *      the request is processed without user interaction.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to encrypt or decrypt.
+ *
+ *      password [in]
+ *          The password to use for encryption or decryption.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      completion [in]
+ *          The completion of the request, if the caller awaits completion.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      When processing without user interaction, the progress dialog window
+ *      is never created; it serves only to accumulate the batch totals
+ *      reported in the summary.
+ */
+void WorkerThreads::RunBatch(const FileList &file_list,
+                             const SecureU8String &password,
+                             BatchOperation operation,
+                             const RequestCompletion *completion)
+{
+    BatchContext batch{};
+    std::thread progress_thread;
+    bool encrypt = (operation == BatchOperation::Encrypt);
+
+    batch.headless = (completion != nullptr) && completion->headless;
+    batch.verify_only = (operation == BatchOperation::Verify);
+
+    // Load the settings that control batch processing, applying any
+    // options given by the caller
+    batch.settings = LoadSettings();
+    ApplyBatchOptions(batch, completion);
+    GetBufferPool().Configure(batch.settings.buffer_pool_size,
+                              batch.settings.lock_buffers);
+    GetMemoryBudget().Configure(batch.settings.memory_budget);
+
+    // Write a performance report for the batch if configured
+    batch.report.Open(ReportFormatFromSetting(batch.settings.batch_report),
+                      operation,
+                      batch.settings);
+
+    // Create a progress dialog that will notify the waiting threads
+    ProgressDialog progress_dialog(
+        [&]()
         {
-            DWORD error_code = ERROR_SUCCESS;
-            if (!ofs.good()) error_code = GetLastError();
+            std::lock_guard<std::mutex> lock(batch.mutex);
 
-            // Report an error opening the file
-            std::wstring message =
-                L"Unable to open the output file " + out_file;
-            ::ReportError(application_error, message, error_code);
+            // Stop the engine for each file being processed
+            for (auto &cancel : batch.cancel_handlers) cancel();
 
-            break;
-        }
+            batch.cv.notify_all();
+        });
 
-        // Set the buffer to use for writing
-        ofs.rdbuf()->pubsetbuf(write_buffer.data(), write_buffer.size());
-
-        // Encrypt the input stream
-        bool result = EncryptStream(cv,
-                                    mutex,
-                                    progress_dialog,
-                                    in_file,
-                                    password,
-                                    KDF_Iterations,
-                                    extensions,
-                                    file_size,
-                                    ifs,
-                                    ofs);
-
-        // Close any open files; there may be delay in closing the output
-        // file if it is large and transmission is over a network
-        if (ifs.is_open()) ifs.close();
-        if (ofs.is_open())
-        {
-            ofs.flush();
-            ofs.close();
-        }
+    // The progress dialog allows the user to change the background mode
+    progress_dialog.SetBackgroundMode(batch.settings.background_mode);
 
-        // Did the encryption process fail?
-        if (!result)
-        {
-            // Remove the partial output file if it's not stdout
-            if (remove_on_fail)
+    if (!batch.headless)
+    {
+        // Create an event used to indicate the progress dialog is ready
+        HANDLE event_handle = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        // Create a thread to service the windows message loop for the dialog
+        progress_thread = std::thread(
+            [&]()
             {
                 try
                 {
-                    std::filesystem::remove(std::filesystem::path(out_file));
+                    // The LPARAM selects the operation displayed
+                    progress_dialog.Create(GetDesktopWindow(),
+                                           static_cast<LPARAM>(operation));
+                    progress_dialog.ShowWindow(SW_SHOWNORMAL);
+
+                    // Signal that the progress dialog is ready
+                    SetEvent(event_handle);
+
+                    // Process messages
+                    WindowsMessageLoop();
+
+                    // Destroy the progress window
+                    progress_dialog.DestroyWindow();
+                }
+                catch (const std::exception &e)
+                {
+                    ::ReportError(application_error,
+                                  L"Unexpected error in progress dialog thread",
+                                  e.what());
                 }
                 catch (...)
                 {
-                    // Nothing we can do
+                    ::ReportError(application_error,
+                                  L"Unexpected error in progress dialog "
+                                  L"thread");
                 }
-            }
-            break;
+            });
+
+        // Wait for the progress window to open
+        WaitForSingleObject(event_handle, INFINITE);
+        CloseHandle(event_handle);
+    }
+
+    // Encrypt, decrypt, or verify the files
+    ProcessBatch(batch, progress_dialog, file_list, password, encrypt);
+
+    // This pool thread may have processed files in background mode
+    SetThreadBackgroundMode(false);
+
+    if (progress_thread.joinable())
+    {
+        // Instruct the progress window to terminate
+        DWORD progress_thread_id =
+            GetThreadId(progress_thread.native_handle());
+        PostThreadMessage(progress_thread_id, WM_QUIT, 0, 0);
+
+        // Wait for the progress window thread to complete
+        progress_thread.join();
+    }
+
+    // Summarize the batch, completing the report with the totals
+    BatchSummary summary{};
+    progress_dialog.GetBatchTotals(summary.octets_completed,
+                                   summary.octets_total,
+                                   summary.files_completed,
+                                   summary.files_total);
+    summary.success = !batch.aborted &&
+                      !progress_dialog.WasCancelPressed() &&
+                      (summary.files_completed == summary.files_total) &&
+                      batch.failed_files.empty();
+    summary.files_skipped = batch.files_skipped;
+    summary.peak_memory = batch.peak_memory;
+    summary.error_message = batch.error_message;
+    summary.failed_files = batch.failed_files;
+    summary.report_file = batch.report.Close(summary);
+
+    // Return the summary to the caller
+    if ((completion != nullptr) && (completion->summary != nullptr))
+    {
+        *completion->summary = std::move(summary);
+    }
+
+    // Tell the user whether the files passed verification
+    if (batch.verify_only && !batch.headless)
+    {
+        ReportVerifyResults(batch, progress_dialog);
+    }
+
+    // List the files that could not be processed when continuing on error
+    if (!batch.verify_only && !batch.headless)
+    {
+        ReportBatchFailures(batch, progress_dialog);
+    }
+}
+
+/*
+ *  WorkerThreads::ReportVerifyResults()
+ *
+ *  Description:
+ *      This function will tell the user whether the files in a batch
+ *      passed verification, listing any that failed and the reason.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that showed batch progress.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Nothing is shown if the user cancelled or if an error that stopped
+ *      the batch was already reported.
+ */
+void WorkerThreads::ReportVerifyResults(BatchContext &batch,
+                                        ProgressDialog &progress_dialog) const
+{
+    std::uint64_t octets_completed{};
+    std::uint64_t octets_total{};
+    std::size_t files_completed{};
+    std::size_t files_total{};
+    std::wstring message;
+
+    if (batch.aborted || progress_dialog.WasCancelPressed()) return;
+
+    progress_dialog.GetBatchTotals(octets_completed,
+                                   octets_total,
+                                   files_completed,
+                                   files_total);
+
+    if (batch.failed_files.empty())
+    {
+        message = L"All " + std::to_wstring(files_completed) +
+                  L" file(s) passed verification.";
+        ::MessageBox(NULL,
+                     message.c_str(),
+                     application_name.c_str(),
+                     MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    message = std::to_wstring(batch.failed_files.size()) + L" of " +
+              std::to_wstring(files_completed) +
+              L" file(s) failed verification:\n" +
+              ListFailedFiles(batch.failed_files);
+
+    ::MessageBox(NULL,
+                 message.c_str(),
+                 application_name.c_str(),
+                 MB_OK | MB_ICONWARNING);
+}
+
+/*
+ *  WorkerThreads::ReportBatchFailures()
+ *
+ *  Description:
+ *      This function will tell the user which files in a batch could not
+ *      be encrypted or decrypted when the batch continued on error, giving
+ *      the reason each failed.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that showed batch progress.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Nothing is shown if every file was processed, if the user
+ *      cancelled, or if an error that stopped the batch was already
+ *      reported.
+ */
+void WorkerThreads::ReportBatchFailures(BatchContext &batch,
+                                        ProgressDialog &progress_dialog) const
+{
+    std::uint64_t octets_completed{};
+    std::uint64_t octets_total{};
+    std::size_t files_completed{};
+    std::size_t files_total{};
+    std::wstring message;
+
+    if (batch.failed_files.empty() || batch.aborted ||
+        progress_dialog.WasCancelPressed())
+    {
+        return;
+    }
+
+    progress_dialog.GetBatchTotals(octets_completed,
+                                   octets_total,
+                                   files_completed,
+                                   files_total);
+
+    message = std::to_wstring(batch.failed_files.size()) + L" of " +
+              std::to_wstring(files_total) +
+              L" file(s) could not be processed:\n" +
+              ListFailedFiles(batch.failed_files);
+
+    ::MessageBox(NULL,
+                 message.c_str(),
+                 application_name.c_str(),
+                 MB_OK | MB_ICONWARNING);
+}
+
+/*
+ *  WorkerThreads::ProcessBatch()
+ *
+ *  Description:
+ *      This function will encrypt or decrypt the list of files as a batch.
+ *      The files are ordered such that the largest files are processed first
+ *      and then several files are processed concurrently, with all threads
+ *      sharing the same progress dialog.  Any directories in the list are
+ *      enumerated recursively, with the files found added to the batch as
+ *      they are found.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      file_list [in]
+ *          The list of files and directories to encrypt or decrypt.
+ *
+ *      password [in]
+ *          The password to use for encryption or decryption.
+ *
+ *      encrypt [in]
+ *          True if encrypting, false if decrypting.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The calling thread also processes files, so the batch will complete
+ *      even if no additional threads could be created.  More threads than
+ *      streaming slots are created so that key derivation for the next file
+ *      overlaps the streaming of files already in progress.  When there are
+ *      directories to enumerate, the calling thread enumerates them while
+ *      the other threads begin processing the files found.
+ */
+void WorkerThreads::ProcessBatch(BatchContext &batch,
+                                 ProgressDialog &progress_dialog,
+                                 const FileList &file_list,
+                                 const SecureU8String &password,
+                                 bool encrypt)
+{
+    std::vector<ThreadPool::JobID> helper_jobs;
+    std::vector<std::wstring> directories;
+
+    // When configured to do so, encrypt a selection of several files or a
+    // directory into a single archive
+    if (encrypt && batch.settings.archive_mode && !file_list.empty())
+    {
+        DWORD attributes = ::GetFileAttributesW(file_list.front().c_str());
+
+        if ((file_list.size() > 1) ||
+            ((attributes != INVALID_FILE_ATTRIBUTES) &&
+             (attributes & FILE_ATTRIBUTE_DIRECTORY)))
+        {
+            EncryptArchive(batch, progress_dialog, file_list, password);
+            return;
+        }
+    }
+
+    // Keep a journal so that the batch may be resumed if it does not
+    // complete (verification produces no output, so has no need of one)
+    if (batch.settings.batch_journal && !batch.verify_only)
+    {
+        batch.journal.Open(file_list, encrypt);
+    }
+
+    // Determine the size of each file to be processed, setting aside any
+    // directories to be enumerated
+    batch.files.reserve(file_list.size());
+    for (const auto &in_file : file_list)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes{};
+        std::uint64_t file_size{};
+        std::uint64_t last_write_time{};
+
+        // Attempt to get the file attributes and size (failure is not
+        // critical here, as it will be reported when opening the file)
+        if (::GetFileAttributesExW(in_file.c_str(),
+                                   GetFileExInfoStandard,
+                                   &attributes))
+        {
+            if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                directories.push_back(in_file);
+                continue;
+            }
+
+            file_size =
+                (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) |
+                attributes.nFileSizeLow;
+            last_write_time =
+                (static_cast<std::uint64_t>(
+                     attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                attributes.ftLastWriteTime.dwLowDateTime;
+        }
+
+        batch.files.push_back({in_file, file_size, last_write_time});
+        batch.total_bytes += file_size;
+    }
+
+    // Process the largest files first so that one large file does not
+    // remain to be processed alone at the end of the batch
+    std::stable_sort(batch.files.begin(),
+                     batch.files.end(),
+                     [](const BatchFile &a, const BatchFile &b)
+                     {
+                         return a.file_size > b.file_size;
+                     });
+
+    // Show the size of the batch before processing begins
+    progress_dialog.AddBatchSize(batch.total_bytes, batch.files.size());
+
+    // Directories are enumerated as the batch is processed
+    batch.enumerating = !directories.empty();
+
+    // Determine the number of files to stream concurrently and the number
+    // of threads, allowing extra threads to perform key derivation for
+    // upcoming files while other files are streaming (the number of files
+    // is not known in advance if directories are to be enumerated)
+    batch.streaming_slots = batch.settings.batch_threads;
+    std::size_t concurrency =
+        batch.settings.batch_threads + batch.settings.kdf_prefetch;
+    if (!batch.enumerating)
+    {
+        concurrency = std::min(concurrency, batch.files.size());
+    }
+
+    // Submit jobs to the thread pool to help process files
+    for (std::size_t i = 1; i < concurrency; i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.active_helpers++;
+        }
+
+        auto job_id = thread_pool.Submit(
+            [&]()
+            {
+                BatchWorker(batch, progress_dialog, password, encrypt);
+
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                batch.active_helpers--;
+                batch.cv.notify_all();
+            });
+
+        if (job_id == 0)
+        {
+            // Unable to submit more jobs, so proceed with those submitted
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.active_helpers--;
+            break;
+        }
+
+        helper_jobs.push_back(job_id);
+    }
+
+    // Enumerate directories while the helpers process the files found
+    if (batch.enumerating)
+    {
+        EnumerateBatchDirectories(batch, progress_dialog, directories, encrypt);
+    }
+
+    // This thread also processes files
+    BatchWorker(batch, progress_dialog, password, encrypt);
+
+    // Helpers that have not yet started are no longer needed; since this
+    // thread never waits for a job that has not started, the batch cannot
+    // deadlock when all pool threads are busy
+    for (auto job_id : helper_jobs)
+    {
+        if (thread_pool.Revoke(job_id))
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.active_helpers--;
+        }
+    }
+
+    // Wait for the helpers that started to complete
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.cv.wait(lock, [&]() { return batch.active_helpers == 0; });
+
+    // Close any files whose close jobs have not yet started on this thread,
+    // for the same reason helpers are revoked, then wait for the rest
+    auto close_jobs = std::move(batch.close_jobs);
+    lock.unlock();
+    for (auto &[job_id, pending_close] : close_jobs)
+    {
+        if (thread_pool.Revoke(job_id)) (*pending_close)();
+    }
+    lock.lock();
+    batch.cv.wait(lock, [&]() { return batch.pending_closes == 0; });
+
+    // The journal is no longer needed once every file has been processed,
+    // but is kept to retry any files that failed when continuing on error
+    batch.journal.Close(!batch.aborted &&
+                        !progress_dialog.WasCancelPressed() &&
+                        batch.failed_files.empty());
+}
+
+/*
+ *  WorkerThreads::EnumerateBatchDirectories()
+ *
+ *  Description:
+ *      This function will recursively enumerate the given directories and
+ *      add the files found to the batch.  When encrypting, files that
+ *      already have a .aes extension are skipped.  When decrypting, only
+ *      files having a .aes extension are added.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      directories [in]
+ *          The directories to enumerate.
+ *
+ *      encrypt [in]
+ *          True if encrypting, false if decrypting.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Threads waiting for files are woken as each file is added, so files
+ *      are processed while enumeration continues.  Skipping files by
+ *      extension also ensures that files produced by the batch itself are
+ *      not added to the batch if they appear in a directory not yet fully
+ *      enumerated.
+ */
+void WorkerThreads::EnumerateBatchDirectories(
+                                BatchContext &batch,
+                                ProgressDialog &progress_dialog,
+                                const std::vector<std::wstring> &directories,
+                                bool encrypt)
+{
+    std::wstring failed_directory;
+    DWORD result = ERROR_SUCCESS;
+
+    // Function called for each file found
+    auto file_handler = [&](const std::wstring &filename,
+                            std::uint64_t file_size,
+                            std::uint64_t last_write_time) -> bool
+    {
+        // Stop if the user clicked cancel (or closed the dialog)
+        if (progress_dialog.WasCancelPressed()) return false;
+
+        // Skip files that would not be processed by this operation
+        if (HasAESExtension(filename) == encrypt) return true;
+
+        std::lock_guard<std::mutex> lock(batch.mutex);
+
+        // Stop if processing failed
+        if (batch.aborted) return false;
+
+        batch.files.push_back({filename, file_size, last_write_time});
+        batch.total_bytes += file_size;
+        progress_dialog.AddBatchSize(file_size, 1);
+
+        // Wake a thread waiting for a file to process
+        batch.cv.notify_one();
+
+        return true;
+    };
+
+    for (const auto &directory : directories)
+    {
+        result = EnumerateDirectory(directory, file_handler, failed_directory);
+        if (result != ERROR_SUCCESS) break;
+    }
+
+    // Report any failure to read a directory
+    if ((result != ERROR_SUCCESS) && (result != ERROR_CANCELLED))
+    {
+        ReportBatchError(batch,
+                         L"Unable to read the directory: " + failed_directory,
+                         result);
+    }
+
+    // Enumeration is complete, so wake threads waiting for more files
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    batch.enumerating = false;
+    batch.cv.notify_all();
+}
+
+/*
+ *  WorkerThreads::BatchWorker()
+ *
+ *  Description:
+ *      This function is executed by each thread processing a batch.  It will
+ *      take the next file from the batch and encrypt or decrypt it, repeating
+ *      until there are no more files to process.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      password [in]
+ *          The password to use for encryption or decryption.
+ *
+ *      encrypt [in]
+ *          True if encrypting, false if decrypting.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void WorkerThreads::BatchWorker(BatchContext &batch,
+                                ProgressDialog &progress_dialog,
+                                const SecureU8String &password,
+                                bool encrypt)
+{
+    BatchFile batch_file;
+
+    // Define the extensions to insert into the header
+    const ExtensionList extensions = GetHeaderExtensions();
+
+    try
+    {
+        // Process files until there are no more or processing stops
+        while (NextBatchFile(batch, progress_dialog, batch_file))
+        {
+            bool result{};
+
+            // Errors are recorded against this file if continuing on error
+            BatchFileScope batch_file_scope(batch_file.filename);
+
+            // Apply the background mode selected for the batch, which
+            // lowers the priority of key derivation as well as streaming
+            SetThreadBackgroundMode(progress_dialog.IsBackgroundMode());
+
+            if (encrypt)
+            {
+                result = EncryptBatchFile(batch,
+                                          progress_dialog,
+                                          batch_file,
+                                          password,
+                                          extensions);
+            }
+            else if (batch.verify_only)
+            {
+                result = VerifyBatchFile(batch,
+                                         progress_dialog,
+                                         batch_file,
+                                         password);
+            }
+            else
+            {
+                result = DecryptBatchFile(batch,
+                                          progress_dialog,
+                                          batch_file,
+                                          password);
+            }
+
+            // Ensure no further files are processed on failure, unless the
+            // failure was recorded so the batch may continue
+            if (!result)
+            {
+                if (batch.settings.continue_on_error) continue;
+
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                batch.aborted = true;
+                continue;
+            }
+
+            // Update the count of files completed
+            progress_dialog.FileCompleted();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ReportBatchError(batch,
+                         L"Unhandled exception processing file(s)",
+                         e.what());
+    }
+    catch (...)
+    {
+        ReportBatchError(batch, L"Unhandled exception processing file(s)");
+    }
+
+    // Pool threads must not remain in background mode
+    SetThreadBackgroundMode(false);
+}
+
+/*
+ *  WorkerThreads::NextBatchFile()
+ *
+ *  Description:
+ *      This function will get the next file in the batch to process.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      batch_file [out]
+ *          The next file to process.
+ *
+ *  Returns:
+ *      True if there is a file to process, false if all files have been
+ *      taken, processing failed, or the user cancelled processing.
+ *
+ *  Comments:
+ *      While directories are being enumerated, this will wait for the next
+ *      file to be found.
+ */
+bool WorkerThreads::NextBatchFile(BatchContext &batch,
+                                  ProgressDialog &progress_dialog,
+                                  BatchFile &batch_file)
+{
+    std::unique_lock<std::mutex> lock(batch.mutex);
+
+    // Wait for more files if directories are still being enumerated
+    batch.cv.wait(lock,
+                  [&]() -> bool
+                  {
+                      return batch.aborted ||
+                             progress_dialog.WasCancelPressed() ||
+                             (batch.next_file < batch.files.size()) ||
+                             !batch.enumerating;
+                  });
+
+    // If the user clicked cancel or closed the dialog, stop processing
+    if (progress_dialog.WasCancelPressed()) return false;
+
+    // Stop if processing failed or there are no more files
+    if (batch.aborted || (batch.next_file >= batch.files.size())) return false;
+
+    batch_file = batch.files[batch.next_file++];
+
+    return true;
+}
+
+/*
+ *  WorkerThreads::AcquireStreamingSlot()
+ *
+ *  Description:
+ *      This function is called just before the contents of a file begin to
+ *      stream through the AES Crypt Engine (i.e., after key derivation).  It
+ *      will wait until fewer than the maximum number of files are streaming
+ *      and the memory the file will use fits within both the budget for the
+ *      process and the budget for the batch.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      memory [in]
+ *          The number of octets of memory the file will use while streaming.
+ *
+ *  Returns:
+ *      True if a streaming slot was acquired, false if processing was
+ *      cancelled or aborted while waiting.
+ *
+ *  Comments:
+ *      A slot acquired by this function must be released by calling
+ *      ReleaseStreamingSlot().  A batch having no files streaming is always
+ *      admitted, so it progresses (one file at a time) however little
+ *      memory is available.  Memory released by another batch does not
+ *      notify this batch, so the process budget is checked periodically.
+ */
+bool WorkerThreads::AcquireStreamingSlot(BatchContext &batch,
+                                         ProgressDialog &progress_dialog,
+                                         std::uint64_t memory)
+{
+    std::unique_lock<std::mutex> lock(batch.mutex);
+
+    while (true)
+    {
+        if (batch.aborted || progress_dialog.WasCancelPressed()) return false;
+
+        bool required = (batch.active_streams == 0);
+
+        if ((batch.active_streams < batch.streaming_slots) &&
+            (required || (batch.settings.job_memory_budget == 0) ||
+             (batch.stream_memory + memory <=
+              batch.settings.job_memory_budget)) &&
+            GetMemoryBudget().Reserve(memory, required))
+        {
+            break;
+        }
+
+        batch.cv.wait_for(lock, Memory_Budget_Interval);
+    }
+
+    batch.active_streams++;
+    batch.stream_memory += memory;
+    batch.peak_memory = std::max(batch.peak_memory, batch.stream_memory);
+
+    return true;
+}
+
+/*
+ *  WorkerThreads::ReleaseStreamingSlot()
+ *
+ *  Description:
+ *      This function releases a streaming slot previously acquired by
+ *      calling AcquireStreamingSlot(), allowing another file to stream.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      memory [in]
+ *          The number of octets of memory given when the slot was acquired.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void WorkerThreads::ReleaseStreamingSlot(BatchContext &batch,
+                                         std::uint64_t memory)
+{
+    std::lock_guard<std::mutex> lock(batch.mutex);
+
+    GetMemoryBudget().Release(memory);
+
+    batch.active_streams--;
+    batch.stream_memory -= memory;
+    batch.cv.notify_all();
+}
+
+/*
+ *  WorkerThreads::RecordFileFailure()
+ *
+ *  Description:
+ *      This function will record the failure of the file being processed by
+ *      the calling thread when the batch is to continue on error, so that
+ *      the remaining files are processed and the failures are listed once
+ *      the batch is complete.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      reason [in]
+ *          The reason the file failed.
+ *
+ *  Returns:
+ *      True if the failure was recorded (or the batch has already stopped),
+ *      false if the error is to stop the batch.
+ *
+ *  Comments:
+ *      Errors that are not associated with a file (e.g., failing to read a
+ *      directory or to create an archive) always stop the batch.
+ */
+bool WorkerThreads::RecordFileFailure(BatchContext &batch,
+                                      const std::wstring &reason) const
+{
+    if (!batch.settings.continue_on_error || (current_batch_file == nullptr))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(batch.mutex);
+
+    // Once the batch has stopped, there is nothing more to record
+    if (!batch.aborted)
+    {
+        batch.failed_files.push_back({*current_batch_file, reason});
+    }
+
+    return true;
+}
+
+/*
+ *  WorkerThreads::ReportBatchError()
+ *
+ *  Description:
+ *      This function will report an error that occurred while processing a
+ *      batch and stop any further files from being processed.  Only the first
+ *      error in the batch is reported, since other threads processing files
+ *      at the same time are likely to encounter the same issue (e.g., an
+ *      incorrect password).
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      message [in]
+ *          The message to show the user.
+ *
+ *      reason [in]
+ *          The reason for the error (generally, the value from GetLastError()).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      When continuing on error, an error processing a file is instead
+ *      recorded by RecordFileFailure() and the batch continues.
+ */
+void WorkerThreads::ReportBatchError(BatchContext &batch,
+                                     const std::wstring &message,
+                                     DWORD reason) const
+{
+    // Record the failure against the file and let the batch continue
+    if (RecordFileFailure(batch, FormatError(message, reason))) return;
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+
+    // Only report the first error
+    if (batch.aborted) return;
+    batch.aborted = true;
+
+    // Wake any threads waiting to stream so they will stop
+    batch.cv.notify_all();
+
+    // Record the error for the summary rather than showing it
+    if (batch.headless)
+    {
+        batch.error_message = FormatError(message, reason);
+        return;
+    }
+
+    lock.unlock();
+
+    // Record the time the modal error dialog holds up the batch
+    TraceActivity trace_activity("ErrorDialog", message);
+
+    ::ReportError(application_error, message, reason);
+}
+
+/*
+ *  WorkerThreads::ReportBatchError()
+ *
+ *  Description:
+ *      This function will report an error that occurred while processing a
+ *      batch and stop any further files from being processed.  Only the first
+ *      error in the batch is reported.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      message [in]
+ *          The message to show the user.
+ *
+ *      error_string [in]
+ *          A UTF-8 error string that will be appended to the above message.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      When continuing on error, an error processing a file is instead
+ *      recorded by RecordFileFailure() and the batch continues.
+ */
+void WorkerThreads::ReportBatchError(BatchContext &batch,
+                                     const std::wstring &message,
+                                     const std::string &error_string) const
+{
+    // Record the failure against the file and let the batch continue
+    if (RecordFileFailure(batch, FormatError(message, error_string))) return;
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+
+    // Only report the first error
+    if (batch.aborted) return;
+    batch.aborted = true;
+
+    // Wake any threads waiting to stream so they will stop
+    batch.cv.notify_all();
+
+    // Record the error for the summary rather than showing it
+    if (batch.headless)
+    {
+        batch.error_message = FormatError(message, error_string);
+        return;
+    }
+
+    lock.unlock();
+
+    // Record the time the modal error dialog holds up the batch
+    TraceActivity trace_activity("ErrorDialog", message);
+
+    ::ReportError(application_error, message, error_string);
+}
+
+/*
+ *  WorkerThreads::ReportBatchError()
+ *
+ *  Description:
+ *      This function will report an error that occurred while processing a
+ *      batch and stop any further files from being processed.  Only the first
+ *      error in the batch is reported.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      message [in]
+ *          The message to show the user (encoded as UTF-8).
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      When continuing on error, an error processing a file is instead
+ *      recorded by RecordFileFailure() and the batch continues.
+ */
+void WorkerThreads::ReportBatchError(BatchContext &batch,
+                                     const std::string &message) const
+{
+    // Record the failure against the file and let the batch continue
+    if (RecordFileFailure(batch, FormatError(message))) return;
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+
+    // Only report the first error
+    if (batch.aborted) return;
+    batch.aborted = true;
+
+    // Wake any threads waiting to stream so they will stop
+    batch.cv.notify_all();
+
+    // Record the error for the summary rather than showing it
+    if (batch.headless)
+    {
+        batch.error_message = FormatError(message);
+        return;
+    }
+
+    lock.unlock();
+
+    // Record the time the modal error dialog holds up the batch
+    TraceActivity trace_activity("ErrorDialog", {});
+
+    ::ReportError(application_error, message);
+}
+
+/*
+ *  WorkerThreads::UpdateBatchProgress()
+ *
+ *  Description:
+ *      This function is called as a file is processed to add the octets
+ *      processed to the batch total shown by the progress dialog.
+ *
+ *  Parameters:
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      input_size [in]
+ *          The size of the file being processed.
+ *
+ *      reported_position [in/out]
+ *          The position within the file already added to the batch total.
+ *
+ *      position [in]
+ *          The current position within the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      This only updates an atomic counter that the progress dialog samples
+ *      periodically, so it takes no locks and never waits on the progress
+ *      dialog thread.
+ */
+void WorkerThreads::UpdateBatchProgress(ProgressDialog &progress_dialog,
+                                        std::uint64_t input_size,
+                                        std::uint64_t &reported_position,
+                                        std::uint64_t position) const
+{
+    // Do not count more than the expected size of the file
+    position = std::min(position, input_size);
+    if (position <= reported_position) return;
+
+    // Add the octets processed since the last update to the batch total
+    progress_dialog.AddBatchProgress(position - reported_position);
+    reported_position = position;
+}
+
+/*
+ *  WorkerThreads::ApplyBatchOptions()
+ *
+ *  Description:
+ *      Apply the options given with a request to the settings loaded for
+ *      the batch and configure the batch throttle accordingly.
+ *
+ *  Parameters:
+ *      batch [in/out]
+ *          The batch context whose settings are to be updated.
+ *
+ *      completion [in]
+ *          Completion state for the request, which holds the options given
+ *          by the caller, or nullptr if there is none.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Options given with the request take precedence over the settings,
+ *      though options left as zero leave the settings unchanged.
+ */
+void WorkerThreads::ApplyBatchOptions(BatchContext &batch,
+                                      const RequestCompletion *completion) const
+{
+    if (completion != nullptr)
+    {
+        const BatchOptions &options = completion->options;
+
+        if (options.background) batch.settings.background_mode = true;
+        if (options.sync) batch.settings.sync_mode = true;
+        if (options.continue_on_error)
+        {
+            batch.settings.continue_on_error = true;
+        }
+        if (options.bandwidth_limit > 0)
+        {
+            batch.settings.bandwidth_limit =
+                static_cast<std::uint64_t>(options.bandwidth_limit) *
+                1'000'000;
+        }
+        if (options.cpu_share > 0)
+        {
+            batch.settings.cpu_share = options.cpu_share;
+        }
+    }
+
+    batch.throttle.Configure(batch.settings.bandwidth_limit,
+                             batch.settings.cpu_share);
+}
+
+/*
+ *  WorkerThreads::PaceStream()
+ *
+ *  Description:
+ *      This function is called as a file is processed to apply the current
+ *      background mode to the calling thread and, while in background mode,
+ *      pause as needed to keep within the bandwidth and processor limits.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      state [in/out]
+ *          The throttle state for the file being processed.
+ *
+ *      position [in]
+ *          The current position within the file.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      The user may enter or leave background mode at any time using the
+ *      progress dialog, so the pause is taken in short intervals and ends
+ *      early if the user leaves background mode or cancels processing.
+ *      The limits apply only in background mode.
+ */
+void WorkerThreads::PaceStream(BatchContext &batch,
+                               ProgressDialog &progress_dialog,
+                               Throttle::StreamState &state,
+                               std::uint64_t position) const
+{
+    bool background = progress_dialog.IsBackgroundMode();
+
+    SetThreadBackgroundMode(background);
+
+    // Account for progress even when not limited so the throttle has an
+    // accurate view of the stream if background mode is entered
+    auto delay = batch.throttle.Pace(state, position);
+    if (!background) return;
+
+    auto end_time = std::chrono::steady_clock::now() + delay;
+
+    while (!progress_dialog.WasCancelPressed() &&
+           progress_dialog.IsBackgroundMode())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= end_time) break;
+
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(
+                end_time - now,
+                std::chrono::milliseconds(100)));
+    }
+}
+
+/*
+ *  WorkerThreads::EncryptBatchFile()
+ *
+ *  Description:
+ *      This function will encrypt a single file that is part of a batch.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      batch_file [in]
+ *          The file to encrypt.
+ *
+ *      password [in]
+ *          The password to use for encryption.
+ *
+ *      extensions [in]
+ *          Plaintext extension data to insert into the AES stream header.
+ *
+ *
+ *  Returns:
+ *      True if successful, false if there was an error or the user
+ *      cancelled processing.
+ *
+ *  Comments:
+ *      None.
+ */
+bool WorkerThreads::EncryptBatchFile(BatchContext &batch,
+                                     ProgressDialog &progress_dialog,
+                                     const BatchFile &batch_file,
+                                     const SecureU8String &password,
+                                     const ExtensionList &extensions)
+{
+    const std::wstring &in_file = batch_file.filename;
+    OverlappedFileReader reader(batch.settings.io_buffer_size,
+                                batch.settings.io_queue_depth);
+    MappedFileReader mapped_reader;
+    auto writer = std::make_shared<OverlappedFileWriter>(
+                                            batch.settings.io_buffer_size,
+                                            batch.settings.io_queue_depth);
+    std::streambuf *input_buffer{};
+    bool remove_on_fail{};
+
+    // Define the output filename
+    std::wstring out_file = in_file + L".aes";
+
+    // Skip the file if it was completed by an earlier run of this batch
+    if (batch.journal.IsCompleted(batch_file, out_file))
+    {
+        progress_dialog.AddBatchProgress(batch_file.file_size);
+        return true;
+    }
+
+    // In sync mode, skip the file if the existing output was produced from
+    // the input file as it is now; otherwise, the existing output is
+    // replaced only once the new output is complete
+    bool replace_output{};
+    if (batch.settings.sync_mode)
+    {
+        std::error_code ec;
+
+        if (std::filesystem::is_regular_file(std::filesystem::path(out_file),
+                                             ec))
+        {
+            if (IsOutputCurrent(batch_file, out_file))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(batch.mutex);
+                    batch.files_skipped++;
+                }
+                progress_dialog.AddBatchProgress(batch_file.file_size);
+                return true;
+            }
+
+            replace_output = true;
+        }
+    }
+
+    // Display the file name
+    progress_dialog.SetFileName(in_file);
+
+    // Open the input file for reading
+    TraceActivity open_trace("OpenInput", in_file);
+    DWORD error_code = OpenInputFile(batch.settings,
+                                     batch_file,
+                                     reader,
+                                     mapped_reader,
+                                     input_buffer);
+    open_trace.SetResult(error_code);
+    open_trace.Stop();
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the input file " + in_file;
+        ReportBatchError(batch, message, error_code);
+
+        return false;
+    }
+
+    // Hold back reading the input (but not key derivation) until this file
+    // is allowed to stream, along with the memory it will use
+    std::uint64_t stream_memory{};
+    StreamTrace stream_trace(in_file);
+    GatedStreamBuffer gated_input(input_buffer,
+                                  [&]() -> bool
+                                  {
+                                      stream_trace.KeyDerived();
+                                      return stream_trace.Streaming(
+                                          AcquireStreamingSlot(
+                                              batch,
+                                              progress_dialog,
+                                              stream_memory));
+                                  });
+
+    // Compress the input ahead of encryption if configured, naming the
+    // algorithm in the header so that decryption can reverse it
+    CompressionAlgorithm compression =
+        CompressionFromSetting(batch.settings.compression);
+    CompressingStreamBuffer compressed_input(&gated_input, compression);
+    ExtensionList file_extensions = extensions;
+    std::function<std::uint64_t()> input_position;
+    std::streambuf *plaintext_buffer = &gated_input;
+    if (compression != CompressionAlgorithm::None)
+    {
+        error_code = compressed_input.Open();
+        if (error_code != ERROR_SUCCESS)
+        {
+            std::wstring message = L"Unable to compress the input file " +
+                                   in_file;
+            ReportBatchError(batch, message, error_code);
+
+            return false;
+        }
+
+        file_extensions.emplace_back(Compression_Extension,
+                                     CompressionName(compression));
+        input_position = [&]() { return compressed_input.GetPosition(); };
+        plaintext_buffer = &compressed_input;
+    }
+
+    // In sync mode, record the input file's size and last write time so a
+    // later run can tell whether the output is up to date
+    if (batch.settings.sync_mode)
+    {
+        file_extensions.emplace_back(Source_Size_Extension,
+                                     std::to_string(batch_file.file_size));
+        file_extensions.emplace_back(
+                                Source_Time_Extension,
+                                std::to_string(batch_file.last_write_time));
+    }
+
+    std::istream input_stream(plaintext_buffer);
+
+    try
+    {
+        // Get the file status of the output file
+        std::filesystem::file_status file_status =
+            std::filesystem::status(std::filesystem::path(out_file));
+
+        // If the output file does not exist, attempt to remove later
+        // (Do not remove by default so as to not attempt to remove things
+        // like character special devices.)
+        if (!std::filesystem::exists(file_status)) remove_on_fail = true;
+
+        // Does a regular file having this output file name exist (other
+        // than one being replaced in sync mode)?
+        if (std::filesystem::is_regular_file(file_status) && !replace_output)
+        {
+            // Report an error opening the file
+            ReportBatchError(batch,
+                             std::wstring(L"Output file already exists: ") +
+                                 out_file);
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file,
+                         e.what());
+        return false;
+    }
+    catch (...)
+    {
+        // Report an error opening the file
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file);
+        return false;
+    }
+
+    // An output file being replaced is written under a temporary name and
+    // renamed over the existing file once complete, so the existing file
+    // remains intact if encryption fails
+    if (replace_output) remove_on_fail = true;
+    std::wstring write_file =
+        replace_output ? out_file + Partial_Extension : out_file;
+
+    // Open the output file for writing, only bypassing the system file cache
+    // when creating a new file (i.e., not when writing to a device); a new
+    // file must not already exist, so a temporary file of that name that
+    // belongs to the user is never truncated or later removed
+    TraceActivity create_trace("OpenOutput", write_file);
+    error_code =
+        writer->Open(write_file,
+                     batch.settings.unbuffered_io && remove_on_fail,
+                     remove_on_fail);
+    create_trace.SetResult(error_code);
+    create_trace.Stop();
+    if (error_code == ERROR_FILE_EXISTS)
+    {
+        ReportBatchError(batch,
+                         std::wstring(L"Output file already exists: ") +
+                             write_file);
+
+        return false;
+    }
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the output file " + write_file;
+        ReportBatchError(batch, message, error_code);
+
+        return false;
+    }
+
+    // Record the new output file so it is removed if the batch is resumed
+    // before this file is complete
+    if (remove_on_fail) batch.journal.Started(batch_file, write_file);
+
+    // Reserve space for the new output file (if compressed, the output is
+    // usually smaller and the file is trimmed when closed)
+    if (batch.settings.preallocate_output && remove_on_fail)
+    {
+        writer->Preallocate(EncryptedSize(batch_file.file_size,
+                                          file_extensions));
+    }
+
+    // For a large file, hand the encrypted output to a separate thread to
+    // be written so that the encrypting thread does not wait on writes
+    // (following the batch's background mode, as the encrypting thread does)
+    PipelinedStreamBuffer pipelined_output(
+        writer.get(),
+        Pipeline_Buffer_Size,
+        Pipeline_Depth,
+        [&]() -> bool { return progress_dialog.IsBackgroundMode(); });
+    bool pipelined = (batch.settings.pipeline_threshold > 0) &&
+                     (batch_file.file_size >=
+                      batch.settings.pipeline_threshold) &&
+                     pipelined_output.Start();
+    std::streambuf *output_buffer = writer.get();
+    if (pipelined) output_buffer = &pipelined_output;
+    std::ostream output_stream(output_buffer);
+
+    // Determine the memory this file will use while streaming
+    stream_memory = reader.GetBufferOctets() + writer->GetBufferOctets() +
+                    Engine_Stream_Memory;
+    if (pipelined) stream_memory += Pipeline_Buffer_Size * Pipeline_Depth;
+    if (compression != CompressionAlgorithm::None)
+    {
+        stream_memory += 2 * Compression_Block_Size;
+    }
+
+    // Encrypt the input stream
+    std::string result_text;
+    stream_trace.Start();
+    bool result = EncryptStream(batch,
+                                progress_dialog,
+                                in_file,
+                                password,
+                                KDF_Iterations,
+                                file_extensions,
+                                batch_file.file_size,
+                                input_stream,
+                                output_stream,
+                                input_position,
+                                &result_text);
+
+    // Wait for the pipelined output to be written; a write error that
+    // occurs after the engine completes would otherwise go unreported
+    if (pipelined && !pipelined_output.Finish() && result)
+    {
+        ReportBatchError(batch,
+                         L"Unable to write the output file " + out_file,
+                         writer->GetError());
+        result = false;
+    }
+    stream_trace.Stop(batch_file.file_size);
+
+    // Allow another file to stream
+    if (gated_input.WasOpened()) ReleaseStreamingSlot(batch, stream_memory);
+
+    // If streaming was not permitted, the input was not fully consumed
+    if (gated_input.WasDenied()) result = false;
+
+    // Record the measurements of this file for the batch report
+    DWORD read_error = reader.GetError();
+    if (read_error == ERROR_SUCCESS) read_error = mapped_reader.GetError();
+    FileReport file_report = StreamReport(in_file,
+                                          batch_file.file_size,
+                                          stream_trace,
+                                          &reader,
+                                          writer.get(),
+                                          result_text);
+    file_report.error_code =
+        (read_error != ERROR_SUCCESS) ? read_error : writer->GetError();
+
+    // Close the input file
+    reader.Close();
+    mapped_reader.Close();
+
+    // A read error would otherwise appear to be the end of the input file
+    if (result && (read_error != ERROR_SUCCESS))
+    {
+        ReportBatchError(batch,
+                         L"Unable to read the input file " + in_file,
+                         read_error);
+        result = false;
+    }
+
+    // Close the output file; there may be delay in closing the output file
+    // if it is large and transmission is over a network, so this may
+    // complete on another thread while the next file is processed
+    if (result)
+    {
+        return CloseOutputFile(batch,
+                               writer,
+                               batch_file,
+                               out_file,
+                               write_file,
+                               file_report,
+                               remove_on_fail,
+                               replace_output);
+    }
+
+    // The encryption process failed, so close the partial output file
+    writer->Close();
+    file_report.octets_out = writer->GetOctetsWritten();
+    batch.report.AddFile(file_report);
+
+    // Remove the partial output file if it's not stdout
+    if (remove_on_fail)
+    {
+        TraceActivity cleanup_trace("Cleanup", write_file);
+
+        try
+        {
+            std::filesystem::remove(std::filesystem::path(write_file));
+        }
+        catch (...)
+        {
+            // Nothing we can do
+        }
+    }
+
+    return false;
+}
+
+/*
+ *  WorkerThreads::EncryptArchive()
+ *
+ *  Description:
+ *      This function will encrypt the list of files and directories into a
+ *      single archive.  Directories are enumerated recursively, with each
+ *      file stored using its path relative to the directory containing the
+ *      selected items.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      file_list [in]
+ *          The list of files and directories to encrypt.
+ *
+ *      password [in]
+ *          The password to use for encryption.
+ *
+ *  Returns:
+ *      True if successful, false if there was an error or the user
+ *      cancelled processing.
+ *
+ *  Comments:
+ *      A single directory is encrypted to a file named after the directory,
+ *      while several items are encrypted to a file named after the directory
+ *      containing them.  The key is derived only once for the entire
+ *      archive.  Empty directories are not stored in the archive.
+ */
+bool WorkerThreads::EncryptArchive(BatchContext &batch,
+                                   ProgressDialog &progress_dialog,
+                                   const FileList &file_list,
+                                   const SecureU8String &password)
+{
+    ArchiveBuilder builder(batch.settings.io_buffer_size,
+                           batch.settings.io_queue_depth,
+                           batch.settings.unbuffered_io);
+    OverlappedFileWriter writer(batch.settings.io_buffer_size,
+                                batch.settings.io_queue_depth);
+    std::set<std::wstring> member_names;
+    std::wstring parent_directory;
+    std::wstring out_file;
+    std::wstring name_error;
+    bool remove_on_fail{};
+
+    // Function to add a file to the archive, named relative to the parent
+    auto add_member = [&](const std::wstring &filename,
+                          std::uint64_t file_size,
+                          std::uint64_t last_write_time) -> bool
+    {
+        // Stop if the user clicked cancel (or closed the dialog)
+        if (progress_dialog.WasCancelPressed()) return false;
+
+        std::wstring name = filename.substr(parent_directory.size());
+
+        // Names differing only in case would refer to the same file
+        std::wstring folded_name = name;
+        std::transform(folded_name.begin(),
+                       folded_name.end(),
+                       folded_name.begin(),
+                       [](wchar_t c) { return std::towlower(c); });
+
+        if (!member_names.insert(folded_name).second ||
+            !builder.AddMember(filename, name, file_size, last_write_time))
+        {
+            name_error = filename;
+            return false;
+        }
+
+        return true;
+    };
+
+    for (const auto &item : file_list)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes{};
+        std::wstring item_name = item;
+
+        // Remove any trailing separator from the name
+        while ((item_name.size() > 1) &&
+               ((item_name.back() == L'\\') || (item_name.back() == L'/')))
+        {
+            item_name.pop_back();
+        }
+
+        // Names within the archive are relative to the item's parent
+        std::size_t separator = item_name.find_last_of(L"\\/");
+        parent_directory = (separator == std::wstring::npos) ?
+                               std::wstring() :
+                               item_name.substr(0, separator + 1);
+
+        if (!::GetFileAttributesExW(item_name.c_str(),
+                                    GetFileExInfoStandard,
+                                    &attributes))
+        {
+            std::wstring message = L"Unable to open the input file " + item;
+            ReportBatchError(batch, message, ::GetLastError());
+
+            return false;
+        }
+
+        if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            std::wstring failed_directory;
+
+            DWORD result =
+                EnumerateDirectory(item_name, add_member, failed_directory);
+            if (result == ERROR_CANCELLED) break;
+            if (result != ERROR_SUCCESS)
+            {
+                ReportBatchError(batch,
+                                 L"Unable to read the directory: " +
+                                     failed_directory,
+                                 result);
+                return false;
+            }
+        }
+        else
+        {
+            std::uint64_t file_size =
+                (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) |
+                attributes.nFileSizeLow;
+            std::uint64_t last_write_time =
+                (static_cast<std::uint64_t>(
+                     attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                attributes.ftLastWriteTime.dwLowDateTime;
+
+            if (!add_member(item_name, file_size, last_write_time)) break;
+        }
+
+        // Name a single directory's archive after that directory
+        if (file_list.size() == 1) out_file = item_name;
+    }
+
+    // Stop if the user cancelled while the files were enumerated
+    if (progress_dialog.WasCancelPressed()) return false;
+
+    if (!name_error.empty())
+    {
+        ReportBatchError(batch,
+                         L"Unable to store this file in the archive: " +
+                             name_error);
+        return false;
+    }
+
+    if (builder.GetMemberCount() == 0)
+    {
+        ReportBatchError(batch, L"There are no files to encrypt");
+        return false;
+    }
+
+    // Otherwise, name the archive after the directory holding the items
+    if (out_file.empty())
+    {
+        out_file = parent_directory;
+        if (!out_file.empty()) out_file.pop_back();
+
+        std::size_t separator = out_file.find_last_of(L"\\/");
+        std::wstring base_name = (separator == std::wstring::npos) ?
+                                     out_file :
+                                     out_file.substr(separator + 1);
+
+        // The root of a drive has no name to use
+        if (base_name.empty() || (base_name.back() == L':'))
+        {
+            base_name = L"Archive";
+        }
+
+        out_file = parent_directory + base_name;
+    }
+    out_file += std::wstring(Archive_Extension) + L".aes";
+
+    // Display the file name
+    progress_dialog.SetFileName(out_file);
+
+    try
+    {
+        // Get the file status of the output file
+        std::filesystem::file_status file_status =
+            std::filesystem::status(std::filesystem::path(out_file));
+
+        // If the output file does not exist, attempt to remove later
+        if (!std::filesystem::exists(file_status)) remove_on_fail = true;
+
+        // Does a regular file having this output file name exist?
+        if (std::filesystem::is_regular_file(file_status))
+        {
+            // Report an error opening the file
+            ReportBatchError(batch,
+                             std::wstring(L"Output file already exists: ") +
+                                 out_file);
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             out_file,
+                         e.what());
+        return false;
+    }
+    catch (...)
+    {
+        // Report an error opening the file
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             out_file);
+        return false;
+    }
+
+    // Open the output file for writing
+    TraceActivity create_trace("OpenOutput", out_file);
+    DWORD error_code =
+        writer.Open(out_file, batch.settings.unbuffered_io && remove_on_fail);
+    create_trace.SetResult(error_code);
+    create_trace.Stop();
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the output file " + out_file;
+        ReportBatchError(batch, message, error_code);
+
+        return false;
+    }
+
+    // Show the size of the archive, counting each member as it is read
+    std::uint64_t archive_size = builder.GetArchiveSize();
+    progress_dialog.AddBatchSize(archive_size, builder.GetMemberCount());
+
+    // Reserve space for the new output file
+    if (batch.settings.preallocate_output && remove_on_fail)
+    {
+        writer.Preallocate(EncryptedSize(archive_size, GetHeaderExtensions()));
+    }
+    builder.SetMemberCallback([&]() { progress_dialog.FileCompleted(); });
+
+    // Key derivation ends when the engine first reads the archive
+    StreamTrace stream_trace(out_file);
+    GatedStreamBuffer gated_input(&builder,
+                                  [&]() -> bool
+                                  {
+                                      stream_trace.KeyDerived();
+                                      return stream_trace.Streaming(true);
+                                  });
+    std::istream input_stream(&gated_input);
+    std::ostream output_stream(&writer);
+
+    // Encrypt the archive
+    std::string result_text;
+    stream_trace.Start();
+    bool result = EncryptStream(batch,
+                                progress_dialog,
+                                out_file,
+                                password,
+                                KDF_Iterations,
+                                GetHeaderExtensions(),
+                                archive_size,
+                                input_stream,
+                                output_stream,
+                                {},
+                                &result_text);
+    stream_trace.Stop(archive_size);
+
+    // The archive is reported as a single file
+    FileReport file_report = StreamReport(out_file,
+                                          archive_size,
+                                          stream_trace,
+                                          nullptr,
+                                          &writer,
+                                          result_text);
+
+    // Close the files
+    DWORD read_error = builder.GetError();
+    std::wstring read_error_file = builder.GetErrorFile();
+    TraceActivity close_trace("Close", out_file);
+    auto close_start = std::chrono::steady_clock::now();
+    builder.Close();
+    error_code = writer.Close();
+    close_trace.SetResult(error_code);
+    close_trace.Stop();
+
+    // Complete the archive's record in the batch report
+    file_report.octets_out = writer.GetOctetsWritten();
+    file_report.close_time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - close_start)
+            .count());
+    file_report.error_code =
+        (read_error != ERROR_SUCCESS) ? read_error : error_code;
+    batch.report.AddFile(file_report);
+
+    // A read error would otherwise appear to be the end of the archive
+    if (result && (read_error != ERROR_SUCCESS))
+    {
+        ReportBatchError(batch,
+                         L"Unable to read the input file " + read_error_file,
+                         read_error);
+        result = false;
+    }
+
+    // Report any failure to write the output file completely
+    if (result && (error_code != ERROR_SUCCESS))
+    {
+        ReportBatchError(batch,
+                         L"Unable to write the output file " + out_file,
+                         error_code);
+        result = false;
+    }
+
+    // Did the encryption process fail?
+    if (!result)
+    {
+        if (remove_on_fail)
+        {
+            TraceActivity cleanup_trace("Cleanup", out_file);
+
+            try
+            {
+                std::filesystem::remove(std::filesystem::path(out_file));
+            }
+            catch (...)
+            {
+                // Nothing we can do
+            }
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ *  WorkerThreads::EncryptStream()
+ *
+ *  Description:
+ *      This function will encrypt the given input stream to the given output
+ *      stream using the specified password.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows encryption progress.
+ *
+ *      filename [in]
+ *          The name of the file to encrypt.
+ *
+ *      password [in]
+ *          The password (in UTF-16 format) to use for encryption.
+ *
+ *      iterations [in]
+ *          The number of Key Derivation Function (KDF) iterations to perform.
+ *
+ *      extensions [in]
+ *          Plaintext extension data to insert into the AES stream header.
+ *
+ *      input_size [in]
+ *          The size of the input stream.
+ *
+ *      istream [in]
+ *          A reference to the input stream.
+ *
+ *      ostream [in]
+ *          A reference to the output stream.
+ *
+ *      input_position [in]
+ *          If given, a function returning the number of octets of the input
+ *          consumed, used to report progress when the stream read by the
+ *          engine is not the input itself (e.g., when it is compressed).
+ *
+ *      result_text [out]
+ *          If given, receives the engine's result as text, whether or not
+ *          encryption succeeded.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      The progress meter reflects the progress of the entire batch.  The
+ *      engine runs on the calling thread.
+ */
+bool WorkerThreads::EncryptStream(BatchContext &batch,
+                                  ProgressDialog &progress_dialog,
+                                  const std::wstring &filename,
+                                  const SecureU8String &password,
+                                  const std::uint32_t iterations,
+                                  const ExtensionList &extensions,
+                                  const std::uint64_t input_size,
+                                  std::istream &istream,
+                                  std::ostream &ostream,
+                                  const std::function<std::uint64_t()>
+                                      &input_position,
+                                  std::string *result_text) const
+{
+    Terra::AESCrypt::Engine::Encryptor encryptor;
+    std::uint64_t reported_position{};
+    Throttle::StreamState throttle_state;
+
+    // Progress meter update function (called on this thread by the engine)
+    auto progress_updater = [&]([[maybe_unused]]const std::string &instance,
+                                std::size_t position)
+    {
+        // Stop if the user clicked cancel (or closed the dialog)
+        if (progress_dialog.WasCancelPressed()) encryptor.Cancel();
+
+        // The engine's position is within the compressed stream, if any, so
+        // use the position within the input (kept as 64 bits, as the input
+        // may exceed 4 GiB on 32-bit builds)
+        std::uint64_t input_offset = position;
+        if (input_position) input_offset = input_position();
+
+        UpdateBatchProgress(progress_dialog,
+                            input_size,
+                            reported_position,
+                            input_offset);
+
+        // Pause as needed to remain within background mode limits
+        PaceStream(batch, progress_dialog, throttle_state, input_offset);
+    };
+
+    // Allow the progress dialog thread to cancel encryption directly, as the
+    // engine may be deriving the key or blocked on I/O for some time
+    CancelRegistration cancel_registration(batch,
+                                           [&]() { encryptor.Cancel(); });
+    if (progress_dialog.WasCancelPressed()) return false;
+
+    // Encrypt the current input stream
+    auto encrypt_result = encryptor.Encrypt(
+        static_cast<std::u8string>(password),
+        iterations,
+        istream,
+        ostream,
+        extensions,
+        progress_updater,
+        Progress_Interval);
+
+    // Return the engine's result to the caller if requested
+    if (result_text != nullptr)
+    {
+        std::ostringstream oss;
+        oss << encrypt_result;
+        *result_text = oss.str();
+    }
+
+    // Account for any octets not yet reflected in the batch progress
+    UpdateBatchProgress(progress_dialog,
+                        input_size,
+                        reported_position,
+                        input_size);
+
+    // Present a reason to the user in the event of an error
+    if ((encrypt_result != Terra::AESCrypt::Engine::EncryptResult::Success) &&
+        (encrypt_result !=
+         Terra::AESCrypt::Engine::EncryptResult::EncryptionCancelled))
+    {
+        std::ostringstream oss;
+
+        // An error resulting from the user cancelling is not reported
+        if (progress_dialog.WasCancelPressed()) return false;
+
+        // Convert the encryption result into a string
+        oss << encrypt_result;
+
+        // Report the error to the user
+        ReportBatchError(batch, std::string("Failed to encrypt: ") + oss.str());
+
+        return false;
+    }
+
+    // Return true only if encryption succeeded
+    return encrypt_result == Terra::AESCrypt::Engine::EncryptResult::Success;
+}
+
+/*
+ *  WorkerThreads::DecryptBatchFile()
+ *
+ *  Description:
+ *      This function will decrypt a single file that is part of a batch.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      batch_file [in]
+ *          The file to decrypt.
+ *
+ *      password [in]
+ *          The password to use for decryption.
+ *
+ *
+ *  Returns:
+ *      True if successful, false if there was an error or the user
+ *      cancelled processing.
+ *
+ *  Comments:
+ *      None.
+ */
+bool WorkerThreads::DecryptBatchFile(BatchContext &batch,
+                                     ProgressDialog &progress_dialog,
+                                     const BatchFile &batch_file,
+                                     const SecureU8String &password)
+{
+    const std::wstring &in_file = batch_file.filename;
+    OverlappedFileReader reader(batch.settings.io_buffer_size,
+                                batch.settings.io_queue_depth);
+    MappedFileReader mapped_reader;
+    auto writer = std::make_shared<OverlappedFileWriter>(
+                                            batch.settings.io_buffer_size,
+                                            batch.settings.io_queue_depth);
+    std::streambuf *input_buffer{};
+    bool remove_on_fail{};
+
+    // An encrypted archive is extracted into a directory
+    if (HasArchiveExtension(in_file.substr(0, in_file.size() - 4)))
+    {
+        return ExtractArchive(batch, progress_dialog, batch_file, password);
+    }
+
+    // Define the output filename (same as input file without .aes)
+    std::wstring out_file = in_file;
+    out_file.resize(out_file.size() - 4);
+
+    // Skip the file if it was completed by an earlier run of this batch
+    if (batch.journal.IsCompleted(batch_file, out_file))
+    {
+        progress_dialog.AddBatchProgress(batch_file.file_size);
+        return true;
+    }
+
+    // Display the file name
+    progress_dialog.SetFileName(in_file);
+
+    // Open the input file for reading
+    TraceActivity open_trace("OpenInput", in_file);
+    DWORD error_code = OpenInputFile(batch.settings,
+                                     batch_file,
+                                     reader,
+                                     mapped_reader,
+                                     input_buffer);
+    open_trace.SetResult(error_code);
+    open_trace.Stop();
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the input file " + in_file;
+        ReportBatchError(batch, message, error_code);
+
+        return false;
+    }
+
+    std::istream input_stream(input_buffer);
+
+    try
+    {
+        // Get the file status of the output file
+        std::filesystem::file_status file_status =
+            std::filesystem::status(std::filesystem::path(out_file));
+
+        // If the output file does not exist, attempt to remove later
+        // (Do not remove by default so as to not attempt to remove things
+        // like character special devices.)
+        if (!std::filesystem::exists(file_status)) remove_on_fail = true;
+
+        // Does a regular file having this output file name exist?
+        if (std::filesystem::is_regular_file(file_status))
+        {
+            // Report an error opening the file
+            ReportBatchError(batch,
+                             std::wstring(L"Output file already exists: ") +
+                                 out_file);
+
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        // Report an error opening the file
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file,
+                         e.what());
+        return false;
+    }
+    catch (...)
+    {
+        // Report an error opening the file
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file);
+        return false;
+    }
+
+    // If the contents were compressed before being encrypted, decompress
+    // them as they are written
+    CompressionAlgorithm compression;
+    if (!GetFileCompression(in_file, compression))
+    {
+        ReportBatchError(batch,
+                         L"Unsupported compression algorithm in " + in_file);
+
+        return false;
+    }
+    DecompressingStreamBuffer decompressed_output(writer.get(), compression);
+    std::streambuf *output_buffer = writer.get();
+    if (compression != CompressionAlgorithm::None)
+    {
+        error_code = decompressed_output.Open();
+        if (error_code != ERROR_SUCCESS)
+        {
+            std::wstring message = L"Unable to decompress the input file " +
+                                   in_file;
+            ReportBatchError(batch, message, error_code);
+
+            return false;
+        }
+
+        output_buffer = &decompressed_output;
+    }
+
+    // A new output file is written under a temporary name and renamed only
+    // once decryption completes and the HMAC is verified, so the decrypted
+    // contents never appear under the output name unless they are valid
+    std::wstring write_file =
+        remove_on_fail ? out_file + Partial_Extension : out_file;
+
+    // Open the output file for writing, only bypassing the system file cache
+    // when creating a new file (i.e., not when writing to a device); the
+    // temporary file must not already exist, so a file of that name that
+    // belongs to the user is never truncated or later removed
+    TraceActivity create_trace("OpenOutput", write_file);
+    error_code =
+        writer->Open(write_file,
+                     batch.settings.unbuffered_io && remove_on_fail,
+                     remove_on_fail);
+    create_trace.SetResult(error_code);
+    create_trace.Stop();
+    if (error_code == ERROR_FILE_EXISTS)
+    {
+        ReportBatchError(batch,
+                         std::wstring(L"Temporary output file already "
+                                      L"exists: ") +
+                             write_file);
+
+        return false;
+    }
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the output file " + write_file;
+        ReportBatchError(batch, message, error_code);
+
+        return false;
+    }
+
+    // Record the new output file so it is removed if the batch is resumed
+    // before this file is complete
+    if (remove_on_fail) batch.journal.Started(batch_file, write_file);
+
+    // Reserve space for the new output file, which is no larger than the
+    // input file unless its contents were compressed
+    if (batch.settings.preallocate_output && remove_on_fail)
+    {
+        writer->Preallocate(batch_file.file_size);
+    }
+
+    // Determine the memory this file will use while streaming
+    std::uint64_t stream_memory = reader.GetBufferOctets() +
+                                  writer->GetBufferOctets() +
+                                  Engine_Stream_Memory;
+    if (compression != CompressionAlgorithm::None)
+    {
+        stream_memory += 2 * Compression_Block_Size;
+    }
+
+    // Hold back writing the output (but not key derivation) until this file
+    // is allowed to stream
+    StreamTrace stream_trace(in_file);
+    GatedStreamBuffer gated_output(output_buffer,
+                                   [&]() -> bool
+                                   {
+                                       stream_trace.KeyDerived();
+                                       return stream_trace.Streaming(
+                                           AcquireStreamingSlot(
+                                               batch,
+                                               progress_dialog,
+                                               stream_memory));
+                                   });
+    std::ostream output_stream(&gated_output);
+
+    // Decrypt the input stream
+    std::string result_text;
+    stream_trace.Start();
+    bool result = DecryptStream(batch,
+                                progress_dialog,
+                                in_file,
+                                password,
+                                batch_file.file_size,
+                                input_stream,
+                                output_stream,
+                                nullptr,
+                                &result_text);
+
+    // Ensure the decompressed contents are complete and written
+    if (result && (compression != CompressionAlgorithm::None))
+    {
+        error_code = decompressed_output.Finish();
+        if (error_code != ERROR_SUCCESS)
+        {
+            ReportBatchError(batch,
+                             L"Unable to decompress the input file " + in_file,
+                             error_code);
+            result = false;
+        }
+    }
+    stream_trace.Stop(batch_file.file_size);
+
+    // Allow another file to stream
+    if (gated_output.WasOpened()) ReleaseStreamingSlot(batch, stream_memory);
+
+    // If streaming was not permitted, the output is incomplete
+    if (gated_output.WasDenied()) result = false;
+
+    // Record the measurements of this file for the batch report
+    DWORD read_error = reader.GetError();
+    if (read_error == ERROR_SUCCESS) read_error = mapped_reader.GetError();
+    FileReport file_report = StreamReport(in_file,
+                                          batch_file.file_size,
+                                          stream_trace,
+                                          &reader,
+                                          writer.get(),
+                                          result_text);
+    file_report.error_code =
+        (read_error != ERROR_SUCCESS) ? read_error : writer->GetError();
+
+    // Close the input file
+    reader.Close();
+    mapped_reader.Close();
+
+    // A read error would otherwise appear to be the end of the input file
+    if (result && (read_error != ERROR_SUCCESS))
+    {
+        ReportBatchError(batch,
+                         L"Unable to read the input file " + in_file,
+                         read_error);
+        result = false;
+    }
+
+    // Close the output file; there may be delay in closing the output file
+    // if it is large and transmission is over a network, so this may
+    // complete on another thread while the next file is processed
+    if (result)
+    {
+        return CloseOutputFile(batch,
+                               writer,
+                               batch_file,
+                               out_file,
+                               write_file,
+                               file_report,
+                               remove_on_fail);
+    }
+
+    // The decryption process failed, so close the partial output file
+    writer->Close();
+    file_report.octets_out = writer->GetOctetsWritten();
+    batch.report.AddFile(file_report);
+
+    // Remove the partial output file if it's not stdout
+    if (remove_on_fail)
+    {
+        TraceActivity cleanup_trace("Cleanup", write_file);
+
+        try
+        {
+            std::filesystem::remove(std::filesystem::path(write_file));
+        }
+        catch (...)
+        {
+            // Nothing we can do
         }
-
-        // If the user clicked cancel or closed the dialog, stop processing
-        if (progress_dialog.WasCancelPressed()) break;
     }
 
-    // Instruct the progress window to terminate
-    DWORD progress_thread_id = GetThreadId(progress_thread.native_handle());
-    PostThreadMessage(progress_thread_id, WM_QUIT, 0, 0);
-
-    // Wait for the progress window thread to complete
-    progress_thread.join();
+    return false;
 }
 
 /*
- *  WorkerThreads::EncryptStream()
+ *  WorkerThreads::VerifyBatchFile()
  *
  *  Description:
- *      This function will encrypt the given input stream to the given output
- *      stream using the specified password.
+ *      This function will verify a single file that is part of a batch by
+ *      decrypting it and discarding the decrypted contents.  This checks
+ *      the password, the integrity of the file, and the padding without
+ *      writing anything.  A file that fails verification is recorded and
+ *      the batch continues with the next file.
  *
  *  Parameters:
- *      cv [in]
- *          Condition variable used for thread syncronization
- *
- *      mutex [in]
- *          Mutex used in association with the above condition variable.
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
  *
  *      progress_dialog [in]
- *          A reference to the progress dialog that shows encryption progress.
+ *          A reference to the progress dialog that shows batch progress.
  *
- *      filename [in]
- *          The name of the file to encrypt.
+ *      batch_file [in]
+ *          The file to verify.
  *
  *      password [in]
- *          The password (in UTF-16 format) to use for encryption.
- *
- *      iterations [in]
- *          The number of Key Derivation Function (KDF) iterations to perform.
- *
- *      extensions [in]
- *          Plaintext extension data to insert into the AES stream header.
- *
- *      input_size [in]
- *          The size of the input stream.
- *
- *      istream [in]
- *          A reference to the input stream.
- *
- *      ostream [in]
- *          A reference to the output stream.
+ *          The password to use for decryption.
  *
  *  Returns:
- *      True if successful, false if not.
+ *      True if the file was verified (whether or not it passed), false if
+ *      the user cancelled or the batch is stopping.
  *
  *  Comments:
- *      None.
+ *      An archive is verified as any other file, as its contents are
+ *      authenticated as a single stream.
  */
-bool WorkerThreads::EncryptStream(std::condition_variable &cv,
-                                  std::mutex &mutex,
-                                  ProgressDialog &progress_dialog,
-                                  const std::wstring &filename,
-                                  const SecureU8String &password,
-                                  const std::uint32_t iterations,
-                                  const ExtensionList &extensions,
-                                  const std::size_t input_size,
-                                  std::istream &istream,
-                                  std::ostream &ostream) const
+bool WorkerThreads::VerifyBatchFile(BatchContext &batch,
+                                    ProgressDialog &progress_dialog,
+                                    const BatchFile &batch_file,
+                                    const SecureU8String &password)
 {
-    Terra::AESCrypt::Engine::Encryptor encryptor;
-    Terra::AESCrypt::Engine::EncryptResult encrypt_result{};
-    bool encryption_complete{};
-    std::size_t current_meter_position{};
-    std::size_t last_meter_position{};
-
-    // Define the update interval (progress bar has 100 positions)
-    std::size_t update_interval = input_size / 100;
+    const std::wstring &in_file = batch_file.filename;
+    OverlappedFileReader reader(batch.settings.io_buffer_size,
+                                batch.settings.io_queue_depth);
+    MappedFileReader mapped_reader;
+    DiscardStreamBuffer discard_buffer;
+    std::streambuf *input_buffer{};
+    std::wstring failure_reason;
+
+    // Function to record a file that failed verification
+    auto record_failure = [&](const std::wstring &reason)
+    {
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        batch.failed_files.push_back({in_file, reason});
+    };
 
-    // If the interval is really tiny, just update once -- but only if the
-    // input size is known
-    if ((update_interval < Minimal_Interval) && (input_size > 0))
+    // Display the file name
+    progress_dialog.SetFileName(in_file);
+
+    // Open the input file for reading
+    TraceActivity open_trace("OpenInput", in_file);
+    DWORD error_code = OpenInputFile(batch.settings,
+                                     batch_file,
+                                     reader,
+                                     mapped_reader,
+                                     input_buffer);
+    open_trace.SetResult(error_code);
+    open_trace.Stop();
+    if (error_code != ERROR_SUCCESS)
     {
-        update_interval = std::numeric_limits<std::size_t>::max();
+        record_failure(FormatError(L"Unable to open the file", error_code));
+        return true;
     }
 
-    // Progress meter update function
-    auto progress_updater = [&]([[maybe_unused]]const std::string &instance,
-                                std::size_t position)
+    std::istream input_stream(input_buffer);
+
+    // Hold back decrypting the contents (but not key derivation) until this
+    // file is allowed to stream, along with the memory it will use
+    std::uint64_t stream_memory =
+        reader.GetBufferOctets() + Engine_Stream_Memory;
+    StreamTrace stream_trace(in_file);
+    GatedStreamBuffer gated_output(&discard_buffer,
+                                   [&]() -> bool
+                                   {
+                                       stream_trace.KeyDerived();
+                                       return stream_trace.Streaming(
+                                           AcquireStreamingSlot(
+                                               batch,
+                                               progress_dialog,
+                                               stream_memory));
+                                   });
+    std::ostream output_stream(&gated_output);
+
+    // Decrypt the input stream, discarding the output
+    std::string result_text;
+    stream_trace.Start();
+    bool result = DecryptStream(batch,
+                                progress_dialog,
+                                in_file,
+                                password,
+                                batch_file.file_size,
+                                input_stream,
+                                output_stream,
+                                &failure_reason,
+                                &result_text);
+    stream_trace.Stop(batch_file.file_size);
+
+    // Allow another file to stream
+    if (gated_output.WasOpened()) ReleaseStreamingSlot(batch, stream_memory);
+
+    // Record the measurements of this file for the batch report
+    DWORD read_error = reader.GetError();
+    if (read_error == ERROR_SUCCESS) read_error = mapped_reader.GetError();
+    FileReport file_report = StreamReport(in_file,
+                                          batch_file.file_size,
+                                          stream_trace,
+                                          &reader,
+                                          nullptr,
+                                          result_text);
+    file_report.error_code = read_error;
+    batch.report.AddFile(file_report);
+
+    // Close the input file
+    reader.Close();
+    mapped_reader.Close();
+
+    // If streaming was not permitted or the user cancelled, the file was
+    // not verified
+    if (gated_output.WasDenied() || progress_dialog.WasCancelPressed())
     {
-        // Lock the mutex
-        std::lock_guard<std::mutex> lock(mutex);
-
-        // Dot not update if the input size is not known
-        if (input_size == 0) return;
-
-        // Compute the percentage of file completion (aligns with the meters'
-        // range of 0..100
-        current_meter_position = 100 * position / input_size;
-
-        // Notify thread to update the progress bar
-        cv.notify_all();
-    };
-
-    // Encrypt the stream via a separate thread
-    std::thread encrypt_thread(
-        [&]()
-        {
-            // Encrypt the current input stream
-            encrypt_result = encryptor.Encrypt(
-                static_cast<std::u8string>(password),
-                iterations,
-                istream,
-                ostream,
-                extensions,
-                progress_updater,
-                update_interval);
-
-            // Lock the mutex to assign result
-            std::lock_guard<std::mutex> lock(mutex);
-            encryption_complete = true;
-            cv.notify_all();
-        });
-
-    // Lock the mutex
-    std::unique_lock<std::mutex> lock(mutex);
+        return false;
+    }
 
-    // Wait for encryption to complete or to be told to terminate
-    while (!encryption_complete)
+    // A read error would otherwise appear to be the end of the input file
+    if (read_error != ERROR_SUCCESS)
     {
-        // If the user clicked cancel (or closed the dialog), stop the
-        // encryption thread
-        if (progress_dialog.WasCancelPressed())
-        {
-            lock.unlock();
-            encryptor.Cancel();
-            lock.lock();
-            break;
-        }
-
-        // Wait for some event to trigger the thread
-        cv.wait(lock,
-                [&]() -> bool
-                {
-                    return encryption_complete ||
-                           (current_meter_position != last_meter_position) ||
-                           progress_dialog.WasCancelPressed();
-                });
-
-        // Get the new meter position (copying to allow unlocking mutex while
-        // operating on "current_meter_position")
-        auto new_meter_position = current_meter_position;
-
-        // Service the message loop to ensure an up-to-date display
-        lock.unlock();
-
-        // Update the progress window with the new position value
-        if (new_meter_position > last_meter_position)
-        {
-            progress_dialog.SendDlgItemMessage(
-                IDC_PROGRESSBAR,
-                PBM_SETPOS,
-                static_cast<WPARAM>(new_meter_position),
-                0);
-            last_meter_position = new_meter_position;
-        }
-
-        lock.lock();
+        record_failure(FormatError(L"Unable to read the file", read_error));
     }
-
-    // Unlock the mutex
-    lock.unlock();
-
-    // Wait for the encryption thread to exit
-    encrypt_thread.join();
-
-    // Present a reason to the user in the event of an error
-    if ((encrypt_result != Terra::AESCrypt::Engine::EncryptResult::Success) &&
-        (encrypt_result !=
-         Terra::AESCrypt::Engine::EncryptResult::EncryptionCancelled))
+    else if (!result)
     {
-        std::ostringstream oss;
-
-        // Convert the encryption result into a string
-        oss << encrypt_result;
-
-        // Report the error to the user
-        ::ReportError(application_error,
-                      std::string("Failed to encrypt: ") + oss.str());
-
-        return false;
+        record_failure(failure_reason.empty() ? L"Decryption failed" :
+                                                failure_reason);
     }
 
-    // Return true only if encryption succeeded
-    return encrypt_result == Terra::AESCrypt::Engine::EncryptResult::Success;
+    return true;
 }
 
 /*
- *  WorkerThreads::DecryptFiles()
+ *  WorkerThreads::CloseOutputFile()
  *
  *  Description:
- *      This function will iterate over the list of files and decrypt each one
- *      given the provided password.
+ *      This function will close an output file that was written completely.
+ *      Closing a file may take some time if it is large and transmission is
+ *      over a network, so when configured to do so the file is closed on a
+ *      pool thread, allowing the next file to be opened and processed
+ *      without waiting.  If closing fails, the error is reported and the
+ *      output file is removed.
  *
  *  Parameters:
- *      file_list [in]
- *          The list of files to decrypt.
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
  *
- *      password [in]
- *          The password to use for decryption.
+ *      writer [in]
+ *          The stream buffer writing the output file.
+ *
+ *      batch_file [in]
+ *          The input file from which the output file was produced.
+ *
+ *      out_file [in]
+ *          The name of the output file.
+ *
+ *      write_file [in]
+ *          The name under which the output file was written.  If this
+ *          differs from out_file, the file is renamed to out_file once
+ *          closed, failing if a file by that name has since been created
+ *          unless replace_output is true.
+ *
+ *      file_report [in]
+ *          The file's record for the batch report, which is completed with
+ *          the octets written and time taken to close the file and then
+ *          written to the report.
+ *
+ *      remove_on_fail [in]
+ *          True if the output file should be removed if closing fails.
+ *
+ *      replace_output [in]
+ *          True if the renamed file replaces an existing file by the name
+ *          out_file, as when re-encrypting a changed file in sync mode.
  *
  *  Returns:
- *      Nothing.
+ *      True if the file was closed or handed off to be closed, false if
+ *      closing the file failed.
  *
  *  Comments:
- *      None.
+ *      ProcessBatch() waits for all output files to be closed before the
+ *      batch completes, so a failure to close a file is still reflected in
+ *      the result of the batch.  A file created by the batch is recorded in
+ *      the journal as completed only once it is closed successfully.
  */
-void WorkerThreads::DecryptFiles(const FileList &file_list,
-                                 const SecureU8String &password)
+bool WorkerThreads::CloseOutputFile(
+                        BatchContext &batch,
+                        const std::shared_ptr<OverlappedFileWriter> &writer,
+                        const BatchFile &batch_file,
+                        const std::wstring &out_file,
+                        const std::wstring &write_file,
+                        const FileReport &file_report,
+                        bool remove_on_fail,
+                        bool replace_output)
 {
-    std::condition_variable cv;
-    std::mutex mutex;
-
-    // Secure buffer for file I/O
-    SecureVector<char> read_buffer(Buffered_IO_Size, 0);
-    SecureVector<char> write_buffer(Buffered_IO_Size, 0);
-
-    // If the file list is empty, just return
-    if (file_list.empty()) return;
-
-    // Ensure all files end in .aes
-    for (const auto &in_file : file_list)
+    // Function to close the file, removing it if closing fails
+    auto close = [this,
+                  &batch,
+                  writer,
+                  batch_file,
+                  out_file,
+                  write_file,
+                  file_report,
+                  remove_on_fail,
+                  replace_output]() -> bool
     {
-        if (!HasAESExtension(in_file))
+        // Errors are recorded against this file if continuing on error
+        BatchFileScope batch_file_scope(batch_file.filename);
+
+        TraceActivity close_trace("Close", write_file);
+        auto close_start = std::chrono::steady_clock::now();
+        DWORD error_code = writer->Close();
+
+        // Give the file its output name (data is written before the rename,
+        // which replaces any existing file in a single step)
+        if ((error_code == ERROR_SUCCESS) && (write_file != out_file) &&
+            !::MoveFileEx(write_file.c_str(),
+                          out_file.c_str(),
+                          MOVEFILE_WRITE_THROUGH |
+                              (replace_output ? MOVEFILE_REPLACE_EXISTING :
+                                                0)))
         {
-            ::ReportError(application_error,
-                          L"File to decrypt does not end in .aes: " + in_file);
-            return;
+            error_code = ::GetLastError();
         }
-    }
-
-    // Create a progress dialog that will notify the waiting thread
-    ProgressDialog progress_dialog(
-        [&]()
+        close_trace.SetResult(error_code);
+        close_trace.Stop();
+
+        // Complete the file's record in the batch report
+        FileReport completed_report = file_report;
+        completed_report.octets_out = writer->GetOctetsWritten();
+        completed_report.close_time = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - close_start)
+                .count());
+        if (error_code != ERROR_SUCCESS)
         {
-            std::lock_guard<std::mutex> lock(mutex);
-            cv.notify_all();
-        });
-
-    // Create an event used to indicate the progress dialog is ready
-    HANDLE event_handle = CreateEvent(NULL, TRUE, FALSE, NULL);
+            completed_report.error_code = error_code;
+        }
+        batch.report.AddFile(completed_report);
 
-    // Create a thread to service the windows message loop for the dialog
-    std::thread progress_thread(
-        [&]()
+        if (error_code == ERROR_SUCCESS)
         {
-            try
-            {
-                // Zero LPARAM displays "Decrypting"
-                progress_dialog.Create(GetDesktopWindow(), LPARAM(0));
-                progress_dialog.ShowWindow(SW_SHOWNORMAL);
+            if (remove_on_fail) batch.journal.Completed(batch_file, out_file);
+            return true;
+        }
 
-                // Signal that the progress dialog is ready
-                SetEvent(event_handle);
+        // Report the failure to write the output file completely
+        ReportBatchError(batch,
+                         L"Unable to write the output file " + out_file,
+                         error_code);
 
-                // Process messages
-                WindowsMessageLoop();
+        // Remove the partial output file if it's not stdout
+        if (remove_on_fail)
+        {
+            TraceActivity cleanup_trace("Cleanup", write_file);
 
-                // Destroy the progress window
-                progress_dialog.DestroyWindow();
-            }
-            catch (const std::exception &e)
+            try
             {
-                ::ReportError(application_error,
-                              L"Unexpected error in progress dialog thread",
-                              e.what());
+                std::filesystem::remove(std::filesystem::path(write_file));
             }
             catch (...)
             {
-                ::ReportError(application_error,
-                              L"Unexpected error in progress dialog thread");
+                // Nothing we can do
             }
-        });
-
-    // Wait for the progress window to open
-    WaitForSingleObject(event_handle, INFINITE);
-    CloseHandle(event_handle);
-
-    // Iterate over the list of files
-    for (const auto &in_file : file_list)
-    {
-        std::size_t file_size{};
-        std::ifstream ifs;
-        std::ofstream ofs;
-        bool remove_on_fail{};
-
-        // Reset the progress bar (default range is 0..100)
-        progress_dialog.SendDlgItemMessage(IDC_PROGRESSBAR, PBM_SETPOS, 0, 0);
+        }
 
-        // Display the file name
-        progress_dialog.SetDlgItemText(IDC_FILENAME, in_file.c_str());
+        return false;
+    };
 
-        try
-        {
-            // Attempt to get the file size
-            file_size =
-                std::filesystem::file_size(std::filesystem::path(in_file));
-        }
-        catch (...)
-        {
-            // Nothing we can do, nor is this critical
-        }
+    if (!batch.settings.background_close) return close();
 
-        try
+    // Function called on a pool thread (or by ProcessBatch() if the job
+    // has not started when the batch finishes)
+    auto pending_close = std::make_shared<std::function<void()>>(
+        [&batch, close]()
         {
-            // Open the input file for reading
-            ifs.open(std::filesystem::path(in_file),
-                     std::ios::in | std::ios::binary);
-        }
-        catch (...)
-        {
-            // Nothing we can do, but an error will be presented below
-        }
+            close();
 
-        if (!ifs.good() || !ifs.is_open())
-        {
-            DWORD error_code = ERROR_SUCCESS;
-            if (!ifs.good()) error_code = GetLastError();
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.pending_closes--;
+            batch.cv.notify_all();
+        });
 
-            // Report an error opening the file
-            std::wstring message = L"Unable to open the input file " + in_file;
-            ::ReportError(application_error, message, error_code);
+    std::unique_lock<std::mutex> lock(batch.mutex);
 
-            break;
-        }
+    batch.pending_closes++;
 
-        // Set the buffer to use for reading
-        ifs.rdbuf()->pubsetbuf(read_buffer.data(), read_buffer.size());
+    auto job_id = thread_pool.Submit([pending_close]() { (*pending_close)(); });
 
-        // Define the output filename (same as input file without .aes)
-        std::wstring out_file = in_file;
-        out_file.resize(out_file.size() - 4);
+    // If the job cannot be submitted, close the file on this thread
+    if (job_id == 0)
+    {
+        batch.pending_closes--;
+        lock.unlock();
+        return close();
+    }
 
-        try
-        {
-            // Get the file status of the output file
-            std::filesystem::file_status file_status =
-                std::filesystem::status(std::filesystem::path(out_file));
+    batch.close_jobs.emplace_back(job_id, pending_close);
 
-            // If the output file does not exist, attempt to remove later
-            // (Do not remove by default so as to not attempt to remove things
-            // like character special devices.)
-            if (!std::filesystem::exists(file_status)) remove_on_fail = true;
+    return true;
+}
 
-            // Does a regular file having this output file name exist?
-            if (std::filesystem::is_regular_file(file_status))
-            {
-                // Report an error opening the file
-                ::ReportError(application_error,
-                              std::wstring(L"Output file already exists: ") +
-                                  out_file);
+/*
+ *  WorkerThreads::ExtractArchive()
+ *
+ *  Description:
+ *      This function will decrypt an encrypted archive that is part of a
+ *      batch, extracting the files it contains into a directory named after
+ *      the archive.
+ *
+ *  Parameters:
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
+ *
+ *      progress_dialog [in]
+ *          A reference to the progress dialog that shows batch progress.
+ *
+ *      batch_file [in]
+ *          The archive to decrypt.
+ *
+ *      password [in]
+ *          The password to use for decryption.
+ *
+ *  Returns:
+ *      True if successful, false if there was an error or the user
+ *      cancelled processing.
+ *
+ *  Comments:
+ *      Since the integrity of the archive can only be verified once it has
+ *      been decrypted completely, all extracted files are removed if
+ *      decryption fails.
+ */
+bool WorkerThreads::ExtractArchive(BatchContext &batch,
+                                   ProgressDialog &progress_dialog,
+                                   const BatchFile &batch_file,
+                                   const SecureU8String &password)
+{
+    const std::wstring &in_file = batch_file.filename;
+    OverlappedFileReader reader(batch.settings.io_buffer_size,
+                                batch.settings.io_queue_depth);
+    MappedFileReader mapped_reader;
+    std::streambuf *input_buffer{};
+
+    // Define the output directory (same as input file without .aar.aes)
+    std::wstring out_directory = in_file;
+    out_directory.resize(out_directory.size() - 4 -
+                         (sizeof(Archive_Extension) / sizeof(wchar_t) - 1));
+
+    // Skip the archive if it was extracted by an earlier run of this batch
+    if (batch.journal.IsCompleted(batch_file, out_directory))
+    {
+        progress_dialog.AddBatchProgress(batch_file.file_size);
+        return true;
+    }
 
-                break;
-            }
-        }
-        catch (const std::exception &e)
-        {
-            // Report an error opening the file
-            ::ReportError(application_error,
-                          std::wstring(L"Unexpected error processing ") +
-                              in_file,
-                          e.what());
-            break;
-        }
-        catch (...)
-        {
-            // Report an error opening the file
-            ::ReportError(application_error,
-                          std::wstring(L"Unexpected error processing ") +
-                              in_file);
-            break;
-        }
+    // Display the file name
+    progress_dialog.SetFileName(in_file);
 
-        try
-        {
-            // Open the output file for writing
-            ofs.open(std::filesystem::path(out_file),
-                     std::ios::out | std::ios::binary);
-        }
-        catch (...)
+    try
+    {
+        // Refuse to extract into an existing file or directory
+        if (std::filesystem::exists(std::filesystem::path(out_directory)))
         {
-            // Nothing we can do, but an error will be presented below
+            ReportBatchError(batch,
+                             std::wstring(L"Output file already exists: ") +
+                                 out_directory);
+            return false;
         }
+    }
+    catch (const std::exception &e)
+    {
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file,
+                         e.what());
+        return false;
+    }
+    catch (...)
+    {
+        // Report an error opening the file
+        ReportBatchError(batch,
+                         std::wstring(L"Unexpected error processing ") +
+                             in_file);
+        return false;
+    }
 
-        if (!ofs.good() || !ofs.is_open())
-        {
-            DWORD error_code = ERROR_SUCCESS;
-            if (!ofs.good()) error_code = GetLastError();
+    // Open the input file for reading
+    TraceActivity open_trace("OpenInput", in_file);
+    DWORD error_code = OpenInputFile(batch.settings,
+                                     batch_file,
+                                     reader,
+                                     mapped_reader,
+                                     input_buffer);
+    open_trace.SetResult(error_code);
+    open_trace.Stop();
+    if (error_code != ERROR_SUCCESS)
+    {
+        // Report an error opening the file
+        std::wstring message = L"Unable to open the input file " + in_file;
+        ReportBatchError(batch, message, error_code);
 
-            // Report an error opening the file
-            std::wstring message =
-                L"Unable to open the output file " + out_file;
-            ::ReportError(application_error, message, error_code);
+        return false;
+    }
 
-            break;
-        }
+    std::istream input_stream(input_buffer);
+
+    ArchiveExtractor extractor(out_directory,
+                               batch.settings.io_buffer_size,
+                               batch.settings.io_queue_depth,
+                               batch.settings.unbuffered_io);
+
+    // Determine the memory this file will use while streaming, with each
+    // extracted file being written using the configured I/O parameters
+    std::uint64_t stream_memory = reader.GetBufferOctets() +
+                                  EstimatedWriterMemory(batch.settings) +
+                                  Engine_Stream_Memory;
+
+    // Hold back writing the output (but not key derivation) until this file
+    // is allowed to stream
+    StreamTrace stream_trace(in_file);
+    GatedStreamBuffer gated_output(&extractor,
+                                   [&]() -> bool
+                                   {
+                                       stream_trace.KeyDerived();
+                                       return stream_trace.Streaming(
+                                           AcquireStreamingSlot(
+                                               batch,
+                                               progress_dialog,
+                                               stream_memory));
+                                   });
+    std::ostream output_stream(&gated_output);
+
+    // Decrypt the input stream
+    std::string result_text;
+    stream_trace.Start();
+    bool result = DecryptStream(batch,
+                                progress_dialog,
+                                in_file,
+                                password,
+                                batch_file.file_size,
+                                input_stream,
+                                output_stream,
+                                nullptr,
+                                &result_text);
+    stream_trace.Stop(batch_file.file_size);
+
+    // Allow another file to stream
+    if (gated_output.WasOpened()) ReleaseStreamingSlot(batch, stream_memory);
+
+    // If streaming was not permitted, the output is incomplete
+    if (gated_output.WasDenied()) result = false;
+
+    // Record the measurements of the archive for the batch report (the
+    // octets written are spread over the extracted files, so not counted)
+    DWORD read_error = reader.GetError();
+    if (read_error == ERROR_SUCCESS) read_error = mapped_reader.GetError();
+    FileReport file_report = StreamReport(in_file,
+                                          batch_file.file_size,
+                                          stream_trace,
+                                          &reader,
+                                          nullptr,
+                                          result_text);
+
+    // Close the files
+    reader.Close();
+    mapped_reader.Close();
+    TraceActivity close_trace("Close", out_directory);
+    auto close_start = std::chrono::steady_clock::now();
+    error_code = extractor.Close();
+    close_trace.SetResult(error_code);
+    close_trace.Stop();
+
+    // Complete the archive's record in the batch report
+    file_report.close_time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - close_start)
+            .count());
+    file_report.error_code =
+        (read_error != ERROR_SUCCESS) ? read_error : error_code;
+    batch.report.AddFile(file_report);
+
+    // A read error would otherwise appear to be the end of the input file
+    if (result && (read_error != ERROR_SUCCESS))
+    {
+        ReportBatchError(batch,
+                         L"Unable to read the input file " + in_file,
+                         read_error);
+        result = false;
+    }
 
-        // Set the buffer to use for writing
-        ofs.rdbuf()->pubsetbuf(write_buffer.data(), write_buffer.size());
-
-        // Decrypt the input stream
-        bool result = DecryptStream(cv,
-                                    mutex,
-                                    progress_dialog,
-                                    in_file,
-                                    password,
-                                    file_size,
-                                    ifs,
-                                    ofs);
-
-        // Close any open files; there may be delay in closing the output
-        // file if it is large and transmission is over a network
-        if (ifs.is_open()) ifs.close();
-        if (ofs.is_open())
+    // Report any failure to extract the archive completely
+    if (result && (error_code != ERROR_SUCCESS))
+    {
+        if (extractor.GetErrorFile().empty())
         {
-            ofs.flush();
-            ofs.close();
+            ReportBatchError(batch,
+                             L"The archive is not valid: " + in_file,
+                             error_code);
         }
-
-        // Did the decryption process fail?
-        if (!result)
+        else
         {
-            // Remove the partial output file if it's not stdout
-            if (remove_on_fail)
-            {
-                try
-                {
-                    std::filesystem::remove(std::filesystem::path(out_file));
-                }
-                catch (...)
-                {
-                    // Nothing we can do
-                }
-            }
-            break;
+            ReportBatchError(batch,
+                             L"Unable to extract the file " +
+                                 extractor.GetErrorFile(),
+                             error_code);
         }
+        result = false;
+    }
 
-        // If the user clicked cancel or closed the dialog, stop processing
-        if (progress_dialog.WasCancelPressed()) break;
+    // Remove the extracted files if the archive was not fully decrypted
+    if (!result)
+    {
+        TraceActivity cleanup_trace("Cleanup", out_directory);
+        extractor.RemoveExtracted();
+        return false;
     }
 
-    // Instruct the progress window to terminate
-    DWORD progress_thread_id = GetThreadId(progress_thread.native_handle());
-    PostThreadMessage(progress_thread_id, WM_QUIT, 0, 0);
+    batch.journal.Completed(batch_file, out_directory);
 
-    // Wait for the progress window thread to complete
-    progress_thread.join();
+    return true;
 }
 
 /*
@@ -1178,11 +4137,8 @@ void WorkerThreads::DecryptFiles(const FileList &file_list,
  *      stream using the specified password.
  *
  *  Parameters:
- *      cv [in]
- *          Condition variable used for thread syncronization
- *
- *      mutex [in]
- *          Mutex used in association with the above condition variable.
+ *      batch [in]
+ *          The batch context shared by all threads processing the files.
  *
  *      progress_dialog [in]
  *          A reference to the progress dialog that shows decryption progress.
@@ -1202,124 +4158,78 @@ void WorkerThreads::DecryptFiles(const FileList &file_list,
  *      ostream [in]
  *          A reference to the output stream.
  *
+ *      failure_reason [out]
+ *          If not nullptr, the reason decryption failed is stored here rather
+ *          than reported to the user (and the batch is not stopped).
+ *
+ *      result_text [out]
+ *          If given, receives the engine's result as text, whether or not
+ *          decryption succeeded.
+ *
  *  Returns:
  *      True if successful, false if not.
  *
  *  Comments:
- *      None.
+ *      The progress meter reflects the progress of the entire batch.  The
+ *      engine runs on the calling thread.
  */
-bool WorkerThreads::DecryptStream(std::condition_variable &cv,
-                                  std::mutex &mutex,
+bool WorkerThreads::DecryptStream(BatchContext &batch,
                                   ProgressDialog &progress_dialog,
                                   const std::wstring &filename,
                                   const SecureU8String &password,
-                                  const std::size_t input_size,
+                                  const std::uint64_t input_size,
                                   std::istream &istream,
-                                  std::ostream &ostream) const
+                                  std::ostream &ostream,
+                                  std::wstring *failure_reason,
+                                  std::string *result_text) const
 {
     Terra::AESCrypt::Engine::Decryptor decryptor;
-    Terra::AESCrypt::Engine::DecryptResult decrypt_result{};
-    bool decryption_complete{};
-    std::size_t current_meter_position{};
-    std::size_t last_meter_position{};
-
-    // Define the update interval (progress bar has 100 positions)
-    std::size_t update_interval = input_size / 100;
-
-    // If the interval is really tiny, just update once -- but only if the
-    // input size is known
-    if ((update_interval < Minimal_Interval) && (input_size > 0))
-    {
-        update_interval = std::numeric_limits<std::size_t>::max();
-    }
+    std::uint64_t reported_position{};
+    Throttle::StreamState throttle_state;
 
-    // Progress meter update function
+    // Progress meter update function (called on this thread by the engine)
     auto progress_updater = [&]([[maybe_unused]]const std::string &instance,
                                 std::size_t position)
     {
-        // Lock the mutex
-        std::lock_guard<std::mutex> lock(mutex);
-
-        // Dot not update if the input size is not known
-        if (input_size == 0) return;
+        // Stop if the user clicked cancel (or closed the dialog)
+        if (progress_dialog.WasCancelPressed()) decryptor.Cancel();
 
-        // Compute the percentage of file completion (aligns with the meters'
-        // range of 0..100
-        current_meter_position = 100 * position / input_size;
+        UpdateBatchProgress(progress_dialog,
+                            input_size,
+                            reported_position,
+                            position);
 
-        // Notify thread to update the progress bar
-        cv.notify_all();
+        // Pause as needed to remain within background mode limits
+        PaceStream(batch, progress_dialog, throttle_state, position);
     };
 
-    // Decrypt the stream via a separate thread
-    std::thread decrypt_thread(
-        [&]()
-        {
-            // Decrypt the current input stream
-            decrypt_result = decryptor.Decrypt(
-                static_cast<std::u8string>(password),
-                istream,
-                ostream,
-                progress_updater,
-                update_interval);
-
-            // Lock the mutex to assign result
-            std::lock_guard<std::mutex> lock(mutex);
-            decryption_complete = true;
-            cv.notify_all();
-        });
-
-    // Lock the mutex
-    std::unique_lock<std::mutex> lock(mutex);
-
-    // Wait for decryption to complete or to be told to terminate
-    while (!decryption_complete)
+    // Allow the progress dialog thread to cancel decryption directly, as the
+    // engine may be deriving the key or blocked on I/O for some time
+    CancelRegistration cancel_registration(batch,
+                                           [&]() { decryptor.Cancel(); });
+    if (progress_dialog.WasCancelPressed()) return false;
+
+    // Decrypt the current input stream
+    auto decrypt_result = decryptor.Decrypt(
+        static_cast<std::u8string>(password),
+        istream,
+        ostream,
+        progress_updater,
+        Progress_Interval);
+
+    // Return the engine's result to the caller if requested
+    if (result_text != nullptr)
     {
-        // If the user clicked cancel (or closed the dialog), stop the
-        // decryption thread
-        if (progress_dialog.WasCancelPressed())
-        {
-            lock.unlock();
-            decryptor.Cancel();
-            lock.lock();
-            break;
-        }
-
-        // Wait for some event to trigger the thread
-        cv.wait(lock,
-                [&]() -> bool
-                {
-                    return decryption_complete ||
-                           (current_meter_position != last_meter_position) ||
-                           progress_dialog.WasCancelPressed();
-                });
-
-        // Get the new meter position (copying to allow unlocking mutex while
-        // operating on "current_meter_position")
-        auto new_meter_position = current_meter_position;
-
-        // Service the message loop to ensure an up-to-date display
-        lock.unlock();
-
-        // Update the progress window with the new position value
-        if (new_meter_position > last_meter_position)
-        {
-            progress_dialog.SendDlgItemMessage(
-                IDC_PROGRESSBAR,
-                PBM_SETPOS,
-                static_cast<WPARAM>(new_meter_position),
-                0);
-            last_meter_position = new_meter_position;
-        }
-
-        lock.lock();
+        std::ostringstream oss;
+        oss << decrypt_result;
+        *result_text = oss.str();
     }
 
-    // Unlock the mutex
-    lock.unlock();
-
-    // Wait for the decryption thread to exit
-    decrypt_thread.join();
+    // Account for any octets not yet reflected in the batch progress
+    UpdateBatchProgress(progress_dialog,
+                        input_size,
+                        reported_position,
+                        input_size);
 
     // Present a reason to the user in the event of an error
     if ((decrypt_result != Terra::AESCrypt::Engine::DecryptResult::Success) &&
@@ -1328,12 +4238,21 @@ bool WorkerThreads::DecryptStream(std::condition_variable &cv,
     {
         std::ostringstream oss;
 
+        // An error resulting from the user cancelling is not reported
+        if (progress_dialog.WasCancelPressed()) return false;
+
         // Convert the decryption result into a string
         oss << decrypt_result;
 
+        // Return the reason to the caller if requested
+        if (failure_reason != nullptr)
+        {
+            *failure_reason = FormatError(oss.str());
+            return false;
+        }
+
         // Report the error to the user
-        ::ReportError(application_error,
-                      std::string("Failed to decrypt: ") + oss.str());
+        ReportBatchError(batch, std::string("Failed to decrypt: ") + oss.str());
 
         return false;
     }
@@ -26,25 +26,68 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <list>
+#include <functional>
 #include <cstddef>
 #include <iostream>
+#include <memory>
+#include <atomic>
 #include <terra/secutil/secure_string.h>
 #include "secure_containers.h"
 #include "file_list.h"
+#include "batch_summary.h"
 #include "progress_dialog.h"
+#include "settings.h"
+#include "thread_pool.h"
+#include "overlapped_file.h"
+#include "throttle.h"
+#include "batch_journal.h"
+#include "batch_report.h"
 #include "globals.h"
 
 // Type to hold extensions to insert into the container header
 using ExtensionList = std::vector<std::pair<std::string, std::string>>;
 
-// Type used to hold data associated with an encryption or decryption request
-struct RequestData
+// Function producing the list of files to process
+using FileListSource = std::function<FileList()>;
+
+// Type used to hold state shared by all threads processing a batch of files
+struct BatchContext
 {
-    FileList file_list;
-    SecureU8String password;
-    bool encrypt;
-    DWORD thread_id;
-    HANDLE thread_handle;
+    std::mutex mutex;
+    std::condition_variable cv;
+    Settings settings;
+    std::vector<BatchFile> files;
+    std::size_t next_file;
+    bool enumerating;
+    bool aborted;
+    std::size_t active_helpers;
+    std::size_t streaming_slots;
+    std::size_t active_streams;
+    std::uint64_t stream_memory;
+    std::uint64_t peak_memory;
+    std::size_t files_skipped;
+    std::uint64_t total_bytes;
+    std::list<std::function<void()>> cancel_handlers;
+    std::size_t pending_closes;
+    std::vector<std::pair<ThreadPool::JobID,
+                          std::shared_ptr<std::function<void()>>>> close_jobs;
+    bool headless;
+    std::wstring error_message;
+    bool verify_only;
+    std::vector<FileFailure> failed_files;
+    Throttle throttle;
+    BatchJournal journal;
+    BatchReport report;
+};
+
+// Type used to hold a request whose completion is awaited by the caller
+struct RequestCompletion
+{
+    HANDLE event;
+    bool headless;
+    BatchSummary *summary;
+    BatchOptions options;
 };
 
 // Class that interfaces between the Windows shell and the AES Crypt Engine
@@ -60,48 +103,187 @@ class WorkerThreads
         // Process files for encryption (true) or decryption (false)
         void ProcessFiles(const FileList &file_list, bool encrypt);
 
-        // This should only be called by threads spawned by this class
-        void ThreadEntry();
+        // Process files as directed, with the file list produced on a
+        // background thread
+        bool ProcessFiles(
+                    const FileListSource &file_list_source,
+                    BatchOperation operation,
+                    const std::shared_ptr<RequestCompletion> &completion = {});
+
+        // As above, returning an event signaled once processing completes
+        HANDLE ProcessFilesAsync(const FileList &file_list,
+                                 BatchOperation operation,
+                                 const BatchOptions &options = {});
+
+        // Process files without prompting for a password or showing dialogs
+        HANDLE ProcessFilesHeadless(const FileList &file_list,
+                                    const SecureU8String &password,
+                                    BatchOperation operation,
+                                    const BatchOptions &options,
+                                    BatchSummary &summary);
 
     protected:
-        void CloseThreadHandles();
+        std::shared_ptr<RequestCompletion> CreateCompletion(
+                                                    bool headless,
+                                                    BatchSummary *summary,
+                                                    HANDLE &caller_event);
 
-        void StartThread(const FileList &file_list,
-                         const SecureU8String &password,
-                         bool encrypt);
+        void CompleteRequest(RequestCompletion &completion);
+
+        bool QueueHostRequest(const FileListSource &file_list_source,
+                              BatchOperation operation);
+
+        bool QueueRequest(const FileListSource &file_list_source,
+                          const SecureU8String &password,
+                          BatchOperation operation,
+                          const std::shared_ptr<RequestCompletion> &completion);
+
+        void ProcessRequest(
+                    const FileListSource &file_list_source,
+                    const SecureU8String &password,
+                    BatchOperation operation,
+                    const std::shared_ptr<RequestCompletion> &completion);
+
+        void ReportRequestError(const RequestCompletion *completion,
+                                const std::wstring &error_text) const;
 
         void EncryptFiles(const FileList &file_list,
-                          const SecureU8String &password);
+                          const SecureU8String &password,
+                          const RequestCompletion *completion);
 
         void DecryptFiles(const FileList &file_list,
-                          const SecureU8String &password);
+                          const SecureU8String &password,
+                          bool verify_only,
+                          const RequestCompletion *completion);
+
+        void RunBatch(const FileList &file_list,
+                      const SecureU8String &password,
+                      BatchOperation operation,
+                      const RequestCompletion *completion);
+
+        void ApplyBatchOptions(BatchContext &batch,
+                               const RequestCompletion *completion) const;
+
+        void ReportVerifyResults(BatchContext &batch,
+                                 ProgressDialog &progress_dialog) const;
+
+        void ReportBatchFailures(BatchContext &batch,
+                                 ProgressDialog &progress_dialog) const;
+
+        void ProcessBatch(BatchContext &batch,
+                          ProgressDialog &progress_dialog,
+                          const FileList &file_list,
+                          const SecureU8String &password,
+                          bool encrypt);
+
+        void EnumerateBatchDirectories(
+                                BatchContext &batch,
+                                ProgressDialog &progress_dialog,
+                                const std::vector<std::wstring> &directories,
+                                bool encrypt);
+
+        void BatchWorker(BatchContext &batch,
+                         ProgressDialog &progress_dialog,
+                         const SecureU8String &password,
+                         bool encrypt);
+
+        bool NextBatchFile(BatchContext &batch,
+                           ProgressDialog &progress_dialog,
+                           BatchFile &batch_file);
+
+        bool AcquireStreamingSlot(BatchContext &batch,
+                                  ProgressDialog &progress_dialog,
+                                  std::uint64_t memory);
+
+        void ReleaseStreamingSlot(BatchContext &batch, std::uint64_t memory);
+
+        bool RecordFileFailure(BatchContext &batch,
+                               const std::wstring &reason) const;
+
+        void ReportBatchError(BatchContext &batch,
+                              const std::wstring &message,
+                              DWORD reason = ERROR_SUCCESS) const;
+
+        void ReportBatchError(BatchContext &batch,
+                              const std::wstring &message,
+                              const std::string &error_string) const;
+
+        void ReportBatchError(BatchContext &batch,
+                              const std::string &message) const;
+
+        void PaceStream(BatchContext &batch,
+                        ProgressDialog &progress_dialog,
+                        Throttle::StreamState &state,
+                        std::uint64_t position) const;
+
+        void UpdateBatchProgress(ProgressDialog &progress_dialog,
+                                 std::uint64_t input_size,
+                                 std::uint64_t &reported_position,
+                                 std::uint64_t position) const;
+
+        bool EncryptBatchFile(BatchContext &batch,
+                              ProgressDialog &progress_dialog,
+                              const BatchFile &batch_file,
+                              const SecureU8String &password,
+                              const ExtensionList &extensions);
+
+        bool DecryptBatchFile(BatchContext &batch,
+                              ProgressDialog &progress_dialog,
+                              const BatchFile &batch_file,
+                              const SecureU8String &password);
+
+        bool VerifyBatchFile(BatchContext &batch,
+                             ProgressDialog &progress_dialog,
+                             const BatchFile &batch_file,
+                             const SecureU8String &password);
+
+        bool CloseOutputFile(
+                        BatchContext &batch,
+                        const std::shared_ptr<OverlappedFileWriter> &writer,
+                        const BatchFile &batch_file,
+                        const std::wstring &out_file,
+                        const std::wstring &write_file,
+                        const FileReport &file_report,
+                        bool remove_on_fail,
+                        bool replace_output = false);
+
+        bool EncryptArchive(BatchContext &batch,
+                            ProgressDialog &progress_dialog,
+                            const FileList &file_list,
+                            const SecureU8String &password);
+
+        bool ExtractArchive(BatchContext &batch,
+                            ProgressDialog &progress_dialog,
+                            const BatchFile &batch_file,
+                            const SecureU8String &password);
 
-        bool EncryptStream(std::condition_variable &cv,
-                           std::mutex &mutex,
+        bool EncryptStream(BatchContext &batch,
                            ProgressDialog &progress_dialog,
                            const std::wstring &filename,
                            const SecureU8String &password,
                            const std::uint32_t iterations,
                            const ExtensionList &extensions,
-                           const std::size_t input_size,
+                           const std::uint64_t input_size,
                            std::istream &istream,
-                           std::ostream &ostream) const;
+                           std::ostream &ostream,
+                           const std::function<std::uint64_t()>
+                               &input_position = {},
+                           std::string *result_text = nullptr) const;
 
-        bool DecryptStream(std::condition_variable &cv,
-                           std::mutex &mutex,
+        bool DecryptStream(BatchContext &batch,
                            ProgressDialog &progress_dialog,
                            const std::wstring &filename,
                            const SecureU8String &password,
-                           const std::size_t input_size,
+                           const std::uint64_t input_size,
                            std::istream &istream,
-                           std::ostream &ostream) const;
+                           std::ostream &ostream,
+                           std::wstring *failure_reason = nullptr,
+                           std::string *result_text = nullptr) const;
 
         void WindowsMessageLoop();
 
         std::wstring application_name;
         std::wstring application_error;
-        int thread_count;
-        std::deque<HANDLE> terminated_threads;
-        std::deque<RequestData> requests;
-        CRITICAL_SECTION critical_section;
+        std::atomic<std::size_t> active_requests;
+        ThreadPool thread_pool;
 };
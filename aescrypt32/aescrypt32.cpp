@@ -15,8 +15,47 @@
  *      to perform processing in the background.
  *
  *      The reason this program exists is to serve as a launcher that gets
- *      invoked when the user double-clicks on a .aes file.  It is not
- *      intended to be used directly by the user or via the command-line.
+ *      invoked when the user double-clicks on a .aes file.  It may also be
+ *      used from scripts by providing the password via a file or handle, in
+ *      which case no dialogs are shown.  The result is then reported via
+ *      the process exit code and a single-line JSON summary written to the
+ *      standard output handle (if one is provided).  The command syntax is:
+ *
+ *          aescrypt32 [/d|/e|/v] [/sync] [/k] [/b] [/mbps rate]
+ *                     [/cpu percent] [/p passwordfile | /ph handle]
+ *                     [@listfile | @-] [filename ...]
+ *
+ *      The /v option verifies the files by decrypting them without writing
+ *      the decrypted contents, checking the password and integrity of each.
+ *
+ *      The /sync option encrypts only the files that are new or have
+ *      changed since their existing .aes file was produced in sync mode,
+ *      replacing any outdated .aes file once its replacement is complete.
+ *
+ *      The /k option keeps processing the remaining files when a file
+ *      cannot be processed, listing each file that failed in the summary.
+ *
+ *      The /b option processes the files in background mode, lowering the
+ *      CPU and I/O priority of the processing threads.  The /mbps option
+ *      limits the rate of processing (MB/s) and the /cpu option limits the
+ *      share of a processor used by each thread (percent); both imply /b.
+ *
+ *      Running "aescrypt32 /host" serves as the batch host for the logon
+ *      session, processing the files selected in Explorer and given to other
+ *      instances of this program until it has been idle for a few minutes.
+ *      The host is normally started as needed by the aescrypt DLL.  Files
+ *      given to this program are handed to the host unless a password is
+ *      given (or the BatchHost setting is disabled).
+ *
+ *      Running "aescrypt32 /diag" reports the processor features used to
+ *      accelerate AES and SHA, the result of the cryptographic self-test,
+ *      and the measured performance, either to the standard output handle
+ *      or, if there is none, in a message box.
+ *
+ *      The password is the first line of the password file or the data read
+ *      from the given inherited handle (e.g., a pipe), encoded as UTF-8.
+ *      A list file names one file per line (UTF-8), with "@-" reading the
+ *      list from standard input.
  *
  *  Portability Issues:
  *      Windows specific code.
@@ -26,8 +65,538 @@
 #include <Windows.h>
 #include <tchar.h>
 #include <cstdint>
+#include <cwchar>
+#include <string>
+#include <cstdio>
 #include "aescrypt32.h"
 
+namespace
+{
+
+// Process exit codes used when processing without user interaction
+constexpr int Exit_Success = 0;
+constexpr int Exit_Failure = 1;
+constexpr int Exit_Usage = 2;
+
+// Usage text shown when the command-line is not valid
+constexpr wchar_t Usage_Text[] =
+    L"Usage: aescrypt32 [/d|/e|/v] [/sync] [/k] [/b] [/mbps rate] "
+    L"[/cpu percent] [/p passwordfile | /ph handle] [@listfile | @-] "
+    L"filename ...";
+
+/*
+ *  ConvertToUTF16()
+ *
+ *  Description:
+ *      Convert the UTF-8 string to UTF-16.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The UTF-16 string, which is empty if conversion failed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::wstring ConvertToUTF16(const std::string &text)
+{
+    if (text.empty()) return {};
+
+    int length = ::MultiByteToWideChar(CP_UTF8,
+                                       MB_ERR_INVALID_CHARS,
+                                       text.data(),
+                                       static_cast<int>(text.size()),
+                                       nullptr,
+                                       0);
+    if (length <= 0) return {};
+
+    std::wstring utf16_text(static_cast<std::size_t>(length), L'\0');
+
+    ::MultiByteToWideChar(CP_UTF8,
+                          MB_ERR_INVALID_CHARS,
+                          text.data(),
+                          static_cast<int>(text.size()),
+                          utf16_text.data(),
+                          length);
+
+    return utf16_text;
+}
+
+/*
+ *  ConvertToUTF8()
+ *
+ *  Description:
+ *      Convert the UTF-16 string to UTF-8.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The string to convert.
+ *
+ *  Returns:
+ *      The UTF-8 string, which is empty if conversion failed.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string ConvertToUTF8(const std::wstring &text)
+{
+    if (text.empty()) return {};
+
+    int length = ::WideCharToMultiByte(CP_UTF8,
+                                       0,
+                                       text.data(),
+                                       static_cast<int>(text.size()),
+                                       nullptr,
+                                       0,
+                                       nullptr,
+                                       nullptr);
+    if (length <= 0) return {};
+
+    std::string utf8_text(static_cast<std::size_t>(length), '\0');
+
+    ::WideCharToMultiByte(CP_UTF8,
+                          0,
+                          text.data(),
+                          static_cast<int>(text.size()),
+                          utf8_text.data(),
+                          length,
+                          nullptr,
+                          nullptr);
+
+    return utf8_text;
+}
+
+/*
+ *  ReadHandle()
+ *
+ *  Description:
+ *      Read all data from the given handle until the end of the file or
+ *      until the writer closes the pipe.
+ *
+ *  Parameters:
+ *      handle [in]
+ *          The handle from which to read.
+ *
+ *      contents [out]
+ *          The data read.
+ *
+ *  Returns:
+ *      True if successful, false if there was an error reading.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ReadHandle(HANDLE handle, std::string &contents)
+{
+    char buffer[4096];
+    DWORD octets_read{};
+
+    contents.clear();
+
+    if ((handle == NULL) || (handle == INVALID_HANDLE_VALUE)) return false;
+
+    while (true)
+    {
+        if (!::ReadFile(handle, buffer, sizeof(buffer), &octets_read, NULL))
+        {
+            // A pipe whose writer has closed has simply reached its end
+            return ::GetLastError() == ERROR_BROKEN_PIPE;
+        }
+
+        if (octets_read == 0) break;
+
+        contents.append(buffer, octets_read);
+    }
+
+    return true;
+}
+
+/*
+ *  ReadNamedFile()
+ *
+ *  Description:
+ *      Read the entire contents of the named file.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The name of the file to read.
+ *
+ *      contents [out]
+ *          The data read.
+ *
+ *  Returns:
+ *      True if successful, false if the file could not be read.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ReadNamedFile(const std::wstring &filename, std::string &contents)
+{
+    HANDLE handle = ::CreateFileW(filename.c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN,
+                                  NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    bool result = ReadHandle(handle, contents);
+
+    ::CloseHandle(handle);
+
+    return result;
+}
+
+/*
+ *  SplitLines()
+ *
+ *  Description:
+ *      Split UTF-8 text into lines, ignoring a leading byte order mark and
+ *      removing carriage returns from line endings.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The text to split.
+ *
+ *      lines [out]
+ *          The lines of text, excluding empty lines.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      None.
+ */
+void SplitLines(const std::string &text, FileList &lines)
+{
+    std::size_t start{};
+
+    // Skip any UTF-8 byte order mark
+    if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) start = 3;
+
+    while (start < text.size())
+    {
+        std::size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+
+        std::string line = text.substr(start, end - start);
+        if (!line.empty() && (line.back() == '\r')) line.pop_back();
+
+        if (!line.empty()) lines.push_back(ConvertToUTF16(line));
+
+        start = end + 1;
+    }
+}
+
+/*
+ *  ExtractPassword()
+ *
+ *  Description:
+ *      Extract the password from the contents of a password file, which is
+ *      the first line of the file.
+ *
+ *  Parameters:
+ *      contents [in/out]
+ *          The contents of the password file.  This is cleared on return.
+ *
+ *  Returns:
+ *      The password (encoded as UTF-8).
+ *
+ *  Comments:
+ *      None.
+ */
+std::string ExtractPassword(std::string &contents)
+{
+    std::size_t start{};
+
+    // Skip any UTF-8 byte order mark
+    if (contents.compare(0, 3, "\xEF\xBB\xBF") == 0) start = 3;
+
+    std::size_t end = contents.find_first_of("\r\n", start);
+    if (end == std::string::npos) end = contents.size();
+
+    std::string password = contents.substr(start, end - start);
+
+    // Do not leave the password in memory longer than necessary
+    ::SecureZeroMemory(contents.data(), contents.size());
+    contents.clear();
+
+    return password;
+}
+
+/*
+ *  EscapeJSON()
+ *
+ *  Description:
+ *      Escape the UTF-8 string so that it may be placed in a JSON string.
+ *
+ *  Parameters:
+ *      text [in]
+ *          The text to escape.
+ *
+ *  Returns:
+ *      The escaped text.
+ *
+ *  Comments:
+ *      None.
+ */
+std::string EscapeJSON(const std::string &text)
+{
+    std::string escaped_text;
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '"':
+                escaped_text += "\\\"";
+                break;
+
+            case '\\':
+                escaped_text += "\\\\";
+                break;
+
+            case '\n':
+                escaped_text += "\\n";
+                break;
+
+            case '\r':
+                escaped_text += "\\r";
+                break;
+
+            case '\t':
+                escaped_text += "\\t";
+                break;
+
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped_text += code;
+                }
+                else
+                {
+                    escaped_text += c;
+                }
+                break;
+        }
+    }
+
+    return escaped_text;
+}
+
+/*
+ *  WriteSummary()
+ *
+ *  Description:
+ *      Write the summary of the request as a single line of JSON to the
+ *      standard output handle.
+ *
+ *  Parameters:
+ *      summary [in]
+ *          The summary to write.
+ *
+ *  Returns:
+ *      Nothing.
+ *
+ *  Comments:
+ *      Nothing is written if the process has no standard output handle, as
+ *      is the case unless the caller redirected it.
+ */
+void WriteSummary(const BatchSummary &summary)
+{
+    HANDLE output = ::GetStdHandle(STD_OUTPUT_HANDLE);
+    char numbers[320];
+    DWORD octets_written{};
+
+    if ((output == NULL) || (output == INVALID_HANDLE_VALUE)) return;
+
+    // Compute the rate at which data was processed
+    std::uint64_t octets_per_second =
+        (summary.elapsed_time > 0) ?
+            summary.octets_completed * 1000 / summary.elapsed_time :
+            0;
+
+    std::snprintf(numbers,
+                  sizeof(numbers),
+                  "\"files_total\":%llu,\"files_completed\":%llu,"
+                  "\"files_skipped\":%llu,"
+                  "\"octets_total\":%llu,\"octets_completed\":%llu,"
+                  "\"elapsed_ms\":%llu,\"octets_per_second\":%llu,"
+                  "\"peak_memory\":%llu",
+                  static_cast<unsigned long long>(summary.files_total),
+                  static_cast<unsigned long long>(summary.files_completed),
+                  static_cast<unsigned long long>(summary.files_skipped),
+                  static_cast<unsigned long long>(summary.octets_total),
+                  static_cast<unsigned long long>(summary.octets_completed),
+                  static_cast<unsigned long long>(summary.elapsed_time),
+                  static_cast<unsigned long long>(octets_per_second),
+                  static_cast<unsigned long long>(summary.peak_memory));
+
+    // List any files that failed verification
+    std::string failed_files;
+    for (const auto &failure : summary.failed_files)
+    {
+        if (!failed_files.empty()) failed_files += ",";
+        failed_files += "{\"file\":\"" +
+                        EscapeJSON(ConvertToUTF8(failure.filename)) +
+                        "\",\"reason\":\"" +
+                        EscapeJSON(ConvertToUTF8(failure.reason)) + "\"}";
+    }
+
+    // Give the path of the performance report, if one was written
+    std::string report;
+    if (!summary.report_file.empty())
+    {
+        report = ",\"report\":\"" +
+                 EscapeJSON(ConvertToUTF8(summary.report_file)) + "\"";
+    }
+
+    std::string line = std::string("{\"result\":\"") +
+                       (summary.success ? "success" : "failure") + "\"," +
+                       numbers + ",\"error\":\"" +
+                       EscapeJSON(ConvertToUTF8(summary.error_message)) +
+                       "\",\"failed_files\":[" + failed_files + "]" +
+                       report + "}\r\n";
+
+    ::WriteFile(output,
+                line.data(),
+                static_cast<DWORD>(line.size()),
+                &octets_written,
+                NULL);
+}
+
+/*
+ *  ReportDiagnostics()
+ *
+ *  Description:
+ *      Report the diagnostic information produced by the DLL.
+ *
+ *  Parameters:
+ *      application_name [in]
+ *          The application name to use as the message box title.
+ *
+ *  Returns:
+ *      The process exit code to use.
+ *
+ *  Comments:
+ *      The report is written to the standard output handle if there is one,
+ *      else it is shown in a message box.
+ */
+int ReportDiagnostics(const std::wstring &application_name)
+{
+    HANDLE output = ::GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD octets_written{};
+
+    std::wstring report = GetDiagnostics();
+
+    if ((output == NULL) || (output == INVALID_HANDLE_VALUE))
+    {
+        ::MessageBox(NULL,
+                     report.c_str(),
+                     application_name.c_str(),
+                     MB_ICONINFORMATION | MB_OK);
+        return 0;
+    }
+
+    std::string text = ConvertToUTF8(report);
+
+    ::WriteFile(output,
+                text.data(),
+                static_cast<DWORD>(text.size()),
+                &octets_written,
+                NULL);
+
+    return 0;
+}
+
+/*
+ *  ReportUsageError()
+ *
+ *  Description:
+ *      Report an error in the command-line arguments or inputs when
+ *      processing without user interaction.
+ *
+ *  Parameters:
+ *      message [in]
+ *          The message describing the error.
+ *
+ *  Returns:
+ *      The process exit code to use.
+ *
+ *  Comments:
+ *      None.
+ */
+int ReportUsageError(const std::wstring &message)
+{
+    BatchSummary summary{};
+
+    summary.error_message = message;
+    WriteSummary(summary);
+
+    return Exit_Usage;
+}
+
+/*
+ *  ProcessHeadless()
+ *
+ *  Description:
+ *      Process the list of files without user interaction, waiting for the
+ *      request to complete.
+ *
+ *  Parameters:
+ *      file_list [in]
+ *          The list of files to process
+ *
+ *      password [in/out]
+ *          The password (encoded as UTF-8).  This is cleared on return.
+ *
+ *      operation [in]
+ *          The operation to perform (encrypt, decrypt, or verify).
+ *
+ *      batch_options [in]
+ *          Options controlling how the files are processed.
+ *
+ *  Returns:
+ *      The process exit code to use.
+ *
+ *  Comments:
+ *      None.
+ */
+int ProcessHeadless(FileList &file_list,
+                    std::string &password,
+                    BatchOperation operation,
+                    const BatchOptions &batch_options)
+{
+    BatchSummary summary{};
+
+    HANDLE job = ProcessFilesHeadless(file_list,
+                                      password,
+                                      operation,
+                                      batch_options,
+                                      summary);
+
+    // The DLL has its own copy of the password
+    ::SecureZeroMemory(password.data(), password.size());
+    password.clear();
+
+    if (job != NULL)
+    {
+        ::WaitForSingleObject(job, INFINITE);
+        ::CloseHandle(job);
+    }
+
+    WriteSummary(summary);
+
+    return summary.success ? Exit_Success : Exit_Failure;
+}
+
+} // namespace
+
 // Windows Callback Procedure
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -52,10 +621,17 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance,
 {
     WNDCLASS wndclass{};
     HWND hWnd;
-    MSG msg;
+    MSG msg{};
     int nArgs;
-    bool encrypt = false;
+    BatchOperation operation = BatchOperation::Decrypt;
+    BatchOptions batch_options{};
+    bool headless = false;
+    bool diagnostics = false;
+    bool batch_host = false;
+    bool options = true;
     FileList file_list;
+    std::string password;
+    std::wstring input_error;
     std::wstring application_name(256, '\0');
 
     // Load the application name
@@ -70,6 +646,187 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance,
     LPWSTR *szArglist = CommandLineToArgvW(GetCommandLineW(), &nArgs);
     if(szArglist == NULL) return 0;
 
+    // Process the command-line arguments (options precede the filenames)
+    for (std::size_t i = 1; i < nArgs; i++)
+    {
+        std::wstring argument = szArglist[i];
+
+        if (options && ((argument == L"/d") || (argument == L"-d")))
+        {
+            operation = BatchOperation::Decrypt;
+        }
+        else if (options && ((argument == L"/e") || (argument == L"-e")))
+        {
+            operation = BatchOperation::Encrypt;
+        }
+        else if (options && ((argument == L"/v") || (argument == L"-v")))
+        {
+            operation = BatchOperation::Verify;
+        }
+        else if (options && ((argument == L"/diag") || (argument == L"-diag")))
+        {
+            diagnostics = true;
+        }
+        else if (options && ((argument == L"/host") || (argument == L"-host")))
+        {
+            batch_host = true;
+        }
+        else if (options && ((argument == L"/sync") || (argument == L"-sync")))
+        {
+            batch_options.sync = true;
+        }
+        else if (options && ((argument == L"/k") || (argument == L"-k")))
+        {
+            batch_options.continue_on_error = true;
+        }
+        else if (options && ((argument == L"/b") || (argument == L"-b")))
+        {
+            batch_options.background = true;
+        }
+        else if (options && ((argument == L"/mbps") || (argument == L"-mbps") ||
+                             (argument == L"/cpu") || (argument == L"-cpu")))
+        {
+            if (++i >= nArgs)
+            {
+                input_error = L"A value must follow " + argument;
+                break;
+            }
+
+            unsigned long value = std::wcstoul(szArglist[i], nullptr, 10);
+            if ((value == 0) || (value > UINT32_MAX))
+            {
+                input_error = L"Invalid value for " + argument + L": " +
+                              std::wstring(szArglist[i]);
+                break;
+            }
+
+            if ((argument == L"/mbps") || (argument == L"-mbps"))
+            {
+                batch_options.bandwidth_limit =
+                    static_cast<std::uint32_t>(value);
+            }
+            else
+            {
+                batch_options.cpu_share = static_cast<std::uint32_t>(value);
+            }
+
+            // Limits apply only in background mode
+            batch_options.background = true;
+        }
+        else if (options && ((argument == L"/p") || (argument == L"-p") ||
+                             (argument == L"/ph") || (argument == L"-ph")))
+        {
+            std::string contents;
+            bool read_result{};
+
+            if (++i >= nArgs)
+            {
+                input_error = L"A password source must follow " + argument;
+                break;
+            }
+
+            if ((argument == L"/ph") || (argument == L"-ph"))
+            {
+                // Read from a handle inherited from the parent process
+                HANDLE handle = reinterpret_cast<HANDLE>(static_cast<
+                    std::uintptr_t>(std::wcstoull(szArglist[i], nullptr, 0)));
+                read_result = ReadHandle(handle, contents);
+            }
+            else
+            {
+                read_result = ReadNamedFile(szArglist[i], contents);
+            }
+
+            if (!read_result)
+            {
+                input_error = L"Unable to read the password from " +
+                              std::wstring(szArglist[i]);
+                break;
+            }
+
+            password = ExtractPassword(contents);
+            headless = true;
+        }
+        else if ((argument.size() > 1) && (argument.front() == L'@'))
+        {
+            std::string contents;
+            bool read_result{};
+
+            // Read the list of files from a list file or standard input
+            if (argument == L"@-")
+            {
+                read_result =
+                    ReadHandle(::GetStdHandle(STD_INPUT_HANDLE), contents);
+            }
+            else
+            {
+                read_result = ReadNamedFile(argument.substr(1), contents);
+            }
+
+            if (!read_result)
+            {
+                input_error = L"Unable to read the file list " + argument;
+                break;
+            }
+
+            SplitLines(contents, file_list);
+            options = false;
+        }
+        else
+        {
+            file_list.push_back(argument);
+            options = false;
+        }
+    }
+
+    // Free allocated memory
+    LocalFree(szArglist);
+
+    // Serve as the batch host if that is all that was requested
+    if (batch_host && input_error.empty())
+    {
+        ::SecureZeroMemory(password.data(), password.size());
+        return (ServeBatchHost() == ERROR_SUCCESS) ? Exit_Success :
+                                                     Exit_Failure;
+    }
+
+    // Report diagnostic information if that is all that was requested
+    if (diagnostics && input_error.empty())
+    {
+        ::SecureZeroMemory(password.data(), password.size());
+        return ReportDiagnostics(application_name);
+    }
+
+    // Process the files without showing any windows if a password is given
+    if (headless || !input_error.empty())
+    {
+        int exit_code{};
+
+        if (!input_error.empty())
+        {
+            exit_code = ReportUsageError(input_error);
+        }
+        else if (password.empty())
+        {
+            exit_code = ReportUsageError(L"The password is empty");
+        }
+        else if (file_list.empty())
+        {
+            exit_code = ReportUsageError(Usage_Text);
+        }
+        else
+        {
+            exit_code = ProcessHeadless(file_list,
+                                        password,
+                                        operation,
+                                        batch_options);
+        }
+
+        ::SecureZeroMemory(password.data(), password.size());
+
+        return exit_code;
+    }
+
     // Create the window class and application window (hidden)
     if (!hPrevInstance)
     {
@@ -105,88 +862,48 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance,
     ShowWindow(hWnd, SW_HIDE);
     UpdateWindow(hWnd);
 
-    // Process the command-line arguments
-    for (std::size_t i = 1; i < nArgs; i++)
-    {
-        if (i == 1)
-        {
-            if (!_tcscmp(szArglist[i], L"/d"))
-            {
-                encrypt = false;
-            }
-            else if (!_tcscmp(szArglist[i], L"-d"))
-            {
-                encrypt = false;
-            }
-            else if (!_tcscmp(szArglist[i], L"/e"))
-            {
-                encrypt = true;
-            }
-            else if (!_tcscmp(szArglist[i], L"-e"))
-            {
-                encrypt = true;
-            }
-            else
-            {
-                file_list.push_back(szArglist[i]);
-            }
-        }
-        else
-        {
-            file_list.push_back(szArglist[i]);
-        }
-    }
-
     // Report an error if the file list is empty
     if (file_list.empty())
     {
         ::MessageBox(NULL,
-                     L"Usage: aescrypt32 [/d|/e] filename ...",
+                     Usage_Text,
                      application_name.c_str(),
                      MB_ICONERROR | MB_OK);
-        SendMessage(hWnd, WM_DESTROY, 0, 0);
+        return 0;
     }
-    else
+
+    // Hand the files to the batch host, which prompts for the password
+    if (ProcessFilesInHost(file_list, operation, batch_options))
     {
-        // Initiate file processing
-        ProcessFiles(file_list, encrypt);
+        DestroyWindow(hWnd);
+        return 0;
     }
 
-    // Sit in a loop waiting for the AES Crypt Library to indicate it is no
-    // longer busy and message processing completes on WM_DESTROY.
-    while(true)
+    // Initiate file processing, which returns an event that is signaled
+    // once processing completes (or NULL if there is nothing to wait for)
+    HANDLE job = ProcessFilesAsync(file_list, operation, batch_options);
+
+    // Service the message queue until processing completes
+    while (job != NULL)
     {
-        if (PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE))
-        {
-            if (GetMessage(&msg, NULL, 0, 0))
-            {
-                TranslateMessage(&msg);
-                DispatchMessage(&msg);
-            }
-            else
-            {
-                // GetMessage() returns false when WM_QUIT is posted
-                break;
-            }
-        }
-        else
+        DWORD wait_result =
+            MsgWaitForMultipleObjects(1, &job, FALSE, INFINITE, QS_ALLINPUT);
+        if (wait_result != WAIT_OBJECT_0 + 1) break;
+
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
-            // If the AES library is busy, we will sleep.  Otherwise
-            // we will send a WM_DESTROY message to terminate the main
-            // window processing loop.
-            if (AESLibraryBusy())
-            {
-                Sleep(250);
-            }
-            else
-            {
-                SendMessage(hWnd, WM_DESTROY, 0, 0);
-            }
+            if (msg.message == WM_QUIT) break;
+
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
         }
+
+        if (msg.message == WM_QUIT) break;
     }
 
-    // Free allocated memory
-    LocalFree(szArglist);
+    if (job != NULL) CloseHandle(job);
+
+    DestroyWindow(hWnd);
 
-    return (int) msg.wParam;
+    return 0;
 }
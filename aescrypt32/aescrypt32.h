@@ -15,8 +15,8 @@
  *      to perform processing in the background.
  *
  *      The reason this program exists is to serve as a launcher that gets
- *      invoked when the user double-clicks on a .aes file.  It is not
- *      intended to be used directly by the user or via the command-line.
+ *      invoked when the user double-clicks on a .aes file.  It may also be
+ *      used from scripts to process files without user interaction.
  *
  *  Portability Issues:
  *      Windows specific code.
@@ -24,8 +24,24 @@
 
 #pragma once
 
+#include <Windows.h>
+#include <string>
 #include "file_list.h"
+#include "batch_summary.h"
 
 // Externals in the aescrypt DLL
 bool AESLibraryBusy();
 void ProcessFiles(FileList &file_list, bool encrypt);
+HANDLE ProcessFilesAsync(FileList &file_list,
+                         BatchOperation operation,
+                         const BatchOptions &options);
+HANDLE ProcessFilesHeadless(FileList &file_list,
+                            const std::string &password,
+                            BatchOperation operation,
+                            const BatchOptions &options,
+                            BatchSummary &summary);
+bool ProcessFilesInHost(FileList &file_list,
+                        BatchOperation operation,
+                        const BatchOptions &options);
+DWORD ServeBatchHost();
+std::wstring GetDiagnostics();
@@ -0,0 +1,96 @@
+/*
+ *  batch_summary.h
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This file defines the BatchSummary type, which holds the result of a
+ *      request processed without user interaction, the BatchOperation
+ *      type, which identifies the operation performed by a request, and the
+ *      BatchOptions type, which holds options given by the caller.
+ *
+ *  Portability Issues:
+ *      None.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Operation to perform on a list of files
+enum class BatchOperation
+{
+    Encrypt,
+    Decrypt,
+    Verify
+};
+
+// Options given by the caller that override the settings for a request,
+// with zero values leaving the corresponding setting unchanged
+struct BatchOptions
+{
+    // Process the files in background mode (low priority and throttled)
+    bool background;
+
+    // Maximum rate in MB/s at which data is processed in background mode
+    std::uint32_t bandwidth_limit;
+
+    // Percentage of a processor each thread may use in background mode
+    std::uint32_t cpu_share;
+
+    // Skip files whose encrypted output is up to date (encryption only)
+    bool sync;
+
+    // Continue with the remaining files when a file cannot be processed
+    bool continue_on_error;
+};
+
+// File that could not be processed and the reason
+struct FileFailure
+{
+    std::wstring filename;
+    std::wstring reason;
+};
+
+// Result of processing a list of files
+struct BatchSummary
+{
+    // True if every file was processed successfully
+    bool success;
+
+    // Number of files found and the number processed successfully
+    std::size_t files_total;
+    std::size_t files_completed;
+
+    // Number of completed files skipped because their encrypted output was
+    // already up to date (sync mode only)
+    std::size_t files_skipped;
+
+    // Number of octets to be read and the number read
+    std::uint64_t octets_total;
+    std::uint64_t octets_completed;
+
+    // Time taken to process the request in milliseconds
+    std::uint64_t elapsed_time;
+
+    // Most octets of memory reserved at once by the files being streamed
+    std::uint64_t peak_memory;
+
+    // Description of the error that stopped processing, if any
+    std::wstring error_message;
+
+    // Path of the performance report written for the request, if any
+    std::wstring report_file;
+
+    // Files that failed verification or, when continuing on error, could
+    // not be processed
+    std::vector<FileFailure> failed_files;
+};
@@ -0,0 +1,916 @@
+/*
+ *  aescrypt_bench.cpp
+ *
+ *  Copyright (C) 2024
+ *  Terrapane Corporation
+ *  All Rights Reserved
+ *
+ *  Author:
+ *      Paul E. Jones <paulej@packetizer.com>
+ *
+ *  Description:
+ *      This program measures the performance of the paths used by AES Crypt
+ *      for Windows to encrypt and decrypt files.  The engine is driven as
+ *      WorkerThreads::EncryptStream() and WorkerThreads::DecryptStream()
+ *      drive it, with the same progress interval and the same stream
+ *      buffers used to read and write files.  It reports:
+ *
+ *          - Key derivation latency at KDF_Iterations
+ *          - Streaming throughput for data held in memory
+ *          - Aggregate throughput as the number of threads is varied
+ *          - Throughput for files on disk as the buffer size is varied
+ *          - Per-file overhead when processing many small files
+ *
+ *      The command syntax is:
+ *
+ *          aescrypt_bench [--size MiB] [--files count] [--threads count]
+ *                         [--directory path]
+ *
+ *  Portability Issues:
+ *      Windows specific code.
+ */
+
+#include "pch.h"
+#include <cstdio>
+#include <cstdint>
+#include <cwchar>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <terra/aescrypt/engine/encryptor.h>
+#include <terra/aescrypt/engine/decryptor.h>
+#include "overlapped_file.h"
+#include "mapped_file_reader.h"
+#include "globals.h"
+#include "version.h"
+
+namespace
+{
+
+// Number of octets processed between progress updates from the engine
+// (this must match the value used by WorkerThreads)
+constexpr std::size_t Progress_Interval = 256 * 1024;
+
+// Octets in a mebibyte
+constexpr std::uint64_t MiB = 1024 * 1024;
+
+// KDF iterations used when measuring streaming alone
+constexpr std::uint32_t Streaming_Iterations = 1;
+
+// Number of times the key derivation latency is measured
+constexpr std::size_t KDF_Samples = 3;
+
+// Size of each small file when measuring per-file overhead
+constexpr std::size_t Small_File_Size = 4096;
+
+// Buffer sizes used when measuring file throughput
+constexpr std::size_t Buffer_Sizes[] =
+{
+    64 * 1024,
+    128 * 1024,
+    256 * 1024,
+    1024 * 1024,
+    4 * 1024 * 1024
+};
+
+// Password used for all measurements
+const std::u8string Password = u8"aescrypt_bench";
+
+// Options controlling the benchmark
+struct BenchOptions
+{
+    std::uint64_t size;
+    std::size_t files;
+    std::size_t threads;
+    std::filesystem::path directory;
+};
+
+// Clock used for all measurements
+using Clock = std::chrono::steady_clock;
+
+// Stream buffer that produces a given number of octets of synthetic data
+class PatternStreamBuffer : public std::streambuf
+{
+    public:
+        PatternStreamBuffer(const std::vector<char> &pattern,
+                            std::uint64_t size) :
+            pattern{pattern},
+            remaining{size}
+        {
+        }
+
+    protected:
+        int_type underflow() override
+        {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            if (remaining == 0) return traits_type::eof();
+
+            std::size_t length = static_cast<std::size_t>(
+                std::min<std::uint64_t>(pattern.size(), remaining));
+            remaining -= length;
+
+            // The pattern is never written, so it is safe to expose
+            char *data = const_cast<char *>(pattern.data());
+            setg(data, data, data + length);
+
+            return traits_type::to_int_type(*gptr());
+        }
+
+        const std::vector<char> &pattern;
+        std::uint64_t remaining;
+};
+
+// Stream buffer that discards all output
+class NullStreamBuffer : public std::streambuf
+{
+    protected:
+        int_type overflow(int_type c) override
+        {
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize count) override
+        {
+            return count;
+        }
+};
+
+// Stream buffer that holds all output in memory
+class MemoryStreamBuffer : public std::streambuf
+{
+    public:
+        const std::vector<char> &Data() const { return data; }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                data.push_back(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize count) override
+        {
+            data.insert(data.end(), s, s + count);
+            return count;
+        }
+
+        std::vector<char> data;
+};
+
+// Stream buffer that reads from memory
+class MemoryReadBuffer : public std::streambuf
+{
+    public:
+        MemoryReadBuffer(const std::vector<char> &data)
+        {
+            char *begin = const_cast<char *>(data.data());
+            setg(begin, begin, begin + data.size());
+        }
+};
+
+/*
+ *  Seconds()
+ *
+ *  Description:
+ *      Returns the time elapsed since the given start time in seconds.
+ *
+ *  Parameters:
+ *      start_time [in]
+ *          The time at which the measurement started.
+ *
+ *  Returns:
+ *      The elapsed time in seconds.
+ *
+ *  Comments:
+ *      None.
+ */
+double Seconds(Clock::time_point start_time)
+{
+    return std::chrono::duration<double>(Clock::now() - start_time).count();
+}
+
+/*
+ *  Rate()
+ *
+ *  Description:
+ *      Returns the rate at which the given number of octets was processed
+ *      in megabytes (10^6 octets) per second.
+ *
+ *  Parameters:
+ *      octets [in]
+ *          The number of octets processed.
+ *
+ *      seconds [in]
+ *          The time taken to process the octets.
+ *
+ *  Returns:
+ *      The rate in MB/s.
+ *
+ *  Comments:
+ *      None.
+ */
+double Rate(std::uint64_t octets, double seconds)
+{
+    if (seconds <= 0.0) return 0.0;
+
+    return static_cast<double>(octets) / seconds / 1'000'000.0;
+}
+
+/*
+ *  Encrypt()
+ *
+ *  Description:
+ *      Encrypt the input stream to the output stream as EncryptStream()
+ *      does.
+ *
+ *  Parameters:
+ *      iterations [in]
+ *          The number of KDF iterations to perform.
+ *
+ *      istream [in]
+ *          The input stream.
+ *
+ *      ostream [in]
+ *          The output stream.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool Encrypt(std::uint32_t iterations,
+             std::istream &istream,
+             std::ostream &ostream)
+{
+    Terra::AESCrypt::Engine::Encryptor encryptor;
+
+    const std::vector<std::pair<std::string, std::string>> extensions =
+    {
+        {"CREATED_BY", std::string(Project_Name) + " " + Project_Version}
+    };
+
+    auto result = encryptor.Encrypt(
+        Password,
+        iterations,
+        istream,
+        ostream,
+        extensions,
+        []([[maybe_unused]] const std::string &instance,
+           [[maybe_unused]] std::size_t position)
+        {
+        },
+        Progress_Interval);
+
+    return result == Terra::AESCrypt::Engine::EncryptResult::Success;
+}
+
+/*
+ *  Decrypt()
+ *
+ *  Description:
+ *      Decrypt the input stream to the output stream as DecryptStream()
+ *      does.
+ *
+ *  Parameters:
+ *      istream [in]
+ *          The input stream.
+ *
+ *      ostream [in]
+ *          The output stream.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool Decrypt(std::istream &istream, std::ostream &ostream)
+{
+    Terra::AESCrypt::Engine::Decryptor decryptor;
+
+    auto result = decryptor.Decrypt(
+        Password,
+        istream,
+        ostream,
+        []([[maybe_unused]] const std::string &instance,
+           [[maybe_unused]] std::size_t position)
+        {
+        },
+        Progress_Interval);
+
+    return result == Terra::AESCrypt::Engine::DecryptResult::Success;
+}
+
+/*
+ *  EncryptFile()
+ *
+ *  Description:
+ *      Encrypt a file to a file as EncryptBatchFile() does.
+ *
+ *  Parameters:
+ *      in_file [in]
+ *          The file to encrypt.
+ *
+ *      out_file [in]
+ *          The encrypted file to create.
+ *
+ *      iterations [in]
+ *          The number of KDF iterations to perform.
+ *
+ *      buffer_size [in]
+ *          The size of each read or write (zero selects a size for the
+ *          volume).
+ *
+ *      mapped [in]
+ *          True to read the input by mapping it into memory.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool EncryptFile(const std::wstring &in_file,
+                 const std::wstring &out_file,
+                 std::uint32_t iterations,
+                 std::size_t buffer_size,
+                 bool mapped)
+{
+    OverlappedFileReader reader(buffer_size, 0);
+    MappedFileReader mapped_reader;
+    OverlappedFileWriter writer(buffer_size, 0);
+    std::streambuf *input_buffer{};
+
+    if (mapped)
+    {
+        if (mapped_reader.Open(in_file) != ERROR_SUCCESS) return false;
+        input_buffer = &mapped_reader;
+    }
+    else
+    {
+        if (reader.Open(in_file, false) != ERROR_SUCCESS) return false;
+        input_buffer = &reader;
+    }
+
+    if (writer.Open(out_file, false) != ERROR_SUCCESS) return false;
+
+    std::istream input_stream(input_buffer);
+    std::ostream output_stream(&writer);
+
+    bool result = Encrypt(iterations, input_stream, output_stream);
+
+    if ((reader.GetError() != ERROR_SUCCESS) ||
+        (mapped_reader.GetError() != ERROR_SUCCESS))
+    {
+        result = false;
+    }
+    reader.Close();
+    mapped_reader.Close();
+    if (writer.Close() != ERROR_SUCCESS) result = false;
+
+    return result;
+}
+
+/*
+ *  DecryptFile()
+ *
+ *  Description:
+ *      Decrypt a file to a file as DecryptBatchFile() does.
+ *
+ *  Parameters:
+ *      in_file [in]
+ *          The file to decrypt.
+ *
+ *      out_file [in]
+ *          The decrypted file to create.
+ *
+ *      buffer_size [in]
+ *          The size of each read or write (zero selects a size for the
+ *          volume).
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool DecryptFile(const std::wstring &in_file,
+                 const std::wstring &out_file,
+                 std::size_t buffer_size)
+{
+    OverlappedFileReader reader(buffer_size, 0);
+    OverlappedFileWriter writer(buffer_size, 0);
+
+    if (reader.Open(in_file, false) != ERROR_SUCCESS) return false;
+    if (writer.Open(out_file, false) != ERROR_SUCCESS) return false;
+
+    std::istream input_stream(&reader);
+    std::ostream output_stream(&writer);
+
+    bool result = Decrypt(input_stream, output_stream);
+
+    if (reader.GetError() != ERROR_SUCCESS) result = false;
+    reader.Close();
+    if (writer.Close() != ERROR_SUCCESS) result = false;
+
+    return result;
+}
+
+/*
+ *  CreateDataFile()
+ *
+ *  Description:
+ *      Create a file holding the given number of octets of synthetic data.
+ *
+ *  Parameters:
+ *      filename [in]
+ *          The file to create.
+ *
+ *      pattern [in]
+ *          The data to repeat throughout the file.
+ *
+ *      size [in]
+ *          The size of the file in octets.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      None.
+ */
+bool CreateDataFile(const std::wstring &filename,
+                    const std::vector<char> &pattern,
+                    std::uint64_t size)
+{
+    OverlappedFileWriter writer(0, 0);
+
+    if (writer.Open(filename, false) != ERROR_SUCCESS) return false;
+
+    while (size > 0)
+    {
+        std::size_t length = static_cast<std::size_t>(
+            std::min<std::uint64_t>(pattern.size(), size));
+
+        if (writer.sputn(pattern.data(), static_cast<std::streamsize>(
+                                             length)) !=
+            static_cast<std::streamsize>(length))
+        {
+            break;
+        }
+
+        size -= length;
+    }
+
+    return (writer.Close() == ERROR_SUCCESS) && (size == 0);
+}
+
+/*
+ *  MeasureKDF()
+ *
+ *  Description:
+ *      Measure the time to encrypt and decrypt an empty stream, which is
+ *      dominated by key derivation at KDF_Iterations.
+ *
+ *  Parameters:
+ *      None.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      The smallest of several samples is reported.
+ */
+bool MeasureKDF()
+{
+    double encrypt_time = 0.0;
+    double decrypt_time = 0.0;
+
+    for (std::size_t i = 0; i < KDF_Samples; i++)
+    {
+        std::vector<char> empty;
+        MemoryReadBuffer empty_buffer(empty);
+        MemoryStreamBuffer ciphertext;
+        NullStreamBuffer null_buffer;
+        std::istream input_stream(&empty_buffer);
+        std::ostream output_stream(&ciphertext);
+
+        auto start_time = Clock::now();
+        if (!Encrypt(KDF_Iterations, input_stream, output_stream)) return false;
+        double seconds = Seconds(start_time);
+        if ((i == 0) || (seconds < encrypt_time)) encrypt_time = seconds;
+
+        MemoryReadBuffer ciphertext_buffer(ciphertext.Data());
+        std::istream ciphertext_stream(&ciphertext_buffer);
+        std::ostream null_stream(&null_buffer);
+
+        start_time = Clock::now();
+        if (!Decrypt(ciphertext_stream, null_stream)) return false;
+        seconds = Seconds(start_time);
+        if ((i == 0) || (seconds < decrypt_time)) decrypt_time = seconds;
+    }
+
+    std::printf("Key derivation (%u iterations)\n",
+                static_cast<unsigned>(KDF_Iterations));
+    std::printf("    encrypt %10.1f ms\n", encrypt_time * 1000.0);
+    std::printf("    decrypt %10.1f ms\n\n", decrypt_time * 1000.0);
+
+    return true;
+}
+
+/*
+ *  MeasureStreaming()
+ *
+ *  Description:
+ *      Measure the throughput of encrypting and decrypting data held in
+ *      memory, excluding file I/O.
+ *
+ *  Parameters:
+ *      options [in]
+ *          The benchmark options.
+ *
+ *      pattern [in]
+ *          The synthetic data to encrypt.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      Only a single KDF iteration is performed so that the measurement
+ *      reflects streaming alone.
+ */
+bool MeasureStreaming(const BenchOptions &options,
+                      const std::vector<char> &pattern)
+{
+    PatternStreamBuffer input_buffer(pattern, options.size);
+    MemoryStreamBuffer ciphertext;
+    NullStreamBuffer null_buffer;
+    std::istream input_stream(&input_buffer);
+    std::ostream output_stream(&ciphertext);
+
+    auto start_time = Clock::now();
+    if (!Encrypt(Streaming_Iterations, input_stream, output_stream))
+    {
+        return false;
+    }
+    double encrypt_time = Seconds(start_time);
+
+    MemoryReadBuffer ciphertext_buffer(ciphertext.Data());
+    std::istream ciphertext_stream(&ciphertext_buffer);
+    std::ostream null_stream(&null_buffer);
+
+    start_time = Clock::now();
+    if (!Decrypt(ciphertext_stream, null_stream)) return false;
+    double decrypt_time = Seconds(start_time);
+
+    std::printf("Streaming in memory (%llu MiB)\n",
+                static_cast<unsigned long long>(options.size / MiB));
+    std::printf("    encrypt %10.1f MB/s\n", Rate(options.size, encrypt_time));
+    std::printf("    decrypt %10.1f MB/s\n\n",
+                Rate(options.size, decrypt_time));
+
+    return true;
+}
+
+/*
+ *  MeasureThreads()
+ *
+ *  Description:
+ *      Measure the aggregate throughput of encrypting data held in memory on
+ *      several threads at once, as a batch does.
+ *
+ *  Parameters:
+ *      options [in]
+ *          The benchmark options.
+ *
+ *      pattern [in]
+ *          The synthetic data to encrypt.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      Each thread encrypts the full size given in the options.
+ */
+bool MeasureThreads(const BenchOptions &options,
+                    const std::vector<char> &pattern)
+{
+    std::printf("Concurrent streams in memory (%llu MiB each)\n",
+                static_cast<unsigned long long>(options.size / MiB));
+
+    for (std::size_t threads = 1; threads <= options.threads; threads *= 2)
+    {
+        std::vector<std::thread> workers;
+        std::vector<char> results(threads, 0);
+
+        auto start_time = Clock::now();
+
+        for (std::size_t i = 0; i < threads; i++)
+        {
+            workers.emplace_back(
+                [&, i]()
+                {
+                    PatternStreamBuffer input_buffer(pattern, options.size);
+                    NullStreamBuffer null_buffer;
+                    std::istream input_stream(&input_buffer);
+                    std::ostream output_stream(&null_buffer);
+
+                    results[i] = Encrypt(Streaming_Iterations,
+                                         input_stream,
+                                         output_stream);
+                });
+        }
+
+        for (auto &worker : workers) worker.join();
+
+        double seconds = Seconds(start_time);
+
+        if (std::find(results.begin(), results.end(), 0) != results.end())
+        {
+            return false;
+        }
+
+        std::printf("    %3zu threads %10.1f MB/s\n",
+                    threads,
+                    Rate(options.size * threads, seconds));
+
+        // Ensure the maximum is measured even if not a power of two
+        if ((threads < options.threads) && (threads * 2 > options.threads))
+        {
+            threads = options.threads / 2;
+        }
+    }
+
+    std::printf("\n");
+
+    return true;
+}
+
+/*
+ *  MeasureFiles()
+ *
+ *  Description:
+ *      Measure the throughput of encrypting and decrypting a file on disk
+ *      for each of several buffer sizes.
+ *
+ *  Parameters:
+ *      options [in]
+ *          The benchmark options.
+ *
+ *      pattern [in]
+ *          The synthetic data to place in the file.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      The files are written and read through the system file cache, as
+ *      they are by default.
+ */
+bool MeasureFiles(const BenchOptions &options,
+                  const std::vector<char> &pattern)
+{
+    std::wstring plaintext = (options.directory / L"bench_data").wstring();
+    std::wstring ciphertext = plaintext + L".aes";
+    std::wstring decrypted = plaintext + L".out";
+    bool result = true;
+
+    if (!CreateDataFile(plaintext, pattern, options.size)) return false;
+
+    std::printf("Files on disk (%llu MiB)\n",
+                static_cast<unsigned long long>(options.size / MiB));
+
+    for (std::size_t buffer_size : Buffer_Sizes)
+    {
+        auto start_time = Clock::now();
+        result = EncryptFile(plaintext,
+                             ciphertext,
+                             Streaming_Iterations,
+                             buffer_size,
+                             false);
+        double encrypt_time = Seconds(start_time);
+        if (!result) break;
+
+        start_time = Clock::now();
+        result = DecryptFile(ciphertext, decrypted, buffer_size);
+        double decrypt_time = Seconds(start_time);
+        if (!result) break;
+
+        std::printf("    %5zu KiB buffer  encrypt %8.1f MB/s  "
+                    "decrypt %8.1f MB/s\n",
+                    buffer_size / 1024,
+                    Rate(options.size, encrypt_time),
+                    Rate(options.size, decrypt_time));
+    }
+
+    // Measure reading the input by mapping it into memory
+    if (result)
+    {
+        auto start_time = Clock::now();
+        result = EncryptFile(plaintext,
+                             ciphertext,
+                             Streaming_Iterations,
+                             0,
+                             true);
+        double encrypt_time = Seconds(start_time);
+
+        if (result)
+        {
+            std::printf("    mapped input      encrypt %8.1f MB/s\n",
+                        Rate(options.size, encrypt_time));
+        }
+    }
+
+    std::printf("\n");
+
+    std::error_code ec;
+    std::filesystem::remove(plaintext, ec);
+    std::filesystem::remove(ciphertext, ec);
+    std::filesystem::remove(decrypted, ec);
+
+    return result;
+}
+
+/*
+ *  MeasureSmallFiles()
+ *
+ *  Description:
+ *      Measure the time taken per file to encrypt many small files, both at
+ *      KDF_Iterations and with a single iteration to separate the cost of
+ *      opening, writing, and closing files from that of key derivation.
+ *
+ *  Parameters:
+ *      options [in]
+ *          The benchmark options.
+ *
+ *      pattern [in]
+ *          The synthetic data to place in the files.
+ *
+ *  Returns:
+ *      True if successful, false if not.
+ *
+ *  Comments:
+ *      Files are processed one at a time on a single thread.
+ */
+bool MeasureSmallFiles(const BenchOptions &options,
+                       const std::vector<char> &pattern)
+{
+    std::filesystem::path directory = options.directory / L"bench_files";
+    std::vector<std::wstring> filenames;
+    bool result = true;
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) return false;
+
+    for (std::size_t i = 0; (i < options.files) && result; i++)
+    {
+        filenames.push_back(
+            (directory / (L"file_" + std::to_wstring(i))).wstring());
+        result = CreateDataFile(filenames.back(), pattern, Small_File_Size);
+    }
+
+    std::printf("Small files (%zu files of %zu octets)\n",
+                options.files,
+                Small_File_Size);
+
+    for (std::uint32_t iterations : {Streaming_Iterations, KDF_Iterations})
+    {
+        if (!result) break;
+
+        auto start_time = Clock::now();
+        for (const auto &filename : filenames)
+        {
+            result = EncryptFile(filename,
+                                 filename + L".aes",
+                                 iterations,
+                                 0,
+                                 false);
+            if (!result) break;
+        }
+        double seconds = Seconds(start_time);
+
+        if (result)
+        {
+            std::printf("    %7u iterations %10.3f ms per file\n",
+                        static_cast<unsigned>(iterations),
+                        seconds * 1000.0 /
+                            static_cast<double>(filenames.size()));
+        }
+    }
+
+    std::printf("\n");
+
+    std::filesystem::remove_all(directory, ec);
+
+    return result;
+}
+
+/*
+ *  ParseOptions()
+ *
+ *  Description:
+ *      Parse the command-line options.
+ *
+ *  Parameters:
+ *      argc [in]
+ *          The number of arguments.
+ *
+ *      argv [in]
+ *          The arguments.
+ *
+ *      options [out]
+ *          The options parsed.
+ *
+ *  Returns:
+ *      True if successful, false if the options are not valid.
+ *
+ *  Comments:
+ *      None.
+ */
+bool ParseOptions(int argc, wchar_t *argv[], BenchOptions &options)
+{
+    options.size = 256 * MiB;
+    options.files = 200;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    options.directory = std::filesystem::temp_directory_path();
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring option = argv[i];
+
+        if (i + 1 >= argc) return false;
+
+        if (option == L"--size")
+        {
+            options.size = std::wcstoull(argv[++i], nullptr, 10) * MiB;
+        }
+        else if (option == L"--files")
+        {
+            options.files = std::wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (option == L"--threads")
+        {
+            options.threads = std::wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (option == L"--directory")
+        {
+            options.directory = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return (options.size > 0) && (options.files > 0) && (options.threads > 0);
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t *argv[])
+{
+    BenchOptions options{};
+
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr,
+                     "Usage: aescrypt_bench [--size MiB] [--files count] "
+                     "[--threads count] [--directory path]\n");
+        return 2;
+    }
+
+    std::printf("%s %s benchmark\n\n",
+                Project_Name.c_str(),
+                Project_Version.c_str());
+
+    // Produce data that does not compress or repeat within a buffer
+    std::vector<char> pattern(Buffered_IO_Size * 8);
+    std::uint32_t state = 0x12345678;
+    for (auto &octet : pattern)
+    {
+        state = state * 1664525 + 1013904223;
+        octet = static_cast<char>(state >> 24);
+    }
+
+    bool result = MeasureKDF() &&
+                  MeasureStreaming(options, pattern) &&
+                  MeasureThreads(options, pattern) &&
+                  MeasureFiles(options, pattern) &&
+                  MeasureSmallFiles(options, pattern);
+
+    if (!result)
+    {
+        std::fprintf(stderr, "Benchmark failed\n");
+        return 1;
+    }
+
+    return 0;
+}